@@ -1,7 +1,48 @@
 import base64
+import struct
+import time
+import zlib
 import requests
 
 
+def packbits_encode(data):
+    out = bytearray()
+    i = 0
+    n = len(data)
+    while i < n:
+        run = 1
+        while i + run < n and run < 128 and data[i + run] == data[i]:
+            run += 1
+        if run >= 3:
+            out += bytes([257 - run, data[i]])
+            i += run
+        else:
+            lit = 0
+            while i + lit < n and lit < 128:
+                if i + lit + 2 < n and data[i + lit] == data[i + lit + 1] == data[i + lit + 2]:
+                    break
+                lit += 1
+            out.append(lit - 1)
+            out += data[i:i + lit]
+            i += lit
+    return bytes(out)
+
+
+def packbits_decode(data):
+    out = bytearray()
+    i = 0
+    while i < len(data):
+        n = data[i]
+        i += 1
+        if n < 128:
+            out += data[i:i + n + 1]
+            i += n + 1
+        elif n > 128:
+            out += bytes([data[i]]) * (257 - n)
+            i += 1
+    return bytes(out)
+
+
 class Display:
     def __init__(self, host):
         self.host = host
@@ -48,6 +89,107 @@ class Display:
         buffer_b64 = base64.b64encode(buf).decode('ascii')
         requests.post(f"{self.host}/canvas/buffer.json", json={'buffer': buffer_b64})
 
+    # Buffer names: "pixel", "text", "unit", "lineFlags"
+
+    def get_buffer_b64(self, name):
+        resp = requests.get(f"{self.host}/canvas/buffer/{name}")
+        return base64.b64decode(resp.text)
+
+    def set_buffer_b64(self, name, data):
+        requests.post(f"{self.host}/canvas/buffer/{name}", data=base64.b64encode(bytes(data)), headers={'Content-Type': 'text/plain'})
+
+    def get_buffer_raw(self, name, rle=False):
+        headers = {'Accept': 'application/octet-stream', 'Accept-Encoding': 'x-packbits' if rle else 'identity'}
+        # stream=True keeps requests from trying to decode the unknown Content-Encoding
+        resp = requests.get(f"{self.host}/canvas/buffer/{name}", headers=headers, stream=True)
+        data = resp.raw.read()
+        if resp.headers.get('Content-Encoding') == 'x-packbits':
+            data = packbits_decode(data)
+        return data
+
+    def set_buffer_raw(self, name, data, encoding=None):
+        # encoding: None, "x-packbits" or "deflate"
+        data = bytes(data)
+        headers = {'Content-Type': 'application/octet-stream'}
+        if encoding == "x-packbits":
+            data = packbits_encode(data)
+        elif encoding == "deflate":
+            data = zlib.compress(data, 9)
+        if encoding is not None:
+            headers['Content-Encoding'] = encoding
+        requests.post(f"{self.host}/canvas/buffer/{name}", data=data, headers=headers)
+
+    def set_pixel_rect_raw(self, x, y, w, h, data):
+        # Same rectangle layout as LiveCanvas.send_rect, uncompressed only
+        assert len(data) == w * h
+        headers = {'Content-Type': 'application/octet-stream', 'X-Canvas-Rect': f"{x},{y},{w},{h}"}
+        requests.post(f"{self.host}/canvas/buffer/pixel", data=bytes(data), headers=headers)
+
+    def measure_buffer_roundtrip(self, name, iterations=20):
+        # Mean seconds for writing and reading back the current buffer content per transfer mode
+        data = self.get_buffer_raw(name)
+        modes = {
+            'base64': (lambda: self.set_buffer_b64(name, data), lambda: self.get_buffer_b64(name)),
+            'raw': (lambda: self.set_buffer_raw(name, data), lambda: self.get_buffer_raw(name)),
+            'x-packbits': (lambda: self.set_buffer_raw(name, data, "x-packbits"), lambda: self.get_buffer_raw(name, rle=True)),
+            'deflate': (lambda: self.set_buffer_raw(name, data, "deflate"), lambda: self.get_buffer_raw(name)),
+        }
+        results = {}
+        for mode, (set_func, get_func) in modes.items():
+            start = time.perf_counter()
+            for i in range(iterations):
+                set_func()
+                assert get_func() == data
+            results[mode] = (time.perf_counter() - start) / iterations
+        return results
+
     def set_brightness(self, brightness):
         assert brightness in range(0, 256)
-        requests.post(f"{self.host}/canvas/brightness.json", json={'brightness': brightness})
\ No newline at end of file
+        requests.post(f"{self.host}/canvas/brightness.json", json={'brightness': brightness})
+
+class LiveCanvas:
+    """
+    Client for the /canvas/ws live frame endpoint.
+    Requires the websocket-client package.
+    """
+
+    FULL = 0x00
+    RANGE = 0x01
+    RECT = 0x02
+    SUBSCRIBE = 0x10
+
+    BUF_PIXEL = 0
+    BUF_TEXT = 1
+    BUF_UNIT = 2
+    BUF_LINE_FLAGS = 3
+
+    def __init__(self, host, timeout=5):
+        import websocket
+        url = host.replace("https://", "wss://").replace("http://", "ws://")
+        self.ws = websocket.create_connection(f"{url}/canvas/ws", timeout=timeout)
+
+    def close(self):
+        self.ws.close()
+
+    def send_full(self, buffer_id, data):
+        self.ws.send_binary(bytes([self.FULL, buffer_id]) + bytes(data))
+
+    def send_range(self, buffer_id, offset, data):
+        self.ws.send_binary(struct.pack("<BBI", self.RANGE, buffer_id, offset) + bytes(data))
+
+    def send_rect(self, x, y, w, h, data):
+        # x and w are in columns, y and h in bytes within a column,
+        # data is ordered column by column like the pixel buffer
+        assert len(data) == w * h
+        self.ws.send_binary(struct.pack("<BBHHHH", self.RECT, self.BUF_PIXEL, x, y, w, h) + bytes(data))
+
+    def subscribe(self, *buffer_ids):
+        mask = 0
+        for buffer_id in buffer_ids:
+            mask |= 1 << buffer_id
+        self.ws.send_binary(bytes([self.SUBSCRIBE, 0, mask]))
+
+    def receive(self):
+        # Returns (buffer_id, data) of the next buffer pushed by the display
+        msg = self.ws.recv()
+        return msg[1], msg[2:]
@@ -0,0 +1,52 @@
+import argparse
+import socket
+import struct
+import time
+
+# Stand-in for a sync leader display (see components/display_sync).
+# Broadcasts the local time base and a playlist position that advances
+# through a playlist with the given entry durations.
+
+PACKET_FORMAT = "<4sBBHqHHqI4x"
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("-g", "--group", type=str, default="239.255.67.83", help="Multicast group")
+    parser.add_argument("-p", "--port", type=int, default=6583, help="UDP port")
+    parser.add_argument("-i", "--interval", type=float, default=0.25, help="Broadcast interval in seconds")
+    parser.add_argument("-d", "--durations", type=str, default="", help="Comma-separated entry durations (s) of the first playlist group, e.g. 5,5,10")
+    args = parser.parse_args()
+
+    durations = [int(d) for d in args.durations.split(",") if d]
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+
+    sequence = 0
+    entry = 0
+    switch_time = time.time_ns() // 1000
+    next_tx = time.monotonic()
+
+    while True:
+        now_us = time.time_ns() // 1000
+        flags = 0
+        duration_ms = 0
+        if durations:
+            flags = 0x01
+            while now_us >= switch_time + durations[entry] * 1000000:
+                switch_time += durations[entry] * 1000000
+                entry = (entry + 1) % len(durations)
+                next_tx = time.monotonic() # Announce switches immediately
+            duration_ms = durations[entry] * 1000
+
+        if time.monotonic() >= next_tx:
+            sequence = (sequence + 1) & 0xFFFF
+            packet = struct.pack(PACKET_FORMAT, b"CHSY", 1, flags, sequence, time.time_ns() // 1000, 0, entry, switch_time, duration_ms)
+            sock.sendto(packet, (args.group, args.port))
+            next_tx += args.interval
+        time.sleep(0.001)
+
+
+if __name__ == "__main__":
+    main()
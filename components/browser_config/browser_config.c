@@ -1,4 +1,5 @@
 #include "esp_log.h"
+#include <math.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
 #include "cJSON.h"
@@ -17,51 +18,8 @@ static basic_auth_info_t* basic_auth_info;
 #endif
 
 // Embedded files - refer to CMakeLists.txt
-extern const uint8_t browser_config_html_start[] asm("_binary_browser_config_html_start");
-extern const uint8_t browser_config_html_end[]   asm("_binary_browser_config_html_end");
-
-
-// List of config options to present
-nvs_handle_t config_nvs_handle;
-config_entry_t config_entries[] = {
-    {.key = "hostname",        .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Network hostname. A-Z, a-z, 0-9 and - allowed."},
-    {.key = "sta_ssid",        .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WiFi SSID to connect to"},
-    {.key = "sta_anon_ident",  .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Anonymous Identity"},
-    {.key = "sta_ident",       .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Identity"},
-    {.key = "sta_pass",        .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WiFi password"},
-    {.key = "sta_phase2",      .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Phase 2 Auth. 0=TLS, 1=PEAP, 2=TTLS"},
-    {.key = "sta_phase2_ttls", .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Phase 2 TTLS. 0=None, 1=MSCHAPv2, 2=MSCHAP, 3=PAP, 4=CHAP"},
-    {.key = "sta_retries",     .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "Number of WiFi connection attempts before giving up and starting AP"},
-    {.key = "sta_fallb_ssid",  .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Secondary WiFi SSID if primary does not work"},
-    {.key = "sta_fallb_pass",  .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Secondary WiFi password"},
-    {.key = "ap_ssid",         .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "SSID of access-point WiFi when normal connection fails"},
-    {.key = "ap_pass",         .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Password of access-point WiFi"},
-    {.key = "ap_timeout",      .dataType = U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "Timeout until AP WiFi shuts down if no connection is made (in seconds). 0 for no timeout."},
-    {.key = "tg_bot_token",    .dataType = STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "Telegram Bot API token to use for controlling the display via Telegram"},
-    {.key = "tg_log_chnl_id",  .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Telegram chat ID of channel to log received texts to"},
-    {.key = "tg_log_chnl_en",  .dataType = U8 , .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to enable logging to Telegram channel, 0 to disable"},
-    {.key = "tg_deadtime",     .dataType = U8 , .flags = BC_FIELD_FLAGS_NONE, .comment = "Minimum dead time between Telegram messages in seconds"},
-    {.key = "disp_led_gamma",  .dataType = U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "Gamma value for LED color displays"},
-    {.key = "sel_conf_file",   .dataType = STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Configuration file for selection display"},
-    {.key = "cnv_preset_file", .dataType = STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Preset file for canvas"},
-    {.key = "startup_file",    .dataType = STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Startup default settings file"},
-    {.key = "wg_private_key",  .dataType = STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "WireGuard private key"},
-    {.key = "wg_public_key",   .dataType = STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "WireGuard public key"},
-    {.key = "wg_allowed_ip",   .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard allowed IP base"},
-    {.key = "wg_allowed_mask", .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard allowed IP subnet mask"},
-    {.key = "wg_listen_port",  .dataType = U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard listening port"},
-    {.key = "wg_endpoint",     .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard endpoint IP"},
-    {.key = "wg_endpnt_port",  .dataType = U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard endpoint port"},
-    {.key = "wg_keepalive",    .dataType = U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard keepalive period (in seconds)"},
-    {.key = "playlist_active", .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to enable playlist playback, 0 to disable"},
-    {.key = "pl_poll_url",     .dataType = STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "URL to fetch a playlist file from"},
-    {.key = "pl_poll_token",   .dataType = STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "API token to fetch playlist from server"},
-    {.key = "pl_poll_intvl",   .dataType = U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "Playlist polling interval (in seconds). Refreshes the given playlist URL or file periodically. 0 to disable."},
-    {.key = "playlist_file",   .dataType = STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Playlist file to use"},
-    {.key = "pl_save_to_file", .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to save downloaded playlist to specified playlist file, 0 to disable"},
-    {.key = "canvas_use_auth", .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to require authentication to use the canvas, 0 to disable"},
-    {.key = "deflt_bright",    .dataType = U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "Default brightness of the display"},
-};
+extern const uint8_t browser_config_html_gz_start[] asm("_binary_browser_config_html_gz_start");
+extern const uint8_t browser_config_html_gz_end[]   asm("_binary_browser_config_html_gz_end");
 
 
 static esp_err_t config_get_handler(httpd_req_t *req) {
@@ -69,9 +27,7 @@ static esp_err_t config_get_handler(httpd_req_t *req) {
     bool authenticated = basic_auth_handler(req, LOG_TAG);
     if (authenticated == false) return ESP_OK;
     
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char *)browser_config_html_start, browser_config_html_end - browser_config_html_start);
-    return ESP_OK;
+    return httpd_send_asset(req, "text/html", browser_config_html_gz_start, browser_config_html_gz_end, true);
 }
 
 static esp_err_t config_get_fields_handler(httpd_req_t *req) {
@@ -88,7 +44,8 @@ static esp_err_t config_get_fields_handler(httpd_req_t *req) {
     cJSON* json = cJSON_CreateObject();
     cJSON* fields_arr = cJSON_AddArrayToObject(json, "fields");
 
-    uint16_t num_fields = sizeof(config_entries) / sizeof(config_entries[0]);
+    uint16_t num_fields;
+    const config_entry_t* config_entries = config_get_entries(&num_fields);
 
     for (uint16_t i = 0; i < num_fields; i++) {
         cJSON* entry = cJSON_CreateObject();
@@ -97,124 +54,24 @@ static esp_err_t config_get_fields_handler(httpd_req_t *req) {
         cJSON_AddNumberToObject(entry, "flags", (uint32_t)config_entries[i].flags);
         cJSON_AddStringToObject(entry, "comment", config_entries[i].comment);
 
-        if (config_entries[i].dataType == BLOB) {
+        if (config_entries[i].dataType == CONFIG_TYPE_BLOB) {
             // Not yet implemented
-        } else if (config_entries[i].dataType == STR) {
-            // Query string length
-            size_t valueLength;
+        } else if (config_entries[i].dataType == CONFIG_TYPE_STR) {
             if (config_entries[i].flags & BC_FIELD_FLAGS_WRITE_ONLY) {
                 // The string "<unchanged>" will also be checked for when receiving field data.
                 // This means that a field can not actually have this value.
                 // This seems acceptable.
                 cJSON_AddStringToObject(entry, "value", "<unchanged>");
             } else {
-                esp_err_t ret = nvs_get_str(config_nvs_handle, config_entries[i].key, NULL, &valueLength);
-                if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                    cJSON_AddStringToObject(entry, "value", "");
-                } else {
-                    ESP_ERROR_CHECK(ret);
-                    // Allocate buffer for value
-                    char* value = malloc(valueLength);
-                    // Read value
-                    ESP_ERROR_CHECK(nvs_get_str(config_nvs_handle, config_entries[i].key, value, &valueLength));
-                    cJSON_AddStringToObject(entry, "value", value);
-                    // Free allocated memory
-                    free(value);
-                }
+                char* value = config_get_str_alloc(config_entries[i].key);
+                cJSON_AddStringToObject(entry, "value", (value != NULL) ? value : "");
+                free(value);
             }
         } else {
             // Numerical value
-            switch(config_entries[i].dataType) {
-                case I8: {
-                    int8_t value;
-                    esp_err_t ret = nvs_get_i8(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case U8: {
-                    uint8_t value;
-                    esp_err_t ret = nvs_get_u8(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case I16: {
-                    int16_t value;
-                    esp_err_t ret = nvs_get_i16(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case U16: {
-                    uint16_t value;
-                    esp_err_t ret = nvs_get_u16(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case I32: {
-                    int32_t value;
-                    esp_err_t ret = nvs_get_i32(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case U32: {
-                    uint32_t value;
-                    esp_err_t ret = nvs_get_u32(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case I64: {
-                    int64_t value;
-                    esp_err_t ret = nvs_get_i64(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                case U64: {
-                    uint64_t value;
-                    esp_err_t ret = nvs_get_u64(config_nvs_handle, config_entries[i].key, &value);
-                    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-                        cJSON_AddNumberToObject(entry, "value", 0);
-                    } else {
-                        ESP_ERROR_CHECK(ret);
-                        cJSON_AddNumberToObject(entry, "value", value);
-                    }
-                    break;
-                }
-                default: break;
-            }
+            int64_t value;
+            if (config_get_int(config_entries[i].key, &value) != ESP_OK) value = 0;
+            cJSON_AddNumberToObject(entry, "value", value);
         }
         cJSON_AddItemToArray(fields_arr, entry);
     }
@@ -255,120 +112,73 @@ static esp_err_t config_post_update_handler(httpd_req_t *req) {
         return abortRequest(req, HTTPD_500);
     }
 
+    // All fields are written in one transaction, so an invalid field leaves the configuration untouched
+    config_begin();
+
+    esp_err_t ret = ESP_OK;
     cJSON* entry = NULL;
     cJSON_ArrayForEach(entry, fields_arr) {
         if (!cJSON_IsObject(entry)) {
             ESP_LOGE(LOG_TAG, "Invalid object in 'fields' array");
-            cJSON_Delete(json);
-            return abortRequest(req, HTTPD_500);
+            ret = ESP_ERR_INVALID_ARG;
+            break;
         }
 
         cJSON* field_name = cJSON_GetObjectItem(entry, "name");
         if (!cJSON_IsString(field_name)) {
             ESP_LOGE(LOG_TAG, "'name' field is not a valid string");
-            cJSON_Delete(json);
-            return abortRequest(req, HTTPD_500);
+            ret = ESP_ERR_INVALID_ARG;
+            break;
         }
         char* fieldName = cJSON_GetStringValue(field_name);
 
-        cJSON* field_type = cJSON_GetObjectItem(entry, "type");
-        if (!cJSON_IsNumber(field_type)) {
-            ESP_LOGE(LOG_TAG, "'type' field is not a valid number");
-            cJSON_Delete(json);
-            return abortRequest(req, HTTPD_500);
+        // The type is taken from the registry, not from the request
+        const config_entry_t* config_entry = config_find_entry(fieldName);
+        if (config_entry == NULL) {
+            ESP_LOGE(LOG_TAG, "'%s' is not a known field", fieldName);
+            ret = ESP_ERR_NOT_FOUND;
+            break;
         }
-        config_data_type_t fieldType = (config_data_type_t)(int)cJSON_GetNumberValue(field_type);
 
         cJSON* field_value = cJSON_GetObjectItem(entry, "value");
-        switch(fieldType) {
-            case I8:
-            case U8:
-            case I16:
-            case U16:
-            case I32:
-            case U32:
-            case I64:
-            case U64: {
-                if (!cJSON_IsNumber(field_value)) {
-                    ESP_LOGE(LOG_TAG, "'%s' value is not a valid number", fieldName);
-                    cJSON_Delete(json);
-                    return abortRequest(req, HTTPD_500);
-                }
+        if (config_entry->dataType == CONFIG_TYPE_STR) {
+            if (!cJSON_IsString(field_value)) {
+                ESP_LOGE(LOG_TAG, "'%s' value is not a valid string", fieldName);
+                ret = ESP_ERR_INVALID_ARG;
                 break;
             }
-            case STR: {
-                if (!cJSON_IsString(field_value)) {
-                    ESP_LOGE(LOG_TAG, "'%s' value is not a valid string", fieldName);
-                    cJSON_Delete(json);
-                    return abortRequest(req, HTTPD_500);
-                }
+            char* value = cJSON_GetStringValue(field_value);
+            if (strcmp(value, "<unchanged>") == 0) continue;
+            ret = config_set_str(fieldName, value);
+        } else if (config_entry->dataType != CONFIG_TYPE_BLOB) {
+            // Fractions would be truncated and anything outside of int64_t can't be converted at all
+            double value = cJSON_GetNumberValue(field_value);
+            if (!cJSON_IsNumber(field_value) || !isfinite(value) || value != trunc(value)
+                || value < -9223372036854775808.0 || value >= 9223372036854775808.0) {
+                ESP_LOGE(LOG_TAG, "'%s' value is not a valid integer", fieldName);
+                ret = ESP_ERR_INVALID_ARG;
                 break;
             }
-            default: {
-                ESP_LOGE(LOG_TAG, "'%s' has unknown field type %d", fieldName, fieldType);
-                cJSON_Delete(json);
-                return abortRequest(req, HTTPD_500);
-            }
+            ret = config_set_int(fieldName, (int64_t)value);
+        } else {
+            ret = ESP_ERR_NOT_SUPPORTED;
         }
-
-        switch(fieldType) {
-            case I8: {
-                int8_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_i8(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case U8: {
-                uint8_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_u8(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case I16: {
-                int16_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_i16(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case U16: {
-                uint16_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_u16(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case I32: {
-                int32_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_i32(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case U32: {
-                uint32_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_u32(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case I64: {
-                int64_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_i64(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case U64: {
-                uint64_t value = cJSON_GetNumberValue(field_value);
-                ESP_ERROR_CHECK(nvs_set_u64(config_nvs_handle, fieldName, value));
-                break;
-            }
-            case STR: {
-                char* value = cJSON_GetStringValue(field_value);
-                if (strcmp(value, "<unchanged>") == 0) break;
-                ESP_ERROR_CHECK(nvs_set_str(config_nvs_handle, fieldName, value));
-                break;
-            }
-            default: {
-                ESP_LOGE(LOG_TAG, "'%s' has unknown field type %d", fieldName, fieldType);
-                cJSON_Delete(json);
-                return abortRequest(req, HTTPD_500);
-            }
+        if (ret != ESP_OK) {
+            ESP_LOGE(LOG_TAG, "Invalid value for '%s': %s", fieldName, esp_err_to_name(ret));
+            break;
         }
     }
-
-    nvs_commit(config_nvs_handle);
     cJSON_Delete(json);
 
+    if (ret != ESP_OK) {
+        config_abort();
+        return abortRequest(req, HTTPD_400);
+    }
+    if (config_commit() != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Failed to save configuration");
+        return abortRequest(req, HTTPD_500);
+    }
+
     // End response
     httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
@@ -393,7 +203,6 @@ static httpd_uri_t config_post_update = {
 };
 
 void browser_config_init(httpd_handle_t* server, nvs_handle_t* nvsHandle) {
-    config_nvs_handle = *nvsHandle;
     ESP_LOGI(LOG_TAG, "Init");
     ESP_LOGI(LOG_TAG, "Registering URI handlers");
 
@@ -1,16 +1,31 @@
 #include "esp_log.h"
+#include <string.h>
 #include "esp_ota_ops.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
+#include "freertos/queue.h"
 #include "sys/param.h"
+#include "mbedtls/sha256.h"
 #include "cJSON.h"
 
 #include "browser_ota.h"
+#include "ota_upload.h"
+#include "util_http_parse.h"
 #include "util_httpd.h"
 #include "settings_secret.h"
 
 #define LOG_TAG "BROWSER-OTA"
 
+// Received data is handed to the flash writer task in chunks of this size,
+// while one chunk is being written the next one is received
+#define OTA_CHUNK_SIZE 4096
+#define OTA_NUM_CHUNKS 2
+
+typedef struct {
+    uint8_t* data;
+    size_t len;
+} ota_chunk_t;
+
 static uint32_t ota_payload_length = 0;
 static uint32_t ota_rx_len = 0;
 static uint8_t ota_success = 0;
@@ -19,9 +34,23 @@ static EventGroupHandle_t restart_event_group;
 static TaskHandle_t systemRestartTaskHandle;
 #define restart_BIT BIT0
 
+// State of the update in progress, kept across requests so an interrupted upload can be resumed
+static esp_ota_handle_t ota_handle;
+static const esp_partition_t* ota_partition = NULL;
+static uint8_t ota_pending = 0;
+static uint32_t ota_written = 0;
+static uint8_t ota_check_sha = 0;
+static uint8_t ota_expected_sha[OTA_SHA256_LEN];
+static mbedtls_sha256_context ota_sha;
+
+static QueueHandle_t ota_full_queue;
+static QueueHandle_t ota_free_queue;
+static TaskHandle_t otaWriterTaskHandle;
+static volatile esp_err_t ota_write_err = ESP_OK;
+
 // Embedded files - refer to CMakeLists.txt
-extern const uint8_t browser_ota_html_start[] asm("_binary_browser_ota_html_start");
-extern const uint8_t browser_ota_html_end[]   asm("_binary_browser_ota_html_end");
+extern const uint8_t browser_ota_html_gz_start[] asm("_binary_browser_ota_html_gz_start");
+extern const uint8_t browser_ota_html_gz_end[]   asm("_binary_browser_ota_html_gz_end");
 extern const uint8_t spinner_gif_start[] asm("_binary_spinner_gif_start");
 extern const uint8_t spinner_gif_end[]   asm("_binary_spinner_gif_end");
 
@@ -39,14 +68,30 @@ static void systemRestartTask(void* arg) {
     }
 }
 
+static void otaWriterTask(void* arg) {
+    ota_chunk_t chunk;
+    while (1) {
+        if (!xQueueReceive(ota_full_queue, &chunk, portMAX_DELAY)) continue;
+        // After an error, chunks are only passed back until the upload is aborted
+        if (ota_write_err == ESP_OK) {
+            ota_write_err = esp_ota_write(ota_handle, chunk.data, chunk.len);
+            if (ota_write_err == ESP_OK) {
+                mbedtls_sha256_update(&ota_sha, chunk.data, chunk.len);
+                ota_written += chunk.len;
+            } else {
+                ESP_LOGE(LOG_TAG, "Failed to write OTA data, status %d", ota_write_err);
+            }
+        }
+        xQueueSend(ota_free_queue, &chunk, portMAX_DELAY);
+    }
+}
+
 static esp_err_t ota_get_handler(httpd_req_t *req) {
     // If authenticated == false, the handler already takes care of the server response
     bool authenticated = basic_auth_handler(req, LOG_TAG);
     if (authenticated == false) return ESP_OK;
 
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char *)browser_ota_html_start, browser_ota_html_end - browser_ota_html_start);
-    return ESP_OK;
+    return httpd_send_asset(req, "text/html", browser_ota_html_gz_start, browser_ota_html_gz_end, true);
 }
 
 static esp_err_t ota_spinner_get_handler(httpd_req_t *req) {
@@ -55,30 +100,106 @@ static esp_err_t ota_spinner_get_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-static esp_err_t ota_length_post_handler(httpd_req_t *req) {
-    // If authenticated == false, the handler already takes care of the server response
-    bool authenticated = basic_auth_handler(req, LOG_TAG);
-    if (authenticated == false) return ESP_OK;
+static void ota_abort(void) {
+    /*
+     * Give up on the pending update, the next upload has to start from the beginning
+     */
+    esp_ota_abort(ota_handle);
+    mbedtls_sha256_free(&ota_sha);
+    ota_pending = 0;
+    ota_written = 0;
+}
 
-    char buf[10];
-    size_t length = req->content_len;
-    ESP_LOGD(LOG_TAG, "Content length: %d bytes", length);
-    
-    if (length > 9) {
-        return abortRequest(req, "413 Payload Too Large");
+static esp_err_t ota_begin(size_t total) {
+    /*
+     * Start a new update with an image of total bytes (0 if not known yet), replacing a pending one
+     */
+    if (ota_pending) ota_abort();
+
+    ota_partition = esp_ota_get_next_update_partition(NULL);
+    if (!ota_partition) {
+        ESP_LOGE(LOG_TAG, "Failed to find a suitable OTA partition, aborting");
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (total > ota_partition->size) {
+        ESP_LOGE(LOG_TAG, "Image doesn't fit into OTA partition, aborting");
+        return ESP_ERR_INVALID_SIZE;
     }
 
-    int ret = httpd_req_recv(req, buf, length);
-    if (ret <= 0) {
-        return abortRequest(req, HTTPD_500);
+    // Erase each sector just before it is written instead of the whole partition up front,
+    // this way erasing happens in the writer task while the next chunk is received
+    esp_err_t err = esp_ota_begin(ota_partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Failed to initialise OTA, status %d", err);
+        return err;
     }
-    buf[length] = 0x00;
+    ESP_LOGI(LOG_TAG, "Writing %d bytes to partition subtype %d at offset 0x%lx", total, ota_partition->subtype, ota_partition->address);
+
+    mbedtls_sha256_init(&ota_sha);
+    mbedtls_sha256_starts(&ota_sha, 0);
+    ota_payload_length = total;
+    ota_written = 0;
+    ota_write_err = ESP_OK;
+    ota_pending = 1;
+    return ESP_OK;
+}
 
-    ota_payload_length = atoi(buf);
-    ESP_LOGI(LOG_TAG, "OTA payload length: %ld bytes", ota_payload_length);
+static esp_err_t ota_finish(void) {
+    /*
+     * Check the complete image and make it the next boot partition
+     */
+    uint8_t sha[OTA_SHA256_LEN];
+    mbedtls_sha256_finish(&ota_sha, sha);
+    mbedtls_sha256_free(&ota_sha);
+    ota_pending = 0;
+
+    if (ota_check_sha && memcmp(sha, ota_expected_sha, OTA_SHA256_LEN) != 0) {
+        ESP_LOGE(LOG_TAG, "SHA-256 of image doesn't match, aborting");
+        esp_ota_abort(ota_handle);
+        return ESP_ERR_INVALID_CRC;
+    }
 
-    // End response
-    httpd_resp_send_chunk(req, NULL, 0);
+    if (esp_ota_end(ota_handle) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Failed to end OTA, aborting");
+        return ESP_FAIL;
+    }
+
+    // Update the boot partition
+    if (esp_ota_set_boot_partition(ota_partition) != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Failed to set boot partition, aborting");
+        return ESP_FAIL;
+    }
+    const esp_partition_t *boot_partition = esp_ota_get_boot_partition();
+    ESP_LOGI(LOG_TAG, "Next boot partition subtype %d at offset 0x%lx", boot_partition->subtype, boot_partition->address);
+    xEventGroupSetBits(restart_event_group, restart_BIT);
+    ota_success = 1;
+    ESP_LOGI(LOG_TAG, "OTA success! Restart flag set.");
+    return ESP_OK;
+}
+
+static esp_err_t ota_pass_chunk(ota_chunk_t* chunk) {
+    /*
+     * Hand the chunk to the writer task and continue with the other one
+     */
+    xQueueSend(ota_full_queue, chunk, portMAX_DELAY);
+    xQueueReceive(ota_free_queue, chunk, portMAX_DELAY);
+    chunk->len = 0;
+    return ota_write_err;
+}
+
+static esp_err_t ota_copy_to_chunk(ota_chunk_t* chunk, const uint8_t* data, size_t len) {
+    /*
+     * Append data to the chunk, passing it on whenever it is full
+     */
+    while (len > 0) {
+        size_t n = MIN(len, OTA_CHUNK_SIZE - chunk->len);
+        memcpy(&chunk->data[chunk->len], data, n);
+        chunk->len += n;
+        ota_rx_len += n;
+        data += n;
+        len -= n;
+        if (chunk->len == OTA_CHUNK_SIZE && ota_pass_chunk(chunk) != ESP_OK) return ota_write_err;
+    }
     return ESP_OK;
 }
 
@@ -87,109 +208,168 @@ static esp_err_t ota_post_handler(httpd_req_t *req) {
     bool authenticated = basic_auth_handler(req, LOG_TAG);
     if (authenticated == false) return ESP_OK;
 
-    esp_ota_handle_t ota_handle;        // OTA flash handle
-    char ota_buf[1024];                 // OTA data buffer for flashing
+    /*
+     * The image is either sent as the body of an application/octet-stream request
+     * or as the only file of a multipart/form-data request.
+     * Raw uploads may carry a Content-Range header to resume an interrupted upload
+     * (the number of bytes already written is reported by /ota/status)
+     * and an X-OTA-SHA256 header with the hex digest of the whole image.
+     */
+    ota_chunk_t chunks[OTA_NUM_CHUNKS];  // Buffers shared with the writer task
+    ota_chunk_t chunk;                   // Buffer currently being received into
+    http_multipart_t multipart;
+    uint8_t recv_buf[1024];              // Multipart data is received here and parsed
+    char hdr[128];
+    uint8_t is_raw = httpd_req_is_raw(req);
+    uint8_t form_started = 0;           // Whether the update was begun for the multipart file
     size_t length = req->content_len;   // Total POST payload length
     size_t remaining = length;          // Remaining POST payload bytes to be read
-    int ret = 0;                        // Number of received bytes per block
-    uint8_t req_body_started = 0;       // Whether the form data headers have already been skipped
-    uint16_t chunk_length = 0;          // Length of the current OTA chunk
+    const char* error = NULL;
+    esp_err_t err;
+    int ret;
 
-    ota_rx_len = 0;
     ota_success = 0;
-    esp_err_t err;
+    ESP_LOGD(LOG_TAG, "Content length: %d bytes", length);
 
-    // Abort if OTA payload length has not been announced
-    if(ota_payload_length == 0) {
-        ESP_LOGE(LOG_TAG, "Trying to start OTA without announcing OTA payload length, aborting");
-        return abortRequest(req, HTTPD_500);
-    }
+    if (is_raw) {
+        size_t start = 0;
+        size_t end = length - 1;
+        size_t total = length;
+        err = httpd_req_get_hdr_value_str(req, "Content-Range", hdr, sizeof(hdr));
+        if (err != ESP_ERR_NOT_FOUND) {
+            if (err != ESP_OK || ota_parse_content_range(hdr, &start, &end, &total) != 0) return abortRequest(req, HTTPD_400);
+        }
 
-    // OTA partition handle
-    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
-    if(!update_partition) {
-        ESP_LOGE(LOG_TAG, "Failed to find a suitable OTA partition, aborting");
-        return abortRequest(req, HTTPD_500);
+        switch (ota_check_resume(ota_pending, ota_written, ota_payload_length, start, end, total, length)) {
+            case OTA_RESUME_NEW: {
+                err = httpd_req_get_hdr_value_str(req, "X-OTA-SHA256", hdr, sizeof(hdr));
+                ota_check_sha = (err != ESP_ERR_NOT_FOUND);
+                if (ota_check_sha && (err != ESP_OK || ota_parse_sha256(hdr, ota_expected_sha) != 0)) return abortRequest(req, HTTPD_400);
+                err = ota_begin(total);
+                if (err == ESP_ERR_INVALID_SIZE) return abortRequest(req, "413 Payload Too Large");
+                if (err != ESP_OK) return abortRequest(req, HTTPD_500);
+                break;
+            }
+
+            case OTA_RESUME_CONTINUE: {
+                ESP_LOGI(LOG_TAG, "Resuming OTA at %d of %d bytes", start, total);
+                break;
+            }
+
+            default: {
+                ESP_LOGE(LOG_TAG, "Upload doesn't continue the pending OTA, aborting");
+                return abortRequest(req, "416 Range Not Satisfiable");
+            }
+        }
+        ota_rx_len = start;
+    } else {
+        // The end of the image is found by the multipart parser
+        err = httpd_req_get_hdr_value_str(req, "Content-Type", hdr, sizeof(hdr));
+        if (err != ESP_OK || http_multipart_init(&multipart, hdr) != 0) {
+            ESP_LOGE(LOG_TAG, "No multipart boundary in request, aborting");
+            return abortRequest(req, HTTPD_400);
+        }
     }
 
-    ESP_LOGD(LOG_TAG, "Content length: %d bytes", length);
+    for (uint8_t i = 0; i < OTA_NUM_CHUNKS; i++) {
+        chunks[i].data = malloc(OTA_CHUNK_SIZE);
+        chunks[i].len = 0;
+    }
+    for (uint8_t i = 0; i < OTA_NUM_CHUNKS; i++) {
+        if (chunks[i].data == NULL) {
+            ESP_LOGE(LOG_TAG, "Failed to allocate OTA buffers, aborting");
+            for (uint8_t j = 0; j < OTA_NUM_CHUNKS; j++) free(chunks[j].data);
+            return abortRequest(req, HTTPD_500);
+        }
+        xQueueSend(ota_free_queue, &chunks[i], 0);
+    }
 
-    while (remaining > 0) {
-        ret = httpd_req_recv(req, ota_buf, MIN(remaining, sizeof(ota_buf)));
+    xQueueReceive(ota_free_queue, &chunk, portMAX_DELAY);
+    while (remaining > 0 && error == NULL) {
+        // Raw data is received straight into the chunk
+        uint8_t* dest = is_raw ? &chunk.data[chunk.len] : recv_buf;
+        size_t dest_size = is_raw ? (OTA_CHUNK_SIZE - chunk.len) : sizeof(recv_buf);
+        ret = httpd_req_recv(req, (char*)dest, MIN(remaining, dest_size));
         if (ret <= 0) {
             if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
                 ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
                 continue;
             }
             ESP_LOGI(LOG_TAG, "Receive error, aborting");
-            return abortRequest(req, HTTPD_500);
+            error = HTTPD_500;
+            break;
         }
         remaining -= ret;
-        ESP_LOGI(LOG_TAG, "Received %d of %d bytes", (length - remaining), length);
-
-        if(!req_body_started) {
-            // We need to wait for the headers to be complete
-            // Check if the end of headers is in this block
-            char *body_start_p = strstr(ota_buf, "\r\n\r\n") + 4;
-            if (!body_start_p) {
-                // Header is not yet finished
-                continue;
-            }
-            req_body_started = 1;
-            // How many bytes are left to read in this partial OTA payload
-            uint32_t body_part_len = ret - (body_start_p - ota_buf);
-
-            if((remaining + body_part_len) < ota_payload_length) {
-                // Expected total payload length is smaller than previously announced
-                ESP_LOGE(LOG_TAG, "POST payload length is smaller than previously announced OTA payload length, aborting");
-                return abortRequest(req, HTTPD_500);
-            }
+        ESP_LOGD(LOG_TAG, "Received %d of %d bytes", (length - remaining), length);
 
-            // Initiate OTA
-            err = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &ota_handle);
-            if (err != ESP_OK) {
-                ESP_LOGE(LOG_TAG, "Failed to initialise OTA, status %d", err);
-                return abortRequest(req, HTTPD_500);
-            }
-            ESP_LOGI(LOG_TAG, "Writing to partition subtype %d at offset 0x%lx", update_partition->subtype, update_partition->address);
-
-            // Write the first chunk
-            chunk_length = MIN((ota_payload_length - ota_rx_len), body_part_len);
-            err = esp_ota_write(ota_handle, body_start_p, chunk_length);
-            if (err != ESP_OK) {
-                ESP_LOGE(LOG_TAG, "Failed to write OTA data, status %d", err);
-                return abortRequest(req, HTTPD_500);
-            }
-            ota_rx_len += chunk_length;
-        } else {
-            // Header has already been skipped, just receive OTA data until the payload size is reached
-            chunk_length = MIN((ota_payload_length - ota_rx_len), ret);
-            err = esp_ota_write(ota_handle, ota_buf, chunk_length);
-            if (err != ESP_OK) {
-                ESP_LOGE(LOG_TAG, "Failed to write OTA data, status %d", err);
-                return abortRequest(req, HTTPD_500);
+        if (is_raw) {
+            chunk.len += ret;
+            ota_rx_len += ret;
+            if ((chunk.len == OTA_CHUNK_SIZE || remaining == 0) && ota_pass_chunk(&chunk) != ESP_OK) error = HTTPD_500;
+            continue;
+        }
+
+        size_t pos = 0;
+        while (pos < ret && error == NULL) {
+            const uint8_t* data;
+            size_t data_len;
+            pos += http_multipart_parse(&multipart, &recv_buf[pos], ret - pos, &data, &data_len);
+            if (multipart.hasPart && !form_started) {
+                // The part header is complete, the image size isn't known until its end
+                err = ota_begin(0);
+                if (err != ESP_OK) {
+                    error = HTTPD_500;
+                    break;
+                }
+                form_started = 1;
+                ota_check_sha = 0;
+                ota_rx_len = 0;
             }
-            ota_rx_len += chunk_length;
+            if (data_len > 0 && ota_copy_to_chunk(&chunk, data, data_len) != ESP_OK) error = HTTPD_500;
         }
     }
 
-    // Rx has finished, end OTA
-    if (esp_ota_end(ota_handle) == ESP_OK) {
-        // Update the boot partition
-        if (esp_ota_set_boot_partition(update_partition) == ESP_OK) {
-            const esp_partition_t *boot_partition = esp_ota_get_boot_partition();
-            ESP_LOGI(LOG_TAG, "Next boot partition subtype %d at offset 0x%lx", boot_partition->subtype, boot_partition->address);
-            xEventGroupSetBits(restart_event_group, restart_BIT);
-            ota_success = 1;
-            ESP_LOGI(LOG_TAG, "OTA success! Restart flag set.");
-        } else {
-            ESP_LOGE(LOG_TAG, "Failed to set boot partition, aborting");
-            return abortRequest(req, HTTPD_500);
-        }
+    // Data received before an error is written as well, so a resumed upload can continue after it
+    if (chunk.len > 0) {
+        xQueueSend(ota_full_queue, &chunk, portMAX_DELAY);
     } else {
-        ESP_LOGE(LOG_TAG, "Failed to end OTA, aborting");
+        xQueueSend(ota_free_queue, &chunk, portMAX_DELAY);
+    }
+
+    // Wait for the writer task to return all chunks
+    for (uint8_t i = 0; i < OTA_NUM_CHUNKS; i++) {
+        xQueueReceive(ota_free_queue, &chunk, portMAX_DELAY);
+        free(chunk.data);
+    }
+
+    if (ota_pending && ota_write_err != ESP_OK) {
+        ota_abort();
         return abortRequest(req, HTTPD_500);
     }
+    if (!is_raw && error == NULL) {
+        if (multipart.state == HTTP_MULTIPART_DONE && multipart.hasPart) {
+            ota_payload_length = ota_written;
+        } else {
+            ESP_LOGE(LOG_TAG, "Multipart body ended before the end of the image, aborting");
+            error = HTTPD_400;
+        }
+    }
+    if (error != NULL) {
+        // Form uploads have no offset to resume from
+        if (!is_raw && ota_pending) ota_abort();
+        return abortRequest(req, error);
+    }
+
+    if (ota_written < ota_payload_length) {
+        // The rest of the image follows in another request
+        ESP_LOGI(LOG_TAG, "Written %ld of %ld bytes", ota_written, ota_payload_length);
+        httpd_resp_send_chunk(req, NULL, 0);
+        return ESP_OK;
+    }
+
+    err = ota_finish();
+    if (err == ESP_ERR_INVALID_CRC) return abortRequest(req, HTTPD_400);
+    if (err != ESP_OK) return abortRequest(req, HTTPD_500);
 
     // End response
     httpd_resp_send_chunk(req, NULL, 0);
@@ -204,6 +384,8 @@ static esp_err_t ota_status_get_handler(httpd_req_t *req) {
     cJSON* json = cJSON_CreateObject();
     cJSON_AddNumberToObject(json, "payload_length", ota_payload_length);
     cJSON_AddNumberToObject(json, "received", ota_rx_len);
+    cJSON_AddNumberToObject(json, "written", ota_written);
+    cJSON_AddBoolToObject  (json, "pending", ota_pending);
     cJSON_AddBoolToObject  (json, "success", ota_success);
 
     char *resp = cJSON_Print(json);
@@ -250,12 +432,6 @@ static httpd_uri_t ota_spinner_get = {
     .handler   = ota_spinner_get_handler
 };
 
-static httpd_uri_t ota_length_post = {
-    .uri       = "/ota/length",
-    .method    = HTTP_POST,
-    .handler   = ota_length_post_handler
-};
-
 static httpd_uri_t ota_post = {
     .uri       = "/ota",
     .method    = HTTP_POST,
@@ -291,7 +467,6 @@ void browser_ota_init(httpd_handle_t* server) {
     basic_auth_info->realm    = "Cheetah Firmware Update";
     
     ota_get.user_ctx = basic_auth_info;
-    ota_length_post.user_ctx = basic_auth_info;
     ota_post.user_ctx = basic_auth_info;
     ota_status_get.user_ctx = basic_auth_info;
     ota_verify_get.user_ctx = basic_auth_info;
@@ -300,7 +475,6 @@ void browser_ota_init(httpd_handle_t* server) {
 
     httpd_register_uri_handler(*server, &ota_get);
     httpd_register_uri_handler(*server, &ota_spinner_get);
-    httpd_register_uri_handler(*server, &ota_length_post);
     httpd_register_uri_handler(*server, &ota_post);
     httpd_register_uri_handler(*server, &ota_status_get);
     httpd_register_uri_handler(*server, &ota_verify_get);
@@ -309,16 +483,25 @@ void browser_ota_init(httpd_handle_t* server) {
     
     ESP_LOGI(LOG_TAG, "Creating restart task");
     xTaskCreatePinnedToCore(&systemRestartTask, "restartTask", 2048, NULL, 5, &systemRestartTaskHandle, 0);
+
+    ESP_LOGI(LOG_TAG, "Creating flash writer task");
+    ota_full_queue = xQueueCreate(OTA_NUM_CHUNKS, sizeof(ota_chunk_t));
+    ota_free_queue = xQueueCreate(OTA_NUM_CHUNKS, sizeof(ota_chunk_t));
+    xTaskCreatePinnedToCore(&otaWriterTask, "otaWriterTask", 4096, NULL, 5, &otaWriterTaskHandle, 0);
 }
 
 void browser_ota_deinit(void) {
     ESP_LOGI(LOG_TAG, "De-Init");
     ESP_LOGI(LOG_TAG, "Deleting restart task");
     vTaskDelete(systemRestartTaskHandle);
+    ESP_LOGI(LOG_TAG, "Deleting flash writer task");
+    vTaskDelete(otaWriterTaskHandle);
+    vQueueDelete(ota_full_queue);
+    vQueueDelete(ota_free_queue);
+    if (ota_pending) ota_abort();
     ESP_LOGI(LOG_TAG, "Unregistering URI handlers");
     httpd_unregister_uri_handler(*ota_server, ota_get.uri, ota_get.method);
     httpd_unregister_uri_handler(*ota_server, ota_spinner_get.uri, ota_spinner_get.method);
-    httpd_unregister_uri_handler(*ota_server, ota_length_post.uri, ota_length_post.method);
     httpd_unregister_uri_handler(*ota_server, ota_post.uri, ota_post.method);
     httpd_unregister_uri_handler(*ota_server, ota_status_get.uri, ota_status_get.method);
     httpd_unregister_uri_handler(*ota_server, ota_verify_get.uri, ota_verify_get.method);
@@ -0,0 +1,21 @@
+#pragma once
+
+/*
+ * Request parsing and resume logic for OTA uploads.
+ * Kept free of ESP-IDF dependencies so it can be tested on the host.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define OTA_SHA256_LEN 32
+
+typedef enum {
+    OTA_RESUME_INVALID = 0, // Range doesn't fit the pending update or the request
+    OTA_RESUME_NEW,         // Start a new update from the beginning
+    OTA_RESUME_CONTINUE,    // Continue the pending update
+} ota_resume_t;
+
+int ota_parse_content_range(const char* value, size_t* start, size_t* end, size_t* total);
+int ota_parse_sha256(const char* hex, uint8_t* out);
+ota_resume_t ota_check_resume(uint8_t pending, size_t written, size_t pendingTotal, size_t start, size_t end, size_t total, size_t contentLen);
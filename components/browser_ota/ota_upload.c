@@ -0,0 +1,65 @@
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "ota_upload.h"
+
+
+static int _ota_parse_number(const char** str, size_t* value) {
+    char* end;
+    if (!isdigit((unsigned char)**str)) return -1;
+    errno = 0;
+    unsigned long long result = strtoull(*str, &end, 10);
+    if (errno == ERANGE || result > SIZE_MAX) return -1;
+    *value = result;
+    *str = end;
+    return 0;
+}
+
+int ota_parse_content_range(const char* value, size_t* start, size_t* end, size_t* total) {
+    /*
+     * Parse a Content-Range header of the form "bytes <start>-<end>/<total>", end is inclusive.
+     * Returns 0 on success or -1 if the header is malformed or the range is impossible.
+     */
+    if (strncmp(value, "bytes ", 6) != 0) return -1;
+    value += 6;
+    if (_ota_parse_number(&value, start) != 0) return -1;
+    if (*value++ != '-') return -1;
+    if (_ota_parse_number(&value, end) != 0) return -1;
+    if (*value++ != '/') return -1;
+    if (_ota_parse_number(&value, total) != 0) return -1;
+    if (*value != 0x00) return -1;
+    if (*start > *end || *end >= *total) return -1;
+    return 0;
+}
+
+int ota_parse_sha256(const char* hex, uint8_t* out) {
+    /*
+     * Parse a hex encoded SHA-256 digest.
+     * Returns 0 on success or -1 if hex is not exactly 64 hex digits.
+     */
+    if (strlen(hex) != OTA_SHA256_LEN * 2) return -1;
+    for (uint8_t i = 0; i < OTA_SHA256_LEN * 2; i++) {
+        char c = tolower((unsigned char)hex[i]);
+        uint8_t nibble;
+        if (c >= '0' && c <= '9') nibble = c - '0';
+        else if (c >= 'a' && c <= 'f') nibble = c - 'a' + 10;
+        else return -1;
+        if (i % 2 == 0) out[i / 2] = nibble << 4;
+        else out[i / 2] |= nibble;
+    }
+    return 0;
+}
+
+ota_resume_t ota_check_resume(uint8_t pending, size_t written, size_t pendingTotal, size_t start, size_t end, size_t total, size_t contentLen) {
+    /*
+     * Decide what to do with an upload covering bytes start to end (inclusive) of an image of total bytes.
+     * An upload starting at 0 always begins a new update, anything else
+     * has to continue exactly where the pending update of the same image stopped.
+     */
+    if (contentLen == 0 || contentLen != end - start + 1) return OTA_RESUME_INVALID;
+    if (start == 0) return OTA_RESUME_NEW;
+    if (!pending || start != written || total != pendingTotal) return OTA_RESUME_INVALID;
+    return OTA_RESUME_CONTINUE;
+}
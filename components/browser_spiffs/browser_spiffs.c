@@ -5,10 +5,13 @@
 #include "esp_spiffs.h"
 #include "sys/param.h"
 #include "dirent.h"
+#include <fcntl.h>
+#include <string.h>
 #include "cJSON.h"
 
 #include "browser_spiffs.h"
 #include "util_httpd.h"
+#include "util_http_parse.h"
 #include "util_generic.h"
 #include "settings_secret.h"
 
@@ -17,14 +20,13 @@
 #define MAX_FILENAME_LENGTH 12 // 8.3 filename
 
 static httpd_handle_t* spiffs_server;
-static uint32_t upload_payload_length = 0;
 static uint32_t upload_rx_len = 0;
 static uint8_t upload_success = 0;
 static char upload_filename[MAX_FILENAME_LENGTH + 1] = { 0x00 };
 
 // Embedded files - refer to CMakeLists.txt
-extern const uint8_t browser_spiffs_html_start[] asm("_binary_browser_spiffs_html_start");
-extern const uint8_t browser_spiffs_html_end[]   asm("_binary_browser_spiffs_html_end");
+extern const uint8_t browser_spiffs_html_gz_start[] asm("_binary_browser_spiffs_html_gz_start");
+extern const uint8_t browser_spiffs_html_gz_end[]   asm("_binary_browser_spiffs_html_gz_end");
 
 
 static esp_err_t spiffs_get_handler(httpd_req_t *req) {
@@ -32,9 +34,7 @@ static esp_err_t spiffs_get_handler(httpd_req_t *req) {
     bool authenticated = basic_auth_handler(req, LOG_TAG);
     if (authenticated == false) return ESP_OK;
     
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char *)browser_spiffs_html_start, browser_spiffs_html_end - browser_spiffs_html_start);
-    return ESP_OK;
+    return httpd_send_asset(req, "text/html", browser_spiffs_html_gz_start, browser_spiffs_html_gz_end, true);
 }
 
 static esp_err_t spiffs_files_get_handler(httpd_req_t *req) {
@@ -90,45 +90,16 @@ static esp_err_t spiffs_download_get_handler(httpd_req_t *req) {
     char* disposition_header;
     asprintf(&disposition_header, "attachment; filename=\"%s\"", file_name);
     httpd_resp_set_hdr(req, "Content-Disposition", disposition_header);
+    httpd_resp_set_type(req, "application/octet-stream");
 
     char file_path[21]; // "/spiffs/" + 8.3 filename + null
     snprintf(file_path, 21, "/spiffs/%s", file_name);
-    ESP_LOGI(LOG_TAG, "Opening file: %s", file_path);
-    FILE* file = fopen(file_path, "r");
-    if (file == NULL) {
-        ESP_LOGE(LOG_TAG, "Failed to open file");
-        return abortRequest(req, HTTPD_500);
-    }
+    ESP_LOGI(LOG_TAG, "Sending file: %s", file_path);
 
-    size_t chunk_size = 0;
-    char file_buf[1024];
-
-    do {
-        /* Read file in chunks into the file buffer */
-        chunk_size = fread(file_buf, 1, 1024, file);
-
-        if (chunk_size > 0) {
-            /* Send the buffer contents as HTTP response chunk */
-            if (httpd_resp_send_chunk(req, file_buf, chunk_size) != ESP_OK) {
-                fclose(file);
-                ESP_LOGE(LOG_TAG, "Failed to send file chunk");
-                /* Abort sending file */
-                httpd_resp_sendstr_chunk(req, NULL);
-                /* Respond with 500 Internal Server Error */
-                free(disposition_header);
-                return abortRequest(req, HTTPD_500);
-           }
-        }
-
-        /* Keep looping till the whole file is sent */
-    } while (chunk_size != 0);
-
-    // Close connection
-    httpd_resp_send_chunk(req, NULL, 0);
-
-    fclose(file);
+    // Range and If-None-Match are supported, so clients can resume downloads and revalidate cached files
+    esp_err_t ret = httpd_send_file(LOG_TAG, req, file_path);
     free(disposition_header);
-    return ESP_OK;
+    return ret;
 }
 
 static esp_err_t spiffs_delete_post_handler(httpd_req_t *req) {
@@ -138,7 +109,9 @@ static esp_err_t spiffs_delete_post_handler(httpd_req_t *req) {
 
     ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
 
-    char* buf = malloc(req->content_len);
+    // cJSON needs the body null terminated
+    char* buf = calloc(1, req->content_len + 1);
+    if (buf == NULL) return abortRequest(req, HTTPD_500);
     httpd_req_recv(req, buf, req->content_len);
 
     cJSON* json = cJSON_Parse(buf);
@@ -178,7 +151,9 @@ static esp_err_t spiffs_upload_metadata_post_handler(httpd_req_t *req) {
 
     ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
 
-    char* buf = malloc(req->content_len);
+    // cJSON needs the body null terminated
+    char* buf = calloc(1, req->content_len + 1);
+    if (buf == NULL) return abortRequest(req, HTTPD_500);
     httpd_req_recv(req, buf, req->content_len);
 
     cJSON* json = cJSON_Parse(buf);
@@ -198,12 +173,7 @@ static esp_err_t spiffs_upload_metadata_post_handler(httpd_req_t *req) {
     memset(upload_filename, 0x00, MAX_FILENAME_LENGTH + 1);
     strncpy(upload_filename, file_name, MAX_FILENAME_LENGTH);
 
-    cJSON* file_size_int = cJSON_GetObjectItem(json, "file_size");
-    if (!cJSON_IsNumber(file_size_int)) {
-        cJSON_Delete(json);
-        return abortRequest(req, HTTPD_500);
-    }
-    upload_payload_length = cJSON_GetNumberValue(file_size_int);
+    // file_size is still sent by older clients, but the end of the upload is found by the multipart parser
 
     cJSON_Delete(json);
 
@@ -217,94 +187,101 @@ static esp_err_t spiffs_upload_post_handler(httpd_req_t *req) {
     bool authenticated = basic_auth_handler(req, LOG_TAG);
     if (authenticated == false) return ESP_OK;
 
-    char file_buf[1024];                // Data buffer for storing the file
+    http_multipart_t multipart;
+    char hdr[128];
+    char file_path[21];                 // "/spiffs/" + 8.3 filename + null
     size_t length = req->content_len;   // Total POST payload length
     size_t remaining = length;          // Remaining POST payload bytes to be read
     int ret = 0;                        // Number of received bytes per block
-    uint8_t req_body_started = 0;       // Whether the form data headers have already been skipped
-    uint16_t chunk_length = 0;          // Length of the current file chunk
+    int fd = -1;
+    const char* error = NULL;
 
     upload_rx_len = 0;
     upload_success = 0;
 
-    // Abort if payload length has not been announced
-    if(upload_payload_length == 0) {
-        ESP_LOGE(LOG_TAG, "Trying to start file upload without announcing metadata, aborting");
+    if (httpd_req_get_hdr_value_str(req, "Content-Type", hdr, sizeof(hdr)) != ESP_OK || http_multipart_init(&multipart, hdr) != 0) {
+        ESP_LOGE(LOG_TAG, "No multipart boundary in request, aborting");
+        return abortRequest(req, HTTPD_400);
+    }
+
+    uint8_t* file_buf = malloc(CONFIG_HTTPD_FILE_BUFFER_SIZE);
+    if (file_buf == NULL) {
+        ESP_LOGE(LOG_TAG, "Failed to allocate upload buffer, aborting");
         return abortRequest(req, HTTPD_500);
     }
 
     ESP_LOGD(LOG_TAG, "Content length: %d bytes", length);
 
-    FILE* file = NULL;
-
-    while (remaining > 0) {
-        ret = httpd_req_recv(req, file_buf, MIN(remaining, sizeof(file_buf)));
+    while (remaining > 0 && error == NULL) {
+        ret = httpd_req_recv(req, (char*)file_buf, MIN(remaining, CONFIG_HTTPD_FILE_BUFFER_SIZE));
         if (ret <= 0) {
             if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
                 ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
                 continue;
             }
             ESP_LOGI(LOG_TAG, "Receive error, aborting");
-            return abortRequest(req, HTTPD_500);
+            error = HTTPD_500;
+            break;
         }
         remaining -= ret;
-        ESP_LOGI(LOG_TAG, "Received %d of %d bytes", (length - remaining), length);
-
-        if(!req_body_started) {
-            // We need to wait for the headers to be complete
-            // Check if the end of headers is in this block
-            char *body_start_p = strstr(file_buf, "\r\n\r\n") + 4;
-            if (!body_start_p) {
-                // Header is not yet finished
-                continue;
-            }
-            req_body_started = 1;
-            // How many bytes are left to read in this partial OTA payload
-            uint32_t body_part_len = ret - (body_start_p - file_buf);
-
-            if((remaining + body_part_len) < upload_payload_length) {
-                // Expected total payload length is smaller than previously announced
-                ESP_LOGE(LOG_TAG, "POST payload length is smaller than previously announced payload length, aborting");
-                return abortRequest(req, HTTPD_500);
+        ESP_LOGD(LOG_TAG, "Received %d of %d bytes", (length - remaining), length);
+
+        // The file data is written straight from the receive buffer
+        size_t pos = 0;
+        while (pos < ret && error == NULL) {
+            const uint8_t* data;
+            size_t data_len;
+            pos += http_multipart_parse(&multipart, &file_buf[pos], ret - pos, &data, &data_len);
+
+            if (multipart.hasPart && fd < 0) {
+                // An announced file name takes precedence over the one in the form
+                const char* file_name = (upload_filename[0] != 0x00) ? upload_filename : multipart.filename;
+                if (file_name[0] == 0x00 || strlen(file_name) > MAX_FILENAME_LENGTH) {
+                    ESP_LOGE(LOG_TAG, "Invalid file name, aborting");
+                    error = HTTPD_400;
+                    break;
+                }
+                snprintf(file_path, sizeof(file_path), "/spiffs/%s", file_name);
+                fd = open(file_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0) {
+                    ESP_LOGE(LOG_TAG, "Failed to open file");
+                    error = HTTPD_500;
+                    break;
+                }
+                ESP_LOGI(LOG_TAG, "File opened: %s", file_path);
             }
 
-            // Open file
-            char filename[21]; // "/spiffs/" + 8.3 filename + null
-            snprintf(filename, 21, "/spiffs/%s", upload_filename);
-            file = fopen(filename, "w");
-            if (file == NULL) {
-                ESP_LOGE(LOG_TAG, "Failed to open file");
-                return abortRequest(req, HTTPD_500);
-            }
-            ESP_LOGI(LOG_TAG, "File opened: %s", filename);
-
-            // Write the first chunk
-            chunk_length = MIN((upload_payload_length - upload_rx_len), body_part_len);
-            size_t write_count = fwrite(body_start_p, 1, chunk_length, file);
-            if (write_count != chunk_length) {
-                ESP_LOGE(LOG_TAG, "Failed to write to file");
-                return abortRequest(req, HTTPD_500);
-            }
-            upload_rx_len += chunk_length;
-        } else {
-            // Header has already been skipped, just receive data until the payload size is reached
-            chunk_length = MIN((upload_payload_length - upload_rx_len), ret);
-            size_t write_count = fwrite(file_buf, 1, chunk_length, file);
-            if (write_count != chunk_length) {
-                ESP_LOGE(LOG_TAG, "Failed to write to file");
-                return abortRequest(req, HTTPD_500);
+            if (data_len > 0) {
+                if (write(fd, data, data_len) != data_len) {
+                    ESP_LOGE(LOG_TAG, "Failed to write to file");
+                    error = HTTPD_500;
+                }
+                upload_rx_len += data_len;
             }
-            upload_rx_len += chunk_length;
         }
     }
+    free(file_buf);
 
-    // Rx has finished, close file
-    int status = fclose(file);
-    if (status != 0) {
-        ESP_LOGE(LOG_TAG, "Failed to close file, aborting");
-        return abortRequest(req, HTTPD_500);
+    // Metadata only applies to one upload
+    upload_filename[0] = 0x00;
+
+    if (error == NULL && (multipart.state != HTTP_MULTIPART_DONE || !multipart.hasPart)) {
+        ESP_LOGE(LOG_TAG, "Multipart body ended before the end of the file, aborting");
+        error = HTTPD_400;
+    }
+
+    if (fd >= 0) {
+        if (close(fd) != 0 && error == NULL) {
+            ESP_LOGE(LOG_TAG, "Failed to close file, aborting");
+            error = HTTPD_500;
+        }
+        // Don't leave an incomplete file behind
+        if (error != NULL) unlink(file_path);
+        else ESP_LOGI(LOG_TAG, "File closed");
     }
-    ESP_LOGI(LOG_TAG, "File closed");
+    if (error != NULL) return abortRequest(req, error);
+
+    upload_success = 1;
 
     // End response
     httpd_resp_send_chunk(req, NULL, 0);
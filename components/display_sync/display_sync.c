@@ -0,0 +1,253 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "lwip/err.h"
+#include "lwip/sockets.h"
+#include "lwip/sys.h"
+
+#include "display_sync.h"
+#include "sync_clock.h"
+#include "util_generic.h"
+
+
+#define LOG_TAG "Sync"
+
+/*
+ * Synchronized playback across multiple displays.
+ * The leader periodically multicasts its time base (wall clock in us)
+ * and its current playlist position. Followers estimate the offset between
+ * their monotonic clock and the leader's time base and use that for
+ * animation timing and playlist switching.
+ * Without sync (or while a follower isn't locked), the local wall clock is used.
+ */
+
+#if defined(CONFIG_SYNC_ENABLED)
+
+static TaskHandle_t sync_task_handle;
+static portMUX_TYPE sync_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t sync_pl_group = 0;
+static uint16_t sync_pl_buffer = 0;
+static int64_t sync_pl_switch_time = 0;
+static uint32_t sync_pl_duration_ms = 0;
+static bool sync_pl_valid = false;
+
+#if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+static sync_clock_t sync_clock;
+#endif
+
+
+#if defined(CONFIG_SYNC_ROLE_LEADER)
+static void sync_leader_task(void* arg) {
+    uint8_t tx_buffer[SYNC_PACKET_LENGTH];
+    sync_packet_t packet = { 0 };
+
+    while (1) {
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (sock < 0) {
+            ESP_LOGE(LOG_TAG, "Unable to create socket: errno %d", errno);
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        uint8_t ttl = 1;
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+        struct sockaddr_in dest_addr;
+        dest_addr.sin_addr.s_addr = inet_addr(CONFIG_SYNC_MULTICAST_ADDR);
+        dest_addr.sin_family = AF_INET;
+        dest_addr.sin_port = htons(CONFIG_SYNC_PORT);
+        ESP_LOGI(LOG_TAG, "Broadcasting to %s:%d", CONFIG_SYNC_MULTICAST_ADDR, CONFIG_SYNC_PORT);
+
+        while (1) {
+            // Wake up either periodically or immediately when the playlist switches
+            ulTaskNotifyTake(pdTRUE, CONFIG_SYNC_INTERVAL_MS / portTICK_PERIOD_MS);
+
+            taskENTER_CRITICAL(&sync_lock);
+            packet.flags = sync_pl_valid ? SYNC_FLAG_PLAYLIST_VALID : 0;
+            packet.pl_group = sync_pl_group;
+            packet.pl_buffer = sync_pl_buffer;
+            packet.pl_switch_us = sync_pl_switch_time;
+            packet.pl_duration_ms = sync_pl_duration_ms;
+            taskEXIT_CRITICAL(&sync_lock);
+
+            packet.sequence++;
+            packet.epoch_us = sync_get_time_us();
+            sync_packet_encode(tx_buffer, &packet);
+
+            int err = sendto(sock, tx_buffer, SYNC_PACKET_LENGTH, 0, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+            if (err < 0 && errno != EHOSTUNREACH && errno != ENETUNREACH) {
+                // Unreachable just means there's no network yet
+                ESP_LOGE(LOG_TAG, "sendto failed: errno %d", errno);
+                break;
+            }
+        }
+
+        ESP_LOGE(LOG_TAG, "Shutting down socket and restarting...");
+        shutdown(sock, 0);
+        close(sock);
+    }
+    vTaskDelete(NULL);
+}
+#endif
+
+#if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+static void sync_follower_task(void* arg) {
+    uint8_t rx_buffer[64];
+    sync_packet_t packet;
+
+    while (1) {
+        int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+        if (sock < 0) {
+            ESP_LOGE(LOG_TAG, "Unable to create socket: errno %d", errno);
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+
+        int opt = 1;
+        setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+        struct timeval timeout;
+        timeout.tv_sec = CONFIG_SYNC_TIMEOUT_MS / 1000;
+        timeout.tv_usec = (CONFIG_SYNC_TIMEOUT_MS % 1000) * 1000;
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        struct sockaddr_in bind_addr;
+        bind_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        bind_addr.sin_family = AF_INET;
+        bind_addr.sin_port = htons(CONFIG_SYNC_PORT);
+        int err = bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr));
+        if (err < 0) {
+            ESP_LOGE(LOG_TAG, "Socket unable to bind: errno %d", errno);
+        }
+
+        // Joining fails as long as no interface is up, so keep retrying
+        struct ip_mreq mreq;
+        mreq.imr_multiaddr.s_addr = inet_addr(CONFIG_SYNC_MULTICAST_ADDR);
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        err = setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq));
+        if (err < 0) {
+            ESP_LOGD(LOG_TAG, "Failed to join multicast group: errno %d", errno);
+            close(sock);
+            vTaskDelay(1000 / portTICK_PERIOD_MS);
+            continue;
+        }
+        ESP_LOGI(LOG_TAG, "Listening on %s:%d", CONFIG_SYNC_MULTICAST_ADDR, CONFIG_SYNC_PORT);
+
+        while (1) {
+            int len = recv(sock, rx_buffer, sizeof(rx_buffer), 0);
+            int64_t now = esp_timer_get_time();
+
+            taskENTER_CRITICAL(&sync_lock);
+            bool locked = sync_clock_check_timeout(&sync_clock, now, CONFIG_SYNC_TIMEOUT_MS * 1000LL);
+            if (!locked) sync_pl_valid = false;
+            taskEXIT_CRITICAL(&sync_lock);
+
+            if (len < 0) {
+                // Timeout. Rejoin the group in case the interface went down in the meantime.
+                if (errno != EAGAIN && errno != EWOULDBLOCK) ESP_LOGE(LOG_TAG, "recv failed: errno %d", errno);
+                break;
+            }
+
+            if (!sync_packet_decode(rx_buffer, len, &packet)) {
+                ESP_LOGD(LOG_TAG, "Ignoring invalid packet");
+                continue;
+            }
+
+            taskENTER_CRITICAL(&sync_lock);
+            bool accepted = sync_clock_update(&sync_clock, packet.sequence, packet.epoch_us, now, CONFIG_SYNC_STEP_THRESHOLD_US, CONFIG_SYNC_SLEW_SHIFT);
+            if (accepted) {
+                sync_pl_valid = !!(packet.flags & SYNC_FLAG_PLAYLIST_VALID);
+                sync_pl_group = packet.pl_group;
+                sync_pl_buffer = packet.pl_buffer;
+                sync_pl_switch_time = packet.pl_switch_us;
+                sync_pl_duration_ms = packet.pl_duration_ms;
+            }
+            int64_t offset = sync_clock.offset_us;
+            int64_t jitter = sync_clock.jitter_us;
+            uint32_t steps = sync_clock.num_steps;
+            taskEXIT_CRITICAL(&sync_lock);
+
+            if (accepted && packet.sequence % 64 == 0) {
+                ESP_LOGD(LOG_TAG, "Offset %lld us, jitter %lld us, %lu steps", offset, jitter, steps);
+            }
+        }
+
+        shutdown(sock, 0);
+        close(sock);
+    }
+    vTaskDelete(NULL);
+}
+#endif
+
+void sync_init(void) {
+    #if defined(CONFIG_SYNC_ROLE_LEADER)
+    ESP_LOGI(LOG_TAG, "Starting sync leader");
+    xTaskCreatePinnedToCore(sync_leader_task, "sync_leader", 4096, NULL, 6, &sync_task_handle, 0);
+    #elif defined(CONFIG_SYNC_ROLE_FOLLOWER)
+    ESP_LOGI(LOG_TAG, "Starting sync follower");
+    sync_clock_init(&sync_clock);
+    xTaskCreatePinnedToCore(sync_follower_task, "sync_follower", 4096, NULL, 6, &sync_task_handle, 0);
+    #endif
+}
+
+#else
+
+void sync_init(void) {
+
+}
+
+#endif
+
+int64_t sync_get_time_us(void) {
+    // Shared time base for animations and playlist timing
+    #if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+    int64_t now = esp_timer_get_time();
+    taskENTER_CRITICAL(&sync_lock);
+    bool locked = sync_clock.locked;
+    int64_t shared = sync_clock_to_shared(&sync_clock, now);
+    taskEXIT_CRITICAL(&sync_lock);
+    if (locked) return shared;
+    #endif
+    return time_getSystemTime_us();
+}
+
+bool sync_is_locked(void) {
+    #if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+    return sync_clock.locked;
+    #else
+    return false;
+    #endif
+}
+
+void sync_set_playlist_position(uint16_t group, uint16_t buffer, int64_t switchTime, uint32_t durationMs) {
+    #if defined(CONFIG_SYNC_ROLE_LEADER)
+    taskENTER_CRITICAL(&sync_lock);
+    sync_pl_group = group;
+    sync_pl_buffer = buffer;
+    sync_pl_switch_time = switchTime;
+    sync_pl_duration_ms = durationMs;
+    sync_pl_valid = true;
+    taskEXIT_CRITICAL(&sync_lock);
+
+    // Broadcast right away instead of waiting for the next interval
+    if (sync_task_handle != NULL) xTaskNotifyGive(sync_task_handle);
+    #endif
+}
+
+bool sync_get_playlist_position(uint16_t* group, uint16_t* buffer, int64_t* switchTime, uint32_t* durationMs) {
+    // Returns true if a valid playlist position has been received from the leader
+    #if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+    taskENTER_CRITICAL(&sync_lock);
+    bool valid = sync_pl_valid && sync_clock.locked;
+    *group = sync_pl_group;
+    *buffer = sync_pl_buffer;
+    *switchTime = sync_pl_switch_time;
+    *durationMs = sync_pl_duration_ms;
+    taskEXIT_CRITICAL(&sync_lock);
+    return valid;
+    #else
+    return false;
+    #endif
+}
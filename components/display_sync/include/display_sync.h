@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+void sync_init(void);
+int64_t sync_get_time_us(void);
+bool sync_is_locked(void);
+void sync_set_playlist_position(uint16_t group, uint16_t buffer, int64_t switchTime, uint32_t durationMs);
+bool sync_get_playlist_position(uint16_t* group, uint16_t* buffer, int64_t* switchTime, uint32_t* durationMs);
@@ -0,0 +1,146 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "sync_clock.h"
+
+
+static void _put_u16(uint8_t* buf, uint16_t v) {
+    buf[0] = v & 0xFF;
+    buf[1] = (v >> 8) & 0xFF;
+}
+
+static void _put_u32(uint8_t* buf, uint32_t v) {
+    for (uint8_t i = 0; i < 4; i++) buf[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static void _put_i64(uint8_t* buf, int64_t v) {
+    for (uint8_t i = 0; i < 8; i++) buf[i] = ((uint64_t)v >> (8 * i)) & 0xFF;
+}
+
+static uint16_t _get_u16(const uint8_t* buf) {
+    return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t _get_u32(const uint8_t* buf) {
+    uint32_t v = 0;
+    for (uint8_t i = 0; i < 4; i++) v |= (uint32_t)buf[i] << (8 * i);
+    return v;
+}
+
+static int64_t _get_i64(const uint8_t* buf) {
+    uint64_t v = 0;
+    for (uint8_t i = 0; i < 8; i++) v |= (uint64_t)buf[i] << (8 * i);
+    return (int64_t)v;
+}
+
+void sync_packet_encode(uint8_t* buf, const sync_packet_t* packet) {
+    /*
+    Packet layout (all values little endian):
+    0   4   Magic "CHSY"
+    4   1   Version
+    5   1   Flags
+    6   2   Sequence number
+    8   8   Leader time base (us)
+    16  2   Playlist group
+    18  2   Playlist entry
+    20  8   Time base value of the last playlist switch (us)
+    28  4   Duration of the current playlist entry (ms)
+    32  4   Reserved
+    */
+    memset(buf, 0, SYNC_PACKET_LENGTH);
+    memcpy(buf, SYNC_PACKET_MAGIC, 4);
+    buf[4] = SYNC_PACKET_VERSION;
+    buf[5] = packet->flags;
+    _put_u16(&buf[6], packet->sequence);
+    _put_i64(&buf[8], packet->epoch_us);
+    _put_u16(&buf[16], packet->pl_group);
+    _put_u16(&buf[18], packet->pl_buffer);
+    _put_i64(&buf[20], packet->pl_switch_us);
+    _put_u32(&buf[28], packet->pl_duration_ms);
+}
+
+bool sync_packet_decode(const uint8_t* buf, size_t len, sync_packet_t* packet) {
+    if (len < SYNC_PACKET_LENGTH) return false;
+    if (memcmp(buf, SYNC_PACKET_MAGIC, 4) != 0) return false;
+    if (buf[4] != SYNC_PACKET_VERSION) return false;
+    packet->flags = buf[5];
+    packet->sequence = _get_u16(&buf[6]);
+    packet->epoch_us = _get_i64(&buf[8]);
+    packet->pl_group = _get_u16(&buf[16]);
+    packet->pl_buffer = _get_u16(&buf[18]);
+    packet->pl_switch_us = _get_i64(&buf[20]);
+    packet->pl_duration_ms = _get_u32(&buf[28]);
+    return true;
+}
+
+void sync_clock_init(sync_clock_t* clock) {
+    memset(clock, 0, sizeof(sync_clock_t));
+}
+
+bool sync_clock_update(sync_clock_t* clock, uint16_t sequence, int64_t remote_us, int64_t local_rx_us, int64_t step_threshold_us, uint8_t slew_shift) {
+    // Feed one received leader timestamp into the estimator.
+    // Returns false if the sample was rejected.
+
+    // Reject duplicates and reordered packets (with wraparound),
+    // a late packet would otherwise look like a large network delay
+    if (clock->num_samples > 0 && (int16_t)(sequence - clock->last_sequence) <= 0) {
+        clock->num_dropped++;
+        return false;
+    }
+    clock->last_sequence = sequence;
+    clock->last_rx_us = local_rx_us;
+
+    // Each sample is the true offset minus the (unknown, positive) network delay.
+    // The largest sample in the window is therefore the one with the least delay
+    // and the best estimate of the true offset.
+    int64_t sample = remote_us - local_rx_us;
+    clock->samples[clock->sample_pos] = sample;
+    clock->sample_pos = (clock->sample_pos + 1) % SYNC_CLOCK_WINDOW;
+    if (clock->num_samples < SYNC_CLOCK_WINDOW) clock->num_samples++;
+
+    int64_t estimate = clock->samples[0];
+    for (uint8_t i = 1; i < clock->num_samples; i++) {
+        if (clock->samples[i] > estimate) estimate = clock->samples[i];
+    }
+
+    int64_t deviation = estimate - sample;
+    clock->jitter_us += (deviation - clock->jitter_us) / 16;
+
+    // On a noisy network the filtered estimate wanders by about the jitter as well,
+    // so only step if the error clearly exceeds it
+    if (step_threshold_us < 8 * clock->jitter_us) step_threshold_us = 8 * clock->jitter_us;
+
+    int64_t error = estimate - clock->offset_us;
+    if (!clock->locked || error > step_threshold_us || error < -step_threshold_us) {
+        // Initial lock or leader time base jumped (e.g. NTP sync on the leader)
+        clock->offset_us = estimate;
+        clock->jitter_us = 0;
+        clock->locked = true;
+        clock->num_steps++;
+    } else {
+        // Slew gradually so animations don't visibly jump.
+        // Errors within the jitter are mostly noise, follow them more slowly.
+        if (error <= clock->jitter_us && error >= -clock->jitter_us) slew_shift += 2;
+        clock->offset_us += error / (1 << slew_shift);
+    }
+    return true;
+}
+
+bool sync_clock_check_timeout(sync_clock_t* clock, int64_t local_us, int64_t timeout_us) {
+    // Drop the lock if the leader hasn't been heard from in a while.
+    // Returns true if the clock is (still) locked.
+    if (clock->locked && local_us - clock->last_rx_us > timeout_us) {
+        clock->locked = false;
+        clock->num_samples = 0;
+        clock->sample_pos = 0;
+    }
+    return clock->locked;
+}
+
+int64_t sync_clock_to_shared(const sync_clock_t* clock, int64_t local_us) {
+    return local_us + clock->offset_us;
+}
+
+int64_t sync_clock_to_local(const sync_clock_t* clock, int64_t shared_us) {
+    return shared_us - clock->offset_us;
+}
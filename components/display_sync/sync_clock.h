@@ -0,0 +1,52 @@
+#pragma once
+
+/*
+ * Platform-independent part of the display sync:
+ * Packet (de)serialization and the follower clock estimator.
+ * No ESP-IDF dependencies, so this can be compiled and exercised on a PC.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+#define SYNC_PACKET_MAGIC "CHSY"
+#define SYNC_PACKET_VERSION 1
+#define SYNC_PACKET_LENGTH 36
+
+#define SYNC_FLAG_PLAYLIST_VALID 0x01
+
+// Number of offset samples used for delay filtering
+#define SYNC_CLOCK_WINDOW 8
+
+typedef struct {
+    uint8_t flags;
+    uint16_t sequence;
+    int64_t epoch_us;           // Leader time base at the moment of transmission
+    uint16_t pl_group;          // Currently displayed playlist group
+    uint16_t pl_buffer;         // Currently displayed playlist entry within the group
+    int64_t pl_switch_us;       // Time base value at which the current entry was displayed
+    uint32_t pl_duration_ms;    // Duration of the current entry
+} sync_packet_t;
+
+typedef struct {
+    int64_t offset_us;          // time base = local time + offset
+    int64_t jitter_us;          // Smoothed deviation of the samples from the filtered offset, widens the step threshold and slows slewing
+    int64_t samples[SYNC_CLOCK_WINDOW];
+    uint8_t num_samples;
+    uint8_t sample_pos;
+    int64_t last_rx_us;         // Local time of the last accepted sample
+    uint16_t last_sequence;
+    bool locked;
+    uint32_t num_steps;         // Number of hard offset corrections
+    uint32_t num_dropped;       // Number of packets dropped as duplicate or out of order
+} sync_clock_t;
+
+
+void sync_packet_encode(uint8_t* buf, const sync_packet_t* packet);
+bool sync_packet_decode(const uint8_t* buf, size_t len, sync_packet_t* packet);
+void sync_clock_init(sync_clock_t* clock);
+bool sync_clock_update(sync_clock_t* clock, uint16_t sequence, int64_t remote_us, int64_t local_rx_us, int64_t step_threshold_us, uint8_t slew_shift);
+bool sync_clock_check_timeout(sync_clock_t* clock, int64_t local_us, int64_t timeout_us);
+int64_t sync_clock_to_shared(const sync_clock_t* clock, int64_t local_us);
+int64_t sync_clock_to_local(const sync_clock_t* clock, int64_t shared_us);
@@ -31,6 +31,7 @@ uint8_t display_currentBrightness = 255;
 #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
 void* display_currentEffect = NULL;
 #endif
+static buffer_char_output_t display_lastOutput;
 
 #if defined(CONFIG_16SEG_LED_USE_ENABLE)
 ledc_timer_config_t dimming_timer = {
@@ -97,6 +98,10 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     ESP_ERROR_CHECK(spi_bus_add_device(HSPI_HOST, &devcfg, &spi));
     #endif
 
+    if (buffer_char_output_init(&display_lastOutput, DISPLAY_CHAR_BUF_SIZE) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Not enough memory for change detection, rendering every frame");
+    }
+
     display_enable();
     return ESP_OK;
 }
@@ -159,6 +164,7 @@ esp_err_t display_set_brightness(uint8_t brightness) {
 #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
 esp_err_t display_set_effect(void* effectData) {
     display_currentEffect = effectData;
+    effect_release();
     return ESP_OK;
 }
 #else
@@ -231,15 +237,10 @@ void display_render() {
     ESP_ERROR_CHECK(spi_device_polling_transmit(spi, &spi_trans));
 }
 
-static uint8_t charBufModified_prev = 0;
 void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize, portMUX_TYPE* textBufLock, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize) {
-    uint8_t changed = 0;
-    if (prevTextBuf != NULL) {
-        changed = (memcmp(textBuf, prevTextBuf, textBufSize) != 0);
-    }
     #if !defined(CONFIG_DISPLAY_HAS_EFFECTS)
     // Nothing to do if buffer hasn't changed
-    if (prevTextBuf != NULL && !changed) return;
+    if (prevTextBuf != NULL && memcmp(textBuf, prevTextBuf, textBufSize) == 0) return;
     #endif
 
     taskENTER_CRITICAL(textBufLock);
@@ -248,26 +249,12 @@ void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize,
     taskEXIT_CRITICAL(textBufLock);
 
     #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
-    // Process effect and check if update is needed
-    uint8_t charBufModified = effect_fromJSON(charBuf, charBufSize, display_currentEffect);
-    // Only evaluate charBufModified when the text buf hasn't changed
-    // Otherwise, an update is required anyway
-    if (prevTextBuf != NULL && !changed) {
-        // TODO: This isn't quite right yet. It checks if the effect modified the buffer,
-        // and if it did, triggers an update. If it didn't, the update is skipped,
-        // but only if the buffer wasn't modified in the previous run either.
-        // This is to ensure that if an effect goes from "modified" to "not modified",
-        // the display gets updated. However, this does not represent the actual logic needed.
-        // e.g. if the effect modifies the buffer in the exact same way in two subsequent
-        // iterations, the buffer would be updated in both iterations.
-        if (!charBufModified && !charBufModified_prev) {
-            charBufModified_prev = charBufModified;
-            return;
-        }
-    }
-    charBufModified_prev = charBufModified;
+    effect_fromJSON(charBuf, charBufSize, display_currentEffect);
     #endif
 
+    // Only render and transmit if the output (after effects) has actually changed
+    if (!buffer_char_output_changed(&display_lastOutput, charBuf, quirkFlagBuf, charBufSize)) return;
+
     display_buffers_to_out_buf(charBuf, quirkFlagBuf, charBufSize);
     display_render();
 }
@@ -12,6 +12,7 @@
 #include "macros.h"
 #include "char_16seg_led_ws281x.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_generic.h"
 #include "util_gpio.h"
 #include "char_16seg_font.h"
@@ -33,6 +34,9 @@ spi_device_handle_t spi;
 volatile uint8_t display_transferOngoing = false;
 uint8_t display_currentBrightness = 255;
 void* display_currentShader = NULL;
+static color_rgb_u8_t display_charColors[DISPLAY_CHAR_BUF_SIZE];
+static color_rgb_u8_t display_lastCharColors[DISPLAY_CHAR_BUF_SIZE];
+static buffer_char_output_t display_lastOutput;
 #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
 void* display_currentEffect = NULL;
 #endif
@@ -48,20 +52,25 @@ static const uint8_t ws281x_bit_patterns[4] = {
 static uint8_t gammaLUT[256];
 
 
-esp_err_t display_init(nvs_handle_t* nvsHandle) {
-    /*
-     * Set up all needed peripherals
-     */
-
-    // Calculate gamma lookup table
+static void display_update_gamma(const char* key, void* arg) {
     uint16_t gammaU16;
-    esp_err_t ret = nvs_get_u16(*nvsHandle, "disp_led_gamma", &gammaU16);
+    esp_err_t ret = config_get_u16(key, &gammaU16);
     if (ret != ESP_OK) gammaU16 = 100;
     if (gammaU16 == 0) gammaU16 = 100;
     double gamma = gammaU16 / 100.0;
     for (uint16_t i = 0; i < 256; i++) {
         gammaLUT[i] = round(pow(i, gamma) / pow(255, (gamma - 1)));
     }
+}
+
+esp_err_t display_init(nvs_handle_t* nvsHandle) {
+    /*
+     * Set up all needed peripherals
+     */
+
+    // Calculate gamma lookup table and recalculate it whenever the gamma value is changed
+    display_update_gamma("disp_led_gamma", NULL);
+    config_subscribe("disp_led_gamma", display_update_gamma, NULL);
 
     // Init SPI peripheral
     spi_bus_config_t buscfg = {
@@ -88,6 +97,10 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     ESP_ERROR_CHECK(spi_bus_initialize(HSPI_HOST, &buscfg, 1));
     ESP_ERROR_CHECK(spi_bus_add_device(HSPI_HOST, &devcfg, &spi));
     #endif
+
+    if (buffer_char_output_init(&display_lastOutput, DISPLAY_CHAR_BUF_SIZE) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Not enough memory for change detection, rendering every frame");
+    }
     return ESP_OK;
 }
 
@@ -102,6 +115,8 @@ void display_post_transfer_cb(spi_transaction_t *t) {
 #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
 esp_err_t display_set_brightness(uint8_t brightness) {
     display_currentBrightness = brightness;
+    // Brightness is applied when rendering, so the output needs to be rendered again
+    buffer_char_output_invalidate(&display_lastOutput);
     return ESP_OK;
 }
 #else
@@ -113,6 +128,7 @@ esp_err_t display_set_brightness(uint8_t brightness) {
 #if defined(CONFIG_DISPLAY_HAS_SHADERS)
 esp_err_t display_set_shader(void* shaderData) {
     display_currentShader = shaderData;
+    shader_invalidate_cache();
     return ESP_OK;
 }
 #else
@@ -124,6 +140,7 @@ esp_err_t display_set_shader(void* shaderData) {
 #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
 esp_err_t display_set_effect(void* effectData) {
     display_currentEffect = effectData;
+    effect_release();
     return ESP_OK;
 }
 #else
@@ -259,16 +276,14 @@ void display_setCharDataAt(uint8_t* frameBuf, uint16_t charPos, uint16_t charDat
 
 void display_buffers_to_out_buf(uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize) {
     color_t color;
-    color_rgb_t calcColor_rgb;
 
+    // display_charColors has to be filled by the shader before calling this
     memset(display_outBuf, 0x88, OUTPUT_BUFFER_SIZE);
 
     for (uint16_t charBufIndex = 0; charBufIndex < charBufSize; charBufIndex++) {
-        calcColor_rgb = shader_fromJSON(charBufIndex, charBufSize, charBuf[charBufIndex], display_currentShader);
-
-        color.red = calcColor_rgb.r * 255;
-        color.green = calcColor_rgb.g * 255;
-        color.blue = calcColor_rgb.b * 255;
+        color.red = display_charColors[charBufIndex].r;
+        color.green = display_charColors[charBufIndex].g;
+        color.blue = display_charColors[charBufIndex].b;
 
         if (charBuf[charBufIndex] >= char_seg_font_min && charBuf[charBufIndex] <= char_seg_font_max) {
             display_setCharDataAt(display_outBuf, charBufIndex, char_16seg_font[charBuf[charBufIndex] - char_seg_font_min], color);
@@ -292,43 +307,26 @@ void display_render() {
     ets_delay_us(350); // Ensure reset pulse
 }
 
-static uint8_t charBufModified_prev = 0;
 void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize, portMUX_TYPE* textBufLock, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize) {
-    uint8_t changed = 0;
-    if (prevTextBuf != NULL) {
-        changed = (memcmp(textBuf, prevTextBuf, textBufSize) != 0);
-    }
-    #if !defined(CONFIG_DISPLAY_HAS_EFFECTS)
-    // Nothing to do if buffer hasn't changed
-    if (prevTextBuf != NULL && !changed) return;
-    #endif
-
+    // The text buffer is converted every time since shaders can change
+    // the output even if the text stays the same
     taskENTER_CRITICAL(textBufLock);
     buffer_textbuf_to_charbuf(textBuf, charBuf, quirkFlagBuf, textBufSize, charBufSize);
     if (prevTextBuf != NULL) memcpy(prevTextBuf, textBuf, textBufSize);
     taskEXIT_CRITICAL(textBufLock);
 
     #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
-    // Process effect and check if update is needed
-    uint8_t charBufModified = effect_fromJSON(charBuf, charBufSize, display_currentEffect);
-    // Only evaluate charBufModified when the text buf hasn't changed
-    // Otherwise, an update is required anyway
-    if (prevTextBuf != NULL && !changed) {
-        // TODO: This isn't quite right yet. It checks if the effect modified the buffer,
-        // and if it did, triggers an update. If it didn't, the update is skipped,
-        // but only if the buffer wasn't modified in the previous run either.
-        // This is to ensure that if an effect goes from "modified" to "not modified",
-        // the display gets updated. However, this does not represent the actual logic needed.
-        // e.g. if the effect modifies the buffer in the exact same way in two subsequent
-        // iterations, the buffer would be updated in both iterations.
-        if (!charBufModified && !charBufModified_prev) {
-            charBufModified_prev = charBufModified;
-            return;
-        }
-    }
-    charBufModified_prev = charBufModified;
+    effect_fromJSON(charBuf, charBufSize, display_currentEffect);
     #endif
 
+    shader_fromJSON(display_currentShader, charBuf, charBufSize, display_charColors, charBufSize);
+    uint8_t colorsChanged = (memcmp(display_charColors, display_lastCharColors, charBufSize * sizeof(color_rgb_u8_t)) != 0);
+    if (colorsChanged) memcpy(display_lastCharColors, display_charColors, charBufSize * sizeof(color_rgb_u8_t));
+
+    // Only render and transmit if the output (after effects and shaders) has actually changed
+    uint8_t outputChanged = buffer_char_output_changed(&display_lastOutput, charBuf, quirkFlagBuf, charBufSize);
+    if (!outputChanged && !colorsChanged) return;
+
     display_buffers_to_out_buf(charBuf, quirkFlagBuf, charBufSize);
     display_render();
 }
@@ -6,6 +6,7 @@
 
 #include "driver/spi_master.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
@@ -13,6 +14,7 @@
 
 #include "char_16seg_led_ws281x_hybrid.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_generic.h"
 #include "util_gpio.h"
 #include "char_16seg_mapping.h"
@@ -33,11 +35,15 @@ volatile uint8_t display_transferOngoingLower = false;
 uint8_t display_currentBrightness = 255;
 #if defined(CONFIG_DISPLAY_HAS_SHADERS)
 void* display_currentShader = NULL;
+static color_rgb_u8_t display_charColors[DISPLAY_CHAR_BUF_SIZE];
 #endif
 #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
 void* display_currentTransition = NULL;
 uint8_t display_transitionPixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+static uint8_t display_maskedPixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
 #endif
+static color_t display_lastLEDColors[NUM_LEDS];
+static uint8_t display_lastLEDColorsValid = 0;
 static const color_t OFF = { 0, 0, 0 };
 
 static const uint8_t ws281x_bit_patterns[4] = {
@@ -50,20 +56,25 @@ static const uint8_t ws281x_bit_patterns[4] = {
 static uint8_t gammaLUT[256];
 
 
-esp_err_t display_init(nvs_handle_t* nvsHandle) {
-    /*
-     * Set up all needed peripherals
-     */
-
-    // Calculate gamma lookup table
+static void display_update_gamma(const char* key, void* arg) {
     uint16_t gammaU16;
-    esp_err_t ret = nvs_get_u16(*nvsHandle, "disp_led_gamma", &gammaU16);
+    esp_err_t ret = config_get_u16(key, &gammaU16);
     if (ret != ESP_OK) gammaU16 = 100;
     if (gammaU16 == 0) gammaU16 = 100;
     double gamma = gammaU16 / 100.0;
     for (uint16_t i = 0; i < 256; i++) {
         gammaLUT[i] = round(pow(i, gamma) / pow(255, (gamma - 1)));
     }
+}
+
+esp_err_t display_init(nvs_handle_t* nvsHandle) {
+    /*
+     * Set up all needed peripherals
+     */
+
+    // Calculate gamma lookup table and recalculate it whenever the gamma value is changed
+    display_update_gamma("disp_led_gamma", NULL);
+    config_subscribe("disp_led_gamma", display_update_gamma, NULL);
 
     // Init SPI peripherals
     spi_bus_config_t buscfgUpper = {
@@ -113,6 +124,12 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     ESP_ERROR_CHECK(spi_bus_initialize(HSPI_HOST, &buscfgLower, 2));
     ESP_ERROR_CHECK(spi_bus_add_device(HSPI_HOST, &devcfgLower, &spiLower));
     #endif
+
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    // Without memory for the transitions, changes are shown instantly
+    esp_err_t ret = transition_init(DISPLAY_FRAME_WIDTH_PIXEL, DISPLAY_FRAME_HEIGHT_PIXEL, LED_TO_BITMAP_MAPPING, MAPPING_LENGTH);
+    if (ret != ESP_OK) ESP_LOGE(LOG_TAG, "Failed to initialize transitions: %s", esp_err_to_name(ret));
+    #endif
     return ESP_OK;
 }
 
@@ -135,6 +152,8 @@ void display_post_transfer_cb_lower(spi_transaction_t *t) {
 #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
 esp_err_t display_set_brightness(uint8_t brightness) {
     display_currentBrightness = brightness;
+    // Brightness is applied when encoding the LED colors, so all of them need to be encoded again
+    display_lastLEDColorsValid = 0;
     return ESP_OK;
 }
 #else
@@ -146,6 +165,7 @@ esp_err_t display_set_brightness(uint8_t brightness) {
 #if defined(CONFIG_DISPLAY_HAS_SHADERS)
 esp_err_t display_set_shader(void* shaderData) {
     display_currentShader = shaderData;
+    shader_invalidate_cache();
     return ESP_OK;
 }
 #else
@@ -209,6 +229,12 @@ uint8_t display_led_in_segment(uint16_t ledPos, seg_t segment) {
     }
 }
 
+const uint16_t* display_get_active_pixels(uint32_t* numPixels) {
+    // Pixel buffer offsets of all LEDs, the rest of the pixel buffer is never shown
+    *numPixels = MAPPING_LENGTH;
+    return LED_TO_BITMAP_MAPPING;
+}
+
 uint8_t display_led_in_char_data(uint16_t ledPos, uint32_t charData) {
     if ((charData & A1) && display_led_in_segment(ledPos, A1)) return 1;
     if ((charData & A2) && display_led_in_segment(ledPos, A2)) return 1;
@@ -230,11 +256,29 @@ uint8_t display_led_in_char_data(uint16_t ledPos, uint32_t charData) {
     return 0;
 }
 
-void display_buffers_to_out_buf(uint8_t* pixBuf, size_t pixBufSize, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize) {
+static uint8_t _display_set_led_if_changed(uint16_t ledPos, color_t color) {
+    // Only encode the LED color if it differs from the one already in the output buffer
+    color_t* last = &display_lastLEDColors[ledPos];
+    if (display_lastLEDColorsValid && last->red == color.red && last->green == color.green && last->blue == color.blue) return 0;
+    *last = color;
+    display_setLEDColor(display_outBuf, ledPos, color);
+    return 1;
+}
+
+uint8_t display_buffers_to_out_buf(uint8_t* pixBuf, size_t pixBufSize, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize) {
+    /*
+    With transitions, the LED colors are only written to a pixel buffer
+    with the segment mask baked in, so the transition works on what is
+    actually shown instead of just the background. display_transition_to_out_buf()
+    then outputs it. Pixels without an LED are never written and stay 0.
+    Returns 1 if any LED color in the output buffer has changed.
+    */
     color_t color, shaderColor;
-    color_rgb_t calcColor_rgb;
+    uint8_t changed = 0;
 
-    memset(display_outBuf, 0x88, OUTPUT_BUFFER_SIZE);
+    #if defined(CONFIG_DISPLAY_HAS_SHADERS)
+    shader_fromJSON(display_currentShader, charBuf, charBufSize, display_charColors, charBufSize);
+    #endif
 
     for (uint16_t charPos = 0; charPos < charBufSize; charPos++) {
         uint32_t charData = 0;
@@ -244,10 +288,9 @@ void display_buffers_to_out_buf(uint8_t* pixBuf, size_t pixBufSize, uint8_t* cha
         if (quirkFlagBuf[charPos] & QUIRK_FLAG_COMBINING_FULL_STOP) charData |= DP;
 
         #if defined(CONFIG_DISPLAY_HAS_SHADERS)
-        calcColor_rgb = shader_fromJSON(charBufIndex, charBufSize, charBuf[charBufIndex], display_currentShader);
-        shaderColor.red = calcColor_rgb.r * 255;
-        shaderColor.green = calcColor_rgb.g * 255;
-        shaderColor.blue = calcColor_rgb.b * 255;
+        shaderColor.red = display_charColors[charPos].r;
+        shaderColor.green = display_charColors[charPos].g;
+        shaderColor.blue = display_charColors[charPos].b;
         #endif
 
         for (uint16_t led = 0; led < NUM_LEDS; led++) {
@@ -263,11 +306,45 @@ void display_buffers_to_out_buf(uint8_t* pixBuf, size_t pixBufSize, uint8_t* cha
             } else {
                 color = OFF;
             }
-            display_setLEDColor(display_outBuf, led, color);
+            #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+            uint16_t maskedPixBufIndex = LED_TO_BITMAP_MAPPING[led];
+            display_maskedPixBuf[maskedPixBufIndex] = color.red;
+            display_maskedPixBuf[maskedPixBufIndex + 1] = color.green;
+            display_maskedPixBuf[maskedPixBufIndex + 2] = color.blue;
+            #else
+            changed |= _display_set_led_if_changed(led, color);
+            #endif
         }
     }
+
+    #if !defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    display_lastLEDColorsValid = 1;
+    #endif
+    return changed;
 }
 
+#if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+uint8_t display_transition_to_out_buf() {
+    /*
+    Step the transition towards the masked pixel buffer and output the result.
+    Only works on the driver's own buffers, so this runs outside of the pixel buffer lock.
+    Returns 1 if any LED color in the output buffer has changed.
+    */
+    color_t color;
+    uint8_t changed = 0;
+    if (!transition_update(display_transitionPixBuf, display_maskedPixBuf, display_currentTransition, esp_timer_get_time()) && display_lastLEDColorsValid) return 0;
+    for (uint16_t led = 0; led < NUM_LEDS; led++) {
+        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[led];
+        color.red = display_transitionPixBuf[pixBufIndex];
+        color.green = display_transitionPixBuf[pixBufIndex + 1];
+        color.blue = display_transitionPixBuf[pixBufIndex + 2];
+        changed |= _display_set_led_if_changed(led, color);
+    }
+    display_lastLEDColorsValid = 1;
+    return changed;
+}
+#endif
+
 void display_render() {
     if (display_transferOngoingUpper || display_transferOngoingLower) return;
 
@@ -299,17 +376,15 @@ void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, por
     taskEXIT_CRITICAL(textBufLock);
     
     taskENTER_CRITICAL(pixBufLock);
-    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
-    // TODO: This won't work. Need to a) actually render all the inbetween steps and b) work on masked bitmaps (segment mask for old and new buffers baked in)
-    // otherwise we would just transition the background instead of the whole thing
-    transition_fromJSON(prevPixBuf, pixBuf, display_transitionPixBuf, pixBufSize, display_currentTransition);
-    display_buffers_to_out_buf(outBuf, outBufSize, display_transitionPixBuf, pixBufSize, charBuf, quirkFlagBuf, charBufSize);
-    #else
-    display_buffers_to_out_buf(pixBuf, pixBufSize, charBuf, quirkFlagBuf, charBufSize);
-    #endif
+    uint8_t changed = display_buffers_to_out_buf(pixBuf, pixBufSize, charBuf, quirkFlagBuf, charBufSize);
     if (prevPixBuf != NULL) memcpy(prevPixBuf, pixBuf, pixBufSize);
     taskEXIT_CRITICAL(pixBufLock);
-    display_render();
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    changed = display_transition_to_out_buf();
+    #endif
+
+    // Only transmit if any LED has actually changed
+    if (changed) display_render();
 }
 
 #endif
\ No newline at end of file
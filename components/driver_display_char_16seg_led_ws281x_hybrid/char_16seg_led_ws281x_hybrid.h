@@ -32,6 +32,8 @@ void display_setDecimalPointAt(uint8_t* frameBuf, uint16_t charPos, uint8_t stat
 void display_setCharDataAt(uint8_t* frameBuf, uint16_t charPos, uint16_t charData, color_t color);
 uint8_t display_led_in_segment(uint16_t ledPos, seg_t segment);
 uint8_t display_led_in_char_data(uint16_t ledPos, uint32_t charData);
-void display_buffers_to_out_buf(uint8_t* pixBuf, size_t pixBufSize, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize);
+const uint16_t* display_get_active_pixels(uint32_t* numPixels);
+uint8_t display_buffers_to_out_buf(uint8_t* pixBuf, size_t pixBufSize, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize);
+uint8_t display_transition_to_out_buf();
 void display_render();
 void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock, uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize, portMUX_TYPE* textBufLock, uint8_t* charBuf, uint16_t* quirkFlagBuf, size_t charBufSize);
\ No newline at end of file
@@ -14,6 +14,7 @@
 #include "macros.h"
 #include "char_ibis.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_generic.h"
 #include "util_gpio.h"
 #include "shaders_char.h"
@@ -30,6 +31,12 @@ volatile uint8_t display_backlight_transferOngoing = false;
 uint8_t display_currentBrightness = 255;
 void* display_currentShader = NULL;
 static uint8_t backlightFrameBuf[BACKLIGHT_FRAMEBUF_SIZE] = { 0 };
+#if defined(CONFIG_IBIS_HAS_WS281X_BACKLIGHT)
+// Corrected color in the backlight frame, which is only sent when it changes
+static color_t display_backlightColor;
+static uint8_t display_backlightChanged = 1;
+#endif
+static buffer_char_output_t display_lastOutput;
 
 static const uint8_t ws281x_bit_patterns[4] = {
     0x88,
@@ -41,6 +48,19 @@ static const uint8_t ws281x_bit_patterns[4] = {
 static uint8_t gammaLUT[256];
 
 
+#if defined(CONFIG_IBIS_HAS_WS281X_BACKLIGHT)
+static void display_update_gamma(const char* key, void* arg) {
+    uint16_t gammaU16;
+    esp_err_t ret = config_get_u16(key, &gammaU16);
+    if (ret != ESP_OK) gammaU16 = 100;
+    if (gammaU16 == 0) gammaU16 = 100;
+    double gamma = gammaU16 / 100.0;
+    for (uint16_t i = 0; i < 256; i++) {
+        gammaLUT[i] = round(pow(i, gamma) / pow(255, (gamma - 1)));
+    }
+}
+#endif
+
 esp_err_t display_init(nvs_handle_t* nvsHandle) {
     /*
      * Set up all needed peripherals
@@ -67,15 +87,9 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     #endif
 
     #if defined(CONFIG_IBIS_HAS_WS281X_BACKLIGHT)
-    // Calculate gamma lookup table
-    uint16_t gammaU16;
-    esp_err_t ret = nvs_get_u16(*nvsHandle, "disp_led_gamma", &gammaU16);
-    if (ret != ESP_OK) gammaU16 = 100;
-    if (gammaU16 == 0) gammaU16 = 100;
-    double gamma = gammaU16 / 100.0;
-    for (uint16_t i = 0; i < 256; i++) {
-        gammaLUT[i] = round(pow(i, gamma) / pow(255, (gamma - 1)));
-    }
+    // Calculate gamma lookup table and recalculate it whenever the gamma value is changed
+    display_update_gamma("disp_led_gamma", NULL);
+    config_subscribe("disp_led_gamma", display_update_gamma, NULL);
 
     // Init SPI peripheral
     spi_bus_config_t buscfg = {
@@ -103,6 +117,10 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     ESP_ERROR_CHECK(spi_bus_add_device(HSPI_HOST, &devcfg, &spi));
     #endif
     #endif
+
+    if (buffer_char_output_init(&display_lastOutput, DISPLAY_CHAR_BUF_SIZE) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Not enough memory for change detection, rendering every frame");
+    }
     return ESP_OK;
 }
 
@@ -120,6 +138,7 @@ esp_err_t display_set_brightness(uint8_t brightness) {
 #if defined(CONFIG_DISPLAY_HAS_SHADERS)
 esp_err_t display_set_shader(void* shaderData) {
     display_currentShader = shaderData;
+    shader_invalidate_cache();
     return ESP_OK;
 }
 #else
@@ -142,6 +161,11 @@ void display_setBacklightColor(color_t color) {
     color.green = gammaLUT[((uint16_t)color.green * display_currentBrightness) / 255];
     color.blue = gammaLUT[((uint16_t)color.blue * display_currentBrightness) / 255];
 
+    // Brightness and gamma are applied already, so this also catches changes of those
+    if (!display_backlightChanged && color.red == display_backlightColor.red && color.green == display_backlightColor.green && color.blue == display_backlightColor.blue) return;
+    display_backlightColor = color;
+    display_backlightChanged = 1;
+
     for (uint16_t ledPos = 0; ledPos < CONFIG_IBIS_WS281X_NUM_LEDS; ledPos++) {
         #if defined(CONFIG_IBIS_WS281X_COLOR_ORDER_GRB)
         backlightFrameBuf[ledPos * 12 + 3] = ws281x_bit_patterns[(color.green >> 0) & 0x03];
@@ -243,29 +267,28 @@ void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize,
     #if defined(CONFIG_DISPLAY_HAS_SHADERS)
     // Update shader
     color_t color;
-    color_rgb_t calcColor_rgb;
-
-    memset(backlightFrameBuf, 0x88, BACKLIGHT_FRAMEBUF_SIZE);
+    color_rgb_u8_t calcColor_rgb;
 
     // Backlight color is based on first character
-    calcColor_rgb = shader_fromJSON(0, charBufSize, charBuf[0], display_currentShader);
-    color.red = calcColor_rgb.r * 255;
-    color.green = calcColor_rgb.g * 255;
-    color.blue = calcColor_rgb.b * 255;
+    shader_fromJSON(display_currentShader, charBuf, charBufSize, &calcColor_rgb, 1);
+    color.red = calcColor_rgb.r;
+    color.green = calcColor_rgb.g;
+    color.blue = calcColor_rgb.b;
     #if defined(CONFIG_IBIS_HAS_WS281X_BACKLIGHT)
     display_setBacklightColor(color);
     #endif
     #endif
 
     #if defined(CONFIG_IBIS_HAS_WS281X_BACKLIGHT)
-    // Update backlight
-    if (!display_backlight_transferOngoing) {
+    // Update backlight, only if its color has changed
+    if (display_backlightChanged && !display_backlight_transferOngoing) {
         spi_transaction_t spi_trans = {
             .length = BACKLIGHT_FRAMEBUF_SIZE * 8,
             .tx_buffer = backlightFrameBuf,
         };
         ESP_ERROR_CHECK(spi_device_transmit(spi, &spi_trans));
         ets_delay_us(350); // Ensure reset pulse
+        display_backlightChanged = 0;
     }
     #endif
 
@@ -277,6 +300,9 @@ void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize,
     buffer_textbuf_to_charbuf(textBuf, charBuf, quirkFlagBuf, textBufSize, charBufSize);
     if (prevTextBuf != NULL) memcpy(prevTextBuf, textBuf, textBufSize);
     taskEXIT_CRITICAL(textBufLock);
+
+    if (!buffer_char_output_changed(&display_lastOutput, charBuf, quirkFlagBuf, charBufSize)) return;
+
     display_buffers_to_out_buf(charBuf, quirkFlagBuf, charBufSize);
     display_render();
 }
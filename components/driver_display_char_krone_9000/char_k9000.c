@@ -21,6 +21,7 @@
 // TODO: Do something with Rx pin?
 
 static uint8_t display_outBuf[OUTPUT_BUFFER_SIZE] = {0};
+static buffer_char_output_t display_lastOutput;
 
 
 esp_err_t display_init(nvs_handle_t* nvsHandle) {
@@ -45,6 +46,10 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     ESP_ERROR_CHECK(uart_driver_install(K9000_UART, CONFIG_K9000_RX_BUF_SIZE, CONFIG_K9000_TX_BUF_SIZE, 0, NULL, 0));
     ESP_ERROR_CHECK(uart_param_config(K9000_UART, &uart_config));
     ESP_ERROR_CHECK(uart_set_pin(K9000_UART, CONFIG_K9000_TX_IO, CONFIG_K9000_RX_IO, -1, -1));
+
+    if (buffer_char_output_init(&display_lastOutput, DISPLAY_CHAR_BUF_SIZE) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Not enough memory for change detection, rendering every frame");
+    }
     return ESP_OK;
 }
 
@@ -84,6 +89,9 @@ void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize,
     buffer_textbuf_to_charbuf(textBuf, charBuf, quirkFlagBuf, textBufSize, charBufSize);
     if (prevTextBuf != NULL) memcpy(prevTextBuf, textBuf, textBufSize);
     taskEXIT_CRITICAL(textBufLock);
+
+    if (!buffer_char_output_changed(&display_lastOutput, charBuf, quirkFlagBuf, charBufSize)) return;
+
     display_buffers_to_out_buf(charBuf, quirkFlagBuf, charBufSize);
     display_render();
 }
@@ -28,6 +28,7 @@
 spi_device_handle_t spi;
 volatile static uint8_t transferOngoing = false;
 static uint8_t outBuf[OUTPUT_BUFFER_SIZE] = {0};
+static buffer_char_output_t display_lastOutput;
 
 // true: Latch indicators (if available); false: latch LCD
 volatile static bool latchIndicators = false;
@@ -113,6 +114,10 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     ESP_ERROR_CHECK(spi_bus_initialize(HSPI_HOST, &buscfg, 1));
     ESP_ERROR_CHECK(spi_bus_add_device(HSPI_HOST, &devcfg, &spi));
     #endif
+
+    if (buffer_char_output_init(&display_lastOutput, DISPLAY_CHAR_BUF_SIZE) != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Not enough memory for change detection, rendering every frame");
+    }
     return ESP_OK;
 }
 
@@ -280,6 +285,8 @@ void display_update(uint8_t* textBuf, uint8_t* prevTextBuf, size_t textBufSize,
     if (prevTextBuf != NULL) memcpy(prevTextBuf, textBuf, textBufSize);
     taskEXIT_CRITICAL(textBufLock);
 
+    if (!buffer_char_output_changed(&display_lastOutput, charBuf, quirkFlagBuf, charBufSize)) return;
+
     #if defined(CONFIG_CSEG_LCD_SEPARATE_OUTPUTS_PER_LINE)
     for (uint8_t line = 0; line < DISPLAY_FRAME_HEIGHT_CHAR; line++) {
         cseg_lcd_buffers_to_out_buf(charBuf, quirkFlagBuf, charBufSize, line);
@@ -39,7 +39,9 @@ void display_shiftBit(uint8_t bit) {
      * Thus, the maximum data rate for all ones is 20 kbit/s.
      */
 
-    gpio_pulse_inv(CONFIG_SAFLAP_DATA_IO, 1, bit ? 20 : 5, 0, 30, CONFIG_SAFLAP_DATA_IO_INVERT);
+    // Written through the output register, the 5µs pulses are short enough
+    // for the overhead of gpio_set_level() to be noticeable
+    gpio_pulse_mask(GPIO_BIT(CONFIG_SAFLAP_DATA_IO), !CONFIG_SAFLAP_DATA_IO_INVERT, bit ? 20 : 5, 0, 30);
 }
 
 void display_shiftByte(uint8_t byte) {
@@ -3,12 +3,14 @@
  */
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
 #include "rom/ets_sys.h"
 
 #include "flipdot_brose.h"
+#include "transitions_pixel.h"
 #include "util_gpio.h"
 #include "macros.h"
 
@@ -17,41 +19,89 @@
 
 #define LOG_TAG "FLIPDOT-BROSE"
 
-static uint8_t display_outBuf[OUTPUT_BUFFER_SIZE] = {0};
+// List of dots to flip, grouped by color and then by column
+// so that the color and column address change as rarely as possible
+static display_flip_t display_outBuf[OUTPUT_BUFFER_SIZE];
+static uint16_t display_numFlips = 0;
 static uint8_t display_dirty = 1;
 
+#if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+static void* display_currentTransition = NULL;
+// Copy of the pixel buffer, so the transition can run outside of the lock
+static uint8_t display_framePixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+// What the transition has arrived at, and what the dots currently show
+static uint8_t display_transitionPixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+static uint8_t display_shownPixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+#endif
+
+static const gpio_num_t display_panelEnableIOs[CONFIG_BROSE_NUM_PANELS] = {
+    CONFIG_BROSE_PAN_E_IO,
+    #if CONFIG_BROSE_NUM_PANELS >= 2
+    CONFIG_BROSE_PAN2_E_IO,
+    #endif
+    #if CONFIG_BROSE_NUM_PANELS >= 3
+    CONFIG_BROSE_PAN3_E_IO,
+    #endif
+    #if CONFIG_BROSE_NUM_PANELS >= 4
+    CONFIG_BROSE_PAN4_E_IO,
+    #endif
+    #if CONFIG_BROSE_NUM_PANELS >= 5
+    CONFIG_BROSE_PAN5_E_IO,
+    #endif
+    #if CONFIG_BROSE_NUM_PANELS >= 6
+    CONFIG_BROSE_PAN6_E_IO,
+    #endif
+    #if CONFIG_BROSE_NUM_PANELS >= 7
+    CONFIG_BROSE_PAN7_E_IO,
+    #endif
+    #if CONFIG_BROSE_NUM_PANELS >= 8
+    CONFIG_BROSE_PAN8_E_IO,
+    #endif
+};
+
+// Address and enable lines, each written with a single register access per bank
+static gpio_bus_t display_columnBus;
+static gpio_bus_t display_rowBus;
+static gpio_bus_t display_panelBus;
+
 esp_err_t display_init(nvs_handle_t* nvsHandle) {
     /*
      * Set up all needed peripherals
      */
     
+    const gpio_num_t columnIOs[5] = {CONFIG_BROSE_COL_A0_IO, CONFIG_BROSE_COL_A1_IO, CONFIG_BROSE_COL_A2_IO, CONFIG_BROSE_COL_B0_IO, CONFIG_BROSE_COL_B1_IO};
+    const gpio_num_t rowIOs[3] = {CONFIG_BROSE_RD_A0_IO, CONFIG_BROSE_RD_A1_IO, CONFIG_BROSE_RD_A2_IO};
+    esp_err_t ret;
+
     gpio_reset_pin(CONFIG_BROSE_RD_EN_R_IO);
     gpio_reset_pin(CONFIG_BROSE_RD_EN_S_IO);
-    gpio_reset_pin(CONFIG_BROSE_RD_A0_IO);
-    gpio_reset_pin(CONFIG_BROSE_RD_A1_IO);
-    gpio_reset_pin(CONFIG_BROSE_RD_A2_IO);
-    gpio_reset_pin(CONFIG_BROSE_PAN_E_IO);
     gpio_reset_pin(CONFIG_BROSE_PAN_CS_IO);
-    gpio_reset_pin(CONFIG_BROSE_COL_A0_IO);
-    gpio_reset_pin(CONFIG_BROSE_COL_A1_IO);
-    gpio_reset_pin(CONFIG_BROSE_COL_A2_IO);
-    gpio_reset_pin(CONFIG_BROSE_COL_B0_IO);
-    gpio_reset_pin(CONFIG_BROSE_COL_B1_IO);
 
     gpio_set_direction(CONFIG_BROSE_RD_EN_R_IO, GPIO_MODE_OUTPUT);
     gpio_set_direction(CONFIG_BROSE_RD_EN_S_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_RD_A0_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_RD_A1_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_RD_A2_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_PAN_E_IO, GPIO_MODE_OUTPUT);
     gpio_set_direction(CONFIG_BROSE_PAN_CS_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_COL_A0_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_COL_A1_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_COL_A2_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_COL_B0_IO, GPIO_MODE_OUTPUT);
-    gpio_set_direction(CONFIG_BROSE_COL_B1_IO, GPIO_MODE_OUTPUT);
-    
+
+    ret = gpio_bus_init(&display_columnBus, columnIOs, 5);
+    if (ret != ESP_OK) return ret;
+    ret = gpio_bus_init(&display_rowBus, rowIOs, 3);
+    if (ret != ESP_OK) return ret;
+    ret = gpio_bus_init(&display_panelBus, display_panelEnableIOs, CONFIG_BROSE_NUM_PANELS);
+    if (ret != ESP_OK) return ret;
+
     display_deselect();
+
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    // Without memory for the transitions, changes are shown instantly
+    ret = transition_init(DISPLAY_FRAME_WIDTH_PIXEL, DISPLAY_FRAME_HEIGHT_PIXEL, NULL, 0);
+    if (ret != ESP_OK) ESP_LOGE(LOG_TAG, "Failed to initialize transitions: %s", esp_err_to_name(ret));
+    #endif
+    return ESP_OK;
+}
+
+esp_err_t display_set_transition(void* transitionData) {
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    display_currentTransition = transitionData;
+    #endif
     return ESP_OK;
 }
 
@@ -67,11 +117,7 @@ void display_select_column(uint8_t address) {
     // This is contrary to what the datasheet states
     address += address / 7;
 
-    gpio_set_level(CONFIG_BROSE_COL_A0_IO, ((address & 1) != 0));
-    gpio_set_level(CONFIG_BROSE_COL_A1_IO, ((address & 2) != 0));
-    gpio_set_level(CONFIG_BROSE_COL_A2_IO, ((address & 4) != 0));
-    gpio_set_level(CONFIG_BROSE_COL_B0_IO, ((address & 8) != 0));
-    gpio_set_level(CONFIG_BROSE_COL_B1_IO, ((address & 16) != 0));
+    gpio_bus_write(&display_columnBus, address);
 }
 
 void display_select_row(uint8_t address) {
@@ -79,9 +125,7 @@ void display_select_row(uint8_t address) {
      * Output a 3-bit address on the row address bus
      */
 
-    gpio_set_level(CONFIG_BROSE_RD_A0_IO, ((address & 1) != 0));
-    gpio_set_level(CONFIG_BROSE_RD_A1_IO, ((address & 2) != 0));
-    gpio_set_level(CONFIG_BROSE_RD_A2_IO, ((address & 4) != 0));
+    gpio_bus_write(&display_rowBus, address);
 }
 
 void display_select_color(uint8_t color) {
@@ -92,15 +136,14 @@ void display_select_color(uint8_t color) {
      */
 
     if (color) {
-        gpio_set_level(CONFIG_BROSE_RD_EN_R_IO, 0);
+        gpio_write_mask(0, GPIO_BIT(CONFIG_BROSE_RD_EN_R_IO));
         ets_delay_us(1);
-        gpio_set_level(CONFIG_BROSE_RD_EN_S_IO, 1);
+        gpio_write_mask(GPIO_BIT(CONFIG_BROSE_RD_EN_S_IO) | GPIO_BIT(CONFIG_BROSE_PAN_CS_IO), 0);
     } else {
-        gpio_set_level(CONFIG_BROSE_RD_EN_S_IO, 0);
+        gpio_write_mask(0, GPIO_BIT(CONFIG_BROSE_RD_EN_S_IO));
         ets_delay_us(1);
-        gpio_set_level(CONFIG_BROSE_RD_EN_R_IO, 1);
+        gpio_write_mask(GPIO_BIT(CONFIG_BROSE_RD_EN_R_IO), GPIO_BIT(CONFIG_BROSE_PAN_CS_IO));
     }
-    gpio_set_level(CONFIG_BROSE_PAN_CS_IO, color);
 }
 
 void display_deselect() {
@@ -108,36 +151,38 @@ void display_deselect() {
      * Deselect all control lines
      */
 
-    gpio_set_level(CONFIG_BROSE_RD_EN_R_IO, 0);
-    gpio_set_level(CONFIG_BROSE_RD_EN_S_IO, 0);
-    gpio_set_level(CONFIG_BROSE_RD_A0_IO, 0);
-    gpio_set_level(CONFIG_BROSE_RD_A1_IO, 0);
-    gpio_set_level(CONFIG_BROSE_RD_A2_IO, 0);
-    gpio_set_level(CONFIG_BROSE_PAN_E_IO, 0);
-    gpio_set_level(CONFIG_BROSE_PAN_CS_IO, 1);
-    gpio_set_level(CONFIG_BROSE_COL_A0_IO, 1);
-    gpio_set_level(CONFIG_BROSE_COL_A1_IO, 1);
-    gpio_set_level(CONFIG_BROSE_COL_A2_IO, 1);
-    gpio_set_level(CONFIG_BROSE_COL_B0_IO, 1);
-    gpio_set_level(CONFIG_BROSE_COL_B1_IO, 1);
+    gpio_write_mask(GPIO_BIT(CONFIG_BROSE_PAN_CS_IO), GPIO_BIT(CONFIG_BROSE_RD_EN_R_IO) | GPIO_BIT(CONFIG_BROSE_RD_EN_S_IO));
+    gpio_bus_write(&display_rowBus, 0);
+    gpio_bus_write(&display_panelBus, 0);
+    gpio_bus_write(&display_columnBus, 0x1F);
 }
 
-void display_flip() {
+void display_flip(uint8_t panels) {
     /*
-     * Flip the currently selected pixel
+     * Flip the currently selected pixel on the given panels (bit mask, bit 0 = first panel)
      */
-    
-    gpio_pulse(CONFIG_BROSE_PAN_E_IO, 1, CONFIG_BROSE_FLIP_PULSE_WIDTH, 0, CONFIG_BROSE_FLIP_PAUSE_LENGTH);
+
+    #if defined(CONFIG_BROSE_PARALLEL_PANELS)
+    gpio_bus_write(&display_panelBus, panels);
+    ets_delay_us(CONFIG_BROSE_FLIP_PULSE_WIDTH);
+    gpio_bus_write(&display_panelBus, 0);
+    ets_delay_us(CONFIG_BROSE_FLIP_PAUSE_LENGTH);
+    #else
+    for (uint8_t panel = 0; panel < CONFIG_BROSE_NUM_PANELS; panel++) {
+        if (!(panels & (1 << panel))) continue;
+        gpio_bus_write(&display_panelBus, 1 << panel);
+        ets_delay_us(CONFIG_BROSE_FLIP_PULSE_WIDTH);
+        gpio_bus_write(&display_panelBus, 0);
+        ets_delay_us(CONFIG_BROSE_FLIP_PAUSE_LENGTH);
+    }
+    #endif
 }
 
 void display_buffers_to_out_buf(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize) {
-    uint16_t x, y_byte, y;
-    uint16_t outIdx = 0;
+    uint16_t x;
+    uint8_t column, y, color, value, panel, panels;
 
-    // 0 = Set pixel black
-    // 1 = Set pixel yellow
-    // 0xFF = Skip pixel
-    memset(display_outBuf, 0xFF, OUTPUT_BUFFER_SIZE);
+    display_numFlips = 0;
 
     #if !defined(CONFIG_BROSE_UPDATE_CHANGED_ONLY)
     uint8_t full_update = 1;
@@ -148,45 +193,74 @@ void display_buffers_to_out_buf(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pix
     if (full_update) ESP_LOGD(LOG_TAG, "Updating all pixels");
     else ESP_LOGD(LOG_TAG, "Updating changed pixels");
 
-    if (full_update) {
-        for(uint16_t i = 0; i < pixBufSize; i++) {
-            x = (i / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES);
-            y_byte = i % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
-            for (uint8_t y_bit = 0; y_bit < 7; y_bit++) {
-                y = (y_byte * 8) + y_bit;
-                display_outBuf[outIdx++] = PIX_BUF_VAL(pixBuf, x, y);
-            }
-        }
-    } else {
-        for(uint16_t i = 0; i < pixBufSize; i++) {
-            x = (i / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES);
-            y_byte = i % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
-            for (uint8_t y_bit = 0; y_bit < 7; y_bit++) {
-                y = (y_byte * 8) + y_bit;
-                if(PIX_BUF_VAL(pixBuf, x, y) == PIX_BUF_VAL(prevPixBuf, x, y)) continue;
-                display_outBuf[outIdx++] = PIX_BUF_VAL(pixBuf, x, y);
+    // One phase for all black dots, then one for all yellow dots,
+    // so the color only needs to be selected twice per update.
+    // All panels share the address lines, so the same dot is collected for every panel at once.
+    for (color = 0; color < 2; color++) {
+        for (column = 0; column < CONFIG_BROSE_PANEL_WIDTH; column++) {
+            for (y = 0; y < DISPLAY_FRAME_HEIGHT_PIXEL; y++) {
+                panels = 0;
+                for (panel = 0; panel < CONFIG_BROSE_NUM_PANELS; panel++) {
+                    x = (panel * CONFIG_BROSE_PANEL_WIDTH) + column;
+                    if (x >= DISPLAY_FRAME_WIDTH_PIXEL) break;
+                    value = PIX_BUF_VAL(pixBuf, x, y);
+                    if (value != color) continue;
+                    if (!full_update && value == PIX_BUF_VAL(prevPixBuf, x, y)) continue;
+                    panels |= (1 << panel);
+                }
+                if (panels == 0) continue;
+                display_outBuf[display_numFlips].column = column;
+                display_outBuf[display_numFlips].row = y;
+                display_outBuf[display_numFlips].color = color;
+                display_outBuf[display_numFlips].panels = panels;
+                display_numFlips++;
             }
         }
     }
 }
 
 void display_render() {
-    uint16_t x, y;
-    for(uint16_t i = 0; i < OUTPUT_BUFFER_SIZE; i++) {
-        if (display_outBuf[i] == 0xFF) continue;
-        x = i / DISPLAY_FRAME_HEIGHT_PIXEL;
-        y = i % DISPLAY_FRAME_HEIGHT_PIXEL;
-        display_select_color(display_outBuf[i]);
-        display_select_column(x % CONFIG_BROSE_PANEL_WIDTH);
-        display_select_row(y);
-        ESP_LOGV(LOG_TAG, "display_outBuf[%d] = %d", i, display_outBuf[i]);
-        display_flip();
+    display_flip_t* flip;
+    // Start with values that can't occur so that everything is selected for the first dot
+    uint8_t color = 0xFF;
+    uint8_t column = 0xFF;
+    uint8_t row = 0xFF;
+
+    for (uint16_t i = 0; i < display_numFlips; i++) {
+        flip = &display_outBuf[i];
+        if (flip->color != color) {
+            color = flip->color;
+            display_select_color(color);
+        }
+        if (flip->column != column) {
+            column = flip->column;
+            display_select_column(column);
+        }
+        if (flip->row != row) {
+            row = flip->row;
+            display_select_row(row);
+        }
+        ESP_LOGV(LOG_TAG, "Flip column=%u row=%u color=%u panels=0x%02x", flip->column, flip->row, flip->color, flip->panels);
+        display_flip(flip->panels);
     }
+    display_numFlips = 0;
     display_dirty = 0;
     display_deselect();
 }
 
 void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock) {
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    // The transition is stepped on every call, and only the dots it changed in this step are flipped
+    taskENTER_CRITICAL(pixBufLock);
+    memcpy(display_framePixBuf, pixBuf, pixBufSize);
+    if (prevPixBuf != NULL) memcpy(prevPixBuf, pixBuf, pixBufSize);
+    taskEXIT_CRITICAL(pixBufLock);
+
+    if (!transition_update(display_transitionPixBuf, display_framePixBuf, display_currentTransition, esp_timer_get_time()) && !display_dirty) return;
+    display_buffers_to_out_buf(display_transitionPixBuf, display_shownPixBuf, DISPLAY_PIX_BUF_SIZE);
+    memcpy(display_shownPixBuf, display_transitionPixBuf, DISPLAY_PIX_BUF_SIZE);
+    display_render();
+    #else
     // Nothing to do if buffer hasn't changed
     if (prevPixBuf != NULL && memcmp(pixBuf, prevPixBuf, pixBufSize) == 0) return;
 
@@ -195,6 +269,7 @@ void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, por
     if (prevPixBuf != NULL) memcpy(prevPixBuf, pixBuf, pixBufSize);
     taskEXIT_CRITICAL(pixBufLock);
     display_render();
+    #endif
 }
 
 #endif
\ No newline at end of file
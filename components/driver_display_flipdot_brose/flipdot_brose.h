@@ -3,14 +3,24 @@
 #include "esp_system.h"
 #include "nvs.h"
 
-#define OUTPUT_BUFFER_SIZE (DISPLAY_FRAME_WIDTH_PIXEL * DISPLAY_FRAME_HEIGHT_PIXEL)
+// Each dot of a panel is flipped at most once per color
+#define OUTPUT_BUFFER_SIZE (CONFIG_BROSE_PANEL_WIDTH * DISPLAY_FRAME_HEIGHT_PIXEL * 2)
+
+// A single dot to be flipped, on all panels in the "panels" bit mask
+typedef struct {
+    uint8_t column;
+    uint8_t row;
+    uint8_t color;
+    uint8_t panels;
+} display_flip_t;
 
 esp_err_t display_init(nvs_handle_t* nvsHandle);
+esp_err_t display_set_transition(void* transitionData);
 void display_select_column(uint8_t address);
 void display_select_row(uint8_t address);
 void display_select_color(uint8_t color);
 void display_deselect();
-void display_flip();
+void display_flip(uint8_t panels);
 void display_buffers_to_out_buf(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize);
 void display_render();
 void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock);
\ No newline at end of file
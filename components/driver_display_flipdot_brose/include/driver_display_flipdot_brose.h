@@ -6,4 +6,5 @@
 #include "freertos/task.h"
 
 esp_err_t display_init(nvs_handle_t* nvsHandle);
+esp_err_t display_set_transition(void* transitionData);
 void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock);
\ No newline at end of file
@@ -4,5 +4,6 @@
 #include "nvs.h"
 
 esp_err_t display_init(nvs_handle_t* nvsHandle);
+esp_err_t display_set_transition(void* transitionData);
 void display_set_backlight(uint8_t state);
 void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock);
\ No newline at end of file
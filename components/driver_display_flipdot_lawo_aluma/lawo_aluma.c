@@ -3,11 +3,13 @@
  */
 
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <string.h>
 
 #include "lawo_aluma.h"
+#include "transitions_pixel.h"
 #include "util_gpio.h"
 
 #if defined(CONFIG_DISPLAY_DRIVER_FLIPDOT_LAWO_ALUMA)
@@ -18,6 +20,15 @@
 static uint8_t display_outBuf[OUTPUT_BUFFER_SIZE] = {0};
 static uint8_t display_dirty = 1;
 
+#if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+static void* display_currentTransition = NULL;
+// Copy of the pixel buffer, so the transition can run outside of the lock
+static uint8_t display_framePixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+// What the transition has arrived at, and what the dots currently show
+static uint8_t display_transitionPixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+static uint8_t display_shownPixBuf[DISPLAY_PIX_BUF_SIZE] = {0};
+#endif
+
 
 static const uint8_t rowLookupTableYellow[28] = {
     2, 3, 6, 7, 1, 0, 5, 4,
@@ -35,10 +46,17 @@ static const uint8_t rowLookupTableBlack[28] = {
 
 static uint8_t currentColor = 0;
 
+// Shared address bus for rows, columns and panels
+static gpio_bus_t display_addressBus;
+
 esp_err_t display_init(nvs_handle_t* nvsHandle) {
     /*
      * Set up all needed peripherals
      */
+
+    const gpio_num_t addressIOs[4] = {PIN_A0, PIN_A1, PIN_A2, PIN_A3};
+    esp_err_t ret = gpio_bus_init(&display_addressBus, addressIOs, 4);
+    if (ret != ESP_OK) return ret;
     
     gpio_reset_pin(PIN_CS);
     gpio_reset_pin(PIN_EL);
@@ -46,10 +64,6 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     gpio_reset_pin(PIN_LC_N);
     gpio_reset_pin(PIN_LP_N);
     gpio_reset_pin(PIN_F);
-    gpio_reset_pin(PIN_A0);
-    gpio_reset_pin(PIN_A1);
-    gpio_reset_pin(PIN_A2);
-    gpio_reset_pin(PIN_A3);
     gpio_reset_pin(PIN_COL_A3);
     gpio_reset_pin(PIN_LED);
 
@@ -59,10 +73,6 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     gpio_set_direction(PIN_LC_N, GPIO_MODE_OUTPUT);
     gpio_set_direction(PIN_LP_N, GPIO_MODE_OUTPUT);
     gpio_set_direction(PIN_F, GPIO_MODE_OUTPUT);
-    gpio_set_direction(PIN_A0, GPIO_MODE_OUTPUT);
-    gpio_set_direction(PIN_A1, GPIO_MODE_OUTPUT);
-    gpio_set_direction(PIN_A2, GPIO_MODE_OUTPUT);
-    gpio_set_direction(PIN_A3, GPIO_MODE_OUTPUT);
     gpio_set_direction(PIN_COL_A3, GPIO_MODE_OUTPUT);
     gpio_set_direction(PIN_LED, GPIO_MODE_OUTPUT);
     
@@ -72,12 +82,22 @@ esp_err_t display_init(nvs_handle_t* nvsHandle) {
     gpio_set_level(PIN_LC_N, 1);
     gpio_set_level(PIN_LP_N, 1);
     gpio_set_level(PIN_F, 0);
-    gpio_set_level(PIN_A0, 0);
-    gpio_set_level(PIN_A1, 0);
-    gpio_set_level(PIN_A2, 0);
-    gpio_set_level(PIN_A3, 0);
+    gpio_bus_write(&display_addressBus, 0);
     gpio_set_level(PIN_COL_A3, 0);
     gpio_set_level(PIN_LED, 0);
+
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    // Without memory for the transitions, changes are shown instantly
+    ret = transition_init(DISPLAY_FRAME_WIDTH_PIXEL, DISPLAY_FRAME_HEIGHT_PIXEL, NULL, 0);
+    if (ret != ESP_OK) ESP_LOGE(LOG_TAG, "Failed to initialize transitions: %s", esp_err_to_name(ret));
+    #endif
+    return ESP_OK;
+}
+
+esp_err_t display_set_transition(void* transitionData) {
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    display_currentTransition = transitionData;
+    #endif
     return ESP_OK;
 }
 
@@ -86,10 +106,7 @@ void display_set_address(uint8_t address) {
      * Output a 4-bit address on the address bus
      */
 
-    gpio_set_level(PIN_A0, ((address & 1) != 0));
-    gpio_set_level(PIN_A1, ((address & 2) != 0));
-    gpio_set_level(PIN_A2, ((address & 4) != 0));
-    gpio_set_level(PIN_A3, ((address & 8) != 0));
+    gpio_bus_write(&display_addressBus, address);
 }
 
 void display_select_row(uint8_t address) {
@@ -116,15 +133,15 @@ void display_select_column(uint8_t address) {
     display_set_address(colAddress);
     gpio_pulse(PIN_LC_N, 0, LATCH_PULSE_WIDTH_US, 0, LATCH_PULSE_WIDTH_US);
 
-    gpio_set_level(PIN_COL_A3, ((colAddress & 8) != 0));
-
-    if(colAddress >= 16) {
-        gpio_set_level(PIN_EL, 0);
-        gpio_set_level(PIN_ER, 1);
+    // Column decoder A3 and half panel enable in one go
+    uint64_t setBits = (colAddress >= 16) ? GPIO_BIT(PIN_ER) : GPIO_BIT(PIN_EL);
+    uint64_t clearBits = (colAddress >= 16) ? GPIO_BIT(PIN_EL) : GPIO_BIT(PIN_ER);
+    if (colAddress & 8) {
+        setBits |= GPIO_BIT(PIN_COL_A3);
     } else {
-        gpio_set_level(PIN_ER, 0);
-        gpio_set_level(PIN_EL, 1);
+        clearBits |= GPIO_BIT(PIN_COL_A3);
     }
+    gpio_write_mask(setBits, clearBits);
 }
 
 void display_select_panel(uint8_t address) {
@@ -152,10 +169,7 @@ void display_deselect() {
      * Deselect all control lines
      */
 
-    gpio_set_level(PIN_EL, 0);
-    gpio_set_level(PIN_ER, 0);
-
-    gpio_set_level(PIN_COL_A3, 0);
+    gpio_write_mask(0, GPIO_BIT(PIN_EL) | GPIO_BIT(PIN_ER) | GPIO_BIT(PIN_COL_A3));
 }
 
 void display_flip() {
@@ -224,6 +238,18 @@ void display_buffers_to_out_buf(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pix
 }
 
 void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock) {
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    // The transition is stepped on every call, and only the dots it changed in this step are flipped
+    taskENTER_CRITICAL(pixBufLock);
+    memcpy(display_framePixBuf, pixBuf, pixBufSize);
+    if (prevPixBuf != NULL) memcpy(prevPixBuf, pixBuf, pixBufSize);
+    taskEXIT_CRITICAL(pixBufLock);
+
+    if (!transition_update(display_transitionPixBuf, display_framePixBuf, display_currentTransition, esp_timer_get_time()) && !display_dirty) return;
+    display_buffers_to_out_buf(display_transitionPixBuf, display_shownPixBuf, DISPLAY_PIX_BUF_SIZE);
+    memcpy(display_shownPixBuf, display_transitionPixBuf, DISPLAY_PIX_BUF_SIZE);
+    display_render();
+    #else
     // Nothing to do if buffer hasn't changed
     if (prevPixBuf != NULL && memcmp(pixBuf, prevPixBuf, pixBufSize) == 0) return;
 
@@ -232,6 +258,7 @@ void display_update(uint8_t* pixBuf, uint8_t* prevPixBuf, size_t pixBufSize, por
     if (prevPixBuf != NULL) memcpy(prevPixBuf, pixBuf, pixBufSize);
     taskEXIT_CRITICAL(pixBufLock);
     display_render();
+    #endif
 }
 
 #endif
\ No newline at end of file
@@ -26,6 +26,7 @@
 #define FLIP_PAUSE_US          1500
 
 esp_err_t display_init(nvs_handle_t* nvsHandle);
+esp_err_t display_set_transition(void* transitionData);
 void display_set_address(uint8_t address);
 void display_select_row(uint8_t address);
 void display_select_column(uint8_t address);
@@ -0,0 +1,132 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "effect_glitches.h"
+
+
+static uint32_t glitches_rand(glitch_state_t* state) {
+    // xorshift32, the state must never be 0
+    uint32_t x = state->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    state->rng = x;
+    return x;
+}
+
+static int32_t glitches_rand_range(glitch_state_t* state, int32_t min, int32_t max) {
+    // Same as rand_range(), but with the state's own generator
+    if (max == min) return max;
+    return glitches_rand(state) % (max - min) + min;
+}
+
+static int32_t glitches_rand_spread(glitch_state_t* state, int32_t nominal, int32_t spread) {
+    // Same as rand_spread(), but with the state's own generator
+    if (spread == 0) return nominal;
+    return nominal + (int32_t)(glitches_rand(state) % (spread * 2)) - spread;
+}
+
+static void glitches_reschedule_top(glitch_state_t* state, int64_t time_us) {
+    // Move the earliest event to a new time and restore the heap order
+    glitch_event_t event = state->events[0];
+    event.time_us = time_us;
+    uint16_t i = 0;
+    while (1) {
+        uint32_t child = 2 * i + 1;
+        if (child >= state->numChars) break;
+        if (child + 1 < state->numChars && state->events[child + 1].time_us < state->events[child].time_us) child++;
+        if (state->events[child].time_us >= event.time_us) break;
+        state->events[i] = state->events[child];
+        i = child;
+    }
+    state->events[i] = event;
+}
+
+static void glitches_start(glitch_state_t* state, uint16_t charPos, uint8_t charVal) {
+    state->charVals[charPos] = charVal;
+    state->activeIndex[charPos] = state->numActive;
+    state->active[state->numActive++] = charPos;
+}
+
+static void glitches_stop(glitch_state_t* state, uint16_t charPos) {
+    // Swap with the last active glitch
+    uint16_t index = state->activeIndex[charPos];
+    uint16_t last = state->active[--state->numActive];
+    state->active[index] = last;
+    state->activeIndex[last] = index;
+    state->charVals[charPos] = 0;
+}
+
+glitch_state_t* glitches_create(const glitch_params_t* params, uint16_t numChars, uint32_t seed, int64_t now_us) {
+    glitch_state_t* state = calloc(1, sizeof(glitch_state_t));
+    if (state == NULL) return NULL;
+    state->params = *params;
+    state->rng = seed ? seed : 1;
+    state->numChars = numChars;
+    state->events = malloc(numChars * sizeof(glitch_event_t));
+    state->nextCheck_us = malloc(numChars * sizeof(int64_t));
+    state->charVals = calloc(numChars, sizeof(uint8_t));
+    state->active = malloc(numChars * sizeof(uint16_t));
+    state->activeIndex = malloc(numChars * sizeof(uint16_t));
+    if (numChars > 0 && (state->events == NULL || state->nextCheck_us == NULL || state->charVals == NULL || state->active == NULL || state->activeIndex == NULL)) {
+        glitches_free(state);
+        return NULL;
+    }
+
+    // All characters are checked right away. Equal times are a valid heap.
+    for (uint16_t i = 0; i < numChars; i++) {
+        state->events[i].time_us = now_us;
+        state->events[i].charPos = i;
+        state->nextCheck_us[i] = now_us;
+    }
+    return state;
+}
+
+void glitches_free(glitch_state_t* state) {
+    if (state == NULL) return;
+    free(state->events);
+    free(state->nextCheck_us);
+    free(state->charVals);
+    free(state->active);
+    free(state->activeIndex);
+    free(state);
+}
+
+uint8_t glitches_process(glitch_state_t* state, uint8_t* charBuf, int64_t now_us) {
+    /*
+    Process all events that are due and apply the active glitches to charBuf.
+    charBuf has to hold the unmodified characters, i.e. it needs to be
+    rendered from the text buffer again before every call.
+    Returns 1 if charBuf was modified.
+    */
+    const glitch_params_t* p = &state->params;
+
+    while (state->numChars > 0 && state->events[0].time_us <= now_us) {
+        uint16_t i = state->events[0].charPos;
+        int64_t next_us;
+
+        if (state->charVals[i]) {
+            // Glitch has expired, the character may glitch again once its interval is over
+            glitches_stop(state, i);
+            next_us = state->nextCheck_us[i];
+        } else {
+            state->nextCheck_us[i] = now_us + 1000LL * glitches_rand_spread(state, p->interval_avg_ms, p->interval_spread_ms);
+            next_us = state->nextCheck_us[i];
+
+            uint8_t eligible = (p->glitch_non_blank && charBuf[i] != ' ') || (p->glitch_blank && charBuf[i] == ' ');
+            if (eligible && glitches_rand_range(state, 0, 10000) < p->probability) {
+                next_us = now_us + 1000LL * glitches_rand_spread(state, p->duration_avg_ms, p->duration_spread_ms);
+                glitches_start(state, i, glitches_rand_range(state, 32, 128));
+            }
+        }
+
+        // Events that would be due again right away are handled in the next frame
+        if (next_us <= now_us) next_us = now_us + 1;
+        glitches_reschedule_top(state, next_us);
+    }
+
+    for (uint16_t a = 0; a < state->numActive; a++) {
+        charBuf[state->active[a]] = state->charVals[state->active[a]];
+    }
+    return state->numActive > 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+/*
+ * Glitches effect: characters randomly show a different character for a short time.
+ * Every character has exactly one pending event (the next time it may start
+ * glitching, or the end of its current glitch) in a min-heap ordered by time,
+ * so a frame only processes the events that are due. Active glitches are kept
+ * in a list since they have to be applied to the freshly rendered buffer every frame.
+ * This has no ESP-IDF dependencies and runs on a PC as well. Given the same seed
+ * and the same sequence of calls, the output is always the same.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+typedef struct {
+    uint16_t probability;           // Chance to start a glitch per interval, 1/10000
+    uint16_t duration_avg_ms;
+    uint16_t duration_spread_ms;
+    uint16_t interval_avg_ms;
+    uint16_t interval_spread_ms;
+    uint8_t glitch_non_blank;
+    uint8_t glitch_blank;
+} glitch_params_t;
+
+typedef struct {
+    int64_t time_us;
+    uint16_t charPos;
+} glitch_event_t;
+
+typedef struct {
+    glitch_params_t params;
+    uint32_t rng;
+    uint16_t numChars;
+    glitch_event_t* events;         // Min-heap by time, one event per character
+    int64_t* nextCheck_us;          // Earliest time each character may start a glitch again
+    uint8_t* charVals;              // Glitch character, 0 if not glitching
+    uint16_t* active;               // Positions of the glitching characters
+    uint16_t* activeIndex;          // Index of each glitching character in active
+    uint16_t numActive;
+} glitch_state_t;
+
+
+glitch_state_t* glitches_create(const glitch_params_t* params, uint16_t numChars, uint32_t seed, int64_t now_us);
+void glitches_free(glitch_state_t* state);
+uint8_t glitches_process(glitch_state_t* state, uint8_t* charBuf, int64_t now_us);
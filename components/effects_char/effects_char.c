@@ -3,8 +3,10 @@
  */
 
 #include "effects_char.h"
+#include "effect_glitches.h"
 #include "cJSON.h"
 #include "esp_log.h"
+#include "esp_random.h"
 #include "esp_timer.h"
 #include "util_generic.h"
 #include "macros.h"
@@ -102,120 +104,109 @@ cJSON* effect_get_available() {
 
 // Return value of effect functions is 1 if the char buffer was modified, 0 otherwise
 
-typedef struct {
-    uint8_t active;
-    int64_t next_processing_time_us;
-    int64_t start_time_us;
-    int64_t duration_us;
-    uint8_t charVal;
-} glitch_mod_t;
-static int64_t effect_glitches_last_run_us = 0;
-static glitch_mod_t* effect_glitches_mods = NULL;
-uint8_t effect_glitches(uint8_t* charBuf, size_t charBufSize, uint16_t probability, uint16_t duration_avg_ms, uint16_t duration_spread_ms, uint16_t interval_avg_ms, uint16_t interval_spread_ms, uint8_t glitch_non_blank, uint8_t glitch_blank) {
-    uint8_t modified = 0;
-    // On first call, init buffer for modifications
-    // This will never get freed
-    if (effect_glitches_mods == NULL) {
-        effect_glitches_mods = malloc(sizeof(glitch_mod_t) * charBufSize);
-        memset(effect_glitches_mods, 0x00, sizeof(glitch_mod_t) * charBufSize);
+// State of the current effect instance, created when the effect changes
+static cJSON* effect_stateSource = NULL;
+static size_t effect_stateCharBufSize = 0;
+static enum effect_func effect_stateId = NONE;
+static void* effect_state = NULL;
+
+static void _effect_free_state() {
+    switch (effect_stateId) {
+        case GLITCHES:
+            glitches_free(effect_state);
+            break;
+        default:
+            break;
     }
+    effect_state = NULL;
+    effect_stateSource = NULL;
+    effect_stateId = NONE;
+}
 
-    int64_t now_us = esp_timer_get_time();
-    //int64_t delta_us = now_us - effect_glitches_last_run_us;
-    effect_glitches_last_run_us = now_us;
-
-    for (uint16_t i = 0; i < charBufSize; i++) {
-        // Check if any active mods have expired
-        if (effect_glitches_mods[i].active) {
-            if (now_us >= effect_glitches_mods[i].start_time_us + effect_glitches_mods[i].duration_us) {
-                // Expired
-                effect_glitches_mods[i].active = 0;
-            } else {
-                // Ongoing
-                charBuf[i] = effect_glitches_mods[i].charVal;
-                modified = 1;
-            }
-        }
+void effect_release() {
+    // Needs to be called when the effect changes,
+    // the same address might be reused for a different effect
+    _effect_free_state();
+}
 
-        // Check if any mods can be enabled
-        // This is not an if-else since the same mod couldn't be
-        // instantly re-enabled in that case
-        if (!effect_glitches_mods[i].active) {
-            // Check if non-blank, if applicable
-            if ((glitch_non_blank && charBuf[i] != ' ') || (glitch_blank && charBuf[i] == ' ')) {
-                // Check if mod is ready to be processed again
-                if (now_us >= effect_glitches_mods[i].next_processing_time_us) {
-                    // Update next processing time
-                    effect_glitches_mods[i].next_processing_time_us = now_us + 1000 * rand_spread(interval_avg_ms, interval_spread_ms);
-
-                    // Inactive, modify if probability allows it
-                    if (rand_range(0, 10000) < probability) {
-                        effect_glitches_mods[i].active = 1;
-                        effect_glitches_mods[i].start_time_us = now_us;
-                        effect_glitches_mods[i].duration_us = 1000 * rand_spread(duration_avg_ms, duration_spread_ms);
-                        effect_glitches_mods[i].charVal = rand_range(32, 128);
-                        charBuf[i] = effect_glitches_mods[i].charVal;
-                        modified = 1;
-                    }
-                }
-            }
-        }
-    }
+static glitch_state_t* _effect_glitches_create(cJSON* params, size_t charBufSize) {
+    glitch_params_t glitchParams;
+
+    cJSON* probability_field = cJSON_GetObjectItem(params, "probability");
+    if (!cJSON_IsNumber(probability_field)) return NULL;
+    glitchParams.probability = (uint16_t)cJSON_GetNumberValue(probability_field);
+
+    cJSON* duration_avg_ms_field = cJSON_GetObjectItem(params, "duration_avg_ms");
+    if (!cJSON_IsNumber(duration_avg_ms_field)) return NULL;
+    glitchParams.duration_avg_ms = (uint16_t)cJSON_GetNumberValue(duration_avg_ms_field);
 
-    return modified;
+    cJSON* duration_spread_ms_field = cJSON_GetObjectItem(params, "duration_spread_ms");
+    if (!cJSON_IsNumber(duration_spread_ms_field)) return NULL;
+    glitchParams.duration_spread_ms = (uint16_t)cJSON_GetNumberValue(duration_spread_ms_field);
+
+    cJSON* interval_avg_ms_field = cJSON_GetObjectItem(params, "interval_avg_ms");
+    if (!cJSON_IsNumber(interval_avg_ms_field)) return NULL;
+    glitchParams.interval_avg_ms = (uint16_t)cJSON_GetNumberValue(interval_avg_ms_field);
+
+    cJSON* interval_spread_ms_field = cJSON_GetObjectItem(params, "interval_spread_ms");
+    if (!cJSON_IsNumber(interval_spread_ms_field)) return NULL;
+    glitchParams.interval_spread_ms = (uint16_t)cJSON_GetNumberValue(interval_spread_ms_field);
+    
+    cJSON* glitch_non_blank_field = cJSON_GetObjectItem(params, "glitch_non_blank");
+    if (!cJSON_IsBool(glitch_non_blank_field)) return NULL;
+    glitchParams.glitch_non_blank = (uint8_t)cJSON_IsTrue(glitch_non_blank_field);
+    
+    cJSON* glitch_blank_field = cJSON_GetObjectItem(params, "glitch_blank");
+    if (!cJSON_IsBool(glitch_blank_field)) return NULL;
+    glitchParams.glitch_blank = (uint8_t)cJSON_IsTrue(glitch_blank_field);
+
+    glitch_state_t* state = glitches_create(&glitchParams, charBufSize, esp_random(), esp_timer_get_time());
+    if (state == NULL) ESP_LOGE(LOG_TAG, "Failed to allocate glitches for %u characters", (unsigned int)charBufSize);
+    return state;
 }
 
-uint8_t effect_fromJSON(uint8_t* charBuf, size_t charBufSize, cJSON* effectData) {
-    // TODO: Returning 1 instead of 0 is only a workaround. This whole thing is not quite right
-    if (effectData == NULL) return 1;
+static void _effect_create_state(cJSON* effectData, size_t charBufSize) {
+    _effect_free_state();
+    effect_stateSource = effectData;
+    effect_stateCharBufSize = charBufSize;
+    if (effectData == NULL) return;
 
     cJSON* effect_id_field = cJSON_GetObjectItem(effectData, "effect");
-    if (!cJSON_IsNumber(effect_id_field)) return 1;
+    if (!cJSON_IsNumber(effect_id_field)) return;
     enum effect_func effectId = (enum effect_func)cJSON_GetNumberValue(effect_id_field);
 
     cJSON* params = cJSON_GetObjectItem(effectData, "params");
-    if (!cJSON_IsObject(params)) return 1;
+    if (!cJSON_IsObject(params)) return;
+
+    ESP_LOGV(LOG_TAG, "effect=%p effectId=%u", effectData, effectId);
 
     switch (effectId) {
-        case NONE: {
-            return 1;
-        }
-        
         case GLITCHES: {
-            cJSON* probability_field = cJSON_GetObjectItem(params, "probability");
-            if (!cJSON_IsNumber(probability_field)) return 1;
-            uint16_t probability = (uint16_t)cJSON_GetNumberValue(probability_field);
-
-            cJSON* duration_avg_ms_field = cJSON_GetObjectItem(params, "duration_avg_ms");
-            if (!cJSON_IsNumber(duration_avg_ms_field)) return 1;
-            uint16_t duration_avg_ms = (uint16_t)cJSON_GetNumberValue(duration_avg_ms_field);
-
-            cJSON* duration_spread_ms_field = cJSON_GetObjectItem(params, "duration_spread_ms");
-            if (!cJSON_IsNumber(duration_spread_ms_field)) return 1;
-            uint16_t duration_spread_ms = (uint16_t)cJSON_GetNumberValue(duration_spread_ms_field);
-
-            cJSON* interval_avg_ms_field = cJSON_GetObjectItem(params, "interval_avg_ms");
-            if (!cJSON_IsNumber(interval_avg_ms_field)) return 1;
-            uint16_t interval_avg_ms = (uint16_t)cJSON_GetNumberValue(interval_avg_ms_field);
-
-            cJSON* interval_spread_ms_field = cJSON_GetObjectItem(params, "interval_spread_ms");
-            if (!cJSON_IsNumber(interval_spread_ms_field)) return 1;
-            uint16_t interval_spread_ms = (uint16_t)cJSON_GetNumberValue(interval_spread_ms_field);
-            
-            cJSON* glitch_non_blank_field = cJSON_GetObjectItem(params, "glitch_non_blank");
-            if (!cJSON_IsBool(glitch_non_blank_field)) return 1;
-            uint8_t glitch_non_blank = (uint8_t)cJSON_IsTrue(glitch_non_blank_field);
-            
-            cJSON* glitch_blank_field = cJSON_GetObjectItem(params, "glitch_blank");
-            if (!cJSON_IsBool(glitch_blank_field)) return 1;
-            uint8_t glitch_blank = (uint8_t)cJSON_IsTrue(glitch_blank_field);
-
-            ESP_LOGV(LOG_TAG, "effect=%p effectId=%u", effectData, effectId);
-            return effect_glitches(charBuf, charBufSize, probability, duration_avg_ms, duration_spread_ms, interval_avg_ms, interval_spread_ms, glitch_non_blank, glitch_blank);
+            effect_state = _effect_glitches_create(params, charBufSize);
+            if (effect_state != NULL) effect_stateId = GLITCHES;
+            return;
         }
+
+        default:
+            return;
+    }
+}
+
+uint8_t effect_fromJSON(uint8_t* charBuf, size_t charBufSize, cJSON* effectData) {
+    // The effect is only parsed and its state only allocated when the effect or the buffer size changes
+    if (effectData != effect_stateSource || charBufSize != effect_stateCharBufSize) {
+        _effect_create_state(effectData, charBufSize);
     }
 
-    return 1;
+    switch (effect_stateId) {
+        case GLITCHES: {
+            return glitches_process(effect_state, charBuf, esp_timer_get_time());
+        }
+
+        default: {
+            return 0;
+        }
+    }
 }
 
 #endif
\ No newline at end of file
@@ -1,6 +1,7 @@
 COMPONENT_SRCDIRS = \
 	src \
-	src/crypto/refc
+	src/crypto/refc \
+	src/crypto/opt
 COMPONENT_ADD_INCLUDEDIRS = \
 	include
 COMPONENT_PRIV_INCLUDEDIRS = \
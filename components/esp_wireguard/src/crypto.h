@@ -8,14 +8,24 @@ extern "C" {
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include "sdkconfig.h"
 
 // BLAKE2S IMPLEMENTATION
+#if defined(CONFIG_WIREGUARD_BLAKE2S_IMPLEMENTATION_OPTIMIZED)
+#include "crypto/opt/blake2s-opt.h"
+#define wireguard_blake2s_ctx blake2s_opt_ctx
+#define wireguard_blake2s_init(ctx,outlen,key,keylen) blake2s_opt_init(ctx,outlen,key,keylen)
+#define wireguard_blake2s_update(ctx,in,inlen) blake2s_opt_update(ctx,in,inlen)
+#define wireguard_blake2s_final(ctx,out) blake2s_opt_final(ctx,out)
+#define wireguard_blake2s(out,outlen,key,keylen,in,inlen) blake2s_opt(out,outlen,key,keylen,in,inlen)
+#else
 #include "crypto/refc/blake2s.h"
 #define wireguard_blake2s_ctx blake2s_ctx
 #define wireguard_blake2s_init(ctx,outlen,key,keylen) blake2s_init(ctx,outlen,key,keylen)
 #define wireguard_blake2s_update(ctx,in,inlen) blake2s_update(ctx,in,inlen)
 #define wireguard_blake2s_final(ctx,out) blake2s_final(ctx,out)
 #define wireguard_blake2s(out,outlen,key,keylen,in,inlen) blake2s(out,outlen,key,keylen,in,inlen)
+#endif
 
 // X25519 IMPLEMENTATION
 #if defined(CONFIG_WIREGUARD_x25519_IMPLEMENTATION_DEFAULT)
@@ -28,15 +38,28 @@ extern "C" {
 #define wireguard_x25519(a,b,c)	crypto_scalarmult(a,b,c)
 #endif
 
+#if defined(CONFIG_WIREGUARD_x25519_IMPLEMENTATION_OPTIMIZED)
+#include "crypto/opt/x25519-opt.h"
+#define wireguard_x25519(a,b,c)	x25519_opt(a,b,c)
+#endif
+
 //#include "crypto/cortex/scalarmult.h"
 //#define wireguard_x25519(a,b,c)	crypto_scalarmult_curve25519(a,b,c)
 
 // CHACHA20POLY1305 IMPLEMENTATION
+#if defined(CONFIG_WIREGUARD_AEAD_IMPLEMENTATION_OPTIMIZED)
+#include "crypto/opt/chacha20poly1305-opt.h"
+#define wireguard_aead_encrypt(dst,src,srclen,ad,adlen,nonce,key) chacha20poly1305_opt_encrypt(dst,src,srclen,ad,adlen,nonce,key)
+#define wireguard_aead_decrypt(dst,src,srclen,ad,adlen,nonce,key) chacha20poly1305_opt_decrypt(dst,src,srclen,ad,adlen,nonce,key)
+#define wireguard_xaead_encrypt(dst,src,srclen,ad,adlen,nonce,key) xchacha20poly1305_opt_encrypt(dst,src,srclen,ad,adlen,nonce,key)
+#define wireguard_xaead_decrypt(dst,src,srclen,ad,adlen,nonce,key) xchacha20poly1305_opt_decrypt(dst,src,srclen,ad,adlen,nonce,key)
+#else
 #include "crypto/refc/chacha20poly1305.h"
 #define wireguard_aead_encrypt(dst,src,srclen,ad,adlen,nonce,key) chacha20poly1305_encrypt(dst,src,srclen,ad,adlen,nonce,key)
 #define wireguard_aead_decrypt(dst,src,srclen,ad,adlen,nonce,key) chacha20poly1305_decrypt(dst,src,srclen,ad,adlen,nonce,key)
 #define wireguard_xaead_encrypt(dst,src,srclen,ad,adlen,nonce,key) xchacha20poly1305_encrypt(dst,src,srclen,ad,adlen,nonce,key)
 #define wireguard_xaead_decrypt(dst,src,srclen,ad,adlen,nonce,key) xchacha20poly1305_decrypt(dst,src,srclen,ad,adlen,nonce,key)
+#endif
 
 
 // Endian / unaligned helper macros
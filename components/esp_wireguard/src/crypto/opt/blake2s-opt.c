@@ -0,0 +1,149 @@
+// BLAKE2s as described in RFC7693 - https://tools.ietf.org/html/rfc7693
+// Same results as crypto/refc/blake2s.c, but whole blocks are compressed straight
+// from the input (read as words if it is aligned) instead of being copied byte by byte.
+
+#include "blake2s-opt.h"
+
+#include <string.h>
+#include "../../crypto.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CRYPTO_OPT_WORD_ACCESS(a) ((((uintptr_t)(a)) & 3) == 0)
+#else
+#define CRYPTO_OPT_WORD_ACCESS(a) 0
+#endif
+
+#define ROTR32(x, y)  (((x) >> (y)) ^ ((x) << (32 - (y))))
+
+// Mixing function G.
+#define B2S_G(a, b, c, d, x, y) {   \
+	v[a] = v[a] + v[b] + x;         \
+	v[d] = ROTR32(v[d] ^ v[a], 16); \
+	v[c] = v[c] + v[d];             \
+	v[b] = ROTR32(v[b] ^ v[c], 12); \
+	v[a] = v[a] + v[b] + y;         \
+	v[d] = ROTR32(v[d] ^ v[a], 8);  \
+	v[c] = v[c] + v[d];             \
+	v[b] = ROTR32(v[b] ^ v[c], 7); }
+
+static const uint32_t blake2s_iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint8_t blake2s_sigma[10][16] = {
+	{ 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+	{ 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+	{ 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+	{ 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+	{ 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+	{ 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+	{ 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+	{ 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+	{ 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 }
+};
+
+static void blake2s_opt_increment(blake2s_opt_ctx *ctx, uint32_t inc) {
+	ctx->t[0] += inc;
+	if (ctx->t[0] < inc) ctx->t[1]++;
+}
+
+// Compression function. "last" flag indicates last block.
+static void blake2s_opt_compress(blake2s_opt_ctx *ctx, const uint8_t *block, int last) {
+	uint32_t v[16], m_buf[16];
+	const uint32_t *m;
+	int i;
+
+	if (CRYPTO_OPT_WORD_ACCESS(block)) {
+		m = (const uint32_t *)block;
+	} else {
+		for (i = 0; i < 16; i++) m_buf[i] = U8TO32_LITTLE(block + 4 * i);
+		m = m_buf;
+	}
+
+	for (i = 0; i < 8; i++) {
+		v[i] = ctx->h[i];
+		v[i + 8] = blake2s_iv[i];
+	}
+	v[12] ^= ctx->t[0];
+	v[13] ^= ctx->t[1];
+	if (last) v[14] = ~v[14];
+
+	for (i = 0; i < 10; i++) {
+		const uint8_t *s = blake2s_sigma[i];
+		B2S_G( 0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+		B2S_G( 1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+		B2S_G( 2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+		B2S_G( 3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+		B2S_G( 0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+		B2S_G( 1, 6, 11, 12, m[s[10]], m[s[11]]);
+		B2S_G( 2, 7,  8, 13, m[s[12]], m[s[13]]);
+		B2S_G( 3, 4,  9, 14, m[s[14]], m[s[15]]);
+	}
+
+	for (i = 0; i < 8; i++) ctx->h[i] ^= v[i] ^ v[i + 8];
+}
+
+int blake2s_opt_init(blake2s_opt_ctx *ctx, size_t outlen, const void *key, size_t keylen) {
+	if (outlen == 0 || outlen > 32 || keylen > 32) return -1;
+
+	for (int i = 0; i < 8; i++) ctx->h[i] = blake2s_iv[i];
+	ctx->h[0] ^= 0x01010000 ^ (keylen << 8) ^ outlen;
+	ctx->t[0] = 0;
+	ctx->t[1] = 0;
+	ctx->c = 0;
+	ctx->outlen = outlen;
+
+	// The key is padded to a full block of its own
+	memset(ctx->b, 0, sizeof(ctx->b));
+	if (keylen > 0) {
+		memcpy(ctx->b, key, keylen);
+		ctx->c = BLAKE2S_OPT_BLOCK_SIZE;
+	}
+	return 0;
+}
+
+void blake2s_opt_update(blake2s_opt_ctx *ctx, const void *in, size_t inlen) {
+	// The last block has to be compressed with the final flag, so a full
+	// block is only compressed once it is known that more input follows
+	const uint8_t *p = (const uint8_t *)in;
+	size_t fill = BLAKE2S_OPT_BLOCK_SIZE - ctx->c;
+
+	if (inlen == 0) return;
+	if (inlen > fill) {
+		memcpy((uint8_t *)ctx->b + ctx->c, p, fill);
+		blake2s_opt_increment(ctx, BLAKE2S_OPT_BLOCK_SIZE);
+		blake2s_opt_compress(ctx, (const uint8_t *)ctx->b, 0);
+		ctx->c = 0;
+		p += fill;
+		inlen -= fill;
+
+		while (inlen > BLAKE2S_OPT_BLOCK_SIZE) {
+			blake2s_opt_increment(ctx, BLAKE2S_OPT_BLOCK_SIZE);
+			blake2s_opt_compress(ctx, p, 0);
+			p += BLAKE2S_OPT_BLOCK_SIZE;
+			inlen -= BLAKE2S_OPT_BLOCK_SIZE;
+		}
+	}
+	memcpy((uint8_t *)ctx->b + ctx->c, p, inlen);
+	ctx->c += inlen;
+}
+
+void blake2s_opt_final(blake2s_opt_ctx *ctx, void *out) {
+	blake2s_opt_increment(ctx, ctx->c);
+	memset((uint8_t *)ctx->b + ctx->c, 0, BLAKE2S_OPT_BLOCK_SIZE - ctx->c);
+	blake2s_opt_compress(ctx, (const uint8_t *)ctx->b, 1);
+
+	for (size_t i = 0; i < ctx->outlen; i++) {
+		((uint8_t *)out)[i] = (ctx->h[i >> 2] >> (8 * (i & 3))) & 0xFF;
+	}
+}
+
+int blake2s_opt(void *out, size_t outlen, const void *key, size_t keylen, const void *in, size_t inlen) {
+	blake2s_opt_ctx ctx;
+	if (blake2s_opt_init(&ctx, outlen, key, keylen)) return -1;
+	blake2s_opt_update(&ctx, in, inlen);
+	blake2s_opt_final(&ctx, out);
+	return 0;
+}
@@ -0,0 +1,336 @@
+// AEAD_CHACHA20_POLY1305 as described in https://tools.ietf.org/html/rfc7539
+// AEAD_XChaCha20_Poly1305 as described in https://tools.ietf.org/id/draft-arciszewski-xchacha-02.html
+// Same construction as crypto/refc/chacha20poly1305.c, rewritten for 32-bit CPUs:
+// - The ChaCha20 state is kept in local variables and the key stream is XORed a word at a time
+// - Poly1305 (radix 2^26 like poly1305-donna-32) reads its input a word at a time and
+//   the AEAD padding is done on whole blocks instead of feeding zeros through the update function
+// Word access is only used for 4 byte aligned buffers on little endian CPUs,
+// everything else falls back to byte access with the same result.
+
+#include "chacha20poly1305-opt.h"
+#include "../refc/chacha20.h"
+
+#include <string.h>
+#include <stdint.h>
+#include "../../crypto.h"
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define CRYPTO_OPT_WORD_ACCESS(a, b) (((((uintptr_t)(a)) | ((uintptr_t)(b))) & 3) == 0)
+#else
+#define CRYPTO_OPT_WORD_ACCESS(a, b) 0
+#endif
+
+#define POLY1305_MAC_SIZE		16
+#define POLY1305_BLOCK_SIZE		16
+
+#define ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)       \
+    a += b;  d ^= a;  d = ROTL32(d, 16);  \
+    c += d;  b ^= c;  b = ROTL32(b, 12);  \
+    a += b;  d ^= a;  d = ROTL32(d,  8);  \
+    c += d;  b ^= c;  b = ROTL32(b,  7)
+
+typedef struct {
+	uint32_t r[5];
+	uint32_t h[5];
+	uint32_t pad[4];
+} poly1305_opt_state;
+
+static void chacha20_opt_init(uint32_t *state, const uint8_t *key, uint64_t nonce) {
+	// Constants, key, block counter, WireGuard nonce (32 bits of zeros followed by the 64-bit counter)
+	state[0] = 0x61707865;
+	state[1] = 0x3320646e;
+	state[2] = 0x79622d32;
+	state[3] = 0x6b206574;
+	for (int i = 0; i < 8; i++) {
+		state[4 + i] = U8TO32_LITTLE(key + 4 * i);
+	}
+	state[12] = 0;
+	state[13] = 0;
+	state[14] = nonce & 0xFFFFFFFF;
+	state[15] = nonce >> 32;
+}
+
+static void chacha20_opt_block(uint32_t *state, uint32_t *stream) {
+	// One key stream block as words, advances the block counter
+	uint32_t x0 = state[0], x1 = state[1], x2 = state[2], x3 = state[3];
+	uint32_t x4 = state[4], x5 = state[5], x6 = state[6], x7 = state[7];
+	uint32_t x8 = state[8], x9 = state[9], x10 = state[10], x11 = state[11];
+	uint32_t x12 = state[12], x13 = state[13], x14 = state[14], x15 = state[15];
+
+	for (int i = 0; i < 10; i++) {
+		QUARTERROUND(x0, x4, x8, x12);
+		QUARTERROUND(x1, x5, x9, x13);
+		QUARTERROUND(x2, x6, x10, x14);
+		QUARTERROUND(x3, x7, x11, x15);
+		QUARTERROUND(x0, x5, x10, x15);
+		QUARTERROUND(x1, x6, x11, x12);
+		QUARTERROUND(x2, x7, x8, x13);
+		QUARTERROUND(x3, x4, x9, x14);
+	}
+
+	stream[0] = x0 + state[0];
+	stream[1] = x1 + state[1];
+	stream[2] = x2 + state[2];
+	stream[3] = x3 + state[3];
+	stream[4] = x4 + state[4];
+	stream[5] = x5 + state[5];
+	stream[6] = x6 + state[6];
+	stream[7] = x7 + state[7];
+	stream[8] = x8 + state[8];
+	stream[9] = x9 + state[9];
+	stream[10] = x10 + state[10];
+	stream[11] = x11 + state[11];
+	stream[12] = x12 + state[12];
+	stream[13] = x13 + state[13];
+	stream[14] = x14 + state[14];
+	stream[15] = x15 + state[15];
+	state[12]++;
+}
+
+static void chacha20_opt_xor(uint32_t *state, uint8_t *out, const uint8_t *in, size_t len) {
+	uint32_t stream[16];
+
+	while (len > 0) {
+		chacha20_opt_block(state, stream);
+		if (len >= CHACHA20_BLOCK_SIZE && CRYPTO_OPT_WORD_ACCESS(out, in)) {
+			const uint32_t *in32 = (const uint32_t *)in;
+			uint32_t *out32 = (uint32_t *)out;
+			for (int i = 0; i < 16; i++) {
+				out32[i] = in32[i] ^ stream[i];
+			}
+			len -= CHACHA20_BLOCK_SIZE;
+			out += CHACHA20_BLOCK_SIZE;
+			in += CHACHA20_BLOCK_SIZE;
+		} else {
+			size_t n = (len < CHACHA20_BLOCK_SIZE) ? len : CHACHA20_BLOCK_SIZE;
+			for (size_t i = 0; i < n; i++) {
+				out[i] = in[i] ^ U8V(stream[i >> 2] >> (8 * (i & 3)));
+			}
+			len -= n;
+			out += n;
+			in += n;
+		}
+	}
+	crypto_zero(stream, sizeof(stream));
+}
+
+static void poly1305_opt_init(poly1305_opt_state *st, uint32_t *chacha20_state) {
+	// 2.6. The one-time key is the first 256 bits of the block with counter 0
+	uint32_t key[16];
+	chacha20_opt_block(chacha20_state, key);
+
+	// r &= 0xffffffc0ffffffc0ffffffc0fffffff, split into 26 bit limbs
+	st->r[0] = key[0] & 0x3ffffff;
+	st->r[1] = ((key[0] >> 26) | (key[1] << 6)) & 0x3ffff03;
+	st->r[2] = ((key[1] >> 20) | (key[2] << 12)) & 0x3ffc0ff;
+	st->r[3] = ((key[2] >> 14) | (key[3] << 18)) & 0x3f03fff;
+	st->r[4] = (key[3] >> 8) & 0x00fffff;
+
+	memset(st->h, 0, sizeof(st->h));
+
+	st->pad[0] = key[4];
+	st->pad[1] = key[5];
+	st->pad[2] = key[6];
+	st->pad[3] = key[7];
+
+	crypto_zero(key, sizeof(key));
+}
+
+static void poly1305_opt_blocks(poly1305_opt_state *st, const uint8_t *m, size_t bytes) {
+	// Full 16 byte blocks only. In the AEAD construction, every block is a full one.
+	const uint32_t r0 = st->r[0], r1 = st->r[1], r2 = st->r[2], r3 = st->r[3], r4 = st->r[4];
+	const uint32_t s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+	uint32_t t0, t1, t2, t3, c;
+	uint64_t d0, d1, d2, d3, d4;
+	const uint8_t aligned = CRYPTO_OPT_WORD_ACCESS(m, 0);
+
+	while (bytes >= POLY1305_BLOCK_SIZE) {
+		if (aligned) {
+			const uint32_t *m32 = (const uint32_t *)m;
+			t0 = m32[0];
+			t1 = m32[1];
+			t2 = m32[2];
+			t3 = m32[3];
+		} else {
+			t0 = U8TO32_LITTLE(m + 0);
+			t1 = U8TO32_LITTLE(m + 4);
+			t2 = U8TO32_LITTLE(m + 8);
+			t3 = U8TO32_LITTLE(m + 12);
+		}
+
+		// h += m[i], including the 2^128 bit
+		h0 += t0 & 0x3ffffff;
+		h1 += ((t0 >> 26) | (t1 << 6)) & 0x3ffffff;
+		h2 += ((t1 >> 20) | (t2 << 12)) & 0x3ffffff;
+		h3 += ((t2 >> 14) | (t3 << 18)) & 0x3ffffff;
+		h4 += (t3 >> 8) | (1UL << 24);
+
+		// h *= r
+		d0 = ((uint64_t)h0 * r0) + ((uint64_t)h1 * s4) + ((uint64_t)h2 * s3) + ((uint64_t)h3 * s2) + ((uint64_t)h4 * s1);
+		d1 = ((uint64_t)h0 * r1) + ((uint64_t)h1 * r0) + ((uint64_t)h2 * s4) + ((uint64_t)h3 * s3) + ((uint64_t)h4 * s2);
+		d2 = ((uint64_t)h0 * r2) + ((uint64_t)h1 * r1) + ((uint64_t)h2 * r0) + ((uint64_t)h3 * s4) + ((uint64_t)h4 * s3);
+		d3 = ((uint64_t)h0 * r3) + ((uint64_t)h1 * r2) + ((uint64_t)h2 * r1) + ((uint64_t)h3 * r0) + ((uint64_t)h4 * s4);
+		d4 = ((uint64_t)h0 * r4) + ((uint64_t)h1 * r3) + ((uint64_t)h2 * r2) + ((uint64_t)h3 * r1) + ((uint64_t)h4 * r0);
+
+		// (partial) h %= p
+		              c = (uint32_t)(d0 >> 26); h0 = (uint32_t)d0 & 0x3ffffff;
+		d1 += c;      c = (uint32_t)(d1 >> 26); h1 = (uint32_t)d1 & 0x3ffffff;
+		d2 += c;      c = (uint32_t)(d2 >> 26); h2 = (uint32_t)d2 & 0x3ffffff;
+		d3 += c;      c = (uint32_t)(d3 >> 26); h3 = (uint32_t)d3 & 0x3ffffff;
+		d4 += c;      c = (uint32_t)(d4 >> 26); h4 = (uint32_t)d4 & 0x3ffffff;
+		h0 += c * 5;  c =          (h0 >> 26); h0 =           h0 & 0x3ffffff;
+		h1 += c;
+
+		m += POLY1305_BLOCK_SIZE;
+		bytes -= POLY1305_BLOCK_SIZE;
+	}
+
+	st->h[0] = h0;
+	st->h[1] = h1;
+	st->h[2] = h2;
+	st->h[3] = h3;
+	st->h[4] = h4;
+}
+
+static void poly1305_opt_padded(poly1305_opt_state *st, const uint8_t *m, size_t len) {
+	// Data followed by up to 15 zero bytes to bring it to a multiple of 16
+	uint8_t last[POLY1305_BLOCK_SIZE] = { 0 };
+	size_t full = len & ~(size_t)(POLY1305_BLOCK_SIZE - 1);
+
+	poly1305_opt_blocks(st, m, full);
+	if (len > full) {
+		memcpy(last, m + full, len - full);
+		poly1305_opt_blocks(st, last, POLY1305_BLOCK_SIZE);
+	}
+}
+
+static void poly1305_opt_finish(poly1305_opt_state *st, uint8_t *mac) {
+	uint32_t h0 = st->h[0], h1 = st->h[1], h2 = st->h[2], h3 = st->h[3], h4 = st->h[4];
+	uint32_t g0, g1, g2, g3, g4, c, mask;
+	uint64_t f;
+
+	// fully carry h
+	             c = h1 >> 26; h1 = h1 & 0x3ffffff;
+	h2 +=     c; c = h2 >> 26; h2 = h2 & 0x3ffffff;
+	h3 +=     c; c = h3 >> 26; h3 = h3 & 0x3ffffff;
+	h4 +=     c; c = h4 >> 26; h4 = h4 & 0x3ffffff;
+	h0 += c * 5; c = h0 >> 26; h0 = h0 & 0x3ffffff;
+	h1 +=     c;
+
+	// compute h + -p
+	g0 = h0 + 5; c = g0 >> 26; g0 &= 0x3ffffff;
+	g1 = h1 + c; c = g1 >> 26; g1 &= 0x3ffffff;
+	g2 = h2 + c; c = g2 >> 26; g2 &= 0x3ffffff;
+	g3 = h3 + c; c = g3 >> 26; g3 &= 0x3ffffff;
+	g4 = h4 + c - (1UL << 26);
+
+	// select h if h < p, or h + -p if h >= p, without branching
+	mask = (g4 >> 31) - 1;
+	g0 &= mask;
+	g1 &= mask;
+	g2 &= mask;
+	g3 &= mask;
+	g4 &= mask;
+	mask = ~mask;
+	h0 = (h0 & mask) | g0;
+	h1 = (h1 & mask) | g1;
+	h2 = (h2 & mask) | g2;
+	h3 = (h3 & mask) | g3;
+	h4 = (h4 & mask) | g4;
+
+	// h = h % (2^128)
+	h0 = ((h0      ) | (h1 << 26));
+	h1 = ((h1 >>  6) | (h2 << 20));
+	h2 = ((h2 >> 12) | (h3 << 14));
+	h3 = ((h3 >> 18) | (h4 <<  8));
+
+	// mac = (h + pad) % (2^128)
+	f = (uint64_t)h0 + st->pad[0]            ; h0 = (uint32_t)f;
+	f = (uint64_t)h1 + st->pad[1] + (f >> 32); h1 = (uint32_t)f;
+	f = (uint64_t)h2 + st->pad[2] + (f >> 32); h2 = (uint32_t)f;
+	f = (uint64_t)h3 + st->pad[3] + (f >> 32); h3 = (uint32_t)f;
+
+	U32TO8_LITTLE(mac +  0, h0);
+	U32TO8_LITTLE(mac +  4, h1);
+	U32TO8_LITTLE(mac +  8, h2);
+	U32TO8_LITTLE(mac + 12, h3);
+}
+
+static void chacha20poly1305_opt_mac(poly1305_opt_state *st, const uint8_t *ad, size_t ad_len, const uint8_t *ct, size_t ct_len, uint8_t *mac) {
+	// 2.8. AAD | padding1 | ciphertext | padding2 | length of AAD | length of ciphertext
+	uint8_t lengths[POLY1305_BLOCK_SIZE];
+
+	poly1305_opt_padded(st, ad, ad_len);
+	poly1305_opt_padded(st, ct, ct_len);
+	U64TO8_LITTLE(lengths, (uint64_t)ad_len);
+	U64TO8_LITTLE(lengths + 8, (uint64_t)ct_len);
+	poly1305_opt_blocks(st, lengths, POLY1305_BLOCK_SIZE);
+	poly1305_opt_finish(st, mac);
+}
+
+void chacha20poly1305_opt_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key) {
+	uint32_t chacha20_state[16];
+	poly1305_opt_state poly1305_state;
+
+	chacha20_opt_init(chacha20_state, key, nonce);
+	poly1305_opt_init(&poly1305_state, chacha20_state);
+
+	// Block counter is 1 now
+	chacha20_opt_xor(chacha20_state, dst, src, src_len);
+	chacha20poly1305_opt_mac(&poly1305_state, ad, ad_len, dst, src_len, dst + src_len);
+
+	// Make sure we leave nothing sensitive on the stack
+	crypto_zero(chacha20_state, sizeof(chacha20_state));
+	crypto_zero(&poly1305_state, sizeof(poly1305_state));
+}
+
+bool chacha20poly1305_opt_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key) {
+	uint32_t chacha20_state[16];
+	poly1305_opt_state poly1305_state;
+	uint8_t mac[POLY1305_MAC_SIZE];
+	size_t dst_len;
+	bool result = false;
+
+	if (src_len < POLY1305_MAC_SIZE) return false;
+	dst_len = src_len - POLY1305_MAC_SIZE;
+
+	chacha20_opt_init(chacha20_state, key, nonce);
+	poly1305_opt_init(&poly1305_state, chacha20_state);
+
+	// The MAC is calculated over the ciphertext, so it is checked before decrypting anything
+	chacha20poly1305_opt_mac(&poly1305_state, ad, ad_len, src, dst_len, mac);
+	if (crypto_equal(mac, src + dst_len, POLY1305_MAC_SIZE)) {
+		chacha20_opt_xor(chacha20_state, dst, src, dst_len);
+		result = true;
+	}
+
+	crypto_zero(chacha20_state, sizeof(chacha20_state));
+	crypto_zero(&poly1305_state, sizeof(poly1305_state));
+	return result;
+}
+
+// XChaCha20-Poly1305: HChaCha20 subkey from the first 16 bytes of the nonce,
+// then ChaCha20-Poly1305 with the remaining 8 bytes. Only used for cookies,
+// so the reference HChaCha20 is good enough.
+void xchacha20poly1305_opt_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key) {
+	uint8_t subkey[CHACHA20_KEY_SIZE];
+
+	hchacha20(subkey, nonce, key);
+	chacha20poly1305_opt_encrypt(dst, src, src_len, ad, ad_len, U8TO64_LITTLE(nonce + 16), subkey);
+
+	crypto_zero(subkey, sizeof(subkey));
+}
+
+bool xchacha20poly1305_opt_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key) {
+	uint8_t subkey[CHACHA20_KEY_SIZE];
+	bool result;
+
+	hchacha20(subkey, nonce, key);
+	result = chacha20poly1305_opt_decrypt(dst, src, src_len, ad, ad_len, U8TO64_LITTLE(nonce + 16), subkey);
+
+	crypto_zero(subkey, sizeof(subkey));
+	return result;
+}
@@ -0,0 +1,25 @@
+// AEAD_CHACHA20_POLY1305 (RFC7539) and AEAD_XChaCha20_Poly1305 working on 32-bit words
+// Drop-in replacement for crypto/refc/chacha20poly1305.h with the same results
+#ifndef _CHACHA20POLY1305_OPT_H_
+#define _CHACHA20POLY1305_OPT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// src and dst may be the same buffer. dst needs room for the 16 byte tag when encrypting.
+void chacha20poly1305_opt_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key);
+bool chacha20poly1305_opt_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, uint64_t nonce, const uint8_t *key);
+
+void xchacha20poly1305_opt_encrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key);
+bool xchacha20poly1305_opt_decrypt(uint8_t *dst, const uint8_t *src, size_t src_len, const uint8_t *ad, size_t ad_len, const uint8_t *nonce, const uint8_t *key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CHACHA20POLY1305_OPT_H_ */
@@ -0,0 +1,279 @@
+// X25519 (RFC7748) for 32-bit CPUs
+// Field elements are ten signed 32-bit limbs in radix 2^25.5 (alternating 26 and 25 bits)
+// as in the ref10 implementation by Bernstein et al. (public domain), so every
+// product is a single 32x32->64 bit multiplication. The 19 and 2 factors
+// of the reduction are folded into precomputed operands.
+// Constant time: the ladder only uses conditional swaps, never branches on secret data.
+
+#include "x25519-opt.h"
+
+#include <string.h>
+#include "../../crypto.h"
+
+typedef int32_t fe[10];
+
+static uint64_t x25519_opt_load_3(const uint8_t *in) {
+	return (uint64_t)in[0] | ((uint64_t)in[1] << 8) | ((uint64_t)in[2] << 16);
+}
+
+static uint64_t x25519_opt_load_4(const uint8_t *in) {
+	return (uint64_t)in[0] | ((uint64_t)in[1] << 8) | ((uint64_t)in[2] << 16) | ((uint64_t)in[3] << 24);
+}
+
+static inline void fe_carry(fe out, int64_t *h) {
+	// Reduce the 64-bit limbs of a product back to 26/25 bits
+	int64_t c;
+	c = (h[0] + (1 << 25)) >> 26; h[1] += c; h[0] -= c * ((int64_t)1 << 26);
+	c = (h[4] + (1 << 25)) >> 26; h[5] += c; h[4] -= c * ((int64_t)1 << 26);
+	c = (h[1] + (1 << 24)) >> 25; h[2] += c; h[1] -= c * ((int64_t)1 << 25);
+	c = (h[5] + (1 << 24)) >> 25; h[6] += c; h[5] -= c * ((int64_t)1 << 25);
+	c = (h[2] + (1 << 25)) >> 26; h[3] += c; h[2] -= c * ((int64_t)1 << 26);
+	c = (h[6] + (1 << 25)) >> 26; h[7] += c; h[6] -= c * ((int64_t)1 << 26);
+	c = (h[3] + (1 << 24)) >> 25; h[4] += c; h[3] -= c * ((int64_t)1 << 25);
+	c = (h[7] + (1 << 24)) >> 25; h[8] += c; h[7] -= c * ((int64_t)1 << 25);
+	c = (h[4] + (1 << 25)) >> 26; h[5] += c; h[4] -= c * ((int64_t)1 << 26);
+	c = (h[8] + (1 << 25)) >> 26; h[9] += c; h[8] -= c * ((int64_t)1 << 26);
+	c = (h[9] + (1 << 24)) >> 25; h[0] += c * 19; h[9] -= c * ((int64_t)1 << 25);
+	c = (h[0] + (1 << 25)) >> 26; h[1] += c; h[0] -= c * ((int64_t)1 << 26);
+	for (int i = 0; i < 10; i++) out[i] = (int32_t)h[i];
+}
+
+static void fe_frombytes(fe out, const uint8_t *s) {
+	// The top bit is ignored as required by RFC7748
+	int64_t h[10];
+	int64_t c;
+	h[0] = x25519_opt_load_4(s);
+	h[1] = x25519_opt_load_3(s + 4) << 6;
+	h[2] = x25519_opt_load_3(s + 7) << 5;
+	h[3] = x25519_opt_load_3(s + 10) << 3;
+	h[4] = x25519_opt_load_3(s + 13) << 2;
+	h[5] = x25519_opt_load_4(s + 16);
+	h[6] = x25519_opt_load_3(s + 20) << 7;
+	h[7] = x25519_opt_load_3(s + 23) << 5;
+	h[8] = x25519_opt_load_3(s + 26) << 4;
+	h[9] = (x25519_opt_load_3(s + 29) & 0x7fffff) << 2;
+
+	c = (h[9] + (1 << 24)) >> 25; h[0] += c * 19; h[9] -= c * ((int64_t)1 << 25);
+	c = (h[1] + (1 << 24)) >> 25; h[2] += c; h[1] -= c * ((int64_t)1 << 25);
+	c = (h[3] + (1 << 24)) >> 25; h[4] += c; h[3] -= c * ((int64_t)1 << 25);
+	c = (h[5] + (1 << 24)) >> 25; h[6] += c; h[5] -= c * ((int64_t)1 << 25);
+	c = (h[7] + (1 << 24)) >> 25; h[8] += c; h[7] -= c * ((int64_t)1 << 25);
+	c = (h[0] + (1 << 25)) >> 26; h[1] += c; h[0] -= c * ((int64_t)1 << 26);
+	c = (h[2] + (1 << 25)) >> 26; h[3] += c; h[2] -= c * ((int64_t)1 << 26);
+	c = (h[4] + (1 << 25)) >> 26; h[5] += c; h[4] -= c * ((int64_t)1 << 26);
+	c = (h[6] + (1 << 25)) >> 26; h[7] += c; h[6] -= c * ((int64_t)1 << 26);
+	c = (h[8] + (1 << 25)) >> 26; h[9] += c; h[8] -= c * ((int64_t)1 << 26);
+	for (int i = 0; i < 10; i++) out[i] = (int32_t)h[i];
+}
+
+static void fe_tobytes(uint8_t *s, const fe f) {
+	// Fully reduce mod p = 2^255 - 19, then pack the limbs
+	int32_t h[10];
+	int32_t q, c;
+	memcpy(h, f, sizeof(h));
+
+	q = (19 * h[9] + (1 << 24)) >> 25;
+	for (int i = 0; i < 10; i++) q = (h[i] + q) >> ((i & 1) ? 25 : 26);
+	h[0] += 19 * q;
+	for (int i = 0; i < 9; i++) {
+		int bits = (i & 1) ? 25 : 26;
+		c = h[i] >> bits;
+		h[i + 1] += c;
+		h[i] -= c * (1 << bits);
+	}
+	c = h[9] >> 25;
+	h[9] -= c * (1 << 25);
+
+	s[0] = h[0] >> 0;
+	s[1] = h[0] >> 8;
+	s[2] = h[0] >> 16;
+	s[3] = (h[0] >> 24) | (h[1] * (1 << 2));
+	s[4] = h[1] >> 6;
+	s[5] = h[1] >> 14;
+	s[6] = (h[1] >> 22) | (h[2] * (1 << 3));
+	s[7] = h[2] >> 5;
+	s[8] = h[2] >> 13;
+	s[9] = (h[2] >> 21) | (h[3] * (1 << 5));
+	s[10] = h[3] >> 3;
+	s[11] = h[3] >> 11;
+	s[12] = (h[3] >> 19) | (h[4] * (1 << 6));
+	s[13] = h[4] >> 2;
+	s[14] = h[4] >> 10;
+	s[15] = h[4] >> 18;
+	s[16] = h[5] >> 0;
+	s[17] = h[5] >> 8;
+	s[18] = h[5] >> 16;
+	s[19] = (h[5] >> 24) | (h[6] * (1 << 1));
+	s[20] = h[6] >> 7;
+	s[21] = h[6] >> 15;
+	s[22] = (h[6] >> 23) | (h[7] * (1 << 3));
+	s[23] = h[7] >> 5;
+	s[24] = h[7] >> 13;
+	s[25] = (h[7] >> 21) | (h[8] * (1 << 4));
+	s[26] = h[8] >> 4;
+	s[27] = h[8] >> 12;
+	s[28] = (h[8] >> 20) | (h[9] * (1 << 6));
+	s[29] = h[9] >> 2;
+	s[30] = h[9] >> 10;
+	s[31] = h[9] >> 18;
+}
+
+static inline void fe_add(fe out, const fe f, const fe g) {
+	for (int i = 0; i < 10; i++) out[i] = f[i] + g[i];
+}
+
+static inline void fe_sub(fe out, const fe f, const fe g) {
+	for (int i = 0; i < 10; i++) out[i] = f[i] - g[i];
+}
+
+static void fe_mul(fe out, const fe f, const fe g) {
+	int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4], f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+	int32_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4], g5 = g[5], g6 = g[6], g7 = g[7], g8 = g[8], g9 = g[9];
+	int32_t f1_2 = 2 * f1, f3_2 = 2 * f3, f5_2 = 2 * f5, f7_2 = 2 * f7, f9_2 = 2 * f9;
+	int32_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4, g5_19 = 19 * g5, g6_19 = 19 * g6, g7_19 = 19 * g7, g8_19 = 19 * g8, g9_19 = 19 * g9;
+	int64_t h[10];
+	h[0] = (int64_t)f0 * g0 + (int64_t)f1_2 * g9_19 + (int64_t)f2 * g8_19 + (int64_t)f3_2 * g7_19 + (int64_t)f4 * g6_19 + (int64_t)f5_2 * g5_19 + (int64_t)f6 * g4_19 + (int64_t)f7_2 * g3_19 + (int64_t)f8 * g2_19 + (int64_t)f9_2 * g1_19;
+	h[1] = (int64_t)f0 * g1 + (int64_t)f1 * g0 + (int64_t)f2 * g9_19 + (int64_t)f3 * g8_19 + (int64_t)f4 * g7_19 + (int64_t)f5 * g6_19 + (int64_t)f6 * g5_19 + (int64_t)f7 * g4_19 + (int64_t)f8 * g3_19 + (int64_t)f9 * g2_19;
+	h[2] = (int64_t)f0 * g2 + (int64_t)f1_2 * g1 + (int64_t)f2 * g0 + (int64_t)f3_2 * g9_19 + (int64_t)f4 * g8_19 + (int64_t)f5_2 * g7_19 + (int64_t)f6 * g6_19 + (int64_t)f7_2 * g5_19 + (int64_t)f8 * g4_19 + (int64_t)f9_2 * g3_19;
+	h[3] = (int64_t)f0 * g3 + (int64_t)f1 * g2 + (int64_t)f2 * g1 + (int64_t)f3 * g0 + (int64_t)f4 * g9_19 + (int64_t)f5 * g8_19 + (int64_t)f6 * g7_19 + (int64_t)f7 * g6_19 + (int64_t)f8 * g5_19 + (int64_t)f9 * g4_19;
+	h[4] = (int64_t)f0 * g4 + (int64_t)f1_2 * g3 + (int64_t)f2 * g2 + (int64_t)f3_2 * g1 + (int64_t)f4 * g0 + (int64_t)f5_2 * g9_19 + (int64_t)f6 * g8_19 + (int64_t)f7_2 * g7_19 + (int64_t)f8 * g6_19 + (int64_t)f9_2 * g5_19;
+	h[5] = (int64_t)f0 * g5 + (int64_t)f1 * g4 + (int64_t)f2 * g3 + (int64_t)f3 * g2 + (int64_t)f4 * g1 + (int64_t)f5 * g0 + (int64_t)f6 * g9_19 + (int64_t)f7 * g8_19 + (int64_t)f8 * g7_19 + (int64_t)f9 * g6_19;
+	h[6] = (int64_t)f0 * g6 + (int64_t)f1_2 * g5 + (int64_t)f2 * g4 + (int64_t)f3_2 * g3 + (int64_t)f4 * g2 + (int64_t)f5_2 * g1 + (int64_t)f6 * g0 + (int64_t)f7_2 * g9_19 + (int64_t)f8 * g8_19 + (int64_t)f9_2 * g7_19;
+	h[7] = (int64_t)f0 * g7 + (int64_t)f1 * g6 + (int64_t)f2 * g5 + (int64_t)f3 * g4 + (int64_t)f4 * g3 + (int64_t)f5 * g2 + (int64_t)f6 * g1 + (int64_t)f7 * g0 + (int64_t)f8 * g9_19 + (int64_t)f9 * g8_19;
+	h[8] = (int64_t)f0 * g8 + (int64_t)f1_2 * g7 + (int64_t)f2 * g6 + (int64_t)f3_2 * g5 + (int64_t)f4 * g4 + (int64_t)f5_2 * g3 + (int64_t)f6 * g2 + (int64_t)f7_2 * g1 + (int64_t)f8 * g0 + (int64_t)f9_2 * g9_19;
+	h[9] = (int64_t)f0 * g9 + (int64_t)f1 * g8 + (int64_t)f2 * g7 + (int64_t)f3 * g6 + (int64_t)f4 * g5 + (int64_t)f5 * g4 + (int64_t)f6 * g3 + (int64_t)f7 * g2 + (int64_t)f8 * g1 + (int64_t)f9 * g0;
+	fe_carry(out, h);
+}
+
+static void fe_sq(fe out, const fe f) {
+	int32_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4], f5 = f[5], f6 = f[6], f7 = f[7], f8 = f[8], f9 = f[9];
+	int32_t f0_2 = 2 * f0, f1_2 = 2 * f1, f2_2 = 2 * f2, f3_2 = 2 * f3, f4_2 = 2 * f4, f5_2 = 2 * f5, f6_2 = 2 * f6, f7_2 = 2 * f7, f8_2 = 2 * f8, f9_2 = 2 * f9;
+	int32_t f5_19 = 19 * f5, f6_19 = 19 * f6, f7_19 = 19 * f7, f7_38 = 38 * f7, f8_19 = 19 * f8, f9_19 = 19 * f9, f9_38 = 38 * f9;
+	int64_t h[10];
+	h[0] = (int64_t)f0 * f0 + (int64_t)f1_2 * f9_38 + (int64_t)f2_2 * f8_19 + (int64_t)f3_2 * f7_38 + (int64_t)f4_2 * f6_19 + (int64_t)f5_2 * f5_19;
+	h[1] = (int64_t)f0_2 * f1 + (int64_t)f2_2 * f9_19 + (int64_t)f3_2 * f8_19 + (int64_t)f4_2 * f7_19 + (int64_t)f5_2 * f6_19;
+	h[2] = (int64_t)f0_2 * f2 + (int64_t)f1_2 * f1 + (int64_t)f3_2 * f9_38 + (int64_t)f4_2 * f8_19 + (int64_t)f5_2 * f7_38 + (int64_t)f6 * f6_19;
+	h[3] = (int64_t)f0_2 * f3 + (int64_t)f1_2 * f2 + (int64_t)f4_2 * f9_19 + (int64_t)f5_2 * f8_19 + (int64_t)f6_2 * f7_19;
+	h[4] = (int64_t)f0_2 * f4 + (int64_t)f1_2 * f3_2 + (int64_t)f2 * f2 + (int64_t)f5_2 * f9_38 + (int64_t)f6_2 * f8_19 + (int64_t)f7_2 * f7_19;
+	h[5] = (int64_t)f0_2 * f5 + (int64_t)f1_2 * f4 + (int64_t)f2_2 * f3 + (int64_t)f6_2 * f9_19 + (int64_t)f7_2 * f8_19;
+	h[6] = (int64_t)f0_2 * f6 + (int64_t)f1_2 * f5_2 + (int64_t)f2_2 * f4 + (int64_t)f3_2 * f3 + (int64_t)f7_2 * f9_38 + (int64_t)f8 * f8_19;
+	h[7] = (int64_t)f0_2 * f7 + (int64_t)f1_2 * f6 + (int64_t)f2_2 * f5 + (int64_t)f3_2 * f4 + (int64_t)f8_2 * f9_19;
+	h[8] = (int64_t)f0_2 * f8 + (int64_t)f1_2 * f7_2 + (int64_t)f2_2 * f6 + (int64_t)f3_2 * f5_2 + (int64_t)f4 * f4 + (int64_t)f9_2 * f9_19;
+	h[9] = (int64_t)f0_2 * f9 + (int64_t)f1_2 * f8 + (int64_t)f2_2 * f7 + (int64_t)f3_2 * f6 + (int64_t)f4_2 * f5;
+	fe_carry(out, h);
+}
+
+static void fe_mul121666(fe out, const fe f) {
+	// (A + 2) / 4 with A = 486662, see the ladder step below
+	int64_t h[10];
+	for (int i = 0; i < 10; i++) h[i] = (int64_t)f[i] * 121666;
+	fe_carry(out, h);
+}
+
+static void fe_sq_n(fe out, const fe f, int n) {
+	fe_sq(out, f);
+	for (int i = 1; i < n; i++) fe_sq(out, out);
+}
+
+static void fe_invert(fe out, const fe z) {
+	// z^(p - 2) = z^(2^255 - 21)
+	fe t0, t1, t2, t3;
+	fe_sq(t0, z);                   // 2
+	fe_sq_n(t1, t0, 2);             // 8
+	fe_mul(t1, z, t1);              // 9
+	fe_mul(t0, t0, t1);             // 11
+	fe_sq(t2, t0);                  // 22
+	fe_mul(t1, t1, t2);             // 2^5 - 1
+	fe_sq_n(t2, t1, 5);
+	fe_mul(t1, t2, t1);             // 2^10 - 1
+	fe_sq_n(t2, t1, 10);
+	fe_mul(t2, t2, t1);             // 2^20 - 1
+	fe_sq_n(t3, t2, 20);
+	fe_mul(t2, t3, t2);             // 2^40 - 1
+	fe_sq_n(t2, t2, 10);
+	fe_mul(t1, t2, t1);             // 2^50 - 1
+	fe_sq_n(t2, t1, 50);
+	fe_mul(t2, t2, t1);             // 2^100 - 1
+	fe_sq_n(t3, t2, 100);
+	fe_mul(t2, t3, t2);             // 2^200 - 1
+	fe_sq_n(t2, t2, 50);
+	fe_mul(t1, t2, t1);             // 2^250 - 1
+	fe_sq_n(t1, t1, 5);             // 2^255 - 2^5
+	fe_mul(out, t1, t0);            // 2^255 - 21
+}
+
+static inline void fe_cswap(fe f, fe g, int32_t swap) {
+	// swap is 0 or 1
+	int32_t mask = -swap;
+	for (int i = 0; i < 10; i++) {
+		int32_t x = (f[i] ^ g[i]) & mask;
+		f[i] ^= x;
+		g[i] ^= x;
+	}
+}
+
+int x25519_opt(uint8_t out[X25519_OPT_BYTES], const uint8_t scalar[X25519_OPT_BYTES], const uint8_t point[X25519_OPT_BYTES]) {
+	uint8_t e[X25519_OPT_BYTES];
+	fe x1, x2, z2, x3, z3, tmp0, tmp1;
+	int32_t swap = 0;
+	uint8_t zero = 0;
+
+	memcpy(e, scalar, sizeof(e));
+	e[0] &= 248;
+	e[31] &= 127;
+	e[31] |= 64;
+
+	fe_frombytes(x1, point);
+	memset(x2, 0, sizeof(fe));
+	x2[0] = 1;
+	memset(z2, 0, sizeof(fe));
+	memcpy(x3, x1, sizeof(fe));
+	memset(z3, 0, sizeof(fe));
+	z3[0] = 1;
+
+	// Montgomery ladder, RFC7748 section 5
+	for (int pos = 254; pos >= 0; pos--) {
+		int32_t b = (e[pos / 8] >> (pos & 7)) & 1;
+		swap ^= b;
+		fe_cswap(x2, x3, swap);
+		fe_cswap(z2, z3, swap);
+		swap = b;
+
+		fe_sub(tmp0, x3, z3);       // D
+		fe_sub(tmp1, x2, z2);       // B
+		fe_add(x2, x2, z2);         // A
+		fe_add(z2, x3, z3);         // C
+		fe_mul(z3, tmp0, x2);       // DA
+		fe_mul(z2, z2, tmp1);       // CB
+		fe_sq(tmp0, tmp1);          // BB
+		fe_sq(tmp1, x2);            // AA
+		fe_add(x3, z3, z2);         // DA + CB
+		fe_sub(z2, z3, z2);         // DA - CB
+		fe_mul(x2, tmp1, tmp0);     // x2 = AA * BB
+		fe_sub(tmp1, tmp1, tmp0);   // E = AA - BB
+		fe_sq(z2, z2);              // (DA - CB)^2
+		fe_mul121666(z3, tmp1);     // 121666 * E
+		fe_sq(x3, x3);              // x3 = (DA + CB)^2
+		fe_add(tmp0, tmp0, z3);     // BB + 121666 * E = AA + 121665 * E
+		fe_mul(z3, x1, z2);         // z3 = x1 * (DA - CB)^2
+		fe_mul(z2, tmp1, tmp0);     // z2 = E * (AA + 121665 * E)
+	}
+	fe_cswap(x2, x3, swap);
+	fe_cswap(z2, z3, swap);
+
+	fe_invert(z2, z2);
+	fe_mul(x2, x2, z2);
+	fe_tobytes(out, x2);
+
+	crypto_zero(e, sizeof(e));
+	crypto_zero(x2, sizeof(fe));
+	crypto_zero(z2, sizeof(fe));
+	crypto_zero(x3, sizeof(fe));
+	crypto_zero(z3, sizeof(fe));
+	crypto_zero(tmp0, sizeof(fe));
+	crypto_zero(tmp1, sizeof(fe));
+
+	// Like the default implementation, an all zero result (low order point) is reported as an error
+	for (int i = 0; i < X25519_OPT_BYTES; i++) zero |= out[i];
+	return (zero == 0) ? -1 : 0;
+}
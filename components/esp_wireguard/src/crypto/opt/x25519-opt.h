@@ -0,0 +1,21 @@
+// X25519 (RFC7748) using 32-bit field arithmetic
+#ifndef _X25519_OPT_H_
+#define _X25519_OPT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define X25519_OPT_BYTES 32
+
+// Sets out to the clamped scalar times point.
+// Returns 0 on success, -1 if the result is all zero.
+int x25519_opt(uint8_t out[X25519_OPT_BYTES], const uint8_t scalar[X25519_OPT_BYTES], const uint8_t point[X25519_OPT_BYTES]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _X25519_OPT_H_ */
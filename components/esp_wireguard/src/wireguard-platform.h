@@ -46,6 +46,12 @@ extern "C" {
 #define WIREGUARD_MAX_PEERS CONFIG_WIREGUARD_MAX_PEERS
 #define WIREGUARD_MAX_SRC_IPS CONFIG_WIREGUARD_MAX_SRC_IPS
 
+// Number of packets a transport data packet may be behind the newest one and still be accepted
+#define WIREGUARD_REPLAY_WINDOW_SIZE CONFIG_WIREGUARD_REPLAY_WINDOW_SIZE
+#if (WIREGUARD_REPLAY_WINDOW_SIZE % 32) != 0
+#error "CONFIG_WIREGUARD_REPLAY_WINDOW_SIZE must be a multiple of 32"
+#endif
+
 // Per device limit on accepting (valid) initiation requests - per peer
 #define MAX_INITIATIONS_PER_SECOND	(CONFIG_MAX_INITIATIONS_PER_SECOND)
 
@@ -193,11 +193,11 @@ static void wireguard_mac(uint8_t *dst, const void *message, size_t len, const u
 }
 
 static void wireguard_mac_key(uint8_t *key, const uint8_t *public_key, const uint8_t *label, size_t label_len) {
-	blake2s_ctx ctx;
-	blake2s_init(&ctx, WIREGUARD_SESSION_KEY_LEN, NULL, 0);
-	blake2s_update(&ctx, label, label_len);
-	blake2s_update(&ctx, public_key, WIREGUARD_PUBLIC_KEY_LEN);
-	blake2s_final(&ctx, key);
+	wireguard_blake2s_ctx ctx;
+	wireguard_blake2s_init(&ctx, WIREGUARD_SESSION_KEY_LEN, NULL, 0);
+	wireguard_blake2s_update(&ctx, label, label_len);
+	wireguard_blake2s_update(&ctx, public_key, WIREGUARD_PUBLIC_KEY_LEN);
+	wireguard_blake2s_final(&ctx, key);
 }
 
 static void wireguard_mix_hash(uint8_t *hash, const uint8_t *src, size_t src_len) {
@@ -319,48 +319,51 @@ static void wireguard_kdf3(uint8_t *tau1, uint8_t *tau2, uint8_t *tau3, const ui
 }
 
 bool wireguard_check_replay(struct wireguard_keypair *keypair, uint64_t seq) {
-	// Implementation of packet replay window - as per RFC2401
-	// Adapted from code in Appendix C at https://tools.ietf.org/html/rfc2401
-	uint32_t diff;
+	// Implementation of packet replay window - same scheme as counter_validate() in the Linux kernel WireGuard module
+	// The bitmap is a ring of 32 bit words indexed by the packet number, so moving the window forwards only clears
+	// the words it skips over instead of shifting the whole bitmap
+	const size_t ReplayWindowWords = sizeof(keypair->replay_bitmap) / sizeof(keypair->replay_bitmap[0]);
+	uint64_t index;
+	uint64_t index_current;
+	uint64_t top;
+	uint64_t i;
+	uint32_t bit;
+	uint32_t *word;
 	bool result = false;
-	size_t ReplayWindowSize = sizeof(keypair->replay_bitmap) * CHAR_BIT; // 32 bits
 
 	// WireGuard data packet counter starts from 0 but algorithm expects packet numbers to start from 1
 	seq++;
 
 	if (seq != 0) {
-		if (seq > keypair->replay_counter) {
-			// new larger sequence number
-			diff = seq - keypair->replay_counter;
-			if (diff < ReplayWindowSize) {
-				// In window
-				keypair->replay_bitmap <<= diff;
-				// set bit for this packet
-				keypair->replay_bitmap |= 1;
-			} else {
-				// This packet has a "way larger"
-				keypair->replay_bitmap = 1;
-			}
-			keypair->replay_counter = seq;
-			// larger is good
-			result = true;
-		} else {
-			diff = keypair->replay_counter - seq;
-			if (diff < ReplayWindowSize) {
-				if (keypair->replay_bitmap & ((uint32_t)1 << diff)) {
-					// already seen
-				} else {
-					// mark as seen
-					keypair->replay_bitmap |= ((uint32_t)1 << diff);
-					// out of order but good
-					result = true;
+		if ((keypair->replay_counter <= WIREGUARD_REPLAY_WINDOW_SIZE) || (seq >= keypair->replay_counter - WIREGUARD_REPLAY_WINDOW_SIZE)) {
+			index = seq >> 5;
+			if (seq > keypair->replay_counter) {
+				// new larger sequence number - clear the words between the old and the new position
+				index_current = keypair->replay_counter >> 5;
+				top = index - index_current;
+				if (top > ReplayWindowWords) {
+					// This packet has a "way larger" number
+					top = ReplayWindowWords;
+				}
+				for (i = 1; i <= top; i++) {
+					keypair->replay_bitmap[(index_current + i) % ReplayWindowWords] = 0;
 				}
+				keypair->replay_counter = seq;
+			}
+			word = &keypair->replay_bitmap[index % ReplayWindowWords];
+			bit = (uint32_t)1 << (seq & 31);
+			if (*word & bit) {
+				// already seen
 			} else {
-				// too old or wrapped
+				// mark as seen - either larger or out of order but good
+				*word |= bit;
+				result = true;
 			}
+		} else {
+			// too old
 		}
 	} else {
-		// first == 0 or wrapped
+		// wrapped
 	}
 	return result;
 }
@@ -496,7 +499,7 @@ void wireguard_start_session(struct wireguard_peer *peer, bool initiator) {
 		wireguard_kdf2(new_keypair.receiving_key, new_keypair.sending_key, handshake->chaining_key, NULL, 0);
 	}
 
-	new_keypair.replay_bitmap = 0;
+	memset(new_keypair.replay_bitmap, 0, sizeof(new_keypair.replay_bitmap));
 	new_keypair.replay_counter = 0;
 
 	new_keypair.last_tx = 0;
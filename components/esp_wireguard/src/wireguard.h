@@ -91,7 +91,8 @@ struct wireguard_keypair {
 	uint32_t last_tx;
 	uint32_t last_rx;
 
-	uint32_t replay_bitmap;
+	// Ring of bitmap words, one word more than the window so the oldest word can be cleared ahead of use
+	uint32_t replay_bitmap[(WIREGUARD_REPLAY_WINDOW_SIZE / 32) + 1];
 	uint64_t replay_counter;
 
 	uint32_t local_index; // This is the index we generated for our end
@@ -143,11 +143,12 @@ static err_t wireguardif_output_to_peer(struct netif *netif, struct pbuf *q, con
 			if (pbuf) {
 				// Note: allocating pbuf from RAM above guarantees that the pbuf is in one section and not chained
 				// - i.e payload points to the contiguous memory region
-				memset(pbuf->payload, 0, pbuf->tot_len);
+				// Everything but the padding is overwritten below, so only that needs clearing
 
 				hdr = (struct message_transport_data *)pbuf->payload;
 
 				hdr->type = MESSAGE_TRANSPORT_DATA;
+				memset(hdr->reserved, 0, sizeof(hdr->reserved));
 				hdr->receiver = keypair->remote_index;
 				// Alignment required... pbuf_alloc has probably aligned data, but want to be sure
 				U64TO8_LITTLE(hdr->counter, keypair->sending_counter);
@@ -162,6 +163,7 @@ static err_t wireguardif_output_to_peer(struct netif *netif, struct pbuf *q, con
 					// Copy pbuf to memory - handles case where pbuf is chained
 					pbuf_copy_partial(q, dst, unpadded_len, 0);
 				}
+				memset(dst + unpadded_len, 0, padded_len - unpadded_len);
 
 				// Then encrypt
 				wireguard_encrypt_packet(dst, dst, padded_len, keypair);
@@ -269,15 +271,19 @@ static bool peer_add_ip(struct wireguard_peer *peer, ip_addr_t ip, ip_addr_t mas
 	return result;
 }
 
-static void wireguardif_process_data_message(struct wireguard_device *device, struct wireguard_peer *peer, struct message_transport_data *data_hdr, size_t data_len, const ip_addr_t *addr, u16_t port) {
+// Returns true if the received pbuf has been handed on to the IP layer (and must not be freed by the caller)
+static bool wireguardif_process_data_message(struct wireguard_device *device, struct wireguard_peer *peer, struct pbuf *p, struct message_transport_data *data_hdr, size_t data_len, const ip_addr_t *addr, u16_t port) {
 	struct wireguard_keypair *keypair;
 	uint64_t nonce;
 	uint8_t *src;
+	uint8_t *dst;
 	size_t src_len;
-	struct pbuf *pbuf;
+	struct pbuf *pbuf = NULL;
 	struct ip_hdr *iphdr;
 	ip_addr_t dest;
 	bool dest_ok = false;
+	bool in_place;
+	bool consumed = false;
 	int x;
 	uint32_t now;
 	uint16_t header_len = 0xFFFF;
@@ -297,12 +303,26 @@ static void wireguardif_process_data_message(struct wireguard_device *device, st
 			src = &data_hdr->enc_packet[0];
 			src_len = data_len;
 
-			// We don't know the unpadded size until we have decrypted the packet and validated/inspected the IP header
-			pbuf = pbuf_alloc(PBUF_TRANSPORT, src_len - WIREGUARD_AUTHTAG_LEN, PBUF_RAM);
-			if (pbuf) {
-				// Decrypt the packet
-				memset(pbuf->payload, 0, pbuf->tot_len);
-				if (wireguard_decrypt_packet(pbuf->payload, src, src_len, nonce, keypair)) {
+			// Decrypt straight into the received pbuf if nobody else holds it and the plaintext IP header ends up aligned
+			// Otherwise fall back to a separate buffer - we don't know the unpadded size until we have decrypted the packet and validated/inspected the IP header
+			in_place = (p->ref == 1) && ((((uintptr_t)src) & 3) == 0);
+			if (in_place) {
+				dst = src;
+			} else {
+				pbuf = pbuf_alloc(PBUF_TRANSPORT, src_len - WIREGUARD_AUTHTAG_LEN, PBUF_RAM);
+				dst = pbuf ? pbuf->payload : NULL;
+			}
+
+			if (dst) {
+				// Decrypt the packet - the MAC is checked before anything is written, so a forged packet leaves the buffer untouched
+				if (wireguard_decrypt_packet(dst, src, src_len, nonce, keypair)) {
+
+					if (in_place) {
+						// Strip the transport header and the auth tag, what is left is the plaintext packet
+						pbuf_remove_header(p, sizeof(struct message_transport_data));
+						pbuf_realloc(p, src_len - WIREGUARD_AUTHTAG_LEN);
+						pbuf = p;
+					}
 
 					// 3. Since the packet has authenticated correctly, the source IP of the outer UDP/IP packet is used to update the endpoint for peer TrMv...WXX0.
 					// Update the peer location
@@ -359,6 +379,7 @@ static void wireguardif_process_data_message(struct wireguard_device *device, st
 									// Send packet to be process by LWIP
 									ip_input(pbuf, device->netif);
 									// pbuf is owned by IP layer now
+									consumed = in_place;
 									pbuf = NULL;
 								}
 							} else {
@@ -372,7 +393,8 @@ static void wireguardif_process_data_message(struct wireguard_device *device, st
 					}
 				}
 
-				if (pbuf) {
+				// The received pbuf itself is released by the caller
+				if (pbuf && !in_place) {
 					pbuf_free(pbuf);
 				}
 			}
@@ -388,6 +410,7 @@ static void wireguardif_process_data_message(struct wireguard_device *device, st
 	} else {
 		// Could not locate valid keypair for remote index
 	}
+	return consumed;
 }
 
 static struct pbuf *wireguardif_initiate_handshake(struct wireguard_device *device, struct wireguard_peer *peer, struct message_handshake_initiation *msg, err_t *error) {
@@ -617,7 +640,10 @@ void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, cons
 			peer = peer_lookup_by_receiver(device, msg_data->receiver);
 			if (peer) {
 				// header is 16 bytes long so take that off the length
-				wireguardif_process_data_message(device, peer, msg_data, len - 16, addr, port);
+				if (wireguardif_process_data_message(device, peer, p, msg_data, len - 16, addr, port)) {
+					// Decrypted in place and passed on to the IP layer, which frees it
+					p = NULL;
+				}
 			}
 			break;
 
@@ -626,7 +652,9 @@ void wireguardif_network_rx(void *arg, struct udp_pcb *pcb, struct pbuf *p, cons
 			break;
 	}
 	// Release data!
-	pbuf_free(p);
+	if (p) {
+		pbuf_free(p);
+	}
 }
 
 static err_t wireguard_start_handshake(struct netif *netif, struct wireguard_peer *peer) {
@@ -1,265 +1,259 @@
-#include "i2s_mic.h"
-
-#include "driver/i2s_std.h"
-#include "esp_log.h"
-#include "esp_heap_caps.h"
-#include "rom/ets_sys.h"
-
-#include "esp_dsp.h"
-#include "util_generic.h"
-#include <math.h>
-#include <string.h>
-
-#if defined(CONFIG_I2S_MIC_ENABLED)
-
-#define LOG_TAG "I2S-MIC"
-
-
-#if defined(CONFIG_I2S_MIC_PERIPHERAL_I2S0)
-#define I2S_MIC_PERIPHERAL 0
-#elif defined(CONFIG_I2S_MIC_PERIPHERAL_I2S1)
-#define I2S_MIC_PERIPHERAL 1
-#endif
-
-#if defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_8BIT)
-#define I2S_MIC_SAMPLE_WIDTH_BYTES 1
-#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_8BIT
-#elif defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_16BIT)
-#define I2S_MIC_SAMPLE_WIDTH_BYTES 2
-#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_16BIT
-#elif defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_24BIT)
-#define I2S_MIC_SAMPLE_WIDTH_BYTES 4
-#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_32BIT // TODO
-#elif defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_32BIT)
-#define I2S_MIC_SAMPLE_WIDTH_BYTES 4
-#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_32BIT
-#endif
-
-static i2s_chan_handle_t rx_handle;
-
-
-void i2s_mic_init() {
-    ESP_LOGI(LOG_TAG, "Initializing microphone");
-    i2s_chan_config_t chan_cfg = {
-        .id = I2S_MIC_PERIPHERAL,
-        .role = I2S_ROLE_MASTER,
-        .dma_desc_num = 4,
-        .dma_frame_num = (256 * I2S_MIC_SAMPLE_WIDTH_BYTES),
-        .intr_priority = 0
-    };
-    ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, NULL, &rx_handle));
-
-    i2s_std_config_t std_cfg = {
-        .clk_cfg = {
-            .sample_rate_hz = CONFIG_I2S_MIC_SAMPLE_RATE,
-            .clk_src = I2S_CLK_SRC_DEFAULT,
-            .mclk_multiple = I2S_MCLK_MULTIPLE_384
-        },
-        .slot_cfg = {
-            .data_bit_width = I2S_DATA_BIT_WIDTH,
-            .slot_bit_width = I2S_SLOT_BIT_WIDTH_AUTO,
-            .slot_mode = I2S_SLOT_MODE_MONO,
-            .slot_mask = I2S_STD_SLOT_LEFT,
-            .ws_width = I2S_DATA_BIT_WIDTH,
-            .ws_pol = false,
-            .bit_shift = true,
-            .msb_right = false
-        },
-        .gpio_cfg = {
-            .mclk = I2S_GPIO_UNUSED,
-            .bclk = CONFIG_I2S_MIC_CLK_IO,
-            .ws = CONFIG_I2S_MIC_WS_IO,
-            .dout = I2S_GPIO_UNUSED,
-            .din = CONFIG_I2S_MIC_DATA_IO,
-            .invert_flags = {
-                .mclk_inv = false,
-                .bclk_inv = false,
-                .ws_inv = false,
-            },
-        }
-    };
-
-    i2s_channel_init_std_mode(rx_handle, &std_cfg);
-    i2s_channel_enable(rx_handle);
-}
-
-void i2s_mic_deinit() {
-    i2s_channel_disable(rx_handle);
-    i2s_del_channel(rx_handle);
-}
-
-// Apparently this must be a power of two!
-#define NUM_SAMPLES 1024
-    
-__attribute__((aligned(16)))
-float window[NUM_SAMPLES];
-
-__attribute__((aligned(16)))
-float in1[NUM_SAMPLES] = { 0.0f };
-
-__attribute__((aligned(16)))
-float in2[NUM_SAMPLES] = { 0.0f };
-
-__attribute__((aligned(16)))
-float y_cf[NUM_SAMPLES * 2] = { 0.0f };
-
-uint8_t buf[NUM_SAMPLES * 4];
-
-static float sampleNormalizationFactor = 1.0f;
-
-void i2s_mic_get_samples(float minSampleNormFactor, float maxSampleNormFactor, float maxSampleNormFactorIncrease, float maxSampleNormFactorDecrease) {
-    size_t bytesRead = 0;
-    size_t totalBytesRead = 0;
-    ESP_LOGD(LOG_TAG, "Capturing samples from microphone");
-    for (uint16_t i = 0; i < (NUM_SAMPLES / 256); i++) {
-        i2s_channel_read(rx_handle, &buf[totalBytesRead], (256 * I2S_MIC_SAMPLE_WIDTH_BYTES), &bytesRead, 100);
-        totalBytesRead += bytesRead;
-    }
-    
-    ESP_LOGD(LOG_TAG, "Converting samples to float");
-    float max = 0.0f;
-    for (uint16_t i = 0; i < NUM_SAMPLES; i++) {
-        in1[i] = (float)((int32_t*)buf)[i];
-        if (in1[i] > max) max = in1[i];
-    }
-    
-    float instantaneousNormalizationFactor = 1.0f;
-    if (max > 0.0f) {
-        instantaneousNormalizationFactor = (float)0x7FFFFFFF / max;
-    } else {
-        //ESP_LOGI(LOG_TAG, "Max. sample amplitude is 0");
-    }
-
-    if (instantaneousNormalizationFactor < sampleNormalizationFactor) {
-        // Inst. norm. factor smaller than prev. factor means
-        // this section of audio is louder than previously.
-        // Allow fast change (16th of the diff)
-        float diff = (sampleNormalizationFactor - instantaneousNormalizationFactor);
-        sampleNormalizationFactor -= diff  * maxSampleNormFactorDecrease; //fmin(diff, 1.0);
-    } else if (instantaneousNormalizationFactor > sampleNormalizationFactor) {
-        // Inst. norm. factor larger than prev. factor means
-        // this section of audio is quieter than previously.
-        // Allow slow change (512th of the diff)
-        float diff = (instantaneousNormalizationFactor - sampleNormalizationFactor);
-        sampleNormalizationFactor += diff * maxSampleNormFactorIncrease; //fmin(diff, 0.1);
-    }
-
-    if (isinf(sampleNormalizationFactor) || isnan(sampleNormalizationFactor)) {
-        if (isinf(sampleNormalizationFactor)) ESP_LOGD(LOG_TAG, "Sample normalization factor is Inf");
-        if (isnan(sampleNormalizationFactor)) ESP_LOGD(LOG_TAG, "Sample normalization factor is NaN");
-        ESP_LOGD(LOG_TAG, "Max. sample ampl.:  %.2f", max);
-        ESP_LOGD(LOG_TAG, "Inst. norm. factor: %.2f", instantaneousNormalizationFactor);
-        ESP_LOGD(LOG_TAG, "Samp. norm. factor: %.2f", sampleNormalizationFactor);
-        sampleNormalizationFactor = 1.0f;
-    }
-
-    if (sampleNormalizationFactor < minSampleNormFactor) sampleNormalizationFactor = minSampleNormFactor;
-    if (sampleNormalizationFactor > maxSampleNormFactor) sampleNormalizationFactor = maxSampleNormFactor;
-
-    ESP_LOGD(LOG_TAG, "Normalizing samples (Factor: %.2f)", sampleNormalizationFactor);
-    for (uint16_t i = 0; i < NUM_SAMPLES; i++) {
-        in1[i] *= sampleNormalizationFactor;
-    }
-}
-
-
-void i2s_mic_get_fft_bins(float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor, float minSampleNormFactor /*1.0*/, float maxSampleNormFactor /*500.0*/, float maxSampleNormFactorIncrease /*getting quieter, 1/512.0*/, float maxSampleNormFactorDecrease/*getting louder, 1/16.0*/) {
-    ESP_LOGD(LOG_TAG, "Initializing FFT");
-    ESP_ERROR_CHECK(dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE));
-
-    ESP_LOGD(LOG_TAG, "Generating Hann window");
-    dsps_wind_hann_f32(window, NUM_SAMPLES);
-
-    i2s_mic_get_samples(minSampleNormFactor, maxSampleNormFactor, maxSampleNormFactorIncrease, maxSampleNormFactorDecrease);
-
-    ESP_LOGD(LOG_TAG, "Merging input arrays into complex array");
-    for (uint32_t i = 0 ; i < NUM_SAMPLES ; i++) {
-        y_cf[i * 2 + 0] = in1[i] * window[i];
-        y_cf[i * 2 + 1] = 0;
-    }
-
-    ESP_LOGD(LOG_TAG, "Running FFT");
-    ESP_ERROR_CHECK(dsps_fft2r_fc32(y_cf, NUM_SAMPLES));
-    
-    ESP_LOGD(LOG_TAG, "Reversing bits");
-    ESP_ERROR_CHECK(dsps_bit_rev_fc32(y_cf, NUM_SAMPLES));
-    
-    ESP_LOGD(LOG_TAG, "Splitting complex array into output arrays");
-    ESP_ERROR_CHECK(dsps_cplx2reC_fc32(y_cf, NUM_SAMPLES));
-    
-
-    ESP_LOGD(LOG_TAG, "Calculating power");
-    for (uint32_t i = 0 ; i < NUM_SAMPLES / 2 ; i++) {
-        y_cf[i] = 10 * log10f((y_cf[i * 2 + 0] * y_cf[i * 2 + 0] + y_cf[i * 2 + 1] * y_cf[i * 2 + 1]) / NUM_SAMPLES);
-    }
-
-    ESP_LOGD(LOG_TAG, "Calculating bins");
-    if (x_log) {
-        const float minFreq = 1; // Avoid log(0)
-        const float maxFreq = (NUM_SAMPLES / 2) - 1;
-
-        float bMin = 9999999;
-        float bMax = 0;
-        
-        float logMin = log10(minFreq);
-        float logMax = log10(maxFreq);
-        float logRange = logMax - logMin;
-
-        uint16_t prevEndIdx = 1;  // Start from the lowest meaningful index
-
-        for (uint8_t b = 0; b < numBins; b++) {
-            // Logarithmic binning with a smooth transition
-            float fraction = (float)(b + 1) / numBins;  // Normalize [0, 1]
-            uint16_t endIdx = pow(10, logMin + pow(fraction, lin_log_factor) * logRange);
-
-            // Ensure the bins are contiguous and non-overlapping
-            uint16_t startIdx = prevEndIdx;
-            endIdx = max_i32(startIdx + 1, endIdx);  // Ensure each bin has at least 1 value
-
-            if (endIdx >= NUM_SAMPLES / 2) endIdx = NUM_SAMPLES / 2 - 1; // Clamp to valid range
-
-            // Log the bins for debugging
-            ESP_LOGD(LOG_TAG, "Bin %d: Start = %d, End = %d", b, startIdx, endIdx);
-
-            float bin_sum = 0.0f;
-            uint16_t count = 0;
-            float bin_max = 0.0f;
-            
-            for (uint16_t f = startIdx; f < endIdx; f++) {
-                if (y_cf[f] > bin_max) bin_max = y_cf[f];
-                bin_sum += y_cf[f];
-                count++;
-            }
-
-            //bins[b] = (count > 0) ? (bin_sum / count) : 0; // Use average as bin value
-            bins[b] = bin_max; // Use maximum as bin value
-            if (bins[b] < bMin) bMin = bins[b];
-            if (bins[b] > bMax) bMax = bins[b];
-
-            prevEndIdx = endIdx;  // Set start of next bin
-        }
-    } else {
-        const uint16_t binSize = ((NUM_SAMPLES / 2) / numBins);
-        float bMin = 9999999;
-        float bMax = 0;
-        for (uint8_t b = 0; b < numBins; b++) {
-            float bin_sum = 0.0f;
-            float bin_max = 0.0f;
-            for (uint8_t f = 0; f < binSize; f++) {
-                if (y_cf[b * binSize + f] > bin_max) bin_max = y_cf[b * binSize + f];
-                bin_sum += y_cf[b * binSize + f];
-            }
-            //bins[b] = bin_sum / binSize; // Use average as bin value
-            bins[b] = bin_max; // Use maximum as bin value
-            if (bins[b] < bMin) bMin = bins[b];
-            if (bins[b] > bMax) bMax = bins[b];
-        }
-    }
-    //ESP_LOGI(LOG_TAG, "Min = %.2f, Max = %.2f", bMin, bMax);
-
-    //ESP_LOGI(LOG_TAG, "Rendering output");
-    //dsps_view(bins, numBins, 8, 10, 150, 200, '#');
-    //dsps_view(y_cf, NUM_SAMPLES / 2, 128, 15, 100, 200, '#');
-}
-
+#include "i2s_mic.h"
+
+#include "mic_dsp.h"
+#include "mic_beat.h"
+#include "util_gpio.h"
+
+#include "driver/i2s_std.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(CONFIG_I2S_MIC_ENABLED)
+
+#define LOG_TAG "I2S-MIC"
+
+
+#if defined(CONFIG_I2S_MIC_PERIPHERAL_I2S0)
+#define I2S_MIC_PERIPHERAL 0
+#elif defined(CONFIG_I2S_MIC_PERIPHERAL_I2S1)
+#define I2S_MIC_PERIPHERAL 1
+#endif
+
+#if defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_8BIT)
+#define I2S_MIC_SAMPLE_WIDTH_BYTES 1
+#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_8BIT
+#elif defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_16BIT)
+#define I2S_MIC_SAMPLE_WIDTH_BYTES 2
+#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_16BIT
+#elif defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_24BIT)
+#define I2S_MIC_SAMPLE_WIDTH_BYTES 4
+#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_32BIT // TODO
+#elif defined(CONFIG_I2S_MIC_SAMPLE_WIDTH_32BIT)
+#define I2S_MIC_SAMPLE_WIDTH_BYTES 4
+#define I2S_DATA_BIT_WIDTH I2S_DATA_BIT_WIDTH_32BIT
+#endif
+
+static i2s_chan_handle_t rx_handle;
+
+// Samples read from I2S per call, must be smaller than the hop size
+#define CAPTURE_BLOCK_SIZE 256
+// Holds two frames worth of samples to bridge analysis latency
+#define SAMPLE_RING_SIZE (MIC_DSP_FRAME_SIZE * 2)
+
+static int32_t sample_ring_data[SAMPLE_RING_SIZE];
+static mic_ring_t sample_ring;
+static mic_dsp_t dsp;
+static mic_spectrum_t spectrum;
+
+static mic_beat_t beat_detector;
+static i2s_mic_beat_t beat_state = { 0 };
+static portMUX_TYPE beat_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#define MAX_BEAT_HANDLERS 4
+static i2s_mic_beat_handler_t beat_handlers[MAX_BEAT_HANDLERS] = { NULL };
+static void* beat_handler_args[MAX_BEAT_HANDLERS] = { NULL };
+
+static TaskHandle_t capture_task_handle = NULL;
+static TaskHandle_t analysis_task_handle = NULL;
+static volatile bool capture_running = false;
+static volatile bool analysis_running = false;
+
+
+static void i2s_mic_capture_task(void* arg) {
+    // Keeps the I2S DMA buffers drained, independent of how long the analysis takes
+    int32_t block[CAPTURE_BLOCK_SIZE];
+    uint32_t reportedOverruns = 0;
+
+    while (capture_running) {
+        size_t bytesRead = 0;
+        i2s_channel_read(rx_handle, block, sizeof(block), &bytesRead, 100);
+        if (bytesRead == 0) continue;
+
+        mic_ring_push(&sample_ring, block, bytesRead / sizeof(int32_t));
+        if (sample_ring.overruns != reportedOverruns) {
+            ESP_LOGW(LOG_TAG, "Sample ring overrun, %" PRIu32 " samples dropped so far", sample_ring.overruns);
+            reportedOverruns = sample_ring.overruns;
+        }
+        if (mic_ring_available(&sample_ring) >= MIC_DSP_HOP_SIZE) xTaskNotifyGive(analysis_task_handle);
+    }
+
+    capture_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+static void i2s_mic_handle_beat(float strength) {
+    i2s_mic_beat_t beat;
+    taskENTER_CRITICAL(&beat_lock);
+    beat_state.count++;
+    beat_state.time = esp_timer_get_time();
+    beat_state.strength = strength;
+    beat_state.bpm = mic_beat_get_bpm(&beat_detector);
+    beat = beat_state;
+    taskEXIT_CRITICAL(&beat_lock);
+
+    ESP_LOGD(LOG_TAG, "Beat %" PRIu32 " (strength %.2f, %.1f BPM)", beat.count, beat.strength, beat.bpm);
+    for (uint8_t i = 0; i < MAX_BEAT_HANDLERS; i++) {
+        if (beat_handlers[i] != NULL) beat_handlers[i](&beat, beat_handler_args[i]);
+    }
+}
+
+static void i2s_mic_analysis_task(void* arg) {
+    // Only checks for a stop request between frames, so a spectrum is never left half published
+    while (analysis_running) {
+        if (ulTaskNotifyTake(pdTRUE, 100) == 0) continue;
+        const float* power;
+        float peak;
+        while ((power = mic_dsp_process(&dsp, &sample_ring, &peak)) != NULL) {
+            mic_spectrum_publish(&spectrum, power, peak);
+
+            float strength;
+            if (mic_beat_process(&beat_detector, power, &strength)) {
+                i2s_mic_handle_beat(strength);
+            } else {
+                taskENTER_CRITICAL(&beat_lock);
+                beat_state.bpm = mic_beat_get_bpm(&beat_detector);
+                taskEXIT_CRITICAL(&beat_lock);
+            }
+        }
+
+        #if CONFIG_I2S_MIC_BEAT_GPIO >= 0
+        gpio_set(CONFIG_I2S_MIC_BEAT_GPIO, beat_state.count > 0 && esp_timer_get_time() - beat_state.time < CONFIG_I2S_MIC_BEAT_PULSE_MS * 1000, 0);
+        #endif
+    }
+
+    analysis_task_handle = NULL;
+    vTaskDelete(NULL);
+}
+
+void i2s_mic_init() {
+    ESP_LOGI(LOG_TAG, "Initializing microphone");
+    i2s_chan_config_t chan_cfg = {
+        .id = I2S_MIC_PERIPHERAL,
+        .role = I2S_ROLE_MASTER,
+        .dma_desc_num = 4,
+        .dma_frame_num = (256 * I2S_MIC_SAMPLE_WIDTH_BYTES),
+        .intr_priority = 0
+    };
+    ESP_ERROR_CHECK(i2s_new_channel(&chan_cfg, NULL, &rx_handle));
+
+    i2s_std_config_t std_cfg = {
+        .clk_cfg = {
+            .sample_rate_hz = CONFIG_I2S_MIC_SAMPLE_RATE,
+            .clk_src = I2S_CLK_SRC_DEFAULT,
+            .mclk_multiple = I2S_MCLK_MULTIPLE_384
+        },
+        .slot_cfg = {
+            .data_bit_width = I2S_DATA_BIT_WIDTH,
+            .slot_bit_width = I2S_SLOT_BIT_WIDTH_AUTO,
+            .slot_mode = I2S_SLOT_MODE_MONO,
+            .slot_mask = I2S_STD_SLOT_LEFT,
+            .ws_width = I2S_DATA_BIT_WIDTH,
+            .ws_pol = false,
+            .bit_shift = true,
+            .msb_right = false
+        },
+        .gpio_cfg = {
+            .mclk = I2S_GPIO_UNUSED,
+            .bclk = CONFIG_I2S_MIC_CLK_IO,
+            .ws = CONFIG_I2S_MIC_WS_IO,
+            .dout = I2S_GPIO_UNUSED,
+            .din = CONFIG_I2S_MIC_DATA_IO,
+            .invert_flags = {
+                .mclk_inv = false,
+                .bclk_inv = false,
+                .ws_inv = false,
+            },
+        }
+    };
+
+    i2s_channel_init_std_mode(rx_handle, &std_cfg);
+    i2s_channel_enable(rx_handle);
+
+    #if CONFIG_I2S_MIC_BEAT_GPIO >= 0
+    gpio_reset_pin(CONFIG_I2S_MIC_BEAT_GPIO);
+    gpio_set_direction(CONFIG_I2S_MIC_BEAT_GPIO, GPIO_MODE_OUTPUT);
+    #endif
+
+    mic_ring_init(&sample_ring, sample_ring_data, SAMPLE_RING_SIZE);
+    if (!mic_dsp_init(&dsp)) {
+        ESP_LOGE(LOG_TAG, "Failed to initialize FFT");
+        return;
+    }
+    mic_beat_config_t beatConfig;
+    mic_beat_get_default_config(&beatConfig);
+    mic_beat_init(&beat_detector, &beatConfig, (float)CONFIG_I2S_MIC_SAMPLE_RATE / MIC_DSP_HOP_SIZE);
+    capture_running = true;
+    analysis_running = true;
+    xTaskCreatePinnedToCore(i2s_mic_analysis_task, "mic_analysis", 2048, NULL, 4, &analysis_task_handle, 0);
+    xTaskCreatePinnedToCore(i2s_mic_capture_task, "mic_capture", 3072, NULL, 7, &capture_task_handle, 0);
+}
+
+void i2s_mic_deinit() {
+    // Let the capture task finish its current read before the channel goes away
+    capture_running = false;
+    while (capture_task_handle != NULL) vTaskDelay(1);
+    // Deleting the analysis task from here could catch it in the middle of publishing a spectrum
+    analysis_running = false;
+    while (analysis_task_handle != NULL) vTaskDelay(1);
+    i2s_channel_disable(rx_handle);
+    i2s_del_channel(rx_handle);
+}
+
+static float spectrum_copy[MIC_DSP_SPECTRUM_SIZE];
+static mic_norm_t sample_norm = { .factor = 1.0f, .frame = 0 };
+
+void i2s_mic_get_fft_bins(float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor, float minSampleNormFactor /*1.0*/, float maxSampleNormFactor /*500.0*/, float maxSampleNormFactorIncrease /*getting quieter, 1/512.0*/, float maxSampleNormFactorDecrease/*getting louder, 1/16.0*/) {
+    // Only reads the latest published spectrum, never waits for audio
+    float peak;
+    uint32_t frame = mic_spectrum_read(&spectrum, spectrum_copy, &peak);
+    if (frame == 0) {
+        memset(bins, 0, numBins * sizeof(float));
+        return;
+    }
+
+    // Normalizing the samples by a factor scales the power by its square
+    float factor = mic_norm_update(&sample_norm, frame, peak, minSampleNormFactor, maxSampleNormFactor, maxSampleNormFactorIncrease, maxSampleNormFactorDecrease);
+    ESP_LOGD(LOG_TAG, "Frame %" PRIu32 ", normalization factor %.2f", frame, factor);
+    mic_dsp_get_bins(spectrum_copy, factor * factor, bins, numBins, x_log, lin_log_factor);
+}
+
+void i2s_mic_get_beat(i2s_mic_beat_t* beat) {
+    taskENTER_CRITICAL(&beat_lock);
+    *beat = beat_state;
+    taskEXIT_CRITICAL(&beat_lock);
+}
+
+esp_err_t i2s_mic_register_beat_handler(i2s_mic_beat_handler_t handler, void* arg) {
+    // Handlers are called from the analysis task and must not block
+    for (uint8_t i = 0; i < MAX_BEAT_HANDLERS; i++) {
+        if (beat_handlers[i] == NULL) {
+            beat_handler_args[i] = arg;
+            beat_handlers[i] = handler;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+#else
+
+// Without a microphone, there is no spectrum and there are no beats
+
+void i2s_mic_get_fft_bins(float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor, float minSampleNormFactor, float maxSampleNormFactor, float maxSampleNormFactorIncrease, float maxSampleNormFactorDecrease) {
+    memset(bins, 0, numBins * sizeof(float));
+}
+
+void i2s_mic_get_beat(i2s_mic_beat_t* beat) {
+    memset(beat, 0, sizeof(*beat));
+}
+
+esp_err_t i2s_mic_register_beat_handler(i2s_mic_beat_handler_t handler, void* arg) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
 #endif
\ No newline at end of file
@@ -1,9 +1,23 @@
-#pragma once
-
-#include <stdint.h>
-
-void i2s_mic_init();
-void i2s_mic_deinit();
-void i2s_mic_get_fft_bins(float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor, float minSampleNormFactor, float maxSampleNormFactor, float maxSampleNormFactorIncrease, float maxSampleNormFactorDecrease);
-
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+
+typedef struct {
+    uint32_t count;         // Beats detected since startup
+    int64_t time;           // esp_timer time of the last beat in microseconds
+    float strength;         // Onset strength relative to the detection threshold
+    float bpm;              // Tempo estimate, 0 if unknown
+} i2s_mic_beat_t;
+
+typedef void (*i2s_mic_beat_handler_t)(const i2s_mic_beat_t* beat, void* arg);
+
+
+void i2s_mic_init();
+void i2s_mic_deinit();
+void i2s_mic_get_fft_bins(float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor, float minSampleNormFactor, float maxSampleNormFactor, float maxSampleNormFactorIncrease, float maxSampleNormFactorDecrease);
+void i2s_mic_get_beat(i2s_mic_beat_t* beat);
+esp_err_t i2s_mic_register_beat_handler(i2s_mic_beat_handler_t handler, void* arg);
+
 void fft_test();
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include <math.h>
+#include <string.h>
+
+#include "mic_beat.h"
+
+
+#define FLUX_AT(beat, f) ((beat)->flux[(f) & (MIC_BEAT_HISTORY - 1)])
+
+
+void mic_beat_get_default_config(mic_beat_config_t* config) {
+    config->thresholdSeconds = 0.5f;
+    config->thresholdFactor = 10.0f;
+    config->minFlux = 2.0f;
+    config->minIntervalSeconds = 0.2f;
+}
+
+void mic_beat_init(mic_beat_t* beat, const mic_beat_config_t* config, float frameRate) {
+    memset(beat, 0, sizeof(*beat));
+    beat->config = *config;
+    beat->frameRate = frameRate;
+
+    // Logarithmically spaced bands from bin 1 up to the end of the spectrum,
+    // each one at least one bin wide
+    beat->bandEdges[0] = 1;
+    for (uint16_t b = 1; b <= MIC_BEAT_NUM_BANDS; b++) {
+        uint16_t edge = (uint16_t)roundf(powf(MIC_DSP_SPECTRUM_SIZE, (float)b / MIC_BEAT_NUM_BANDS));
+        if (edge <= beat->bandEdges[b - 1]) edge = beat->bandEdges[b - 1] + 1;
+        if (edge > MIC_DSP_SPECTRUM_SIZE) edge = MIC_DSP_SPECTRUM_SIZE;
+        beat->bandEdges[b] = edge;
+    }
+
+    float thresholdFrames = config->thresholdSeconds * frameRate;
+    if (thresholdFrames < 3) thresholdFrames = 3;
+    if (thresholdFrames > MIC_BEAT_HISTORY / 2) thresholdFrames = MIC_BEAT_HISTORY / 2;
+    beat->thresholdFrames = (uint16_t)thresholdFrames;
+    beat->minIntervalFrames = (uint16_t)(config->minIntervalSeconds * frameRate);
+}
+
+static float mic_beat_median(float* values, uint16_t count) {
+    // Quickselect, reorders the values
+    uint16_t k = count / 2;
+    uint16_t lo = 0;
+    uint16_t hi = count - 1;
+    while (lo < hi) {
+        float pivot = values[(lo + hi) / 2];
+        uint16_t i = lo;
+        uint16_t j = hi;
+        while (i <= j) {
+            while (values[i] < pivot) i++;
+            while (values[j] > pivot) j--;
+            if (i <= j) {
+                float tmp = values[i];
+                values[i] = values[j];
+                values[j] = tmp;
+                i++;
+                if (j == 0) break;
+                j--;
+            }
+        }
+        if (k <= j) hi = j;
+        else if (k >= i) lo = i;
+        else break;
+    }
+    return values[k];
+}
+
+static float mic_beat_flux(mic_beat_t* beat, const float* power) {
+    // Sum of level increases in dB, averaged over all bands.
+    // Using levels makes this independent of the overall volume.
+    // Comparing against the louder of the last two frames keeps
+    // a level recovering from a single frame dip from counting as an onset.
+    float flux = 0.0f;
+    for (uint16_t b = 0; b < MIC_BEAT_NUM_BANDS; b++) {
+        float energy = 0.0f;
+        for (uint16_t i = beat->bandEdges[b]; i < beat->bandEdges[b + 1]; i++) energy += power[i];
+        float level = 10 * log10f(energy + 1.0f);
+        float reference = fmaxf(beat->prevLevels[0][b], beat->prevLevels[1][b]);
+        if (beat->frame > 1 && level > reference) flux += level - reference;
+        beat->prevLevels[1][b] = beat->prevLevels[0][b];
+        beat->prevLevels[0][b] = level;
+    }
+    return flux / MIC_BEAT_NUM_BANDS;
+}
+
+static void mic_beat_estimate_tempo(mic_beat_t* beat) {
+    uint32_t n = beat->frame < MIC_BEAT_HISTORY ? beat->frame : MIC_BEAT_HISTORY;
+    uint32_t start = beat->frame - n;
+    uint16_t minLag = (uint16_t)ceilf(beat->frameRate * 60 / MIC_BEAT_MAX_BPM);
+    uint16_t maxLag = (uint16_t)(beat->frameRate * 60 / MIC_BEAT_MIN_BPM);
+    if (maxLag > n / 2) maxLag = n / 2;
+    if (minLag < 1) minLag = 1;
+    if (maxLag <= minLag + 1) return;
+
+    float mean = 0.0f;
+    for (uint32_t i = 0; i < n; i++) mean += FLUX_AT(beat, start + i);
+    mean /= n;
+    float variance = 0.0f;
+    for (uint32_t i = 0; i < n; i++) {
+        float d = FLUX_AT(beat, start + i) - mean;
+        variance += d * d;
+    }
+    variance /= n;
+    if (variance <= 0.0f) return;
+
+    float* acf = beat->scratch;
+    uint16_t bestLag = 0;
+    float bestScore = 0.0f;
+    for (uint16_t lag = minLag; lag <= maxLag; lag++) {
+        float sum = 0.0f;
+        for (uint32_t i = lag; i < n; i++) {
+            sum += (FLUX_AT(beat, start + i) - mean) * (FLUX_AT(beat, start + i - lag) - mean);
+        }
+        acf[lag] = sum / (n - lag) / variance;
+
+        // Prefer tempos around 120 BPM to avoid picking multiples or fractions of the tempo
+        float octaves = log2f(beat->frameRate * 60 / lag / 120.0f);
+        float score = acf[lag] * expf(-2.0f * octaves * octaves);
+        if (score > bestScore) {
+            bestScore = score;
+            bestLag = lag;
+        }
+    }
+    if (bestLag == 0 || acf[bestLag] < 0.3f) return;
+
+    // Parabolic interpolation for a lag between frames
+    float lag = bestLag;
+    if (bestLag > minLag && bestLag < maxLag) {
+        float a = acf[bestLag - 1];
+        float b = acf[bestLag];
+        float c = acf[bestLag + 1];
+        float denom = a - 2 * b + c;
+        if (denom < 0.0f) lag += 0.5f * (a - c) / denom;
+    }
+    float bpm = beat->frameRate * 60 / lag;
+
+    if (beat->bpm == 0.0f) {
+        beat->bpm = bpm;
+    } else if (fabsf(bpm - beat->bpm) < beat->bpm * 0.08f) {
+        beat->bpm += (bpm - beat->bpm) * 0.25f;
+    } else if (fabsf(bpm - beat->bpmCandidate) < beat->bpmCandidate * 0.08f) {
+        // Only jump to a different tempo once it has been found twice in a row
+        beat->bpm = bpm;
+    }
+    beat->bpmCandidate = bpm;
+}
+
+bool mic_beat_process(mic_beat_t* beat, const float* power, float* strength) {
+    /*
+    Feed the power spectrum of the next frame.
+    Returns true if an onset was detected. Onsets are reported one frame late
+    since a peak can only be confirmed once the flux decreases again.
+    strength is the flux of the onset relative to the threshold.
+    */
+    FLUX_AT(beat, beat->frame) = mic_beat_flux(beat, power);
+    beat->frame++;
+
+    if (beat->frame % MIC_BEAT_TEMPO_INTERVAL == 0 && beat->frame >= MIC_BEAT_HISTORY / 2) {
+        mic_beat_estimate_tempo(beat);
+    }
+
+    // The candidate needs a full threshold window before it as well as one frame after it
+    if (beat->frame < (uint32_t)beat->thresholdFrames + 2) return false;
+    uint32_t candFrame = beat->frame - 2;
+    float cand = FLUX_AT(beat, candFrame);
+    if (cand <= FLUX_AT(beat, candFrame - 1) || cand < FLUX_AT(beat, candFrame + 1)) return false;
+    if (cand < beat->config.minFlux) return false;
+    if (candFrame - beat->lastOnset < beat->minIntervalFrames) return false;
+
+    // Median and median absolute deviation aren't thrown off by previous onsets in the window
+    float* window = beat->scratch;
+    for (uint16_t i = 0; i < beat->thresholdFrames; i++) window[i] = FLUX_AT(beat, candFrame - 1 - i);
+    float median = mic_beat_median(window, beat->thresholdFrames);
+    for (uint16_t i = 0; i < beat->thresholdFrames; i++) window[i] = fabsf(window[i] - median);
+    float deviation = mic_beat_median(window, beat->thresholdFrames);
+    float threshold = median + beat->config.thresholdFactor * deviation;
+    if (cand <= threshold) return false;
+
+    beat->lastOnset = candFrame;
+    *strength = (threshold > 0.0f) ? cand / threshold : cand;
+    return true;
+}
+
+float mic_beat_get_bpm(mic_beat_t* beat) {
+    // Without recent onsets there is no tempo to speak of
+    if (beat->frame - beat->lastOnset > MIC_BEAT_TEMPO_TIMEOUT * beat->frameRate) return 0.0f;
+    return beat->bpm;
+}
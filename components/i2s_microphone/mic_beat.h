@@ -0,0 +1,56 @@
+#pragma once
+
+/*
+ * Onset detection and tempo estimation on the microphone power spectrum.
+ * Like mic_dsp, this has no ESP-IDF dependencies and runs on a PC as well.
+ *
+ * Onsets are peaks in the spectral flux (sum of level increases over
+ * logarithmically spaced bands) that exceed an adaptive threshold derived
+ * from the recent flux history. The tempo is the strongest periodicity in
+ * that history, found by autocorrelation within a plausible BPM range.
+ * Work per frame is bounded by the constants below.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mic_dsp.h"
+
+
+#define MIC_BEAT_NUM_BANDS 24
+// Flux history used for the tempo estimate, must be a power of two
+#define MIC_BEAT_HISTORY 256
+// Frames between tempo estimates
+#define MIC_BEAT_TEMPO_INTERVAL 16
+#define MIC_BEAT_MIN_BPM 60
+#define MIC_BEAT_MAX_BPM 200
+// Seconds without onsets after which no tempo is reported
+#define MIC_BEAT_TEMPO_TIMEOUT 4
+
+typedef struct {
+    float thresholdSeconds;     // Length of the window the threshold is based on
+    float thresholdFactor;      // Median absolute deviations above the median flux
+    float minFlux;              // Absolute minimum flux in dB per band
+    float minIntervalSeconds;   // Minimum time between onsets
+} mic_beat_config_t;
+
+typedef struct {
+    mic_beat_config_t config;
+    float frameRate;
+    uint16_t bandEdges[MIC_BEAT_NUM_BANDS + 1];
+    float prevLevels[2][MIC_BEAT_NUM_BANDS];     // Band levels of the last two frames
+    float flux[MIC_BEAT_HISTORY];
+    uint32_t frame;             // Frames processed so far
+    uint32_t lastOnset;         // Frame of the last onset
+    uint16_t thresholdFrames;
+    uint16_t minIntervalFrames;
+    float bpm;                  // 0 until a tempo has been found
+    float bpmCandidate;
+    float scratch[MIC_BEAT_HISTORY / 2 + 1];    // Autocorrelation or threshold window, kept off the task stack
+} mic_beat_t;
+
+
+void mic_beat_get_default_config(mic_beat_config_t* config);
+void mic_beat_init(mic_beat_t* beat, const mic_beat_config_t* config, float frameRate);
+bool mic_beat_process(mic_beat_t* beat, const float* power, float* strength);
+float mic_beat_get_bpm(mic_beat_t* beat);
@@ -0,0 +1,267 @@
+#include <math.h>
+#include <string.h>
+
+#include "mic_dsp.h"
+
+#if defined(ESP_PLATFORM)
+#include "esp_dsp.h"
+#endif
+
+
+bool mic_ring_init(mic_ring_t* ring, int32_t* data, uint32_t size) {
+    if (size == 0 || (size & (size - 1)) != 0) return false;
+    ring->data = data;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->overruns = 0;
+    return true;
+}
+
+uint32_t mic_ring_push(mic_ring_t* ring, const int32_t* samples, uint32_t count) {
+    // Samples that don't fit are dropped, the consumer is expected to keep up
+    uint32_t head = ring->head;
+    uint32_t space = ring->size - (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+    if (count > space) {
+        ring->overruns += count - space;
+        count = space;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        ring->data[(head + i) & (ring->size - 1)] = samples[i];
+    }
+    __atomic_store_n(&ring->head, head + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+uint32_t mic_ring_available(mic_ring_t* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+uint32_t mic_ring_pop(mic_ring_t* ring, int32_t* samples, uint32_t count) {
+    uint32_t tail = ring->tail;
+    uint32_t available = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - tail;
+    if (count > available) count = available;
+    for (uint32_t i = 0; i < count; i++) {
+        samples[i] = ring->data[(tail + i) & (ring->size - 1)];
+    }
+    __atomic_store_n(&ring->tail, tail + count, __ATOMIC_RELEASE);
+    return count;
+}
+
+
+bool mic_dsp_init(mic_dsp_t* dsp) {
+    // Tables and window only need to be generated once
+    #if defined(ESP_PLATFORM)
+    if (dsps_fft2r_init_fc32(NULL, CONFIG_DSP_MAX_FFT_SIZE) != ESP_OK) return false;
+    #else
+    for (uint32_t k = 0; k < MIC_DSP_FRAME_SIZE / 2; k++) {
+        dsp->twiddle[k * 2 + 0] = cosf(2 * M_PI * k / MIC_DSP_FRAME_SIZE);
+        dsp->twiddle[k * 2 + 1] = -sinf(2 * M_PI * k / MIC_DSP_FRAME_SIZE);
+    }
+    #endif
+
+    // Hann window, same as dsps_wind_hann_f32()
+    for (uint32_t i = 0; i < MIC_DSP_FRAME_SIZE; i++) {
+        dsp->window[i] = 0.5f * (1 - cosf(i * 2 * M_PI / (MIC_DSP_FRAME_SIZE - 1)));
+    }
+    memset(dsp->frame, 0, sizeof(dsp->frame));
+    dsp->filled = 0;
+    return true;
+}
+
+static void mic_dsp_fft(mic_dsp_t* dsp) {
+    // In-place complex FFT with the result in natural order
+    #if defined(ESP_PLATFORM)
+    dsps_fft2r_fc32(dsp->fft, MIC_DSP_FRAME_SIZE);
+    dsps_bit_rev_fc32(dsp->fft, MIC_DSP_FRAME_SIZE);
+    #else
+    float* x = dsp->fft;
+    const uint32_t n = MIC_DSP_FRAME_SIZE;
+    for (uint32_t i = 1, j = 0; i < n; i++) {
+        uint32_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) j ^= bit;
+        j ^= bit;
+        if (i < j) {
+            float re = x[i * 2 + 0];
+            float im = x[i * 2 + 1];
+            x[i * 2 + 0] = x[j * 2 + 0];
+            x[i * 2 + 1] = x[j * 2 + 1];
+            x[j * 2 + 0] = re;
+            x[j * 2 + 1] = im;
+        }
+    }
+    for (uint32_t len = 2; len <= n; len <<= 1) {
+        uint32_t step = n / len;
+        for (uint32_t i = 0; i < n; i += len) {
+            for (uint32_t k = 0; k < len / 2; k++) {
+                float wr = dsp->twiddle[k * step * 2 + 0];
+                float wi = dsp->twiddle[k * step * 2 + 1];
+                uint32_t a = (i + k) * 2;
+                uint32_t b = (i + k + len / 2) * 2;
+                float tr = x[b] * wr - x[b + 1] * wi;
+                float ti = x[b] * wi + x[b + 1] * wr;
+                x[b] = x[a] - tr;
+                x[b + 1] = x[a + 1] - ti;
+                x[a] += tr;
+                x[a + 1] += ti;
+            }
+        }
+    }
+    #endif
+}
+
+const float* mic_dsp_process(mic_dsp_t* dsp, mic_ring_t* ring, float* peak) {
+    /*
+    Analyze the next frame if MIC_DSP_HOP_SIZE new samples are available.
+    The first half of the frame is the second half of the previous one.
+    Returns the linear power spectrum (MIC_DSP_SPECTRUM_SIZE values,
+    valid until the next call) or NULL if there is no new frame.
+    */
+    if (mic_ring_available(ring) < MIC_DSP_HOP_SIZE) return NULL;
+
+    mic_ring_pop(ring, dsp->raw, MIC_DSP_HOP_SIZE);
+    memmove(dsp->frame, &dsp->frame[MIC_DSP_HOP_SIZE], (MIC_DSP_FRAME_SIZE - MIC_DSP_HOP_SIZE) * sizeof(float));
+    for (uint32_t i = 0; i < MIC_DSP_HOP_SIZE; i++) {
+        dsp->frame[MIC_DSP_FRAME_SIZE - MIC_DSP_HOP_SIZE + i] = (float)dsp->raw[i];
+    }
+    if (dsp->filled < MIC_DSP_FRAME_SIZE) {
+        dsp->filled += MIC_DSP_HOP_SIZE;
+        if (dsp->filled < MIC_DSP_FRAME_SIZE) return NULL;
+    }
+
+    float max = 0.0f;
+    for (uint32_t i = 0; i < MIC_DSP_FRAME_SIZE; i++) {
+        if (dsp->frame[i] > max) max = dsp->frame[i];
+        dsp->fft[i * 2 + 0] = dsp->frame[i] * dsp->window[i];
+        dsp->fft[i * 2 + 1] = 0;
+    }
+    *peak = max;
+
+    mic_dsp_fft(dsp);
+
+    // The input is real, so the first half of the output already is its spectrum.
+    // Writing power[i] never overwrites values needed later.
+    float* power = dsp->fft;
+    for (uint32_t i = 0; i < MIC_DSP_SPECTRUM_SIZE; i++) {
+        power[i] = (dsp->fft[i * 2 + 0] * dsp->fft[i * 2 + 0] + dsp->fft[i * 2 + 1] * dsp->fft[i * 2 + 1]) / MIC_DSP_FRAME_SIZE;
+    }
+    return power;
+}
+
+
+void mic_spectrum_publish(mic_spectrum_t* spectrum, const float* power, float peak) {
+    uint32_t seq = spectrum->seq;
+    __atomic_store_n(&spectrum->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(spectrum->power, power, sizeof(spectrum->power));
+    spectrum->peak = peak;
+    spectrum->frame++;
+    __atomic_store_n(&spectrum->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+uint32_t mic_spectrum_read(mic_spectrum_t* spectrum, float* power, float* peak) {
+    // Copy the latest spectrum, retrying if it was updated in the meantime.
+    // Returns the frame number, 0 if nothing has been published yet.
+    uint32_t seq;
+    uint32_t frame = 0;
+    do {
+        seq = __atomic_load_n(&spectrum->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) continue;
+        memcpy(power, spectrum->power, sizeof(spectrum->power));
+        *peak = spectrum->peak;
+        frame = spectrum->frame;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || __atomic_load_n(&spectrum->seq, __ATOMIC_RELAXED) != seq);
+    return frame;
+}
+
+
+void mic_norm_init(mic_norm_t* norm) {
+    norm->factor = 1.0f;
+    norm->frame = 0;
+}
+
+float mic_norm_update(mic_norm_t* norm, uint32_t frame, float peak, float minFactor, float maxFactor, float increase, float decrease) {
+    /*
+    Adapt the sample normalization factor to the peak of a new frame.
+    Calling it again for the same frame only applies the limits.
+    */
+    if (frame != norm->frame) {
+        norm->frame = frame;
+
+        float instantaneousFactor = 1.0f;
+        if (peak > 0.0f) instantaneousFactor = (float)0x7FFFFFFF / peak;
+
+        if (instantaneousFactor < norm->factor) {
+            // Inst. norm. factor smaller than prev. factor means
+            // this section of audio is louder than previously.
+            norm->factor -= (norm->factor - instantaneousFactor) * decrease;
+        } else if (instantaneousFactor > norm->factor) {
+            // Inst. norm. factor larger than prev. factor means
+            // this section of audio is quieter than previously.
+            norm->factor += (instantaneousFactor - norm->factor) * increase;
+        }
+
+        if (isinf(norm->factor) || isnan(norm->factor)) norm->factor = 1.0f;
+    }
+
+    if (norm->factor < minFactor) norm->factor = minFactor;
+    if (norm->factor > maxFactor) norm->factor = maxFactor;
+    return norm->factor;
+}
+
+
+static float mic_dsp_bin_db(float maxPower, float gain) {
+    // Bins are the maximum power in dB, floored at 0.
+    // Only one logarithm per bin since the maximum is the same in both domains.
+    float p = maxPower * gain;
+    if (p <= 1.0f) return 0.0f;
+    return 10 * log10f(p);
+}
+
+void mic_dsp_get_bins(const float* power, float gain, float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor) {
+    /*
+    Reduce a power spectrum to numBins values in dB.
+    gain scales the power, i.e. it's the square of the sample normalization factor.
+    */
+    if (numBins == 0) return;
+
+    if (x_log) {
+        const float minFreq = 1; // Avoid log(0)
+        const float maxFreq = MIC_DSP_SPECTRUM_SIZE - 1;
+
+        float logMin = log10f(minFreq);
+        float logMax = log10f(maxFreq);
+        float logRange = logMax - logMin;
+
+        uint16_t prevEndIdx = 1;  // Start from the lowest meaningful index
+
+        for (uint16_t b = 0; b < numBins; b++) {
+            // Logarithmic binning with a smooth transition
+            float fraction = (float)(b + 1) / numBins;  // Normalize [0, 1]
+            uint16_t endIdx = powf(10, logMin + powf(fraction, lin_log_factor) * logRange);
+
+            // Ensure the bins are contiguous and non-overlapping
+            uint16_t startIdx = prevEndIdx;
+            if (endIdx < startIdx + 1) endIdx = startIdx + 1;  // Ensure each bin has at least 1 value
+            if (endIdx >= MIC_DSP_SPECTRUM_SIZE) endIdx = MIC_DSP_SPECTRUM_SIZE - 1; // Clamp to valid range
+
+            float binMax = 0.0f;
+            for (uint16_t f = startIdx; f < endIdx; f++) {
+                if (power[f] > binMax) binMax = power[f];
+            }
+            bins[b] = mic_dsp_bin_db(binMax, gain);
+
+            prevEndIdx = endIdx;  // Set start of next bin
+        }
+    } else {
+        const uint16_t binSize = MIC_DSP_SPECTRUM_SIZE / numBins;
+        for (uint16_t b = 0; b < numBins; b++) {
+            float binMax = 0.0f;
+            for (uint16_t f = 0; f < binSize; f++) {
+                if (power[b * binSize + f] > binMax) binMax = power[b * binSize + f];
+            }
+            bins[b] = mic_dsp_bin_db(binMax, gain);
+        }
+    }
+}
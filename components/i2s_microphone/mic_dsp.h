@@ -0,0 +1,71 @@
+#pragma once
+
+/*
+ * Audio analysis pipeline for the I2S microphone, i.e. everything after the driver:
+ * sample ring, overlapping windowed FFT frames, spectrum publishing and binning.
+ * Apart from the optional esp-dsp FFT there are no ESP-IDF dependencies,
+ * so this can be compiled on a PC and fed with samples from a WAV file.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Must be a power of two
+#define MIC_DSP_FRAME_SIZE 1024
+// Frames overlap by 50%, so a new one is analyzed every MIC_DSP_HOP_SIZE samples
+#define MIC_DSP_HOP_SIZE (MIC_DSP_FRAME_SIZE / 2)
+#define MIC_DSP_SPECTRUM_SIZE (MIC_DSP_FRAME_SIZE / 2)
+
+// Single producer, single consumer sample ring. Positions are free-running.
+typedef struct {
+    int32_t* data;
+    uint32_t size;          // Must be a power of two
+    uint32_t head;          // Only written by the producer
+    uint32_t tail;          // Only written by the consumer
+    uint32_t overruns;      // Samples dropped because the ring was full
+} mic_ring_t;
+
+typedef struct {
+    __attribute__((aligned(16))) float window[MIC_DSP_FRAME_SIZE];
+    __attribute__((aligned(16))) float frame[MIC_DSP_FRAME_SIZE];       // Last MIC_DSP_FRAME_SIZE samples
+    union {
+        __attribute__((aligned(16))) float fft[MIC_DSP_FRAME_SIZE * 2]; // Interleaved re/im, power after processing
+        int32_t raw[MIC_DSP_HOP_SIZE];                                  // New samples, the FFT buffer is free between frames
+    };
+    #if !defined(ESP_PLATFORM)
+    float twiddle[MIC_DSP_FRAME_SIZE];                                  // Interleaved cos/sin
+    #endif
+    uint32_t filled;        // Samples in the frame buffer, saturates at MIC_DSP_FRAME_SIZE
+} mic_dsp_t;
+
+// Latest power spectrum, published with a sequence lock.
+// Only one task may publish, any number of tasks may read.
+typedef struct {
+    uint32_t seq;           // Odd while being written
+    uint32_t frame;         // Number of the published frame, 0 = none yet
+    float peak;             // Highest sample value in the frame
+    float power[MIC_DSP_SPECTRUM_SIZE];
+} mic_spectrum_t;
+
+typedef struct {
+    float factor;
+    uint32_t frame;         // Last frame the factor was adapted to
+} mic_norm_t;
+
+
+bool mic_ring_init(mic_ring_t* ring, int32_t* data, uint32_t size);
+uint32_t mic_ring_push(mic_ring_t* ring, const int32_t* samples, uint32_t count);
+uint32_t mic_ring_available(mic_ring_t* ring);
+uint32_t mic_ring_pop(mic_ring_t* ring, int32_t* samples, uint32_t count);
+
+bool mic_dsp_init(mic_dsp_t* dsp);
+const float* mic_dsp_process(mic_dsp_t* dsp, mic_ring_t* ring, float* peak);
+
+void mic_spectrum_publish(mic_spectrum_t* spectrum, const float* power, float peak);
+uint32_t mic_spectrum_read(mic_spectrum_t* spectrum, float* power, float* peak);
+
+void mic_norm_init(mic_norm_t* norm);
+float mic_norm_update(mic_norm_t* norm, uint32_t frame, float peak, float minFactor, float maxFactor, float increase, float decrease);
+
+void mic_dsp_get_bins(const float* power, float gain, float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor);
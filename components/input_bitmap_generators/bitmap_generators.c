@@ -1,4 +1,6 @@
 #include "esp_log.h"
+#include "esp_timer.h"
+#include <inttypes.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -9,7 +11,7 @@
 #include "macros.h"
 #include "util_buffer.h"
 #include "util_generic.h"
-#include "util_gpio.h"
+#include "util_geometry.h"
 #include "math.h"
 
 // TODO: More elegant buffer type gating than just gating the entire function content
@@ -29,10 +31,40 @@ static uint16_t frame_height = 0;
 static cJSON* current_bitmap_generator = NULL;
 static color_rgb_u8_t white = {.r = 255, .g = 255, .b = 255};
 
-// TODO: This is REALLY UGLY and a hack for one specific display.
-// I don't have time right now to do it properly, but this can't stay like that.
-#define MAPPING_LENGTH 2062
-extern const uint16_t LED_TO_BITMAP_MAPPING[MAPPING_LENGTH];
+#if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+// Active pixels in memory order, this is what the generators iterate
+static geometry_t geometry = {0};
+
+// Generators that convert colors in batches do so for this many pixels at a time
+#define GENERATOR_CHUNK_SIZE 64
+
+// Spatial part of the gradient generators.
+// The position along the gradient is the sum of a per-column and a per-row term,
+// so it only has to be calculated for each column and row when the parameters change.
+typedef struct {
+    bool valid;
+    uint16_t angle;
+    uint16_t scale;
+    uint16_t range;
+    fx20_12_t x_offsets[DISPLAY_FRAME_WIDTH_PIXEL];
+    fx20_12_t y_offsets[DISPLAY_FRAME_HEIGHT_PIXEL];
+} gradient_cache_t;
+static gradient_cache_t gradient_cache = {0};
+
+// Spatial part of the plasma generators, only recalculated when the scale changes
+typedef struct {
+    bool valid;
+    uint16_t scale;
+    int32_t x_units[DISPLAY_FRAME_WIDTH_PIXEL];
+    int32_t y_units[DISPLAY_FRAME_HEIGHT_PIXEL];
+    int16_t* radial_units;  // Per pixel, in geometry order
+} plasma_cache_t;
+static plasma_cache_t plasma_cache = {0};
+
+// Sum of the column and row terms for the current frame
+static fx20_12_t plasma_x_sin_fx[DISPLAY_FRAME_WIDTH_PIXEL];
+static fx20_12_t plasma_y_sin_fx[DISPLAY_FRAME_HEIGHT_PIXEL];
+#endif
 
 // Order of generators. This is important!
 // This order needs to match the order in which the generators
@@ -55,13 +87,32 @@ enum generator_func {
 };
 
 
-void bitmap_generators_init(uint8_t* pixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock, uint16_t frameWidth, uint16_t frameHeight) {
+void bitmap_generators_init(uint8_t* pixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock, uint16_t frameWidth, uint16_t frameHeight, const uint16_t* activePixels, uint32_t numActivePixels) {
+    /*
+    activePixels optionally lists the pixel buffer offsets that are actually visible,
+    e.g. on displays that only have LEDs in some places. NULL means all pixels.
+    */
     ESP_LOGI(LOG_TAG, "Initializing bitmap generators");
     pixel_buffer = pixBuf;
     pixel_buffer_size = pixBufSize;
     pixel_buffer_lock = pixBufLock;
     frame_width = frameWidth;
     frame_height = frameHeight;
+
+    #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+    // Cached spatial terms belong to the old geometry
+    gradient_cache.valid = false;
+    plasma_cache.valid = false;
+    free(plasma_cache.radial_units);
+    plasma_cache.radial_units = NULL;
+    geometry_deinit(&geometry);
+    esp_err_t ret = geometry_init(&geometry, frameWidth, frameHeight, DISPLAY_FRAME_HEIGHT_PIXEL_BYTES, 3, activePixels, numActivePixels);
+    if (ret != ESP_OK) {
+        ESP_LOGE(LOG_TAG, "Failed to build pixel list: %s", esp_err_to_name(ret));
+    } else {
+        ESP_LOGI(LOG_TAG, "%" PRIu32 " active pixels", geometry.numPixels);
+    }
+    #endif
 }
 
 void bitmap_generator_select(cJSON* bitmapGeneratorData) {
@@ -508,6 +559,28 @@ cJSON* bitmap_generators_get_available() {
         cJSON_AddNumberToObject(param, "value", 1);
         cJSON_AddItemToObject(params, "bin_width", param);
 
+        // Parameter: Level shown as empty (dB)
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "range");
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 250);
+        cJSON_AddNumberToObject(param, "value", 130);
+        cJSON_AddItemToObject(params, "min_db", param);
+
+        // Parameter: Level shown as full (dB)
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "range");
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 250);
+        cJSON_AddNumberToObject(param, "value", 200);
+        cJSON_AddItemToObject(params, "max_db", param);
+
+        // Parameter: Invert on beat
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "checkbox");
+        cJSON_AddBoolToObject(param, "checked", 0);
+        cJSON_AddItemToObject(params, "beat_invert", param);
+
     cJSON_AddItemToObject(generator_entry, "params", params);
     cJSON_AddItemToArray(generators_arr, generator_entry);
 
@@ -547,6 +620,22 @@ cJSON* bitmap_generators_get_available() {
         cJSON_AddNumberToObject(param, "max", 10000);
         cJSON_AddNumberToObject(param, "value", 160);
         cJSON_AddItemToObject(params, "norm_factor_decrease", param);
+
+        // Parameter: Level shown as empty (dB)
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "range");
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 250);
+        cJSON_AddNumberToObject(param, "value", 130);
+        cJSON_AddItemToObject(params, "min_db", param);
+
+        // Parameter: Level shown as full (dB)
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "range");
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 250);
+        cJSON_AddNumberToObject(param, "value", 200);
+        cJSON_AddItemToObject(params, "max_db", param);
     
     cJSON_AddItemToObject(generator_entry, "params", params);
     cJSON_AddItemToArray(generators_arr, generator_entry);
@@ -561,8 +650,8 @@ void bitmap_generator_none(int64_t t) {
 void bitmap_generator_solid_single(int64_t t, color_rgb_u8_t color) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
     taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        uint32_t pixBufIndex = geometry.pixels[i].offset;
         
         pixel_buffer[pixBufIndex] = color.r;
         pixel_buffer[pixBufIndex + 1] = color.g;
@@ -585,49 +674,80 @@ void bitmap_generator_rainbow_t(int64_t t, uint16_t speed) {
     #endif
 }
 
-void bitmap_generator_rainbow_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint8_t s, uint8_t v) {
-    #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+#if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+static uint32_t _chunk_size(uint32_t start) {
+    uint32_t remaining = geometry.numPixels - start;
+    return remaining < GENERATOR_CHUNK_SIZE ? remaining : GENERATOR_CHUNK_SIZE;
+}
+
+static void _write_chunk(const geometry_pixel_t* pixels, const color_rgb_u8_t* colors, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        pixel_buffer[pixels[i].offset] = colors[i].r;
+        pixel_buffer[pixels[i].offset + 1] = colors[i].g;
+        pixel_buffer[pixels[i].offset + 2] = colors[i].b;
+    }
+}
+
+static void _gradient_prepare(uint16_t angle, uint16_t scale, uint16_t range) {
+    /*
+    Calculate the offsets for a gradient going from 0 to range once across the frame
+    (scaled by scale / 100), plus range to ensure they are positive.
+    */
+    if (gradient_cache.valid && gradient_cache.angle == angle && gradient_cache.scale == scale && gradient_cache.range == range) return;
+
     int32_t angle_units = (angle * 0x8000) / 360;
     fx20_12_t sin_angle_fx = sin_i16_to_fx20_12(angle_units);
     fx20_12_t cos_angle_fx = cos_i16_to_fx20_12(angle_units);
     fx20_12_t normalized_scale_fx = FX20_12(scale) / 100;
-    fx20_12_t normalized_s_fx = FX20_12(s) / 255;
-    fx20_12_t normalized_v_fx = FX20_12(v) / 255;
 
     // Calculate the diagonal length of the frame
     fx20_12_t diagonal_length_fx = sqrt_i32_to_fx20_12(frame_width * frame_width + frame_height * frame_height);
 
-    taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
-        uint16_t x = pixBufIndex / (frame_height * 3);
-        uint16_t y = pixBufIndex % (frame_height * 3) / 3;
-        
-        // Calculate the distance along the gradient direction
-        fx20_12_t distance_along_gradient_fx = x * cos_angle_fx + y * sin_angle_fx;
+    for (uint16_t x = 0; x < frame_width; x++) {
+        // Distance along the gradient direction, normalized by the diagonal length to get a value between -1 and 1
+        fx20_12_t normalized_distance_fx = ((int64_t)(x * cos_angle_fx) << 12) / diagonal_length_fx;
+        gradient_cache.x_offsets[x] = UNFX20_12((int64_t)(normalized_distance_fx + FX20_12(1)) * range * normalized_scale_fx);
+    }
+    for (uint16_t y = 0; y < frame_height; y++) {
+        fx20_12_t normalized_distance_fx = ((int64_t)(y * sin_angle_fx) << 12) / diagonal_length_fx;
+        gradient_cache.y_offsets[y] = UNFX20_12((int64_t)normalized_distance_fx * range * normalized_scale_fx);
+    }
 
-        // Normalize the distance by the diagonal length to get a value between 0 and 1
-        fx20_12_t normalized_distance_fx = FX20_12((int64_t)distance_along_gradient_fx) / diagonal_length_fx;
+    gradient_cache.angle = angle;
+    gradient_cache.scale = scale;
+    gradient_cache.range = range;
+    gradient_cache.valid = true;
+}
 
-        // Scale the normalized distance to 360 degrees, add 1 to ensure we are positive
-        fx20_12_t offset_fx = (normalized_distance_fx + FX20_12(1)) * 360;
+static fx20_12_t _gradient_time_offset(int64_t t, fx20_12_t normalized_speed_fx, uint16_t range) {
+    fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
+    return UNFX52_12((int64_t)normalized_speed_fx * t_sec_fx) % FX20_12(range);
+}
+#endif
 
-        // Apply manual scaling
-        offset_fx = UNFX20_12((int64_t)offset_fx * normalized_scale_fx);
-        
-        color_hsv_fx20_12_t hsv_fx;
-        fx20_12_t normalized_speed_fx = speed * normalized_scale_fx; // Use scale to adjust speed so it appears constant
-        fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
-        fx52_12_t temp_fx = UNFX52_12((int64_t)normalized_speed_fx * t_sec_fx) + offset_fx;
-        hsv_fx.h = temp_fx % FX20_12(360);
-        hsv_fx.s = normalized_s_fx;
-        hsv_fx.v = normalized_v_fx;
+void bitmap_generator_rainbow_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint8_t s, uint8_t v) {
+    #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+    fx20_12_t normalized_scale_fx = FX20_12(scale) / 100;
+    fx20_12_t normalized_s_fx = FX20_12(s) / 255;
+    fx20_12_t normalized_v_fx = FX20_12(v) / 255;
 
-        // Get the color for the current segment
-        color_rgb_u8_t rgb_u8 = hsv_fx20_12_to_rgb_u8(hsv_fx);
-        pixel_buffer[pixBufIndex] = rgb_u8.r;
-        pixel_buffer[pixBufIndex + 1] = rgb_u8.g;
-        pixel_buffer[pixBufIndex + 2] = rgb_u8.b;
+    // Scale the gradient to 360 degrees
+    _gradient_prepare(angle, scale, 360);
+    fx20_12_t normalized_speed_fx = speed * normalized_scale_fx; // Use scale to adjust speed so it appears constant
+    fx20_12_t time_offset_fx = _gradient_time_offset(t, normalized_speed_fx, 360);
+
+    fx20_12_t hues_fx[GENERATOR_CHUNK_SIZE];
+    color_rgb_u8_t colors[GENERATOR_CHUNK_SIZE];
+
+    taskENTER_CRITICAL(pixel_buffer_lock);
+    for (uint32_t start = 0; start < geometry.numPixels; start += GENERATOR_CHUNK_SIZE) {
+        const geometry_pixel_t* pixels = &geometry.pixels[start];
+        uint32_t count = _chunk_size(start);
+        for (uint32_t i = 0; i < count; i++) {
+            hues_fx[i] = (time_offset_fx + gradient_cache.x_offsets[pixels[i].x] + gradient_cache.y_offsets[pixels[i].y]) % FX20_12(360);
+        }
+        hue_fx20_12_to_rgb_u8_array(hues_fx, normalized_s_fx, normalized_v_fx, colors, count);
+        _write_chunk(pixels, colors, count);
     }
     taskEXIT_CRITICAL(pixel_buffer_lock);
     #endif
@@ -635,45 +755,25 @@ void bitmap_generator_rainbow_gradient(int64_t t, uint16_t speed, uint16_t angle
 
 void bitmap_generator_hard_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint16_t numColors, color_rgb_u8_t* colors) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
-    int32_t angle_units = (angle * 0x8000) / 360;
-    fx20_12_t sin_angle_fx = sin_i16_to_fx20_12(angle_units);
-    fx20_12_t cos_angle_fx = cos_i16_to_fx20_12(angle_units);
     fx20_12_t normalized_scale_fx = FX20_12(scale) / 100;
 
-    // Calculate the diagonal length of the frame
-    fx20_12_t diagonal_length_fx = sqrt_i32_to_fx20_12(frame_width * frame_width + frame_height * frame_height);
-    
-    taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint32_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
-        uint16_t x = pixBufIndex / (frame_height * 3);
-        uint16_t y = pixBufIndex % (frame_height * 3) / 3;
-        
-        // Calculate the distance along the gradient direction
-        fx20_12_t distance_along_gradient_fx = x * cos_angle_fx + y * sin_angle_fx;
-
-        // Normalize the distance by the diagonal length to get a value between 0 and 1
-        fx20_12_t normalized_distance_fx = FX20_12((int64_t)distance_along_gradient_fx) / diagonal_length_fx;
+    _gradient_prepare(angle, scale, 1);
+    fx20_12_t normalized_speed_fx = (speed * normalized_scale_fx) / 100;
+    fx20_12_t time_offset_fx = _gradient_time_offset(t, normalized_speed_fx, 1);
 
-        // Add 1 to ensure we are positive
-        fx20_12_t offset_fx = normalized_distance_fx + FX20_12(1);
-        
-        // Apply manual scaling
-        offset_fx = UNFX20_12((int64_t)offset_fx * normalized_scale_fx);
-        
-        fx20_12_t normalized_speed_fx = (speed * normalized_scale_fx) / 100;
-        fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
-        fx52_12_t temp_fx = UNFX52_12((int64_t)normalized_speed_fx * t_sec_fx) + offset_fx;
-        temp_fx %= FX20_12(1);
+    taskENTER_CRITICAL(pixel_buffer_lock);
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        const geometry_pixel_t* pixel = &geometry.pixels[i];
+        fx20_12_t temp_fx = (time_offset_fx + gradient_cache.x_offsets[pixel->x] + gradient_cache.y_offsets[pixel->y]) % FX20_12(1);
 
         // Determine the segment index
         uint16_t segment_index = (uint16_t)UNFX20_12_ROUND(temp_fx * numColors) % numColors;
 
         // Get the color for the current segment
         color_rgb_u8_t color = colors[segment_index];
-        pixel_buffer[pixBufIndex] = color.r;
-        pixel_buffer[pixBufIndex + 1] = color.g;
-        pixel_buffer[pixBufIndex + 2] = color.b;
+        pixel_buffer[pixel->offset] = color.r;
+        pixel_buffer[pixel->offset + 1] = color.g;
+        pixel_buffer[pixel->offset + 2] = color.b;
     }
     taskEXIT_CRITICAL(pixel_buffer_lock);
     #endif
@@ -695,36 +795,16 @@ void bitmap_generator_hard_gradient_3(int64_t t, uint16_t speed, uint16_t angle,
 
 void bitmap_generator_soft_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint16_t numColors, color_rgb_u8_t* colors) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
-    int32_t angle_units = (angle * 0x8000) / 360;
-    fx20_12_t sin_angle_fx = sin_i16_to_fx20_12(angle_units);
-    fx20_12_t cos_angle_fx = cos_i16_to_fx20_12(angle_units);
     fx20_12_t normalized_scale_fx = FX20_12(scale) / 100;
 
-    // Calculate the diagonal length of the frame
-    fx20_12_t diagonal_length_fx = sqrt_i32_to_fx20_12(frame_width * frame_width + frame_height * frame_height);
-    
-    taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint32_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
-        uint16_t x = pixBufIndex / (frame_height * 3);
-        uint16_t y = pixBufIndex % (frame_height * 3) / 3;
-        
-        // Calculate the distance along the gradient direction
-        fx20_12_t distance_along_gradient_fx = x * cos_angle_fx + y * sin_angle_fx;
-
-        // Normalize the distance by the diagonal length to get a value between 0 and 1
-        fx20_12_t normalized_distance_fx = FX20_12((int64_t)distance_along_gradient_fx) / diagonal_length_fx;
+    _gradient_prepare(angle, scale, 1);
+    fx20_12_t normalized_speed_fx = (speed * normalized_scale_fx) / 100;
+    fx20_12_t time_offset_fx = _gradient_time_offset(t, normalized_speed_fx, 1);
 
-        // Add 1 to ensure we are positive
-        fx20_12_t offset_fx = normalized_distance_fx + FX20_12(1);
-        
-        // Apply manual scaling
-        offset_fx = UNFX20_12((int64_t)offset_fx * normalized_scale_fx);
-        
-        fx20_12_t normalized_speed_fx = (speed * normalized_scale_fx) / 100;
-        fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
-        fx52_12_t temp_fx = UNFX52_12((int64_t)normalized_speed_fx * t_sec_fx) + offset_fx;
-        temp_fx %= FX20_12(1);
+    taskENTER_CRITICAL(pixel_buffer_lock);
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        const geometry_pixel_t* pixel = &geometry.pixels[i];
+        fx20_12_t temp_fx = (time_offset_fx + gradient_cache.x_offsets[pixel->x] + gradient_cache.y_offsets[pixel->y]) % FX20_12(1);
 
         // Determine the segment index
         fx20_12_t segment_index_fx = temp_fx * numColors;
@@ -735,9 +815,9 @@ void bitmap_generator_soft_gradient(int64_t t, uint16_t speed, uint16_t angle, u
         // Get the color for the current segment
         color_rgb_u8_t color1 = colors[segment_index_base];
         color_rgb_u8_t color2 = colors[next_segment_index];
-        pixel_buffer[pixBufIndex] = interpolate_fx20_12_i32(segment_fraction_fx, color1.r, color2.r);
-        pixel_buffer[pixBufIndex + 1] = interpolate_fx20_12_i32(segment_fraction_fx, color1.g, color2.g);
-        pixel_buffer[pixBufIndex + 2] = interpolate_fx20_12_i32(segment_fraction_fx, color1.b, color2.b);
+        pixel_buffer[pixel->offset] = interpolate_fx20_12_i32(segment_fraction_fx, color1.r, color2.r);
+        pixel_buffer[pixel->offset + 1] = interpolate_fx20_12_i32(segment_fraction_fx, color1.g, color2.g);
+        pixel_buffer[pixel->offset + 2] = interpolate_fx20_12_i32(segment_fraction_fx, color1.b, color2.b);
     }
     taskEXIT_CRITICAL(pixel_buffer_lock);
     #endif
@@ -763,8 +843,8 @@ void bitmap_generator_on_off_100_frames(int64_t t) {
     static uint8_t on_off_100_frames_val = 255;
 
     taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        uint32_t pixBufIndex = geometry.pixels[i].offset;
         
         pixel_buffer[pixBufIndex] = on_off_100_frames_val;
         pixel_buffer[pixBufIndex + 1] = on_off_100_frames_val;
@@ -804,10 +884,10 @@ void bitmap_generator_matrix(int64_t t, uint16_t speed, color_rgb_u8_t base_colo
     }
 
     taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
-        uint16_t x = pixBufIndex / (frame_height * 3);
-        uint16_t y = pixBufIndex % (frame_height * 3) / 3;
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        uint32_t pixBufIndex = geometry.pixels[i].offset;
+        uint16_t x = geometry.pixels[i].x;
+        uint16_t y = geometry.pixels[i].y;
 
         // Check if the current matrix column should be updated
         if (t >= matrix_columns[x].next_update_us) {
@@ -853,46 +933,83 @@ void bitmap_generator_matrix(int64_t t, uint16_t speed, color_rgb_u8_t base_colo
     #endif
 }
 
+#if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+static bool _plasma_prepare(uint16_t scale) {
+    if (plasma_cache.valid && plasma_cache.scale == scale) return true;
+
+    if (plasma_cache.radial_units == NULL && geometry.numPixels > 0) {
+        plasma_cache.radial_units = malloc(geometry.numPixels * sizeof(int16_t));
+        if (plasma_cache.radial_units == NULL) return false;
+    }
+
+    for (uint16_t x = 0; x < frame_width; x++) {
+        int32_t x_units = (x * 0x4000) / frame_width - 0x2000;
+        plasma_cache.x_units[x] = x_units * scale / 10;
+    }
+    for (uint16_t y = 0; y < frame_height; y++) {
+        int32_t y_units = (y * 0x4000) / frame_height - 0x2000;
+        plasma_cache.y_units[y] = y_units * scale / 10;
+    }
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        int32_t x_units = plasma_cache.x_units[geometry.pixels[i].x];
+        int32_t y_units = plasma_cache.y_units[geometry.pixels[i].y];
+        // The sine is periodic in 16 bits, so truncating doesn't change the result
+        plasma_cache.radial_units[i] = UNFX20_12_ROUND(sqrt_i32_to_fx20_12(x_units*x_units + y_units*y_units)) * 2;
+    }
+
+    plasma_cache.scale = scale;
+    plasma_cache.valid = true;
+    return true;
+}
+
+static int16_t _plasma_frame(int64_t t, uint16_t speed) {
+    /*
+    Calculate the column and row terms for the current frame.
+    Returns the time offset for the radial term.
+    */
+    fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
+    fx52_12_t t_speed_fx = t_sec_fx * 1000 * speed;
+    int16_t t_x = UNFX52_12(t_speed_fx * 5 / 10);
+    int16_t t_2x = UNFX52_12(t_speed_fx * 6 / 10);
+    int16_t t_y = UNFX52_12(t_speed_fx * 7 / 10);
+    int16_t t_2y = UNFX52_12(t_speed_fx * 8 / 10);
+
+    for (uint16_t x = 0; x < frame_width; x++) {
+        int32_t x_units = plasma_cache.x_units[x];
+        plasma_x_sin_fx[x] = sin_i16_to_fx20_12(x_units + t_x) + sin_i16_to_fx20_12(x_units * 2 + t_2x);
+    }
+    for (uint16_t y = 0; y < frame_height; y++) {
+        int32_t y_units = plasma_cache.y_units[y];
+        plasma_y_sin_fx[y] = sin_i16_to_fx20_12(y_units + t_y) + sin_i16_to_fx20_12(y_units * 2 + t_2y);
+    }
+    return UNFX52_12(t_speed_fx * 9 / 10);
+}
+#endif
+
 void bitmap_generator_plasma(int64_t t, uint16_t speed, uint16_t scale, uint8_t s, uint8_t v) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
     fx20_12_t normalized_s_fx = FX20_12(s) / 255;
     fx20_12_t normalized_v_fx = FX20_12(v) / 255;
 
-    taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
-        uint16_t x = pixBufIndex / (frame_height * 3);
-        uint16_t y = pixBufIndex % (frame_height * 3) / 3;
-        
-        int32_t x_units = (x * 0x4000) / frame_width - 0x2000;
-        int32_t y_units = (y * 0x4000) / frame_height - 0x2000;
-        
-        x_units = x_units * scale / 10;
-        y_units = y_units * scale / 10;
-        
-        fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
-        fx52_12_t t_speed_fx = t_sec_fx * 1000 * speed;
-        
-        fx20_12_t sin_x_fx = sin_i16_to_fx20_12(x_units + UNFX52_12(t_speed_fx * 5 / 10));
-        fx20_12_t sin_2x_fx = sin_i16_to_fx20_12(x_units * 2 + UNFX52_12(t_speed_fx * 6 / 10));
-        fx20_12_t sin_y_fx = sin_i16_to_fx20_12(y_units + UNFX52_12(t_speed_fx * 7 / 10));
-        fx20_12_t sin_2y_fx = sin_i16_to_fx20_12(y_units * 2 + UNFX52_12(t_speed_fx * 8 / 10));
-        fx20_12_t sin_circ_fx = sin_i16_to_fx20_12(UNFX20_12_ROUND(sqrt_i32_to_fx20_12(x_units*x_units + y_units*y_units)) * 2 + UNFX52_12(t_speed_fx * 9 / 10));
-        
-        fx20_12_t sin_combined_fx = (sin_x_fx + sin_2x_fx + sin_y_fx + sin_2y_fx + sin_circ_fx) / 5;
-        
-        fx20_12_t hue_fx = (sin_combined_fx + FX20_12(1)) * 180;
-        
-        color_hsv_fx20_12_t hsv_fx;
-        hsv_fx.h = hue_fx % FX20_12(360);
-        hsv_fx.s = normalized_s_fx;
-        hsv_fx.v = normalized_v_fx;
+    if (!_plasma_prepare(scale)) return;
+    int16_t t_circ = _plasma_frame(t, speed);
 
-        // Get the color for the current segment
-        color_rgb_u8_t rgb_u8 = hsv_fx20_12_to_rgb_u8(hsv_fx);
-        pixel_buffer[pixBufIndex] = rgb_u8.r;
-        pixel_buffer[pixBufIndex + 1] = rgb_u8.g;
-        pixel_buffer[pixBufIndex + 2] = rgb_u8.b;
+    fx20_12_t hues_fx[GENERATOR_CHUNK_SIZE];
+    color_rgb_u8_t colors[GENERATOR_CHUNK_SIZE];
+
+    taskENTER_CRITICAL(pixel_buffer_lock);
+    for (uint32_t start = 0; start < geometry.numPixels; start += GENERATOR_CHUNK_SIZE) {
+        const geometry_pixel_t* pixels = &geometry.pixels[start];
+        const int16_t* radial_units = &plasma_cache.radial_units[start];
+        uint32_t count = _chunk_size(start);
+        for (uint32_t i = 0; i < count; i++) {
+            fx20_12_t sin_circ_fx = sin_i16_to_fx20_12(radial_units[i] + t_circ);
+            fx20_12_t sin_combined_fx = (plasma_x_sin_fx[pixels[i].x] + plasma_y_sin_fx[pixels[i].y] + sin_circ_fx) / 5;
+            fx20_12_t hue_fx = (sin_combined_fx + FX20_12(1)) * 180;
+            hues_fx[i] = hue_fx % FX20_12(360);
+        }
+        hue_fx20_12_to_rgb_u8_array(hues_fx, normalized_s_fx, normalized_v_fx, colors, count);
+        _write_chunk(pixels, colors, count);
     }
     taskEXIT_CRITICAL(pixel_buffer_lock);
     #endif
@@ -900,36 +1017,21 @@ void bitmap_generator_plasma(int64_t t, uint16_t speed, uint16_t scale, uint8_t
 
 void bitmap_generator_plasma_2(int64_t t, uint16_t speed, uint16_t scale, color_rgb_u8_t color1, color_rgb_u8_t color2) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+    if (!_plasma_prepare(scale)) return;
+    int16_t t_circ = _plasma_frame(t, speed);
 
     taskENTER_CRITICAL(pixel_buffer_lock);
-    for (uint16_t i = 0; i < MAPPING_LENGTH; i++) {
-        uint16_t pixBufIndex = LED_TO_BITMAP_MAPPING[i];
-        uint16_t x = pixBufIndex / (frame_height * 3);
-        uint16_t y = pixBufIndex % (frame_height * 3) / 3;
-        
-        int32_t x_units = (x * 0x4000) / frame_width - 0x2000;
-        int32_t y_units = (y * 0x4000) / frame_height - 0x2000;
-        
-        x_units = x_units * scale / 10;
-        y_units = y_units * scale / 10;
-        
-        fx52_12_t t_sec_fx = FX52_12(t) / 1000000; // It's a UNIX timestamp, so it needs more bits
-        fx52_12_t t_speed_fx = t_sec_fx * 1000 * speed;
-        
-        fx20_12_t sin_x_fx = sin_i16_to_fx20_12(x_units + UNFX52_12(t_speed_fx * 5 / 10));
-        fx20_12_t sin_2x_fx = sin_i16_to_fx20_12(x_units * 2 + UNFX52_12(t_speed_fx * 6 / 10));
-        fx20_12_t sin_y_fx = sin_i16_to_fx20_12(y_units + UNFX52_12(t_speed_fx * 7 / 10));
-        fx20_12_t sin_2y_fx = sin_i16_to_fx20_12(y_units * 2 + UNFX52_12(t_speed_fx * 8 / 10));
-        fx20_12_t sin_circ_fx = sin_i16_to_fx20_12(UNFX20_12_ROUND(sqrt_i32_to_fx20_12(x_units*x_units + y_units*y_units)) * 2 + UNFX52_12(t_speed_fx * 9 / 10));
-        
-        fx20_12_t sin_combined_fx = (sin_x_fx + sin_2x_fx + sin_y_fx + sin_2y_fx + sin_circ_fx) / 5;
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        const geometry_pixel_t* pixel = &geometry.pixels[i];
+        fx20_12_t sin_circ_fx = sin_i16_to_fx20_12(plasma_cache.radial_units[i] + t_circ);
+        fx20_12_t sin_combined_fx = (plasma_x_sin_fx[pixel->x] + plasma_y_sin_fx[pixel->y] + sin_circ_fx) / 5;
         
         fx20_12_t gradient_pos_fx = (sin_combined_fx + FX20_12(1)) / 2;
 
         // Get the color for the current segment
-        pixel_buffer[pixBufIndex] = interpolate_fx20_12_i32(gradient_pos_fx, color1.r, color2.r);
-        pixel_buffer[pixBufIndex + 1] = interpolate_fx20_12_i32(gradient_pos_fx, color1.g, color2.g);
-        pixel_buffer[pixBufIndex + 2] = interpolate_fx20_12_i32(gradient_pos_fx, color1.b, color2.b);
+        pixel_buffer[pixel->offset] = interpolate_fx20_12_i32(gradient_pos_fx, color1.r, color2.r);
+        pixel_buffer[pixel->offset + 1] = interpolate_fx20_12_i32(gradient_pos_fx, color1.g, color2.g);
+        pixel_buffer[pixel->offset + 2] = interpolate_fx20_12_i32(gradient_pos_fx, color1.b, color2.b);
     }
     taskEXIT_CRITICAL(pixel_buffer_lock);
     #endif
@@ -937,18 +1039,36 @@ void bitmap_generator_plasma_2(int64_t t, uint16_t speed, uint16_t scale, color_
 
 static float fft_bins[DISPLAY_FRAME_WIDTH_PIXEL] = { 0.0f };
 static int8_t fft_columns[DISPLAY_FRAME_WIDTH_PIXEL] = { 0 };
-void bitmap_generator_1bpp_mic_fft(int64_t t, uint8_t logarithmic, uint8_t lin_log_factor, uint8_t lineOnly, uint16_t minNormFactor, uint16_t maxNormFactor, uint16_t normFactorChangeIncrease, uint16_t normFactorChangeDecrease, uint8_t binWidth) {
+
+// How long the output stays inverted after a beat
+#define BEAT_INVERT_DURATION_US 100000
+
+#if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_1BPP)
+static int16_t _mic_level_to_pixels(float level, uint8_t minDb, uint8_t maxDb, int16_t height) {
+    if (maxDb <= minDb) return 0;
+    int16_t pixels = (int16_t)((level - minDb) * height / (maxDb - minDb));
+    if (pixels < 0) return 0;
+    if (pixels > height) return height;
+    return pixels;
+}
+#endif
+
+void bitmap_generator_1bpp_mic_fft(int64_t t, uint8_t logarithmic, uint8_t lin_log_factor, uint8_t lineOnly, uint16_t minNormFactor, uint16_t maxNormFactor, uint16_t normFactorChangeIncrease, uint16_t normFactorChangeDecrease, uint8_t binWidth, uint8_t minDb, uint8_t maxDb, uint8_t beatInvert) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_1BPP)
     if (binWidth == 0) binWidth = 1;
     uint16_t numBins = DISPLAY_FRAME_WIDTH_PIXEL / binWidth;
     i2s_mic_get_fft_bins(fft_bins, numBins, logarithmic, (float)lin_log_factor / 100.0f, minNormFactor * 0.1f, maxNormFactor * 0.1f, 1 / (normFactorChangeIncrease * 0.1f), 1 / (normFactorChangeDecrease * 0.1f));
 
+    uint8_t invert = 0;
+    if (beatInvert) {
+        i2s_mic_beat_t beat;
+        i2s_mic_get_beat(&beat);
+        invert = beat.count > 0 && esp_timer_get_time() - beat.time < BEAT_INVERT_DURATION_US;
+    }
+
     taskENTER_CRITICAL(pixel_buffer_lock);
-    uint8_t bass_count = 0;
     for (uint16_t binIdx = 0; binIdx < numBins; binIdx++) {
-        int8_t v = (uint8_t)((fft_bins[binIdx] - 130.0f) * (8 - 0) / (200.0f - 130.0f) + 0); // TODO: Get rid of magic numbers
-        if (v < 0) v = 0; // TODO: Adjust for display height
-        if (v > 8) v = 8; // TODO: Adjust for display height
+        int8_t v = _mic_level_to_pixels(fft_bins[binIdx], minDb, maxDb, 8); // TODO: Adjust for display height
         int8_t prev_col = fft_columns[binIdx];
         
         int8_t col = 0;
@@ -958,39 +1078,31 @@ void bitmap_generator_1bpp_mic_fft(int64_t t, uint8_t logarithmic, uint8_t lin_l
 
         for (uint8_t i = 0; i < binWidth; i++) {
             // TODO: Adjust for display height
+            uint8_t pixels;
             if (lineOnly) {
-                pixel_buffer[binIdx * binWidth + i] = (0x0100 >> (col)) & 0xFF;
+                pixels = (0x0100 >> (col)) & 0xFF;
             } else {
-                pixel_buffer[binIdx * binWidth + i] = (0xFF00 >> (col)) & 0xFF;
+                pixels = (0xFF00 >> (col)) & 0xFF;
             }
-        }
-
-        // TODO: Replace this fucked up shit with actual beat detection or something
-        // It counts amplitudes in a specific area
-        if (binIdx < 8) {
-            // Max. count: 8 * 2 = 16
-            if (col >= 7) bass_count += col - 6;
+            pixel_buffer[binIdx * binWidth + i] = invert ? ~pixels : pixels;
         }
     }
-    // TODO: NO no no no no CRUDE BAD aaa
-    // Stop indicator kinda mirrors bass level
-    gpio_set(23, (bass_count >= 4), 0);
     taskEXIT_CRITICAL(pixel_buffer_lock);
     #endif
 }
 
 static uint16_t amplitude_history[DISPLAY_FRAME_WIDTH_PIXEL] = { 0 };
 static uint16_t amplitude_history_start = 0;
-void bitmap_generator_1bpp_mic_amplitude(int64_t t, uint16_t minNormFactor, uint16_t maxNormFactor, uint16_t normFactorChangeIncrease, uint16_t normFactorChangeDecrease) {
+void bitmap_generator_1bpp_mic_amplitude(int64_t t, uint16_t minNormFactor, uint16_t maxNormFactor, uint16_t normFactorChangeIncrease, uint16_t normFactorChangeDecrease, uint8_t minDb, uint8_t maxDb) {
     #if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_1BPP)
     uint16_t numBins = 10;
     i2s_mic_get_fft_bins(fft_bins, numBins, false, 0.5f, minNormFactor * 0.1f, maxNormFactor * 0.1f, 1 / (normFactorChangeIncrease * 0.1f), 1 / (normFactorChangeDecrease * 0.1f));
-    int32_t amplitude = 0;
+    float amplitude = 0;
     for (uint8_t i = 0; i < numBins; i++) {
         amplitude += fft_bins[i];
     }
     amplitude /= numBins;
-    uint16_t amplitudePixels = (uint16_t)(amplitude - 130.0f) * DISPLAY_FRAME_HEIGHT_PIXEL / (200.0f - 130.0f); // TODO: Get rid of magic numbers
+    uint16_t amplitudePixels = _mic_level_to_pixels(amplitude, minDb, maxDb, DISPLAY_FRAME_HEIGHT_PIXEL);
     amplitude_history[amplitude_history_start++] = amplitudePixels;
     amplitude_history_start %= DISPLAY_FRAME_WIDTH_PIXEL;
 
@@ -1235,7 +1347,14 @@ void bitmap_generator_current(int64_t t) {
             cJSON* bin_width_field = cJSON_GetObjectItem(params, "bin_width");
             if (!cJSON_IsNumber(bin_width_field)) return;
             uint8_t bin_width = (uint8_t)cJSON_GetNumberValue(bin_width_field);
-            bitmap_generator_1bpp_mic_fft(t, logarithmic, lin_log_factor, line_only, min_norm_factor, max_norm_factor, norm_factor_increase, norm_factor_decrease, bin_width);
+            // Added later, so fall back to the previous fixed values
+            cJSON* min_db_field = cJSON_GetObjectItem(params, "min_db");
+            uint8_t min_db = cJSON_IsNumber(min_db_field) ? (uint8_t)cJSON_GetNumberValue(min_db_field) : 130;
+            cJSON* max_db_field = cJSON_GetObjectItem(params, "max_db");
+            uint8_t max_db = cJSON_IsNumber(max_db_field) ? (uint8_t)cJSON_GetNumberValue(max_db_field) : 200;
+            cJSON* beat_invert_field = cJSON_GetObjectItem(params, "beat_invert");
+            uint8_t beat_invert = (uint8_t)cJSON_IsTrue(beat_invert_field);
+            bitmap_generator_1bpp_mic_fft(t, logarithmic, lin_log_factor, line_only, min_norm_factor, max_norm_factor, norm_factor_increase, norm_factor_decrease, bin_width, min_db, max_db, beat_invert);
             return;
         }
 
@@ -1252,7 +1371,11 @@ void bitmap_generator_current(int64_t t) {
             cJSON* norm_factor_decrease_field = cJSON_GetObjectItem(params, "norm_factor_decrease");
             if (!cJSON_IsNumber(norm_factor_decrease_field)) return;
             uint16_t norm_factor_decrease = (uint16_t)cJSON_GetNumberValue(norm_factor_decrease_field);
-            bitmap_generator_1bpp_mic_amplitude(t, min_norm_factor, max_norm_factor, norm_factor_increase, norm_factor_decrease);
+            cJSON* min_db_field = cJSON_GetObjectItem(params, "min_db");
+            uint8_t min_db = cJSON_IsNumber(min_db_field) ? (uint8_t)cJSON_GetNumberValue(min_db_field) : 130;
+            cJSON* max_db_field = cJSON_GetObjectItem(params, "max_db");
+            uint8_t max_db = cJSON_IsNumber(max_db_field) ? (uint8_t)cJSON_GetNumberValue(max_db_field) : 200;
+            bitmap_generator_1bpp_mic_amplitude(t, min_norm_factor, max_norm_factor, norm_factor_increase, norm_factor_decrease, min_db, max_db);
             return;
         }
     }
@@ -2,11 +2,12 @@
 #include "esp_netif.h"
 #include <string.h>
 #include "sys/param.h"
-#include "mbedtls/base64.h"
+#include <stdio.h>
 
 #include "macros.h"
 #include "browser_canvas.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_httpd.h"
 #include "util_nvs.h"
 #include "settings_secret.h"
@@ -33,7 +34,6 @@
 #define LOG_TAG "Canvas"
 
 static httpd_handle_t* canvas_server;
-static nvs_handle_t canvas_nvs_handle;
 static basic_auth_info_t* basic_auth_info;
 static uint8_t canvas_use_auth = 0;
 static uint8_t* canvas_pixel_buffer = NULL;
@@ -76,21 +76,118 @@ static uint8_t* bitmap_generator_data_deletable = NULL;
 static cJSON* canvas_presets = NULL;
 
 // Embedded files - refer to CMakeLists.txt
-extern const uint8_t browser_canvas_html_start[] asm("_binary_browser_canvas_html_start");
-extern const uint8_t browser_canvas_html_end[]   asm("_binary_browser_canvas_html_end");
+extern const uint8_t browser_canvas_html_gz_start[] asm("_binary_browser_canvas_html_gz_start");
+extern const uint8_t browser_canvas_html_gz_end[]   asm("_binary_browser_canvas_html_gz_end");
 
 
 static esp_err_t canvas_get_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
 
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, (const char *)browser_canvas_html_start, browser_canvas_html_end - browser_canvas_html_start);
+    return httpd_send_asset(req, "text/html", browser_canvas_html_gz_start, browser_canvas_html_gz_end, true);
+}
+
+#if defined(DISPLAY_HAS_PIXEL_BUFFER)
+// Optional header for raw pixel buffer uploads, "x,y,w,h" in the same units as CANVAS_WS_RECT
+#define CANVAS_RECT_HEADER "X-Canvas-Rect"
+
+static void canvas_rect_write(uint16_t x, uint16_t y, uint16_t h, size_t pos, const uint8_t* src, size_t len) {
+    /*
+     * Copy len bytes of rectangle data, starting pos bytes into the rectangle, to the pixel buffer.
+     * Rectangle data is ordered column by column just like the buffer, h bytes per column.
+     */
+    while (len > 0) {
+        size_t col = pos / h;
+        size_t row = pos % h;
+        size_t n = MIN(len, h - row);
+        memcpy(&canvas_pixel_buffer[(x + col) * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y + row], src, n);
+        pos += n;
+        src += n;
+        len -= n;
+    }
+}
+
+static esp_err_t canvas_rect_post(httpd_req_t *req) {
+    char hdr[32];
+    uint16_t x, y, w, h;
+    if (httpd_req_get_hdr_value_str(req, CANVAS_RECT_HEADER, hdr, sizeof(hdr)) != ESP_OK) return abortRequest(req, HTTPD_400);
+    if (sscanf(hdr, "%hu,%hu,%hu,%hu", &x, &y, &w, &h) != 4) return abortRequest(req, HTTPD_400);
+    if (x + w > DISPLAY_FRAME_WIDTH_PIXEL || y + h > DISPLAY_FRAME_HEIGHT_PIXEL_BYTES) return abortRequest(req, HTTPD_400);
+    if (req->content_len != (size_t)w * h) return abortRequest(req, HTTPD_400);
+    // Rectangles are small, so only uncompressed bodies are supported
+    if (httpd_req_get_hdr_value_len(req, "Content-Encoding") > 0) return abortRequest(req, HTTPD_400);
+
+    uint8_t recv_buf[512];
+    size_t pos = 0;
+    while (pos < req->content_len) {
+        int ret = httpd_req_recv(req, (char*)recv_buf, MIN(req->content_len - pos, sizeof(recv_buf)));
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
+                continue;
+            }
+            ESP_LOGI(LOG_TAG, "Receive error, aborting");
+            return abortRequest(req, HTTPD_500);
+        }
+        taskENTER_CRITICAL(canvas_pixel_buffer_lock);
+        canvas_rect_write(x, y, h, pos, recv_buf, ret);
+        taskEXIT_CRITICAL(canvas_pixel_buffer_lock);
+        pos += ret;
+    }
+
+    // End response
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+#endif
+
+static esp_err_t canvas_buffer_post(httpd_req_t *req, uint8_t* buf, size_t size, portMUX_TYPE* lock, uint8_t isText) {
+    /*
+     * Common part of the buffer POST handlers.
+     * application/octet-stream bodies are received straight into the buffer
+     * (or via a staging buffer if they are compressed),
+     * anything else is base64 and decoded into a staging buffer first.
+     */
+    size_t rxLen = 0;
+    esp_err_t ret;
+
+    if (buf == NULL) return abortRequest(req, HTTPD_404);
+    ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
+
+    if (httpd_req_is_raw(req)) {
+        #if defined(DISPLAY_HAS_PIXEL_BUFFER)
+        if (buf == canvas_pixel_buffer && httpd_req_get_hdr_value_len(req, CANVAS_RECT_HEADER) > 0) return canvas_rect_post(req);
+        #endif
+        ret = httpd_recv_to_buffer(LOG_TAG, req, buf, size, lock, &rxLen);
+    } else {
+        ret = httpd_recv_base64_to_buffer(LOG_TAG, req, buf, size, lock, &rxLen);
+    }
+
+    if (ret == ESP_ERR_INVALID_SIZE) {
+        ESP_LOGI(LOG_TAG, "Request body too large for buffer");
+        return abortRequest(req, HTTPD_400);
+    } else if (ret == ESP_ERR_INVALID_ARG) {
+        ESP_LOGI(LOG_TAG, "Invalid or truncated request body encoding");
+        return abortRequest(req, HTTPD_400);
+    } else if (ret != ESP_OK) {
+        return abortRequest(req, HTTPD_500);
+    }
+
+    // Shorter text ends the string
+    if (isText && rxLen < size) buf[rxLen] = 0;
+
+    // End response
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
 static esp_err_t canvas_pixel_buffer_get_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
 
+    if (httpd_req_accepts_raw(req)) {
+        if (canvas_pixel_buffer == NULL) return abortRequest(req, HTTPD_404);
+        return httpd_send_buffer(LOG_TAG, req, canvas_pixel_buffer, canvas_pixel_buffer_size, canvas_pixel_buffer_lock);
+    }
+
     unsigned char* b64_buf = NULL;
     esp_err_t ret = buffer_to_base64(canvas_pixel_buffer, canvas_pixel_buffer_size, &b64_buf);
 
@@ -108,6 +205,11 @@ static esp_err_t canvas_pixel_buffer_get_handler(httpd_req_t *req) {
 static esp_err_t canvas_text_buffer_get_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
     
+    if (httpd_req_accepts_raw(req)) {
+        if (canvas_text_buffer == NULL) return abortRequest(req, HTTPD_404);
+        return httpd_send_buffer(LOG_TAG, req, canvas_text_buffer, canvas_text_buffer_size, canvas_text_buffer_lock);
+    }
+
     unsigned char* b64_buf = NULL;
     esp_err_t ret = buffer_to_base64(canvas_text_buffer, canvas_text_buffer_size, &b64_buf);
 
@@ -125,6 +227,11 @@ static esp_err_t canvas_text_buffer_get_handler(httpd_req_t *req) {
 static esp_err_t canvas_unit_buffer_get_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
     
+    if (httpd_req_accepts_raw(req)) {
+        if (canvas_unit_buffer == NULL) return abortRequest(req, HTTPD_404);
+        return httpd_send_buffer(LOG_TAG, req, canvas_unit_buffer, canvas_unit_buffer_size, canvas_unit_buffer_lock);
+    }
+
     unsigned char* b64_buf = NULL;
     esp_err_t ret = buffer_to_base64(canvas_unit_buffer, canvas_unit_buffer_size, &b64_buf);
 
@@ -142,6 +249,11 @@ static esp_err_t canvas_unit_buffer_get_handler(httpd_req_t *req) {
 static esp_err_t canvas_line_flags_buffer_get_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
     
+    if (httpd_req_accepts_raw(req)) {
+        if (canvas_line_flags_buffer == NULL) return abortRequest(req, HTTPD_404);
+        return httpd_send_buffer(LOG_TAG, req, canvas_line_flags_buffer, canvas_line_flags_buffer_size, canvas_line_flags_buffer_lock);
+    }
+
     unsigned char* b64_buf = NULL;
     esp_err_t ret = buffer_to_base64(canvas_line_flags_buffer, canvas_line_flags_buffer_size, &b64_buf);
 
@@ -158,203 +270,348 @@ static esp_err_t canvas_line_flags_buffer_get_handler(httpd_req_t *req) {
 
 static esp_err_t canvas_pixel_buffer_post_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
-    
-    if (canvas_pixel_buffer == NULL) return abortRequest(req, HTTPD_404);
 
-    ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
-    char* buf = malloc(req->content_len + 1);
-    int bytesRead = 0;
-    while (bytesRead < req->content_len) {
-        int ret = httpd_req_recv(req, &buf[bytesRead], req->content_len - bytesRead);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
-                continue;
-            }
-            ESP_LOGI(LOG_TAG, "Receive error, aborting");
-            return abortRequest(req, HTTPD_500);
-        }
-        bytesRead += ret;
-    }
-    buf[req->content_len] = 0;
-
-    size_t b64_len = 0;
-    size_t buffer_str_len = strlen(buf);
-    unsigned char* buffer_str_uchar = (unsigned char*)buf;
-    int result = mbedtls_base64_decode(NULL, 0, &b64_len, buffer_str_uchar, buffer_str_len);
-    if (result == MBEDTLS_ERR_BASE64_INVALID_CHARACTER) {
-        // We don't cover MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL here
-        // because this will always be returned when checking size
-        free(buf);
-        return abortRequest(req, HTTPD_500);
-    } else {
-        b64_len = 0;
-        taskENTER_CRITICAL(canvas_pixel_buffer_lock);
-        result = mbedtls_base64_decode(canvas_pixel_buffer, canvas_pixel_buffer_size, &b64_len, buffer_str_uchar, buffer_str_len);
-        taskEXIT_CRITICAL(canvas_pixel_buffer_lock);
-        if (result != 0) {
-            free(buf);
-            ESP_LOGI(LOG_TAG, "result != 0");
-            return abortRequest(req, HTTPD_500);
-        }
-    }
+    return canvas_buffer_post(req, canvas_pixel_buffer, canvas_pixel_buffer_size, canvas_pixel_buffer_lock, 0);
+}
 
-    free(buf);
+static esp_err_t canvas_text_buffer_post_handler(httpd_req_t *req) {
+    if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
 
-    // End response
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    return canvas_buffer_post(req, canvas_text_buffer, canvas_text_buffer_size, canvas_text_buffer_lock, 1);
 }
 
-static esp_err_t canvas_text_buffer_post_handler(httpd_req_t *req) {
+static esp_err_t canvas_unit_buffer_post_handler(httpd_req_t *req) {
     if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
-    
-    if (canvas_text_buffer == NULL) return abortRequest(req, HTTPD_404);
 
-    ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
-    char* buf = malloc(req->content_len + 1);
-    int bytesRead = 0;
-    while (bytesRead < req->content_len) {
-        int ret = httpd_req_recv(req, &buf[bytesRead], req->content_len - bytesRead);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
-                continue;
-            }
-            ESP_LOGI(LOG_TAG, "Receive error, aborting");
-            free(buf);
-            return abortRequest(req, HTTPD_500);
-        }
-        bytesRead += ret;
+    return canvas_buffer_post(req, canvas_unit_buffer, canvas_unit_buffer_size, canvas_unit_buffer_lock, 0);
+}
+
+static esp_err_t canvas_line_flags_buffer_post_handler(httpd_req_t *req) {
+    if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
+
+    return canvas_buffer_post(req, canvas_line_flags_buffer, canvas_line_flags_buffer_size, canvas_line_flags_buffer_lock, 0);
+}
+
+#if defined(CONFIG_HTTPD_WS_SUPPORT)
+/*
+ * Live frame WebSocket on /canvas/ws
+ *
+ * All messages are binary, multi-byte values are little endian.
+ * Every message starts with [type:u8][buffer:u8], buffer being one of CANVAS_WS_BUF_*.
+ *
+ * CANVAS_WS_FULL       [data]                          Whole buffer, starting at offset 0
+ * CANVAS_WS_RANGE      [offset:u32][data]              Byte range within the buffer
+ * CANVAS_WS_RECT       [x:u16][y:u16][w:u16][h:u16][data]
+ *                      Rectangle of the pixel buffer. x and w count columns,
+ *                      y and h count bytes within a column (DISPLAY_FRAME_HEIGHT_PIXEL_BYTES),
+ *                      data is ordered column by column just like the buffer.
+ * CANVAS_WS_SUBSCRIBE  [mask:u8]                       Buffer field is ignored. Bit n set means
+ *                                                      buffer n is pushed back to the client.
+ *
+ * After every display refresh, subscribed buffers whose content has changed
+ * are sent back to the client as CANVAS_WS_FULL messages.
+ */
+
+#define CANVAS_WS_FULL 0x00
+#define CANVAS_WS_RANGE 0x01
+#define CANVAS_WS_RECT 0x02
+#define CANVAS_WS_SUBSCRIBE 0x10
+
+#define CANVAS_WS_BUF_PIXEL 0
+#define CANVAS_WS_BUF_TEXT 1
+#define CANVAS_WS_BUF_UNIT 2
+#define CANVAS_WS_BUF_LINE_FLAGS 3
+#define CANVAS_WS_NUM_BUFS 4
+
+#define CANVAS_WS_HEADER_SIZE 2
+#define CANVAS_WS_MAX_HEADER_SIZE 10
+#define CANVAS_WS_MAX_CLIENTS 4
+
+typedef struct {
+    int fd;
+    uint8_t subscriptions;
+    uint8_t pending; // Buffers to be sent even if unchanged, e.g. after subscribing
+} canvas_ws_client_t;
+
+static httpd_handle_t canvas_ws_server = NULL;
+static canvas_ws_client_t canvas_ws_clients[CANVAS_WS_MAX_CLIENTS];
+static uint8_t* canvas_ws_rx_buffer = NULL;
+static size_t canvas_ws_rx_buffer_size = 0;
+// Last state sent to clients, prefixed with a CANVAS_WS_FULL header so it can be sent as-is
+static uint8_t* canvas_ws_shown[CANVAS_WS_NUM_BUFS] = {NULL};
+static volatile uint8_t canvas_ws_subscribed = 0;
+static volatile uint8_t canvas_ws_push_queued = 0;
+
+static uint8_t canvas_ws_get_buffer(uint8_t id, uint8_t** buf, size_t* size, portMUX_TYPE** lock) {
+    switch (id) {
+        case CANVAS_WS_BUF_PIXEL:
+            *buf = canvas_pixel_buffer;
+            *size = canvas_pixel_buffer_size;
+            *lock = canvas_pixel_buffer_lock;
+            break;
+        case CANVAS_WS_BUF_TEXT:
+            *buf = canvas_text_buffer;
+            *size = canvas_text_buffer_size;
+            *lock = canvas_text_buffer_lock;
+            break;
+        case CANVAS_WS_BUF_UNIT:
+            *buf = canvas_unit_buffer;
+            *size = canvas_unit_buffer_size;
+            *lock = canvas_unit_buffer_lock;
+            break;
+        case CANVAS_WS_BUF_LINE_FLAGS:
+            *buf = canvas_line_flags_buffer;
+            *size = canvas_line_flags_buffer_size;
+            *lock = canvas_line_flags_buffer_lock;
+            break;
+        default:
+            return 0;
     }
-    buf[req->content_len] = 0;
-
-    size_t b64_len = 0;
-    size_t buffer_str_len = strlen(buf);
-    unsigned char* buffer_str_uchar = (unsigned char*)buf;
-    int result = mbedtls_base64_decode(NULL, 0, &b64_len, buffer_str_uchar, buffer_str_len);
-    if (result == MBEDTLS_ERR_BASE64_INVALID_CHARACTER) {
-        // We don't cover MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL here
-        // because this will always be returned when checking size
-        free(buf);
-        return abortRequest(req, HTTPD_500);
-    } else {
-        b64_len = 0;
-        taskENTER_CRITICAL(canvas_text_buffer_lock);
-        result = mbedtls_base64_decode(canvas_text_buffer, canvas_text_buffer_size, &b64_len, buffer_str_uchar, buffer_str_len);
-        taskEXIT_CRITICAL(canvas_text_buffer_lock);
-        if (b64_len < canvas_text_buffer_size) canvas_text_buffer[b64_len] = 0; // Ensure null termination
-        if (result != 0) {
-            ESP_LOGI(LOG_TAG, "result != 0");
-            free(buf);
-            return abortRequest(req, HTTPD_500);
-        }
+    return *buf != NULL;
+}
+
+static canvas_ws_client_t* canvas_ws_find_client(int fd) {
+    for (uint8_t i = 0; i < CANVAS_WS_MAX_CLIENTS; i++) {
+        if (canvas_ws_clients[i].fd == fd) return &canvas_ws_clients[i];
     }
+    return NULL;
+}
 
-    free(buf);
+static void canvas_ws_update_subscribed(void) {
+    uint8_t subscribed = 0;
+    for (uint8_t i = 0; i < CANVAS_WS_MAX_CLIENTS; i++) {
+        if (canvas_ws_clients[i].fd >= 0) subscribed |= canvas_ws_clients[i].subscriptions;
+    }
+    canvas_ws_subscribed = subscribed;
+}
 
-    // End response
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+static void canvas_ws_remove_client(int fd) {
+    canvas_ws_client_t* client = canvas_ws_find_client(fd);
+    if (client == NULL) return;
+    ESP_LOGI(LOG_TAG, "WebSocket client %d disconnected", fd);
+    client->fd = -1;
+    client->subscriptions = 0;
+    client->pending = 0;
+    canvas_ws_update_subscribed();
 }
 
-static esp_err_t canvas_unit_buffer_post_handler(httpd_req_t *req) {
-    if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
-    
-    if (canvas_unit_buffer == NULL) return abortRequest(req, HTTPD_404);
+static void canvas_ws_prune_clients(void) {
+    /*
+     * Tabs that are closed or lose their connection often don't send a CLOSE frame,
+     * so release every slot whose socket is no longer an open WebSocket
+     */
+    for (uint8_t i = 0; i < CANVAS_WS_MAX_CLIENTS; i++) {
+        int fd = canvas_ws_clients[i].fd;
+        if (fd < 0) continue;
+        if (httpd_ws_get_fd_info(canvas_ws_server, fd) != HTTPD_WS_CLIENT_WEBSOCKET) canvas_ws_remove_client(fd);
+    }
+}
 
-    ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
-    char* buf = malloc(req->content_len + 1);
-    int bytesRead = 0;
-    while (bytesRead < req->content_len) {
-        int ret = httpd_req_recv(req, &buf[bytesRead], req->content_len - bytesRead);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
+#if defined(DISPLAY_HAS_PIXEL_BUFFER)
+static uint16_t canvas_ws_get_u16(uint8_t* buf) {
+    return buf[0] | (buf[1] << 8);
+}
+#endif
+
+static uint32_t canvas_ws_get_u32(uint8_t* buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static esp_err_t canvas_ws_subscribe(int fd, uint8_t mask) {
+    canvas_ws_client_t* client = canvas_ws_find_client(fd);
+    if (client == NULL) return ESP_FAIL;
+
+    for (uint8_t id = 0; id < CANVAS_WS_NUM_BUFS; id++) {
+        if (!(mask & (1 << id))) continue;
+        uint8_t* buf;
+        size_t size;
+        portMUX_TYPE* lock;
+        if (!canvas_ws_get_buffer(id, &buf, &size, &lock)) {
+            mask &= ~(1 << id);
+            continue;
+        }
+        // Allocated once on first use and kept for the lifetime of the canvas
+        if (canvas_ws_shown[id] == NULL) {
+            canvas_ws_shown[id] = calloc(1, size + CANVAS_WS_HEADER_SIZE);
+            if (canvas_ws_shown[id] == NULL) {
+                ESP_LOGE(LOG_TAG, "Failed to allocate WebSocket buffer %u", id);
+                mask &= ~(1 << id);
                 continue;
             }
-            ESP_LOGI(LOG_TAG, "Receive error, aborting");
-            return abortRequest(req, HTTPD_500);
+            canvas_ws_shown[id][0] = CANVAS_WS_FULL;
+            canvas_ws_shown[id][1] = id;
         }
-        bytesRead += ret;
     }
-    buf[req->content_len] = 0;
-
-    size_t b64_len = 0;
-    size_t buffer_str_len = strlen(buf);
-    unsigned char* buffer_str_uchar = (unsigned char*)buf;
-    int result = mbedtls_base64_decode(NULL, 0, &b64_len, buffer_str_uchar, buffer_str_len);
-    if (result == MBEDTLS_ERR_BASE64_INVALID_CHARACTER) {
-        // We don't cover MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL here
-        // because this will always be returned when checking size
-        free(buf);
-        return abortRequest(req, HTTPD_500);
-    } else {
-        b64_len = 0;
-        taskENTER_CRITICAL(canvas_unit_buffer_lock);
-        result = mbedtls_base64_decode(canvas_unit_buffer, canvas_unit_buffer_size, &b64_len, buffer_str_uchar, buffer_str_len);
-        taskEXIT_CRITICAL(canvas_unit_buffer_lock);
-        if (result != 0) {
-            free(buf);
-            return abortRequest(req, HTTPD_500);
-        }
-    }
-
-    free(buf);
 
-    // End response
-    httpd_resp_send_chunk(req, NULL, 0);
+    client->pending |= mask & ~client->subscriptions;
+    client->subscriptions = mask;
+    canvas_ws_update_subscribed();
     return ESP_OK;
 }
 
-static esp_err_t canvas_line_flags_buffer_post_handler(httpd_req_t *req) {
-    if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_OK;
-    
-    if (canvas_line_flags_buffer == NULL) return abortRequest(req, HTTPD_404);
+static esp_err_t canvas_ws_apply(int fd, uint8_t* msg, size_t len) {
+    if (len < CANVAS_WS_HEADER_SIZE) return ESP_ERR_INVALID_SIZE;
+    uint8_t type = msg[0];
 
-    ESP_LOGD(LOG_TAG, "Content length: %d bytes", req->content_len);
-    char* buf = malloc(req->content_len + 1);
-    int bytesRead = 0;
-    while (bytesRead < req->content_len) {
-        int ret = httpd_req_recv(req, &buf[bytesRead], req->content_len - bytesRead);
-        if (ret <= 0) {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
-                ESP_LOGI(LOG_TAG, "Socket timeout, continuing");
+    if (type == CANVAS_WS_SUBSCRIBE) {
+        if (len < CANVAS_WS_HEADER_SIZE + 1) return ESP_ERR_INVALID_SIZE;
+        return canvas_ws_subscribe(fd, msg[2]);
+    }
+
+    uint8_t* buf;
+    size_t size;
+    portMUX_TYPE* lock;
+    if (!canvas_ws_get_buffer(msg[1], &buf, &size, &lock)) return ESP_ERR_NOT_FOUND;
+
+    switch (type) {
+        case CANVAS_WS_FULL: {
+            size_t dataLen = len - CANVAS_WS_HEADER_SIZE;
+            if (dataLen > size) return ESP_ERR_INVALID_SIZE;
+            taskENTER_CRITICAL(lock);
+            memcpy(buf, &msg[CANVAS_WS_HEADER_SIZE], dataLen);
+            // Same as the POST handler: shorter text ends the string
+            if (msg[1] == CANVAS_WS_BUF_TEXT && dataLen < size) buf[dataLen] = 0;
+            taskEXIT_CRITICAL(lock);
+            return ESP_OK;
+        }
+
+        case CANVAS_WS_RANGE: {
+            if (len < CANVAS_WS_HEADER_SIZE + 4) return ESP_ERR_INVALID_SIZE;
+            uint32_t offset = canvas_ws_get_u32(&msg[2]);
+            size_t dataLen = len - CANVAS_WS_HEADER_SIZE - 4;
+            if (offset > size || dataLen > size - offset) return ESP_ERR_INVALID_SIZE;
+            taskENTER_CRITICAL(lock);
+            memcpy(&buf[offset], &msg[CANVAS_WS_HEADER_SIZE + 4], dataLen);
+            taskEXIT_CRITICAL(lock);
+            return ESP_OK;
+        }
+
+        #if defined(DISPLAY_HAS_PIXEL_BUFFER)
+        case CANVAS_WS_RECT: {
+            if (msg[1] != CANVAS_WS_BUF_PIXEL) return ESP_ERR_NOT_SUPPORTED;
+            if (len < CANVAS_WS_HEADER_SIZE + 8) return ESP_ERR_INVALID_SIZE;
+            uint16_t x = canvas_ws_get_u16(&msg[2]);
+            uint16_t y = canvas_ws_get_u16(&msg[4]);
+            uint16_t w = canvas_ws_get_u16(&msg[6]);
+            uint16_t h = canvas_ws_get_u16(&msg[8]);
+            if (x + w > DISPLAY_FRAME_WIDTH_PIXEL || y + h > DISPLAY_FRAME_HEIGHT_PIXEL_BYTES) return ESP_ERR_INVALID_ARG;
+            if (len - CANVAS_WS_HEADER_SIZE - 8 != (size_t)w * h) return ESP_ERR_INVALID_SIZE;
+            taskENTER_CRITICAL(lock);
+            canvas_rect_write(x, y, h, 0, &msg[CANVAS_WS_HEADER_SIZE + 8], (size_t)w * h);
+            taskEXIT_CRITICAL(lock);
+            return ESP_OK;
+        }
+        #endif
+
+        default:
+            return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+static void canvas_ws_push_work(void* arg) {
+    canvas_ws_push_queued = 0;
+
+    for (uint8_t id = 0; id < CANVAS_WS_NUM_BUFS; id++) {
+        if (!(canvas_ws_subscribed & (1 << id))) continue;
+        uint8_t* buf;
+        size_t size;
+        portMUX_TYPE* lock;
+        if (!canvas_ws_get_buffer(id, &buf, &size, &lock)) continue;
+        if (canvas_ws_shown[id] == NULL) continue;
+
+        uint8_t* shown = &canvas_ws_shown[id][CANVAS_WS_HEADER_SIZE];
+        uint8_t changed = 0;
+        taskENTER_CRITICAL(lock);
+        if (memcmp(shown, buf, size)) {
+            memcpy(shown, buf, size);
+            changed = 1;
+        }
+        taskEXIT_CRITICAL(lock);
+
+        httpd_ws_frame_t frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_BINARY,
+            .payload = canvas_ws_shown[id],
+            .len = size + CANVAS_WS_HEADER_SIZE
+        };
+
+        for (uint8_t i = 0; i < CANVAS_WS_MAX_CLIENTS; i++) {
+            canvas_ws_client_t* client = &canvas_ws_clients[i];
+            if (client->fd < 0 || !(client->subscriptions & (1 << id))) continue;
+            if (!changed && !(client->pending & (1 << id))) continue;
+            if (httpd_ws_get_fd_info(canvas_ws_server, client->fd) != HTTPD_WS_CLIENT_WEBSOCKET ||
+                httpd_ws_send_frame_async(canvas_ws_server, client->fd, &frame) != ESP_OK) {
+                canvas_ws_remove_client(client->fd);
                 continue;
             }
-            ESP_LOGI(LOG_TAG, "Receive error, aborting");
-            return abortRequest(req, HTTPD_500);
+            client->pending &= ~(1 << id);
         }
-        bytesRead += ret;
     }
-    buf[req->content_len] = 0;
-
-    size_t b64_len = 0;
-    size_t buffer_str_len = strlen(buf);
-    unsigned char* buffer_str_uchar = (unsigned char*)buf;
-    int result = mbedtls_base64_decode(NULL, 0, &b64_len, buffer_str_uchar, buffer_str_len);
-    if (result == MBEDTLS_ERR_BASE64_INVALID_CHARACTER) {
-        // We don't cover MBEDTLS_ERR_BASE64_BUFFER_TOO_SMALL here
-        // because this will always be returned when checking size
-        free(buf);
-        return abortRequest(req, HTTPD_500);
-    } else {
-        b64_len = 0;
-        taskENTER_CRITICAL(canvas_line_flags_buffer_lock);
-        result = mbedtls_base64_decode(canvas_line_flags_buffer, canvas_line_flags_buffer_size, &b64_len, buffer_str_uchar, buffer_str_len);
-        taskEXIT_CRITICAL(canvas_line_flags_buffer_lock);
-        if (result != 0) {
-            free(buf);
-            return abortRequest(req, HTTPD_500);
+}
+
+void browser_canvas_notify_frame(void) {
+    // Called from the display refresh task, the actual work happens in the HTTP server task
+    if (canvas_ws_server == NULL || !canvas_ws_subscribed || canvas_ws_push_queued) return;
+    canvas_ws_push_queued = 1;
+    if (httpd_queue_work(canvas_ws_server, canvas_ws_push_work, NULL) != ESP_OK) canvas_ws_push_queued = 0;
+}
+
+static esp_err_t canvas_ws_handler(httpd_req_t *req) {
+    int fd = httpd_req_to_sockfd(req);
+
+    if (req->method == HTTP_GET) {
+        // Handshake
+        if (canvas_use_auth) if (!basic_auth_handler(req, LOG_TAG)) return ESP_FAIL;
+        // The socket may reuse the number of a connection that went away unnoticed
+        canvas_ws_remove_client(fd);
+        canvas_ws_prune_clients();
+        canvas_ws_client_t* client = canvas_ws_find_client(-1);
+        if (client == NULL) {
+            ESP_LOGW(LOG_TAG, "Too many WebSocket clients");
+            return ESP_FAIL;
         }
+        client->fd = fd;
+        client->subscriptions = 0;
+        client->pending = 0;
+        ESP_LOGI(LOG_TAG, "WebSocket client %d connected", fd);
+        return ESP_OK;
     }
 
-    free(buf);
+    httpd_ws_frame_t frame = {0};
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, 0);
+    if (ret != ESP_OK) {
+        canvas_ws_remove_client(fd);
+        return ret;
+    }
 
-    // End response
-    httpd_resp_send_chunk(req, NULL, 0);
+    if (frame.type == HTTPD_WS_TYPE_CLOSE) {
+        canvas_ws_remove_client(fd);
+        return ESP_OK;
+    }
+
+    if (frame.len > canvas_ws_rx_buffer_size) {
+        ESP_LOGW(LOG_TAG, "WebSocket frame too large: %u bytes", (unsigned int)frame.len);
+        canvas_ws_remove_client(fd);
+        return ESP_FAIL;
+    }
+
+    // Handlers all run in the HTTP server task, so a single receive buffer is enough
+    frame.payload = canvas_ws_rx_buffer;
+    ret = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (ret != ESP_OK) {
+        canvas_ws_remove_client(fd);
+        return ret;
+    }
+
+    if (frame.type != HTTPD_WS_TYPE_BINARY) return ESP_OK;
+
+    ret = canvas_ws_apply(fd, canvas_ws_rx_buffer, frame.len);
+    if (ret != ESP_OK) {
+        ESP_LOGW(LOG_TAG, "Invalid WebSocket message: %s", esp_err_to_name(ret));
+    }
     return ESP_OK;
 }
+#endif
 
 #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
 static esp_err_t canvas_brightness_get_handler(httpd_req_t *req) {
@@ -398,7 +655,9 @@ static esp_err_t canvas_brightness_post_handler(httpd_req_t *req) {
     cJSON* default_field = cJSON_GetObjectItem(json, "saveDefault");
     if (cJSON_IsBool(default_field)) {
         if (cJSON_IsTrue(default_field)) {
-            nvs_set_u8(canvas_nvs_handle, "deflt_bright", *canvas_brightness);
+            config_begin();
+            config_set_int("deflt_bright", *canvas_brightness);
+            if (config_commit() != ESP_OK) ESP_LOGE(LOG_TAG, "Failed to save default brightness");
         }
     }
 
@@ -771,7 +1030,7 @@ static esp_err_t save_startup_post_handler(httpd_req_t *req) {
 
     cJSON_AddItemToObject(startupData, "buffers", buffers_field);
 
-    char* startupFile = get_string_from_nvs(&canvas_nvs_handle, "startup_file");
+    char* startupFile = config_get_str_alloc("startup_file");
     if (startupFile == NULL || strlen(startupFile) == 0) {
         startupFile = "STARTUP.JSN";
         ESP_LOGI(LOG_TAG, "No startup file selected, using default startup file name: %s", startupFile);
@@ -849,6 +1108,15 @@ static httpd_uri_t canvas_line_flags_buffer_post = {
     .handler   = canvas_line_flags_buffer_post_handler
 };
 
+#if defined(CONFIG_HTTPD_WS_SUPPORT)
+static httpd_uri_t canvas_ws = {
+    .uri          = "/canvas/ws",
+    .method       = HTTP_GET,
+    .handler      = canvas_ws_handler,
+    .is_websocket = true
+};
+#endif
+
 #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
 static httpd_uri_t canvas_brightness_get = {
     .uri       = "/canvas/brightness.json",
@@ -957,7 +1225,6 @@ static const httpd_uri_t canvas_save_startup_post = {
 
 void browser_canvas_init(httpd_handle_t* server, nvs_handle_t* nvsHandle, uint8_t* pixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock, uint8_t* textBuf, size_t textBufSize, portMUX_TYPE* textBufLock, uint8_t* unitBuf, size_t unitBufSize, portMUX_TYPE* unitBufLock, uint8_t* lineFlagsBuf, size_t lineFlagsBufSize, portMUX_TYPE* lineFlagsBufLock) {
     ESP_LOGI(LOG_TAG, "Starting browser canvas");
-    canvas_nvs_handle = *nvsHandle;
     canvas_pixel_buffer = pixBuf;
     canvas_pixel_buffer_size = pixBufSize;
     canvas_pixel_buffer_lock = pixBufLock;
@@ -976,7 +1243,7 @@ void browser_canvas_init(httpd_handle_t* server, nvs_handle_t* nvsHandle, uint8_
     basic_auth_info->password = HTTPD_CONFIG_PASSWORD;
     basic_auth_info->realm    = "Cheetah Canvas";
 
-    esp_err_t ret = nvs_get_u8(canvas_nvs_handle, "canvas_use_auth", &canvas_use_auth);
+    esp_err_t ret = config_get_u8("canvas_use_auth", &canvas_use_auth);
     if (ret != ESP_OK) canvas_use_auth = 0;
 
     if (canvas_use_auth) {
@@ -1000,6 +1267,9 @@ void browser_canvas_init(httpd_handle_t* server, nvs_handle_t* nvsHandle, uint8_
         canvas_get_effects.user_ctx = basic_auth_info;
         canvas_get_bitmap_generators.user_ctx = basic_auth_info;
         canvas_get_presets.user_ctx = basic_auth_info;
+        #if defined(CONFIG_HTTPD_WS_SUPPORT)
+        canvas_ws.user_ctx = basic_auth_info;
+        #endif
         
         #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
         canvas_brightness_get.user_ctx = basic_auth_info;
@@ -1027,9 +1297,9 @@ void browser_canvas_init(httpd_handle_t* server, nvs_handle_t* nvsHandle, uint8_
         #endif
     }
 
-    char* presetFile = get_string_from_nvs(nvsHandle, "cnv_preset_file");
+    char* presetFile = config_get_str_alloc("cnv_preset_file");
     if (presetFile == NULL) {
-        ESP_LOGE(LOG_TAG, "Failed to get preset file name from NVS");
+        ESP_LOGE(LOG_TAG, "No preset file name set");
     } else {
         get_json_from_spiffs(presetFile, &canvas_presets, LOG_TAG);
     }
@@ -1050,6 +1320,20 @@ void browser_canvas_init(httpd_handle_t* server, nvs_handle_t* nvsHandle, uint8_
     httpd_register_uri_handler(*server, &canvas_get_bitmap_generators);
     httpd_register_uri_handler(*server, &canvas_get_presets);
     httpd_register_uri_handler(*server, &canvas_save_startup_post);
+
+    #if defined(CONFIG_HTTPD_WS_SUPPORT)
+    for (uint8_t i = 0; i < CANVAS_WS_MAX_CLIENTS; i++) {
+        canvas_ws_clients[i].fd = -1;
+    }
+    canvas_ws_rx_buffer_size = MAX(MAX(pixBufSize, textBufSize), MAX(unitBufSize, lineFlagsBufSize)) + CANVAS_WS_MAX_HEADER_SIZE;
+    canvas_ws_rx_buffer = malloc(canvas_ws_rx_buffer_size);
+    if (canvas_ws_rx_buffer == NULL) {
+        ESP_LOGE(LOG_TAG, "Failed to allocate WebSocket receive buffer");
+    } else {
+        canvas_ws_server = *server;
+        httpd_register_uri_handler(*server, &canvas_ws);
+    }
+    #endif
     canvas_server = server;
 }
 
@@ -1082,6 +1366,26 @@ void browser_canvas_stop(void) {
     httpd_unregister_uri_handler(*canvas_server, canvas_get_bitmap_generators.uri, canvas_get_bitmap_generators.method);
     httpd_unregister_uri_handler(*canvas_server, canvas_get_presets.uri, canvas_get_presets.method);
     httpd_unregister_uri_handler(*canvas_server, canvas_save_startup_post.uri, canvas_save_startup_post.method);
+
+    #if defined(CONFIG_HTTPD_WS_SUPPORT)
+    if (canvas_ws_server != NULL) {
+        httpd_unregister_uri_handler(*canvas_server, canvas_ws.uri, canvas_ws.method);
+        canvas_ws_server = NULL;
+    }
+    for (uint8_t i = 0; i < CANVAS_WS_MAX_CLIENTS; i++) {
+        canvas_ws_clients[i].fd = -1;
+        canvas_ws_clients[i].subscriptions = 0;
+        canvas_ws_clients[i].pending = 0;
+    }
+    canvas_ws_subscribed = 0;
+    for (uint8_t id = 0; id < CANVAS_WS_NUM_BUFS; id++) {
+        free(canvas_ws_shown[id]);
+        canvas_ws_shown[id] = NULL;
+    }
+    free(canvas_ws_rx_buffer);
+    canvas_ws_rx_buffer = NULL;
+    canvas_ws_rx_buffer_size = 0;
+    #endif
     #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
     canvas_brightness = NULL;
     httpd_unregister_uri_handler(*canvas_server, canvas_brightness_get.uri, canvas_brightness_get.method);
@@ -1113,7 +1417,7 @@ void browser_canvas_stop(void) {
 #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
 void browser_canvas_register_brightness(httpd_handle_t* server, uint8_t* brightness) {
     canvas_brightness = brightness;
-    esp_err_t ret = nvs_get_u8(canvas_nvs_handle, "deflt_bright", canvas_brightness);
+    esp_err_t ret = config_get_u8("deflt_bright", canvas_brightness);
     if (ret != ESP_OK) *canvas_brightness = 255;
     httpd_register_uri_handler(*server, &canvas_brightness_get);
     httpd_register_uri_handler(*server, &canvas_brightness_post);
@@ -6,6 +6,9 @@
 
 void browser_canvas_init(httpd_handle_t* server, nvs_handle_t* nvsHandle, uint8_t* pixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock, uint8_t* textBuf, size_t textBufSize, portMUX_TYPE* textBufLock, uint8_t* unitBuf, size_t unitBufSize, portMUX_TYPE* unitBufLock, uint8_t* lineFlagsBuf, size_t lineFlagsBufSize, portMUX_TYPE* lineFlagsBufLock);
 void browser_canvas_stop(void);
+#if defined(CONFIG_HTTPD_WS_SUPPORT)
+void browser_canvas_notify_frame(void);
+#endif
 #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
 void browser_canvas_register_brightness(httpd_handle_t* server, uint8_t* brightness);
 #endif
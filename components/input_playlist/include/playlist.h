@@ -3,6 +3,7 @@
 #include "esp_http_client.h"
 #include "nvs.h"
 #include "cJSON.h"
+#include <stdbool.h>
 
 
 typedef struct {
@@ -11,6 +12,7 @@ typedef struct {
     uint8_t* lineFlagsBuffer;
     uint8_t* unitBuffer;
     uint16_t duration;
+    uint16_t beats;             // Switch after this many beats, 0 = only by duration
     int16_t brightness;
     cJSON* shader;
     uint8_t updateShader;
@@ -42,6 +44,10 @@ void playlist_register_transitions(cJSON** transitionData, uint8_t* transitionDa
 void playlist_register_effects(cJSON** effectData, uint8_t* effectDataDeletable);
 void playlist_register_bitmap_generators(cJSON** bitmapGeneratorData, uint8_t* bitmapGeneratorDataDeletable);
 void playlist_update_config(void);
+void playlist_output_current();
+#if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+bool playlist_follow_leader(int64_t* nextSwitchTime);
+#endif
 void playlist_task(void* arg);
 void playlist_update_from_http();
 void playlist_update_from_file();
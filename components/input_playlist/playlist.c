@@ -7,8 +7,12 @@
 #include "mbedtls/base64.h"
 
 #include "playlist.h"
+#include "playlist_follow.h"
+#include "display_sync.h"
+#include "i2s_microphone.h"
 #include "macros.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_generic.h"
 #include "util_nvs.h"
 
@@ -19,7 +23,6 @@
 
 
 static TaskHandle_t pl_task_handle;
-static nvs_handle_t pl_nvs_handle;
 static char* pollUrl = NULL;
 static char* pollToken = NULL;
 static char* playlistFile = NULL;
@@ -31,6 +34,11 @@ static uint8_t playlistFileInited = 0;
 static uint8_t pollUrlValid = 0;
 static uint8_t pollTokenValid = 0;
 static uint8_t playlistFileValid = 0;
+// Cached from the configuration, so checking it doesn't cost anything
+static volatile uint8_t pl_active = 0;
+// Set when one of the polling settings changed, reloaded by the playlist task
+static volatile bool pl_config_changed = false;
+static bool pl_config_subscribed = false;
 
 // Dynamic array holding the current list of groups and buffers
 static pl_buffer_group_t* pl_groups = NULL;
@@ -45,6 +53,14 @@ static pl_mode_t pl_mode = PL_SEQUENTIAL;
 // Last switch / update times
 static uint64_t pl_last_switch = 0;
 static uint64_t pl_last_update = 0;
+// Beat count at the last switch, for entries that switch on beats
+static uint32_t pl_switch_beat = 0;
+static bool pl_beat_handler_registered = false;
+
+#if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+// Position of the leader's playlist we are following
+static pl_follow_t pl_follow = {0};
+#endif
 
 static uint8_t* pixel_buffer;
 static size_t pixel_buffer_size = 0;
@@ -174,9 +190,24 @@ esp_err_t playlist_http_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
+static void playlist_config_handler(const char* key, void* arg) {
+    if (strcmp(key, "playlist_active") == 0) {
+        uint8_t active;
+        if (config_get_u8(key, &active) != ESP_OK) active = 0;
+        pl_active = active;
+    } else if (strncmp(key, "pl", 2) == 0) {
+        // playlist_file and the pl_* polling settings are used by the playlist task, it reloads them itself
+        pl_config_changed = true;
+    }
+}
+
+static void playlist_beat_handler(const i2s_mic_beat_t* beat, void* arg) {
+    // Wake up the playlist task so entries can switch right on the beat
+    if (pl_task_handle != NULL) xTaskNotifyGive(pl_task_handle);
+}
+
 void playlist_init(nvs_handle_t* nvsHandle, uint8_t* pixBuf, size_t pixBufSize, portMUX_TYPE* pixBufLock, uint8_t* textBuf, size_t textBufSize, portMUX_TYPE* textBufLock, uint8_t* lineFlagsBuf, size_t lineFlagsBufSize, portMUX_TYPE* lineFlagsBufLock, uint8_t* unitBuf, size_t unitBufSize, portMUX_TYPE* unitBufLock) {
     ESP_LOGI(LOG_TAG, "Initializing playlist");
-    pl_nvs_handle = *nvsHandle;
     pixel_buffer = pixBuf;
     pixel_buffer_size = pixBufSize;
     pixel_buffer_lock = pixBufLock;
@@ -193,10 +224,17 @@ void playlist_init(nvs_handle_t* nvsHandle, uint8_t* pixBuf, size_t pixBufSize,
     playlist_deinit();
 
     playlist_update_config();
+    playlist_config_handler("playlist_active", NULL);
+    if (!pl_config_subscribed) {
+        pl_config_subscribed = (config_subscribe(NULL, playlist_config_handler, NULL) == ESP_OK);
+    }
 
     if (pollInterval != 0 && ((pollUrlValid && pollTokenValid) || playlistFileValid)) {
         ESP_LOGI(LOG_TAG, "Starting playlist task");
         xTaskCreatePinnedToCore(playlist_task, "playlist", 4096, NULL, 5, &pl_task_handle, 0);
+        if (!pl_beat_handler_registered) {
+            pl_beat_handler_registered = (i2s_mic_register_beat_handler(playlist_beat_handler, NULL) == ESP_OK);
+        }
     }
 }
 
@@ -257,25 +295,28 @@ void playlist_register_bitmap_generators(cJSON** bitmapGeneratorData, uint8_t* b
 #endif
 
 void playlist_update_config(void) {
-    esp_err_t ret = nvs_get_u16(pl_nvs_handle, "pl_poll_intvl", &pollInterval);
+    // Free the previous values first
+    playlist_deinit();
+
+    esp_err_t ret = config_get_u16("pl_poll_intvl", &pollInterval);
     if (ret != ESP_OK) pollInterval = 0;
 
-    ret = nvs_get_u8(pl_nvs_handle, "pl_save_to_file", &pl_save_to_file);
+    ret = config_get_u8("pl_save_to_file", &pl_save_to_file);
     if (ret != ESP_OK) pl_save_to_file = 0;
 
-    pollUrl = get_string_from_nvs(&pl_nvs_handle, "pl_poll_url");
+    pollUrl = config_get_str_alloc("pl_poll_url");
     if (pollUrl != NULL) {
         pollUrlInited = 1;
         if (strlen(pollUrl) != 0) pollUrlValid = 1;
     }
 
-    pollToken = get_string_from_nvs(&pl_nvs_handle, "pl_poll_token");
+    pollToken = config_get_str_alloc("pl_poll_token");
     if (pollToken != NULL) {
         pollTokenInited = 1;
         if (strlen(pollToken) != 0) pollTokenValid = 1;
     }
 
-    playlistFile = get_string_from_nvs(&pl_nvs_handle, "playlist_file");
+    playlistFile = config_get_str_alloc("playlist_file");
     if (playlistFile != NULL) {
         playlistFileInited = 1;
         if (strlen(playlistFile) != 0) playlistFileValid = 1;
@@ -320,93 +361,153 @@ void playlist_next_buffer() {
     }
 }
 
+void playlist_output_current() {
+    // If the playlist input is disabled in the configuration with this flag,
+    // It'll keep running in the background, but not outputting anything
+    // The flag is updated as soon as it changes, so this takes immediate effect
+    if (!pl_active) return;
+
+    ESP_LOGD(LOG_TAG, "Switching to group %d, buffer %d", pl_cur_group, pl_cur_buffer);
+    if (pl_buffers[pl_cur_buffer].pixelBuffer != NULL) {
+        taskENTER_CRITICAL(pixel_buffer_lock);
+        memcpy(pixel_buffer, pl_buffers[pl_cur_buffer].pixelBuffer, pixel_buffer_size);
+        taskEXIT_CRITICAL(pixel_buffer_lock);
+    }
+    if (pl_buffers[pl_cur_buffer].textBuffer != NULL) {
+        taskENTER_CRITICAL(text_buffer_lock);
+        memcpy(text_buffer, pl_buffers[pl_cur_buffer].textBuffer, text_buffer_size);
+        taskEXIT_CRITICAL(text_buffer_lock);
+    }
+    if (pl_buffers[pl_cur_buffer].lineFlagsBuffer != NULL) {
+        taskENTER_CRITICAL(line_flags_buffer_lock);
+        memcpy(line_flags_buffer, pl_buffers[pl_cur_buffer].lineFlagsBuffer, line_flags_buffer_size);
+        taskEXIT_CRITICAL(line_flags_buffer_lock);
+    }
+    if (pl_buffers[pl_cur_buffer].unitBuffer != NULL) {
+        taskENTER_CRITICAL(unit_buffer_lock);
+        memcpy(unit_buffer, pl_buffers[pl_cur_buffer].unitBuffer, unit_buffer_size);
+        taskEXIT_CRITICAL(unit_buffer_lock);
+    }
+
+    #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
+    if (pl_brightness != NULL && pl_buffers[pl_cur_buffer].brightness != -1) {
+        *pl_brightness = pl_buffers[pl_cur_buffer].brightness;
+    }
+    #endif
+
+    #if defined(CONFIG_DISPLAY_HAS_SHADERS)
+    if (shader_data != NULL && pl_buffers[pl_cur_buffer].updateShader) {
+        *shader_data = pl_buffers[pl_cur_buffer].shader;
+        *shader_data_deletable = 0; // This is taken care of during playlist update
+    }
+    #endif
+
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    if (transition_data != NULL && pl_buffers[pl_cur_buffer].updateTransition) {
+        *transition_data = pl_buffers[pl_cur_buffer].transition;
+        *transition_data_deletable = 0; // This is taken care of during playlist update
+    }
+    #endif
+
+    #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
+    if (effect_data != NULL && pl_buffers[pl_cur_buffer].updateEffect) {
+        *effect_data = pl_buffers[pl_cur_buffer].effect;
+        *effect_data_deletable = 0; // This is taken care of during playlist update
+    }
+    #endif
+
+    #if defined(DISPLAY_HAS_PIXEL_BUFFER)
+    if (bitmap_generator_data != NULL && pl_buffers[pl_cur_buffer].updateBitmapGenerator) {
+        *bitmap_generator_data = pl_buffers[pl_cur_buffer].bitmapGenerator;
+        *bitmap_generator_data_deletable = 0; // This is taken care of during playlist update
+    }
+    #endif
+}
+
+#if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+bool playlist_follow_leader(int64_t* nextSwitchTime) {
+    // Follow the playlist position broadcast by the sync leader.
+    // Returns false if the leader doesn't provide a usable position, local timing applies then.
+    pl_follow_leader_t leader;
+    leader.valid = sync_get_playlist_position(&leader.group, &leader.buffer, &leader.switch_us, &leader.duration_ms);
+    leader.in_playlist = leader.group < pl_num_groups && leader.buffer < pl_groups[leader.group].numEntries;
+    if (leader.valid && !leader.in_playlist && leader.switch_us != pl_follow.switch_us) {
+        ESP_LOGW(LOG_TAG, "Leader position %u/%u not in local playlist", leader.group, leader.buffer);
+    }
+
+    pl_follow_action_t action;
+    bool following = pl_follow_update(&pl_follow, &leader, pl_mode == PL_SEQUENTIAL, pl_cur_group, pl_cur_buffer, sync_get_time_us(), &action, nextSwitchTime);
+    if (action == PL_FOLLOW_NEXT) {
+        playlist_next_buffer();
+        if (pl_cur_buffer < pl_num_buffers) playlist_output_current();
+    } else if (action == PL_FOLLOW_JUMP) {
+        pl_cur_group = leader.group;
+        playlist_update_buffers();
+        pl_cur_buffer = leader.buffer;
+        playlist_output_current();
+    }
+    return following;
+}
+#endif
+
 void playlist_task(void* arg) {
     while (1) {
         uint64_t now = esp_timer_get_time(); // Microseconds!
-
+        uint32_t delayMs = 100;
+
+        #if defined(CONFIG_SYNC_ROLE_FOLLOWER)
+        int64_t nextSwitchTime = 0;
+        if (pl_num_groups > 0 && playlist_follow_leader(&nextSwitchTime)) {
+            pl_last_switch = now; // Continue seamlessly should the leader disappear
+            if (nextSwitchTime != 0) {
+                // Wake up in time for the next switch, but wait at least one tick
+                // in case it is overdue and the leader's announcement hasn't arrived yet
+                int64_t untilSwitchMs = (nextSwitchTime - sync_get_time_us()) / 1000;
+                if (untilSwitchMs < delayMs) delayMs = MAX(untilSwitchMs, portTICK_PERIOD_MS);
+            }
+        } else
+        #endif
         // Switch buffer if necessary
         if (pl_num_groups > 0) {
             uint16_t duration = 1;
-            if (pl_buffers != NULL && pl_cur_buffer < pl_num_buffers) duration = pl_buffers[pl_cur_buffer].duration;
-            if (pl_restart_cycle == true || pl_last_switch == 0 || now - pl_last_switch >= duration * 1000000) {
+            uint16_t beats = 0;
+            if (pl_buffers != NULL && pl_cur_buffer < pl_num_buffers) {
+                duration = pl_buffers[pl_cur_buffer].duration;
+                beats = pl_buffers[pl_cur_buffer].beats;
+            }
+            i2s_mic_beat_t beat;
+            i2s_mic_get_beat(&beat);
+            // The duration still applies to entries switching on beats, in case the music stops
+            bool beatsReached = beats > 0 && beat.count - pl_switch_beat >= beats;
+            if (pl_restart_cycle == true || pl_last_switch == 0 || beatsReached || now - pl_last_switch >= duration * 1000000) {
                 if (!(pl_restart_cycle == true || pl_last_switch == 0)) playlist_next_buffer();
                 if (pl_restart_cycle == true) {
                     ESP_LOGI(LOG_TAG, "Restarting cycle");
                     playlist_first_group();
                 }
                 pl_last_switch = now;
+                pl_switch_beat = beat.count;
                 pl_restart_cycle = false;
 
                 if (pl_cur_buffer < pl_num_buffers) {
-                    // If the playlist input is disabled in NVS with this flag,
-                    // It'll keep running in the background, but not outputting anything
-                    // This gets checked every loop cycle so that it takes immediate effect
-                    uint8_t active = 0;
-                    nvs_get_u8(pl_nvs_handle, "playlist_active", &active);
-                    if (active) {
-                        ESP_LOGD(LOG_TAG, "Switching to group %d, buffer %d", pl_cur_group, pl_cur_buffer);
-                        if (pl_buffers[pl_cur_buffer].pixelBuffer != NULL) {
-                            taskENTER_CRITICAL(pixel_buffer_lock);
-                            memcpy(pixel_buffer, pl_buffers[pl_cur_buffer].pixelBuffer, pixel_buffer_size);
-                            taskEXIT_CRITICAL(pixel_buffer_lock);
-                        }
-                        if (pl_buffers[pl_cur_buffer].textBuffer != NULL) {
-                            taskENTER_CRITICAL(text_buffer_lock);
-                            memcpy(text_buffer, pl_buffers[pl_cur_buffer].textBuffer, text_buffer_size);
-                            taskEXIT_CRITICAL(text_buffer_lock);
-                        }
-                        if (pl_buffers[pl_cur_buffer].lineFlagsBuffer != NULL) {
-                            taskENTER_CRITICAL(line_flags_buffer_lock);
-                            memcpy(line_flags_buffer, pl_buffers[pl_cur_buffer].lineFlagsBuffer, line_flags_buffer_size);
-                            taskEXIT_CRITICAL(line_flags_buffer_lock);
-                        }
-                        if (pl_buffers[pl_cur_buffer].unitBuffer != NULL) {
-                            taskENTER_CRITICAL(unit_buffer_lock);
-                            memcpy(unit_buffer, pl_buffers[pl_cur_buffer].unitBuffer, unit_buffer_size);
-                            taskEXIT_CRITICAL(unit_buffer_lock);
-                        }
-
-                        #if defined(CONFIG_DISPLAY_HAS_BRIGHTNESS_CONTROL)
-                        if (pl_brightness != NULL && pl_buffers[pl_cur_buffer].brightness != -1) {
-                            *pl_brightness = pl_buffers[pl_cur_buffer].brightness;
-                        }
-                        #endif
+                    playlist_output_current();
 
-                        #if defined(CONFIG_DISPLAY_HAS_SHADERS)
-                        if (shader_data != NULL && pl_buffers[pl_cur_buffer].updateShader) {
-                            *shader_data = pl_buffers[pl_cur_buffer].shader;
-                            *shader_data_deletable = 0; // This is taken care of during playlist update
-                        }
-                        #endif
-
-                        #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
-                        if (transition_data != NULL && pl_buffers[pl_cur_buffer].updateTransition) {
-                            *transition_data = pl_buffers[pl_cur_buffer].transition;
-                            *transition_data_deletable = 0; // This is taken care of during playlist update
-                        }
-                        #endif
-
-                        #if defined(CONFIG_DISPLAY_HAS_EFFECTS)
-                        if (effect_data != NULL && pl_buffers[pl_cur_buffer].updateEffect) {
-                            *effect_data = pl_buffers[pl_cur_buffer].effect;
-                            *effect_data_deletable = 0; // This is taken care of during playlist update
-                        }
-                        #endif
-
-                        #if defined(DISPLAY_HAS_PIXEL_BUFFER)
-                        if (bitmap_generator_data != NULL && pl_buffers[pl_cur_buffer].updateBitmapGenerator) {
-                            *bitmap_generator_data = pl_buffers[pl_cur_buffer].bitmapGenerator;
-                            *bitmap_generator_data_deletable = 0; // This is taken care of during playlist update
-                        }
-                        #endif
-                    }
+                    #if defined(CONFIG_SYNC_ROLE_LEADER)
+                    sync_set_playlist_position(pl_cur_group, pl_cur_buffer, sync_get_time_us(), pl_buffers[pl_cur_buffer].duration * 1000);
+                    #endif
                 }
             }
         }
 
-        // Update if necessary
-        if (pl_last_update == 0 || now - pl_last_update >= pollInterval * 1000000) {
+        // Pick up changed polling settings, this also triggers an update
+        if (pl_config_changed) {
+            pl_config_changed = false;
             playlist_update_config();
+            pl_last_update = 0;
+        }
+
+        // Update if necessary, a polling interval of 0 set while running stops further updates
+        if (pl_last_update == 0 || (pollInterval != 0 && now - pl_last_update >= pollInterval * 1000000)) {
             if (pollUrlValid && pollTokenValid && (wifi_gotIP || eth_gotIP)) {
                 playlist_update_from_http();
             } else if(playlistFileValid) {
@@ -414,7 +515,8 @@ void playlist_task(void* arg) {
             }
             pl_last_update = now;
         }
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        // Beats cut the wait short
+        ulTaskNotifyTake(pdTRUE, delayMs / portTICK_PERIOD_MS);
     }
     vTaskDelete(NULL);
 }
@@ -515,7 +617,8 @@ esp_err_t playlist_process_json(cJSON* json) {
                     "buffer": {
                         "text": "Another text"
                     },
-                    "duration": 1,
+                    "duration": 10,
+                    "beats": 4,
                     "brightness": 255,
                     "effect": null
                 }
@@ -534,6 +637,9 @@ esp_err_t playlist_process_json(cJSON* json) {
         "restartCycle": false
     }
 
+    "beats" is optional. If set, the entry switches after that many beats
+    detected by the microphone, or after "duration" seconds, whichever comes first.
+
     On error:
     {
         "error": "Some error here"
@@ -615,6 +721,9 @@ esp_err_t playlist_process_json(cJSON* json) {
             cJSON* duration_field = cJSON_GetObjectItem(item, "duration");
             pl_groups[j].entries[i].duration = cJSON_GetNumberValue(duration_field);
 
+            cJSON* beats_field = cJSON_GetObjectItem(item, "beats");
+            pl_groups[j].entries[i].beats = cJSON_IsNumber(beats_field) ? cJSON_GetNumberValue(beats_field) : 0;
+
             cJSON* brightness_field = cJSON_GetObjectItem(item, "brightness");
             if (brightness_field != NULL && !cJSON_IsNull(brightness_field)) {
                 pl_groups[j].entries[i].brightness = cJSON_GetNumberValue(brightness_field);
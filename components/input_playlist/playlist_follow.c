@@ -0,0 +1,48 @@
+#include <string.h>
+
+#include "playlist_follow.h"
+
+
+void pl_follow_init(pl_follow_t* follow) {
+    memset(follow, 0, sizeof(*follow));
+}
+
+bool pl_follow_update(pl_follow_t* follow, const pl_follow_leader_t* leader, bool sequential, uint16_t cur_group, uint16_t cur_buffer, int64_t now_us, pl_follow_action_t* action, int64_t* next_switch_us) {
+    /*
+    Follow the playlist position broadcast by the sync leader.
+    Returns false if the leader doesn't provide a usable position,
+    i.e. none has been received yet or its entry isn't in the local playlist.
+    Local timing applies then, and the next usable position is jumped to.
+    *next_switch_us is the time base value of the next expected switch, or 0 if unknown.
+    */
+    *action = PL_FOLLOW_KEEP;
+    *next_switch_us = 0;
+    if (!leader->valid) {
+        pl_follow_init(follow);
+        return false;
+    }
+    int64_t nextSwitch = leader->switch_us + (int64_t)leader->duration_ms * 1000;
+
+    if (leader->switch_us == follow->switch_us) {
+        if (!follow->usable) return false;
+        // No news from the leader. In sequential mode, the next entry is known,
+        // so switch right on time instead of waiting for the leader's announcement,
+        // which would add the network delay.
+        if (sequential && !follow->predicted && now_us >= nextSwitch) {
+            *action = PL_FOLLOW_NEXT;
+            follow->predicted = true;
+        }
+        if (!follow->predicted) *next_switch_us = nextSwitch;
+        return true;
+    }
+
+    // The leader switched
+    bool predictionCorrect = follow->predicted && leader->group == cur_group && leader->buffer == cur_buffer;
+    follow->switch_us = leader->switch_us;
+    follow->predicted = false;
+    follow->usable = leader->in_playlist;
+    if (!follow->usable) return false;
+    if (!predictionCorrect) *action = PL_FOLLOW_JUMP;
+    *next_switch_us = nextSwitch;
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ * Platform-independent part of following the sync leader's playlist:
+ * Decides when to jump to the leader's entry, when to advance on our own
+ * and when to fall back to local timing.
+ * No ESP-IDF dependencies, so this can be compiled and exercised on a PC.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+typedef enum {
+    PL_FOLLOW_KEEP = 0,         // Stay on the current entry
+    PL_FOLLOW_NEXT,             // Advance to the next entry, expecting the leader to do the same
+    PL_FOLLOW_JUMP,             // Jump to the leader's entry
+} pl_follow_action_t;
+
+typedef struct {
+    bool valid;                 // A position has been received from the leader
+    bool in_playlist;           // The leader's entry exists in the local playlist
+    uint16_t group;
+    uint16_t buffer;
+    int64_t switch_us;          // Time base value at which the leader displayed the entry
+    uint32_t duration_ms;
+} pl_follow_leader_t;
+
+typedef struct {
+    int64_t switch_us;          // Leader switch time of the currently followed entry
+    bool predicted;             // Whether we already advanced on our own
+    bool usable;                // Whether the followed entry exists in the local playlist
+} pl_follow_t;
+
+
+void pl_follow_init(pl_follow_t* follow);
+bool pl_follow_update(pl_follow_t* follow, const pl_follow_leader_t* leader, bool sequential, uint16_t cur_group, uint16_t cur_buffer, int64_t now_us, pl_follow_action_t* action, int64_t* next_switch_us);
@@ -7,6 +7,7 @@
 
 #include "telegram_bot.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_generic.h"
 #include "util_nvs.h"
 
@@ -16,12 +17,12 @@
 #define LOG_TAG "TGBot"
 
 static TaskHandle_t telegram_bot_task_handle;
-static nvs_handle_t tg_bot_nvs_handle;
 static char* apiToken = NULL;
 static char* logChannelId = NULL;
 static int64_t logChannelIdInt = 0;
 static uint8_t logChannelEnabled = 0;
 static uint8_t deadtime = 0;
+static uint8_t configSubscribed = 0;
 static uint8_t apiTokenInited = 0;
 static uint8_t logChannelIdInited = 0;
 static uint64_t lastMessageTime = 0;
@@ -130,18 +131,25 @@ esp_err_t telegram_bot_http_event_handler(esp_http_client_event_t *evt) {
     return ESP_OK;
 }
 
+static void telegram_bot_config_handler(const char* key, void* arg) {
+    // The dead time is checked for every message, so it can change while running
+    config_get_u8(key, &deadtime);
+}
+
 void telegram_bot_init(nvs_handle_t* nvsHandle, uint8_t* textBuf, size_t textBufSize, portMUX_TYPE* textBufLock) {
-    tg_bot_nvs_handle = *nvsHandle;
     output_buffer = textBuf;
     output_buffer_size = textBufSize;
     output_buffer_lock = textBufLock;
 
     telegram_bot_deinit();
 
-    apiToken = get_string_from_nvs(nvsHandle, "tg_bot_token");
-    logChannelId = get_string_from_nvs(nvsHandle, "tg_log_chnl_id");
-    nvs_get_u8(*nvsHandle, "tg_log_chnl_en", &logChannelEnabled);
-    nvs_get_u8(*nvsHandle, "tg_deadtime", &deadtime);
+    apiToken = config_get_str_alloc("tg_bot_token");
+    logChannelId = config_get_str_alloc("tg_log_chnl_id");
+    config_get_u8("tg_log_chnl_en", &logChannelEnabled);
+    config_get_u8("tg_deadtime", &deadtime);
+    if (!configSubscribed) {
+        configSubscribed = (config_subscribe("tg_deadtime", telegram_bot_config_handler, NULL) == ESP_OK);
+    }
 
     if (logChannelId != NULL) {
         logChannelIdInited = 1;
@@ -0,0 +1,185 @@
+#include <string.h>
+
+#include "log_ring.h"
+
+
+// Header layout (two 32 bit words, always LOG_RING_ALIGN aligned):
+// word 0: end position of the record, low bits hold the flags
+// word 1: payload length (low 16 bits) and check value (high 16 bits)
+// A header only counts as committed if the check value matches and the
+// end position lies within one ring size after the record start.
+#define HDR_FLAG_PAD 0x01
+#define HDR_FLAG_MASK (LOG_RING_ALIGN - 1)
+
+#define ALIGN_UP(x) (((x) + LOG_RING_ALIGN - 1) & ~(uint32_t)(LOG_RING_ALIGN - 1))
+#define POS_BEFORE(a, b) ((int32_t)((a) - (b)) < 0)
+
+
+static uint32_t* log_ring_header(log_ring_t* ring, uint32_t pos) {
+    return (uint32_t*)&ring->data[pos & (ring->size - 1)];
+}
+
+static uint16_t log_ring_header_check(uint32_t word0, uint16_t len) {
+    return ~(word0 ^ (word0 >> 16) ^ len) & 0xFFFF;
+}
+
+static void log_ring_write_header(log_ring_t* ring, uint32_t pos, uint32_t word0, uint16_t len) {
+    uint32_t* hdr = log_ring_header(ring, pos);
+    __atomic_store_n(&hdr[0], word0, __ATOMIC_RELAXED);
+    // Release: payload and word 0 become visible before the record counts as committed
+    __atomic_store_n(&hdr[1], ((uint32_t)log_ring_header_check(word0, len) << 16) | len, __ATOMIC_RELEASE);
+}
+
+static bool log_ring_read_header(log_ring_t* ring, uint32_t pos, uint32_t* end, uint16_t* len, uint8_t* flags) {
+    uint32_t* hdr = log_ring_header(ring, pos);
+    uint32_t word1 = __atomic_load_n(&hdr[1], __ATOMIC_ACQUIRE);
+    uint32_t word0 = __atomic_load_n(&hdr[0], __ATOMIC_RELAXED);
+    uint16_t recLen = word1 & 0xFFFF;
+    if ((word1 >> 16) != log_ring_header_check(word0, recLen)) return false;
+
+    uint32_t recEnd = word0 & ~(uint32_t)HDR_FLAG_MASK;
+    uint32_t recSize = recEnd - pos;
+    if (recSize < LOG_RING_HEADER_SIZE || recSize > ring->size) return false;
+    if (!(word0 & HDR_FLAG_PAD) && recLen > recSize - LOG_RING_HEADER_SIZE) return false;
+
+    *end = recEnd;
+    *len = recLen;
+    *flags = word0 & HDR_FLAG_MASK;
+    return true;
+}
+
+static bool log_ring_reclaim(log_ring_t* ring) {
+    // Move the tail past the oldest record, as long as that one is committed
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint32_t end;
+    uint16_t len;
+    uint8_t flags;
+    if (!log_ring_read_header(ring, tail, &end, &len, &flags)) {
+        // Not committed yet, unless someone else moved the tail in the meantime
+        return __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != tail;
+    }
+    // If this fails, another writer already reclaimed the record
+    __atomic_compare_exchange_n(&ring->tail, &tail, end, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return true;
+}
+
+bool log_ring_init(log_ring_t* ring, uint8_t* data, uint32_t size) {
+    if (size < 4 * LOG_RING_ALIGN || (size & (size - 1)) != 0) return false;
+    if ((uintptr_t)data & (LOG_RING_ALIGN - 1)) return false;
+    memset(data, 0, size);
+    ring->data = data;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->dropped = 0;
+    return true;
+}
+
+bool log_ring_reserve(log_ring_t* ring, size_t len, log_ring_record_t* record) {
+    /*
+    Reserve a contiguous record for len payload bytes.
+    If the record doesn't fit before the end of the ring, the rest of the ring
+    is filled with a padding record and the record starts at the beginning.
+    Returns false and counts a drop if the space is still held by a record
+    that hasn't been committed yet.
+    */
+    uint32_t need = ALIGN_UP(LOG_RING_HEADER_SIZE + len);
+    if (len > 0xFFFF || need > ring->size / 2) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint32_t pad;
+    uint32_t newHead;
+    do {
+        uint32_t offset = head & (ring->size - 1);
+        pad = (offset + need > ring->size) ? ring->size - offset : 0;
+        newHead = head + pad + need;
+        while (newHead - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) > ring->size) {
+            if (!log_ring_reclaim(ring)) {
+                __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+                return false;
+            }
+        }
+    } while (!__atomic_compare_exchange_n(&ring->head, &head, newHead, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+    uint32_t start = head + pad;
+    // Invalidate whatever is left at the record position, end == start is never valid
+    __atomic_store_n(&log_ring_header(ring, start)[0], start, __ATOMIC_RELAXED);
+    if (pad) log_ring_write_header(ring, head, start | HDR_FLAG_PAD, 0);
+
+    record->start = start;
+    record->end = newHead;
+    record->len = len;
+    record->payload = &ring->data[(start + LOG_RING_HEADER_SIZE) & (ring->size - 1)];
+    return true;
+}
+
+void log_ring_commit(log_ring_t* ring, log_ring_record_t* record) {
+    // record->len may have been reduced after reserving
+    log_ring_write_header(ring, record->start, record->end, record->len);
+}
+
+bool log_ring_write(log_ring_t* ring, const char* text, size_t len) {
+    log_ring_record_t record;
+    if (!log_ring_reserve(ring, len, &record)) return false;
+    memcpy(record.payload, text, len);
+    log_ring_commit(ring, &record);
+    return true;
+}
+
+uint32_t log_ring_get_dropped(log_ring_t* ring) {
+    return __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+}
+
+void log_ring_reader_init(log_ring_t* ring, log_ring_reader_t* reader) {
+    // Start at the oldest record so the backlog gets delivered
+    reader->pos = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    reader->next = reader->pos;
+    reader->lost = 0;
+}
+
+const uint8_t* log_ring_peek(log_ring_t* ring, log_ring_reader_t* reader, size_t* len) {
+    /*
+    Get the payload of the next committed record without copying it.
+    Returns NULL if there is none yet. The data stays in the ring, so it
+    has to be confirmed with log_ring_advance() after use.
+    */
+    while (1) {
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (POS_BEFORE(reader->pos, tail)) {
+            reader->lost += tail - reader->pos;
+            reader->pos = tail;
+        }
+        if (reader->pos == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) return NULL;
+
+        uint32_t end;
+        uint16_t recLen;
+        uint8_t flags;
+        bool valid = log_ring_read_header(ring, reader->pos, &end, &recLen, &flags);
+
+        // The header is only trustworthy if the record wasn't reclaimed while reading it
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (POS_BEFORE(reader->pos, __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))) continue;
+        if (!valid) return NULL;
+
+        if (flags & HDR_FLAG_PAD) {
+            reader->pos = end;
+            continue;
+        }
+
+        reader->next = end;
+        *len = recLen;
+        return &ring->data[(reader->pos + LOG_RING_HEADER_SIZE) & (ring->size - 1)];
+    }
+}
+
+bool log_ring_advance(log_ring_t* ring, log_ring_reader_t* reader) {
+    // Returns false if the record was reclaimed (and possibly overwritten) while in use
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    bool intact = !POS_BEFORE(reader->pos, __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+    if (!intact) reader->lost += reader->next - reader->pos;
+    reader->pos = reader->next;
+    return intact;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * Multi-producer, multi-reader byte ring for log records.
+ * No ESP-IDF dependencies, so this can be compiled and exercised on a PC.
+ *
+ * Writers reserve a contiguous record with a CAS on the head position,
+ * fill it in place and commit it. They never wait for each other:
+ * if the oldest record is still being written when space is needed,
+ * the new record is dropped and counted instead.
+ * Readers don't consume anything, each one keeps its own position and
+ * reads committed records directly from the ring.
+ * Positions are free-running 32 bit counters, the ring size must be
+ * a power of two.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define LOG_RING_HEADER_SIZE 8
+#define LOG_RING_ALIGN 8
+
+typedef struct {
+    uint8_t* data;
+    uint32_t size;
+    uint32_t head;          // Next position to be reserved
+    uint32_t tail;          // Oldest position that is still valid
+    uint32_t dropped;       // Records dropped by writers because the ring was blocked
+} log_ring_t;
+
+typedef struct {
+    uint32_t start;         // Position of the record header
+    uint32_t end;           // Position after the record
+    uint16_t len;
+    uint8_t* payload;
+} log_ring_record_t;
+
+typedef struct {
+    uint32_t pos;
+    uint32_t next;          // End of the record returned by the last peek
+    uint32_t lost;          // Bytes overwritten before this reader got to them
+} log_ring_reader_t;
+
+
+bool log_ring_init(log_ring_t* ring, uint8_t* data, uint32_t size);
+bool log_ring_reserve(log_ring_t* ring, size_t len, log_ring_record_t* record);
+void log_ring_commit(log_ring_t* ring, log_ring_record_t* record);
+bool log_ring_write(log_ring_t* ring, const char* text, size_t len);
+uint32_t log_ring_get_dropped(log_ring_t* ring);
+void log_ring_reader_init(log_ring_t* ring, log_ring_reader_t* reader);
+const uint8_t* log_ring_peek(log_ring_t* ring, log_ring_reader_t* reader, size_t* len);
+bool log_ring_advance(log_ring_t* ring, log_ring_reader_t* reader);
@@ -2,25 +2,25 @@
 #include <esp_log.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/semphr.h"
+#include <inttypes.h>
+#include <stdio.h>
 #include <string.h>
 #include <errno.h>
 #include "sdkconfig.h"
 
 #include "logging_tcp.h"
+#include "log_ring.h"
 
 #if defined(CONFIG_TCP_LOG_ENABLED)
 
+_Static_assert((CONFIG_TCP_LOG_RING_SIZE & (CONFIG_TCP_LOG_RING_SIZE - 1)) == 0, "CONFIG_TCP_LOG_RING_SIZE must be a power of two");
+
 static uint8_t numClientTasks = 0;
-static tcp_log_message_t logBuf[CONFIG_TCP_LOG_BUFFER_SIZE];
-static uint16_t logBufWritePtr = 0;
-static uint16_t logBufReadPtr = 0;
-static uint8_t logBufEmpty = 1;
-static uint8_t logBufFull = 0;
-static SemaphoreHandle_t logBufMutex;
+static uint8_t logRingData[CONFIG_TCP_LOG_RING_SIZE] __attribute__((aligned(LOG_RING_ALIGN)));
+static log_ring_t logRing;
 
 void tcp_log_init() {
-    logBufMutex = xSemaphoreCreateMutex();
+    log_ring_init(&logRing, logRingData, sizeof(logRingData));
     esp_log_set_vprintf((vprintf_like_t)tcp_log_vprintf);
 }
 
@@ -29,39 +29,32 @@ void tcp_log_start() {
 }
 
 int tcp_log_vprintf(const char* format, va_list args) {
-    char* text;
-    int textLen = vasprintf(&text, format, args);
+    va_list argsCopy;
+    va_copy(argsCopy, args);
+    int textLen = vsnprintf(NULL, 0, format, argsCopy);
+    va_end(argsCopy);
     if (textLen < 0) {
         // Error
         return textLen;
     }
 
-    tcp_log_message_t msg;
-    msg.text = text;
-    msg.textLen = textLen;
-
-    tcp_log_addToBuffer(&msg);
+    // Format directly into the ring, the extra byte is for the null terminator written by vsnprintf
+    log_ring_record_t record;
+    if (!log_ring_reserve(&logRing, textLen + 1, &record)) return textLen;
+    vsnprintf((char*)record.payload, textLen + 1, format, args);
+    record.len = textLen;
+    log_ring_commit(&logRing, &record);
     return textLen;
 }
 
-void tcp_log_addToBuffer(tcp_log_message_t* msg) {
-    xSemaphoreTake(logBufMutex, portMAX_DELAY);
-
-    if (logBufFull) {
-        free(logBuf[logBufWritePtr].text);
-    }
-    logBuf[logBufWritePtr] = *msg;
-    logBufEmpty = 0;
-    logBufWritePtr++;
-    if (logBufWritePtr >= CONFIG_TCP_LOG_BUFFER_SIZE) {
-        logBufWritePtr = 0;
-        logBufFull = 1;
+static int tcp_log_send(int clientSock, const uint8_t* data, size_t len) {
+    while (len > 0) {
+        int bytesWritten = send(clientSock, data, len, 0);
+        if (bytesWritten < 0) return bytesWritten;
+        data += bytesWritten;
+        len -= bytesWritten;
     }
-    if (logBufFull) {
-        logBufReadPtr = logBufWritePtr;
-    }
-
-    xSemaphoreGive(logBufMutex);
+    return 0;
 }
 
 void tcp_log_server_task(void* arg) {
@@ -118,34 +111,34 @@ void tcp_log_server_task(void* arg) {
 }
 
 void tcp_log_client_handler_task(void* arg) {
-    uint16_t bufPtr = logBufReadPtr;
-    uint8_t backlogStarted = 0;
+    // Starts with the oldest record still in the ring, so the backlog is sent first
+    log_ring_reader_t reader;
+    log_ring_reader_init(&logRing, &reader);
+    uint32_t reportedDropped = log_ring_get_dropped(&logRing);
+    uint32_t reportedLost = 0;
 
     numClientTasks++;
 
     int clientSock = (intptr_t)arg;
-    int bytesWritten;
-    uint8_t prevRunIdle = 0;
     while (1) {
-        if (prevRunIdle) vTaskDelay(1);
-        xSemaphoreTake(logBufMutex, portMAX_DELAY);
-        if (!logBufEmpty && (!backlogStarted || bufPtr != logBufWritePtr)) {
-            prevRunIdle = 0;
-            backlogStarted = 1;
-            tcp_log_message_t* msg = &logBuf[bufPtr];
-            bufPtr++;
-            if (bufPtr >= CONFIG_TCP_LOG_BUFFER_SIZE) {
-                bufPtr = 0;
-            }
-            xSemaphoreGive(logBufMutex);
-
-            bytesWritten = send(clientSock, msg->text, msg->textLen, 0);
-            if (bytesWritten < 0) {
-                break;
-            }
-        } else {
-            xSemaphoreGive(logBufMutex);
-            prevRunIdle = 1;
+        size_t textLen;
+        const uint8_t* text = log_ring_peek(&logRing, &reader, &textLen);
+        if (text == NULL) {
+            vTaskDelay(1);
+            continue;
+        }
+
+        // Sent straight from the ring. If the record gets overwritten meanwhile, it's counted as lost.
+        if (tcp_log_send(clientSock, text, textLen) < 0) break;
+        log_ring_advance(&logRing, &reader);
+
+        uint32_t dropped = log_ring_get_dropped(&logRing);
+        if (dropped != reportedDropped || reader.lost != reportedLost) {
+            char notice[80];
+            int noticeLen = snprintf(notice, sizeof(notice), "[TCP log: %" PRIu32 " messages dropped, %" PRIu32 " bytes lost]\n", dropped - reportedDropped, reader.lost - reportedLost);
+            reportedDropped = dropped;
+            reportedLost = reader.lost;
+            if (tcp_log_send(clientSock, (uint8_t*)notice, noticeLen) < 0) break;
         }
     }
 
@@ -5,9 +5,11 @@
 #include "cJSON.h"
 
 cJSON* shader_get_available();
-color_rgb_t shader_static(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, color_rgb_t color);
-color_rgb_t shader_static_rainbow(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, uint8_t repeats);
-color_rgb_t shader_sweeping_rainbow(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, uint16_t speed, uint8_t repeats, uint8_t rtl);
-color_rgb_t shader_sweeping_single_color_rainbow(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, uint16_t speed);
-color_rgb_t shader_linear_gradient(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, color_rgb_t start, color_rgb_t end, uint8_t repeats);
-color_rgb_t shader_fromJSON(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, cJSON* shaderData);
\ No newline at end of file
+void shader_static(color_rgb_u8_t* colors, uint16_t numColors, color_rgb_u8_t color);
+void shader_static_rainbow(color_rgb_u8_t* colors, uint16_t numColors, uint8_t repeats);
+void shader_sweeping_rainbow(color_rgb_u8_t* colors, uint16_t numColors, uint16_t charBufSize, int64_t t, uint16_t speed, uint8_t repeats, uint8_t rtl);
+void shader_sweeping_single_color_rainbow(color_rgb_u8_t* colors, uint16_t numColors, int64_t t, uint16_t speed);
+void shader_linear_gradient(color_rgb_u8_t* colors, uint16_t numColors, color_rgb_u8_t start, color_rgb_u8_t end, uint8_t repeats);
+void shader_beat_rainbow(color_rgb_u8_t* colors, uint16_t numColors, uint32_t beatCount, uint8_t step, uint8_t repeats);
+void shader_invalidate_cache();
+void shader_fromJSON(cJSON* shaderData, const uint8_t* charBuf, uint16_t charBufSize, color_rgb_u8_t* colors, uint16_t numColors);
@@ -0,0 +1,40 @@
+#include <string.h>
+
+#include "shader_cache.h"
+
+
+void shader_cache_invalidate(shader_cache_t* cache) {
+    cache->valid = false;
+}
+
+bool shader_cache_lookup(shader_cache_t* cache, const void* shader, uint8_t dependencies, uint32_t timeKey, const uint8_t* chars, uint16_t charBufSize, uint16_t numColors) {
+    /*
+    Check whether the colors calculated for the previous lookup are still valid.
+    Returns true if they are. Otherwise, the new inputs are stored and the caller
+    has to calculate the colors of the first numColors characters again.
+    */
+    if (numColors > cache->size) numColors = cache->size;
+
+    bool hit = cache->valid && cache->shader == shader && cache->dependencies == dependencies && cache->numColors == numColors;
+    if (hit && (dependencies & SHADER_DEPENDS_TIME)) {
+        hit = cache->timeKey == timeKey;
+    }
+    if (hit && (dependencies & SHADER_DEPENDS_POSITION)) {
+        hit = cache->charBufSize == charBufSize;
+    }
+    if (hit && (dependencies & SHADER_DEPENDS_CHARACTER)) {
+        hit = memcmp(cache->chars, chars, numColors) == 0;
+    }
+    if (hit) return true;
+
+    cache->valid = true;
+    cache->shader = shader;
+    cache->dependencies = dependencies;
+    cache->timeKey = timeKey;
+    cache->charBufSize = charBufSize;
+    cache->numColors = numColors;
+    if (dependencies & SHADER_DEPENDS_CHARACTER) {
+        memcpy(cache->chars, chars, numColors);
+    }
+    return false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+/*
+ * Decides whether the colors calculated by a character shader in a
+ * previous frame can be reused. Each shader declares what its output
+ * depends on and the cache compares only those inputs against the ones
+ * the colors were calculated from.
+ * This has no ESP-IDF dependencies and runs on a PC as well.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+// Output changes over time. The shader reduces the time to a key
+// which only changes when the output does, e.g. the hue offset.
+#define SHADER_DEPENDS_TIME      (1 << 0)
+// Output depends on the character at each position
+#define SHADER_DEPENDS_CHARACTER (1 << 1)
+// Output depends on the position and the size of the character buffer
+#define SHADER_DEPENDS_POSITION  (1 << 2)
+
+// chars and size need to be set when defining the cache,
+// everything else starts out as zero
+typedef struct {
+    uint8_t* chars;             // Characters the colors were calculated for
+    uint16_t size;              // Capacity of chars
+    bool valid;
+    const void* shader;         // Identity of the shader, e.g. the address of its JSON data
+    uint8_t dependencies;
+    uint32_t timeKey;
+    uint16_t charBufSize;
+    uint16_t numColors;
+} shader_cache_t;
+
+
+void shader_cache_invalidate(shader_cache_t* cache);
+bool shader_cache_lookup(shader_cache_t* cache, const void* shader, uint8_t dependencies, uint32_t timeKey, const uint8_t* chars, uint16_t charBufSize, uint16_t numColors);
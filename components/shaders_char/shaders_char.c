@@ -2,12 +2,17 @@
  * Functions for character display color effects
  */
 
+#include <string.h>
+
 #include "shaders_char.h"
+#include "shader_cache.h"
+#include "display_sync.h"
+#include "i2s_microphone.h"
 #include "macros.h"
 #include "util_generic.h"
+#include "util_fixed_point.h"
 #include "cJSON.h"
 #include "esp_log.h"
-#include "math.h"
 
 
 #if defined(DISPLAY_HAS_TEXT_BUFFER)
@@ -23,6 +28,7 @@ enum shader_func {
     SWEEPING_RAINBOW = 2,
     SWEEPING_SINGLE_COLOR_RAINBOW = 3,
     LINEAR_GRADIENT = 4,
+    BEAT_RAINBOW = 5,
 };
 
 
@@ -133,158 +139,322 @@ cJSON* shader_get_available() {
     cJSON_AddItemToObject(shader_entry, "params", params);
     cJSON_AddItemToArray(shaders_arr, shader_entry);
 
+    // Shader: Beat Rainbow
+    shader_entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(shader_entry, "name", "beat_rainbow");
+    params = cJSON_CreateObject();
+
+        // Parameter: Hue step per beat
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "range");
+        cJSON_AddNumberToObject(param, "min", 1);
+        cJSON_AddNumberToObject(param, "max", 180);
+        cJSON_AddNumberToObject(param, "value", 30);
+        cJSON_AddItemToObject(params, "step", param);
+
+        // Parameter: Repeats
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "number");
+        cJSON_AddNumberToObject(param, "min", 1);
+        cJSON_AddNumberToObject(param, "max", 100);
+        cJSON_AddNumberToObject(param, "value", 1);
+        cJSON_AddItemToObject(params, "repeats", param);
+
+    cJSON_AddItemToObject(shader_entry, "params", params);
+    cJSON_AddItemToArray(shaders_arr, shader_entry);
+
     return json;
 }
 
-color_rgb_t shader_static(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, color_rgb_t color) {
-    return color;
-}
+// Hues of the rainbow shaders, converted to colors in one go
+static fx20_12_t shader_hues_fx[DISPLAY_CHAR_BUF_SIZE];
 
-color_rgb_t shader_static_rainbow(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, uint8_t repeats) {
-    color_hsv_t calcColor_hsv;
+static uint16_t _rainbow_span(uint8_t repeats) {
     uint16_t span = DISPLAY_VIEWPORT_WIDTH_CHAR / repeats;
     if (span == 0) span = 1;
-    calcColor_hsv.h = (cb_i_display % span) * (360 / span);
-    calcColor_hsv.s = 1.0;
-    calcColor_hsv.v = 1.0;
-    return hsv2rgb(calcColor_hsv);
+    return span;
 }
 
-color_rgb_t shader_sweeping_rainbow(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, uint16_t speed, uint8_t repeats, uint8_t rtl) {
-    color_hsv_t calcColor_hsv;
-    uint16_t span = DISPLAY_VIEWPORT_WIDTH_CHAR / repeats;
-    if (span == 0) span = 1;
-    if (rtl) {
-        calcColor_hsv.h = (cb_i_display % span) * (360 / span);
-    } else {
-        calcColor_hsv.h = ((charBufSize - cb_i_display) % span) * (360 / span);
+static void _hues_to_colors(color_rgb_u8_t* colors, uint16_t numColors) {
+    hue_fx20_12_to_rgb_u8_array(shader_hues_fx, FX20_12(1), FX20_12(1), colors, numColors);
+}
+
+void shader_static(color_rgb_u8_t* colors, uint16_t numColors, color_rgb_u8_t color) {
+    for (uint16_t i = 0; i < numColors; i++) colors[i] = color;
+}
+
+void shader_static_rainbow(color_rgb_u8_t* colors, uint16_t numColors, uint8_t repeats) {
+    uint16_t span = _rainbow_span(repeats);
+    for (uint16_t i = 0; i < numColors; i++) {
+        shader_hues_fx[i] = FX20_12((i % span) * (360 / span));
     }
-    calcColor_hsv.h += (double)speed * (double)time_getSystemTime_us() / 1000000.0;
-    calcColor_hsv.h = (uint16_t)fmod(calcColor_hsv.h, 360.0);
-    calcColor_hsv.s = 1.0;
-    calcColor_hsv.v = 1.0;
-    return hsv2rgb(calcColor_hsv);
+    _hues_to_colors(colors, numColors);
 }
 
-color_rgb_t shader_sweeping_single_color_rainbow(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, uint16_t speed) {
-    color_hsv_t calcColor_hsv;
-    calcColor_hsv.h = (double)speed * (double)time_getSystemTime_us() / 1000000.0;
-    calcColor_hsv.h = (uint16_t)fmod(calcColor_hsv.h, 360.0);
-    calcColor_hsv.s = 1.0;
-    calcColor_hsv.v = 1.0;
-    return hsv2rgb(calcColor_hsv);
+void shader_sweeping_rainbow(color_rgb_u8_t* colors, uint16_t numColors, uint16_t charBufSize, int64_t t, uint16_t speed, uint8_t repeats, uint8_t rtl) {
+    uint16_t span = _rainbow_span(repeats);
+    // Whole degrees, the offset stays exact even for large timestamps
+    uint16_t offset = (speed * t / 1000000) % 360;
+    for (uint16_t i = 0; i < numColors; i++) {
+        uint16_t hue;
+        if (rtl) {
+            hue = (i % span) * (360 / span);
+        } else {
+            hue = ((charBufSize - i) % span) * (360 / span);
+        }
+        shader_hues_fx[i] = FX20_12((hue + offset) % 360);
+    }
+    _hues_to_colors(colors, numColors);
 }
 
-color_rgb_t shader_linear_gradient(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, color_rgb_t start, color_rgb_t end, uint8_t repeats) {
-    color_rgb_t calcColor;
-    uint16_t span = DISPLAY_VIEWPORT_WIDTH_CHAR / repeats;
-    if (span == 0) span = 1;
-    calcColor.r = map_double(cb_i_display % span, 0, span - 1, start.r, end.r);
-    calcColor.g = map_double(cb_i_display % span, 0, span - 1, start.g, end.g);
-    calcColor.b = map_double(cb_i_display % span, 0, span - 1, start.b, end.b);
-    return calcColor;
+void shader_sweeping_single_color_rainbow(color_rgb_u8_t* colors, uint16_t numColors, int64_t t, uint16_t speed) {
+    color_hsv_fx20_12_t hsv_fx;
+    hsv_fx.h = FX20_12((speed * t / 1000000) % 360);
+    hsv_fx.s = FX20_12(1);
+    hsv_fx.v = FX20_12(1);
+    shader_static(colors, numColors, hsv_fx20_12_to_rgb_u8(hsv_fx));
 }
 
-static color_rgb_t _color_rgb_from_json(cJSON* json, color_rgb_t fallback) {
-    color_rgb_t color;
+void shader_linear_gradient(color_rgb_u8_t* colors, uint16_t numColors, color_rgb_u8_t start, color_rgb_u8_t end, uint8_t repeats) {
+    uint16_t span = _rainbow_span(repeats);
+    for (uint16_t i = 0; i < numColors; i++) {
+        // Position within the gradient, 0 ... 1
+        fx20_12_t pos_fx = (span > 1) ? FX20_12(i % span) / (span - 1) : 0;
+        colors[i].r = interpolate_fx20_12_i32(pos_fx, start.r, end.r);
+        colors[i].g = interpolate_fx20_12_i32(pos_fx, start.g, end.g);
+        colors[i].b = interpolate_fx20_12_i32(pos_fx, start.b, end.b);
+    }
+}
+
+void shader_beat_rainbow(color_rgb_u8_t* colors, uint16_t numColors, uint32_t beatCount, uint8_t step, uint8_t repeats) {
+    // Rainbow that advances by a fixed hue step on every beat picked up by the microphone
+    uint16_t span = _rainbow_span(repeats);
+    uint16_t offset = (beatCount * step) % 360;
+    for (uint16_t i = 0; i < numColors; i++) {
+        shader_hues_fx[i] = FX20_12(((i % span) * (360 / span) + offset) % 360);
+    }
+    _hues_to_colors(colors, numColors);
+}
+
+static color_rgb_u8_t _color_rgb_from_json(cJSON* json, color_rgb_u8_t fallback) {
+    color_rgb_u8_t color;
     cJSON* r_field = cJSON_GetObjectItem(json, "r");
     if (!cJSON_IsNumber(r_field)) return fallback;
-    color.r = cJSON_GetNumberValue(r_field) / 255.0;
+    color.r = cJSON_GetNumberValue(r_field);
     cJSON* g_field = cJSON_GetObjectItem(json, "g");
     if (!cJSON_IsNumber(g_field)) return fallback;
-    color.g = cJSON_GetNumberValue(g_field) / 255.0;
+    color.g = cJSON_GetNumberValue(g_field);
     cJSON* b_field = cJSON_GetObjectItem(json, "b");
     if (!cJSON_IsNumber(b_field)) return fallback;
-    color.b = cJSON_GetNumberValue(b_field) / 255.0;
+    color.b = cJSON_GetNumberValue(b_field);
     return color;
 }
 
-color_rgb_t shader_fromJSON(uint16_t cb_i_display, uint16_t charBufSize, uint8_t character, cJSON* shaderData) {
-    // Fall back to black/off in case of error
-    color_rgb_t fallback = { .r = 1.0, .g = 1.0, .b = 1.0 };
+// Parameters of the current shader, parsed from JSON only when the shader changes
+typedef struct {
+    enum shader_func shaderId;
+    uint8_t dependencies;
+    color_rgb_u8_t color;
+    color_rgb_u8_t start;
+    color_rgb_u8_t end;
+    uint16_t speed;
+    uint8_t repeats;
+    uint8_t rtl;
+    uint8_t step;
+} shader_params_t;
+
+// Fall back to white in case of error
+static const color_rgb_u8_t shader_fallback = { .r = 255, .g = 255, .b = 255 };
+
+static cJSON* shader_paramsSource = NULL;
+static uint8_t shader_paramsValid = 0;
+static shader_params_t shader_params;
+
+static uint8_t shader_cacheChars[DISPLAY_CHAR_BUF_SIZE];
+static color_rgb_u8_t shader_cacheColors[DISPLAY_CHAR_BUF_SIZE];
+static shader_cache_t shader_cache = {
+    .chars = shader_cacheChars,
+    .size = DISPLAY_CHAR_BUF_SIZE,
+};
 
-    if (shaderData == NULL) return fallback;
+static esp_err_t _shader_parse(cJSON* shaderData, shader_params_t* shader) {
+    if (shaderData == NULL) return ESP_ERR_INVALID_ARG;
 
     cJSON* shader_id_field = cJSON_GetObjectItem(shaderData, "shader");
-    if (!cJSON_IsNumber(shader_id_field)) return fallback;
-    enum shader_func shaderId = (enum shader_func)cJSON_GetNumberValue(shader_id_field);
+    if (!cJSON_IsNumber(shader_id_field)) return ESP_ERR_INVALID_ARG;
+    shader->shaderId = (enum shader_func)cJSON_GetNumberValue(shader_id_field);
 
     cJSON* params = cJSON_GetObjectItem(shaderData, "params");
-    if (!cJSON_IsObject(params)) return fallback;
+    if (!cJSON_IsObject(params)) return ESP_ERR_INVALID_ARG;
 
-    switch (shaderId) {
+    ESP_LOGV(LOG_TAG, "shader=%p shaderId=%u", shaderData, shader->shaderId);
+
+    switch (shader->shaderId) {
         case STATIC: {
             cJSON* color_obj = cJSON_GetObjectItem(params, "color");
-            if (!cJSON_IsObject(color_obj)) return fallback;
-            color_rgb_t color = _color_rgb_from_json(color_obj, fallback);
-            ESP_LOGV(LOG_TAG, "shader=%p shaderId=%u color=%.2f, %.2f, %.2f", shaderData, shaderId, color.r, color.g, color.b);
-            return shader_static(cb_i_display, charBufSize, character, color);
+            if (!cJSON_IsObject(color_obj)) return ESP_ERR_INVALID_ARG;
+            shader->color = _color_rgb_from_json(color_obj, shader_fallback);
+
+            shader->dependencies = 0;
+            return ESP_OK;
         }
         
         case STATIC_RAINBOW: {
             cJSON* repeats_field = cJSON_GetObjectItem(params, "repeats");
-            if (!cJSON_IsNumber(repeats_field)) return fallback;
-            uint8_t repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
+            if (!cJSON_IsNumber(repeats_field)) return ESP_ERR_INVALID_ARG;
+            shader->repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
             // Prevent 0
-            repeats = repeats ? repeats : 1;
+            shader->repeats = shader->repeats ? shader->repeats : 1;
 
-            color_rgb_t color = shader_static_rainbow(cb_i_display, charBufSize, character, repeats);
-            ESP_LOGV(LOG_TAG, "shader=%p shaderId=%u color=%.2f, %.2f, %.2f", shaderData, shaderId, color.r, color.g, color.b);
-            return color;
+            shader->dependencies = SHADER_DEPENDS_POSITION;
+            return ESP_OK;
         }
         
         case SWEEPING_RAINBOW: {
             cJSON* speed_field = cJSON_GetObjectItem(params, "speed");
-            if (!cJSON_IsNumber(speed_field)) return fallback;
-            uint16_t speed = (uint16_t)cJSON_GetNumberValue(speed_field);
+            if (!cJSON_IsNumber(speed_field)) return ESP_ERR_INVALID_ARG;
+            shader->speed = (uint16_t)cJSON_GetNumberValue(speed_field);
             
             cJSON* repeats_field = cJSON_GetObjectItem(params, "repeats");
-            if (!cJSON_IsNumber(repeats_field)) return fallback;
-            uint8_t repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
+            if (!cJSON_IsNumber(repeats_field)) return ESP_ERR_INVALID_ARG;
+            shader->repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
             // Prevent 0
-            repeats = repeats ? repeats : 1;
+            shader->repeats = shader->repeats ? shader->repeats : 1;
             
             cJSON* rtl_field = cJSON_GetObjectItem(params, "right_to_left");
-            if (!cJSON_IsBool(rtl_field)) return fallback;
-            uint8_t rtl = (uint8_t)cJSON_IsTrue(rtl_field);
+            if (!cJSON_IsBool(rtl_field)) return ESP_ERR_INVALID_ARG;
+            shader->rtl = (uint8_t)cJSON_IsTrue(rtl_field);
 
-            color_rgb_t color = shader_sweeping_rainbow(cb_i_display, charBufSize, character, speed, repeats, rtl);
-            ESP_LOGV(LOG_TAG, "shader=%p shaderId=%u color=%.2f, %.2f, %.2f", shaderData, shaderId, color.r, color.g, color.b);
-            return color;
+            shader->dependencies = SHADER_DEPENDS_TIME | SHADER_DEPENDS_POSITION;
+            return ESP_OK;
         }
         
         case SWEEPING_SINGLE_COLOR_RAINBOW: {
             cJSON* speed_field = cJSON_GetObjectItem(params, "speed");
-            if (!cJSON_IsNumber(speed_field)) return fallback;
-            uint16_t speed = (uint16_t)cJSON_GetNumberValue(speed_field);
+            if (!cJSON_IsNumber(speed_field)) return ESP_ERR_INVALID_ARG;
+            shader->speed = (uint16_t)cJSON_GetNumberValue(speed_field);
 
-            color_rgb_t color = shader_sweeping_single_color_rainbow(cb_i_display, charBufSize, character, speed);
-            ESP_LOGV(LOG_TAG, "shader=%p shaderId=%u color=%.2f, %.2f, %.2f", shaderData, shaderId, color.r, color.g, color.b);
-            return color;
+            shader->dependencies = SHADER_DEPENDS_TIME;
+            return ESP_OK;
         }
         
         case LINEAR_GRADIENT: {
             cJSON* start_obj = cJSON_GetObjectItem(params, "start");
-            if (!cJSON_IsObject(start_obj)) return fallback;
-            color_rgb_t start = _color_rgb_from_json(start_obj, fallback);
+            if (!cJSON_IsObject(start_obj)) return ESP_ERR_INVALID_ARG;
+            shader->start = _color_rgb_from_json(start_obj, shader_fallback);
             
             cJSON* end_obj = cJSON_GetObjectItem(params, "end");
-            if (!cJSON_IsObject(end_obj)) return fallback;
-            color_rgb_t end = _color_rgb_from_json(end_obj, fallback);
+            if (!cJSON_IsObject(end_obj)) return ESP_ERR_INVALID_ARG;
+            shader->end = _color_rgb_from_json(end_obj, shader_fallback);
 
             cJSON* repeats_field = cJSON_GetObjectItem(params, "repeats");
-            if (!cJSON_IsNumber(repeats_field)) return fallback;
-            uint8_t repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
+            if (!cJSON_IsNumber(repeats_field)) return ESP_ERR_INVALID_ARG;
+            shader->repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
             // Prevent 0
-            repeats = repeats ? repeats : 1;
+            shader->repeats = shader->repeats ? shader->repeats : 1;
 
-            color_rgb_t color = shader_linear_gradient(cb_i_display, charBufSize, character, start, end, repeats);
-            ESP_LOGV(LOG_TAG, "shader=%p shaderId=%u color=%.2f, %.2f, %.2f", shaderData, shaderId, color.r, color.g, color.b);
-            return color;
+            shader->dependencies = SHADER_DEPENDS_POSITION;
+            return ESP_OK;
+        }
+
+        case BEAT_RAINBOW: {
+            cJSON* step_field = cJSON_GetObjectItem(params, "step");
+            if (!cJSON_IsNumber(step_field)) return ESP_ERR_INVALID_ARG;
+            shader->step = (uint8_t)cJSON_GetNumberValue(step_field);
+
+            cJSON* repeats_field = cJSON_GetObjectItem(params, "repeats");
+            if (!cJSON_IsNumber(repeats_field)) return ESP_ERR_INVALID_ARG;
+            shader->repeats = (uint8_t)cJSON_GetNumberValue(repeats_field);
+            // Prevent 0
+            shader->repeats = shader->repeats ? shader->repeats : 1;
+
+            // The beat count is treated like time
+            shader->dependencies = SHADER_DEPENDS_TIME | SHADER_DEPENDS_POSITION;
+            return ESP_OK;
         }
     }
 
-    return fallback;
+    return ESP_ERR_INVALID_ARG;
+}
+
+static void _shader_fallback(shader_params_t* shader) {
+    shader->shaderId = STATIC;
+    shader->color = shader_fallback;
+    shader->dependencies = 0;
+}
+
+static uint32_t _shader_time_key(shader_params_t* shader, int64_t* t, uint32_t* beatCount) {
+    // Reduce the time to the value the output actually depends on
+    switch (shader->shaderId) {
+        case SWEEPING_RAINBOW:
+        case SWEEPING_SINGLE_COLOR_RAINBOW:
+            *t = sync_get_time_us();
+            return (shader->speed * *t / 1000000) % 360;
+
+        case BEAT_RAINBOW: {
+            i2s_mic_beat_t beat;
+            i2s_mic_get_beat(&beat);
+            *beatCount = beat.count;
+            return (beat.count * shader->step) % 360;
+        }
+
+        default:
+            return 0;
+    }
+}
+
+static void _shader_evaluate(shader_params_t* shader, uint16_t charBufSize, int64_t t, uint32_t beatCount, color_rgb_u8_t* colors, uint16_t numColors) {
+    switch (shader->shaderId) {
+        case STATIC:
+            shader_static(colors, numColors, shader->color);
+            break;
+        case STATIC_RAINBOW:
+            shader_static_rainbow(colors, numColors, shader->repeats);
+            break;
+        case SWEEPING_RAINBOW:
+            shader_sweeping_rainbow(colors, numColors, charBufSize, t, shader->speed, shader->repeats, shader->rtl);
+            break;
+        case SWEEPING_SINGLE_COLOR_RAINBOW:
+            shader_sweeping_single_color_rainbow(colors, numColors, t, shader->speed);
+            break;
+        case LINEAR_GRADIENT:
+            shader_linear_gradient(colors, numColors, shader->start, shader->end, shader->repeats);
+            break;
+        case BEAT_RAINBOW:
+            shader_beat_rainbow(colors, numColors, beatCount, shader->step, shader->repeats);
+            break;
+    }
+}
+
+void shader_invalidate_cache() {
+    // Needs to be called when the shader changes,
+    // the same address might be reused for a different shader
+    shader_paramsValid = 0;
+    shader_cache_invalidate(&shader_cache);
+}
+
+void shader_fromJSON(cJSON* shaderData, const uint8_t* charBuf, uint16_t charBufSize, color_rgb_u8_t* colors, uint16_t numColors) {
+    /*
+    Calculate the colors of the first numColors characters for the current frame.
+    numColors must not exceed DISPLAY_CHAR_BUF_SIZE.
+    The colors are only calculated again if something they depend on has changed.
+    */
+    if (numColors > DISPLAY_CHAR_BUF_SIZE) numColors = DISPLAY_CHAR_BUF_SIZE;
+
+    if (!shader_paramsValid || shaderData != shader_paramsSource) {
+        if (_shader_parse(shaderData, &shader_params) != ESP_OK) _shader_fallback(&shader_params);
+        shader_paramsSource = shaderData;
+        shader_paramsValid = 1;
+        shader_cache_invalidate(&shader_cache);
+    }
+
+    int64_t t = 0;
+    uint32_t beatCount = 0;
+    uint32_t timeKey = _shader_time_key(&shader_params, &t, &beatCount);
+    if (!shader_cache_lookup(&shader_cache, shaderData, shader_params.dependencies, timeKey, charBuf, charBufSize, numColors)) {
+        _shader_evaluate(&shader_params, charBufSize, t, beatCount, shader_cacheColors, numColors);
+    }
+    memcpy(colors, shader_cacheColors, numColors * sizeof(color_rgb_u8_t));
 }
 
-#endif
\ No newline at end of file
+#endif
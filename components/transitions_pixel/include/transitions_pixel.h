@@ -6,4 +6,6 @@
 
 cJSON* transition_get_available();
 void transition_instant(uint8_t* oldPixBuf, uint8_t* newPixBuf, uint8_t* outPixBuf, size_t pixBufSize);
-void transition_fromJSON(uint8_t* oldPixBuf, uint8_t* newPixBuf, uint8_t* outPixBuf, size_t pixBufSize, cJSON* transitionData);
\ No newline at end of file
+esp_err_t transition_init(uint16_t frameWidth, uint16_t frameHeight, const uint16_t* activePixels, uint32_t numActivePixels);
+void transition_deinit();
+uint8_t transition_update(uint8_t* outPixBuf, uint8_t* newPixBuf, cJSON* transitionData, int64_t t);
@@ -5,8 +5,11 @@
 #include "transitions_pixel.h"
 #include "macros.h"
 #include "util_generic.h"
+#include "util_geometry.h"
 #include "esp_log.h"
 #include "math.h"
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -18,7 +21,9 @@
 // are output by transition_get_available().
 enum transition_func {
     INSTANT = 0,
-    WIPE_LTR = 1
+    WIPE_LTR = 1,
+    CROSSFADE = 2,
+    DISSOLVE = 3,
 };
 
 
@@ -41,14 +46,46 @@ cJSON* transition_get_available() {
     cJSON_AddStringToObject(transition_entry, "name", "wipe_ltr");
     params = cJSON_CreateObject();
 
-        // Parameter: Speed
+        // Parameter: Duration
         param = cJSON_CreateObject();
         cJSON_AddStringToObject(param, "type", "number");
-        cJSON_AddNumberToObject(param, "min", 1);
-        cJSON_AddNumberToObject(param, "max", 100);
-        cJSON_AddNumberToObject(param, "value", 1);
-        cJSON_AddItemToObject(params, "speed", param);
-    
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 10000);
+        cJSON_AddNumberToObject(param, "value", 1000);
+        cJSON_AddItemToObject(params, "duration", param);
+
+    cJSON_AddItemToObject(transition_entry, "params", params);
+    cJSON_AddItemToArray(transitions_arr, transition_entry);
+
+    // Transition: Crossfade
+    transition_entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(transition_entry, "name", "crossfade");
+    params = cJSON_CreateObject();
+
+        // Parameter: Duration
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "number");
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 10000);
+        cJSON_AddNumberToObject(param, "value", 1000);
+        cJSON_AddItemToObject(params, "duration", param);
+
+    cJSON_AddItemToObject(transition_entry, "params", params);
+    cJSON_AddItemToArray(transitions_arr, transition_entry);
+
+    // Transition: Dissolve
+    transition_entry = cJSON_CreateObject();
+    cJSON_AddStringToObject(transition_entry, "name", "dissolve");
+    params = cJSON_CreateObject();
+
+        // Parameter: Duration
+        param = cJSON_CreateObject();
+        cJSON_AddStringToObject(param, "type", "number");
+        cJSON_AddNumberToObject(param, "min", 0);
+        cJSON_AddNumberToObject(param, "max", 10000);
+        cJSON_AddNumberToObject(param, "value", 1000);
+        cJSON_AddItemToObject(params, "duration", param);
+
     cJSON_AddItemToObject(transition_entry, "params", params);
     cJSON_AddItemToArray(transitions_arr, transition_entry);
 
@@ -59,35 +96,248 @@ void transition_instant(uint8_t* oldPixBuf, uint8_t* newPixBuf, uint8_t* outPixB
     memcpy(outPixBuf, newPixBuf, pixBufSize);
 }
 
-void transition_fromJSON(uint8_t* oldPixBuf, uint8_t* newPixBuf, uint8_t* outPixBuf, size_t pixBufSize, cJSON* transitionData) {
-    if (transitionData == NULL) return;
+
+#if defined(DISPLAY_HAS_PIXEL_BUFFER)
+
+#if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_1BPP)
+// Pixel offsets are bit offsets, see transition_init()
+#define PIXEL_BYTES 0
+#elif defined(CONFIG_DISPLAY_PIX_BUF_TYPE_8BPP)
+#define PIXEL_BYTES 1
+#elif defined(CONFIG_DISPLAY_PIX_BUF_TYPE_24BPP)
+#define PIXEL_BYTES 3
+#endif
+
+static geometry_t geometry;
+// Active pixels in random order, indices into geometry.pixels
+static uint32_t* dissolve_order = NULL;
+// Pixels that differ between the old and the new frame in the order
+// they are transitioned, indices into geometry.pixels
+static uint32_t* pending_pixels = NULL;
+static uint32_t num_pending_pixels = 0;
+static uint32_t num_done_pixels = 0;
+static uint8_t* old_pix_buf = NULL;
+static uint8_t* new_pix_buf = NULL;
+
+static uint8_t transition_active = 0;
+static enum transition_func transition_id = INSTANT;
+static int64_t transition_start = 0;
+static int64_t transition_duration = 0;
+static uint16_t crossfade_alpha = 0;
+
+
+esp_err_t transition_init(uint16_t frameWidth, uint16_t frameHeight, const uint16_t* activePixels, uint32_t numActivePixels) {
+    /*
+    activePixels optionally lists the pixel buffer offsets that are actually visible,
+    e.g. on displays that only have LEDs in some places. NULL means all pixels.
+    Only active pixels are transitioned, all others simply take the new value at the end.
+    */
+    ESP_LOGI(LOG_TAG, "Initializing transitions");
+    transition_deinit();
+
+    #if PIXEL_BYTES == 0
+    // For 1bpp, the pixel list holds bit offsets. Each column has
+    // DISPLAY_FRAME_HEIGHT_PIXEL_BYTES * 8 bits with pixel y at bit y.
+    esp_err_t ret = geometry_init(&geometry, frameWidth, frameHeight, DISPLAY_FRAME_HEIGHT_PIXEL_BYTES * 8, 1, NULL, 0);
+    #else
+    esp_err_t ret = geometry_init(&geometry, frameWidth, frameHeight, DISPLAY_FRAME_HEIGHT_PIXEL_BYTES, PIXEL_BYTES, activePixels, numActivePixels);
+    #endif
+    if (ret != ESP_OK) return ret;
+
+    old_pix_buf = malloc(DISPLAY_PIX_BUF_SIZE);
+    new_pix_buf = calloc(DISPLAY_PIX_BUF_SIZE, 1);
+    dissolve_order = malloc(geometry.numPixels * sizeof(uint32_t));
+    pending_pixels = malloc(geometry.numPixels * sizeof(uint32_t));
+    if (old_pix_buf == NULL || new_pix_buf == NULL || (geometry.numPixels > 0 && (dissolve_order == NULL || pending_pixels == NULL))) {
+        transition_deinit();
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Fisher-Yates shuffle, generated once so starting a dissolve is just a filter
+    for (uint32_t i = 0; i < geometry.numPixels; i++) dissolve_order[i] = i;
+    for (uint32_t i = geometry.numPixels; i > 1; i--) {
+        uint32_t j = rand_range(0, i);
+        uint32_t tmp = dissolve_order[i - 1];
+        dissolve_order[i - 1] = dissolve_order[j];
+        dissolve_order[j] = tmp;
+    }
+
+    ESP_LOGI(LOG_TAG, "%" PRIu32 " active pixels", geometry.numPixels);
+    return ESP_OK;
+}
+
+void transition_deinit() {
+    geometry_deinit(&geometry);
+    free(dissolve_order);
+    free(pending_pixels);
+    free(old_pix_buf);
+    free(new_pix_buf);
+    dissolve_order = NULL;
+    pending_pixels = NULL;
+    old_pix_buf = NULL;
+    new_pix_buf = NULL;
+    transition_active = 0;
+}
+
+static uint8_t _pixel_differs(uint32_t offset) {
+    #if PIXEL_BYTES == 0
+    return ((old_pix_buf[offset / 8] ^ new_pix_buf[offset / 8]) >> (offset % 8)) & 1;
+    #else
+    return memcmp(&old_pix_buf[offset], &new_pix_buf[offset], PIXEL_BYTES) != 0;
+    #endif
+}
+
+static void _pixel_set_new(uint8_t* outPixBuf, uint32_t offset) {
+    #if PIXEL_BYTES == 0
+    uint8_t bit = 1 << (offset % 8);
+    outPixBuf[offset / 8] = (outPixBuf[offset / 8] & ~bit) | (new_pix_buf[offset / 8] & bit);
+    #else
+    memcpy(&outPixBuf[offset], &new_pix_buf[offset], PIXEL_BYTES);
+    #endif
+}
+
+#if PIXEL_BYTES != 0
+static void _pixel_blend(uint8_t* outPixBuf, uint32_t offset, uint16_t alpha) {
+    // alpha goes from 0 (old) to 256 (new)
+    for (uint8_t i = 0; i < PIXEL_BYTES; i++) {
+        int16_t oldVal = old_pix_buf[offset + i];
+        int16_t newVal = new_pix_buf[offset + i];
+        outPixBuf[offset + i] = oldVal + (((newVal - oldVal) * alpha) >> 8);
+    }
+}
+#endif
+
+static enum transition_func _transition_parse(cJSON* transitionData, int64_t* duration) {
+    // Anything invalid is treated as an instant transition
+    *duration = 0;
+    if (transitionData == NULL) return INSTANT;
 
     cJSON* transition_id_field = cJSON_GetObjectItem(transitionData, "transition");
-    if (!cJSON_IsNumber(transition_id_field)) return;
+    if (!cJSON_IsNumber(transition_id_field)) return INSTANT;
     enum transition_func transitionId = (enum transition_func)cJSON_GetNumberValue(transition_id_field);
     ESP_LOGV(LOG_TAG, "transition=%p transitionId=%u", transitionData, transitionId);
 
     cJSON* params = cJSON_GetObjectItem(transitionData, "params");
-    if (!cJSON_IsObject(params)) return;
+    if (!cJSON_IsObject(params)) return INSTANT;
 
     switch (transitionId) {
-        case INSTANT: {
-            transition_instant(oldPixBuf, newPixBuf, outPixBuf, pixBufSize);
-            return;
+        case WIPE_LTR:
+        case CROSSFADE:
+        case DISSOLVE: {
+            cJSON* duration_field = cJSON_GetObjectItem(params, "duration");
+            if (!cJSON_IsNumber(duration_field)) return INSTANT;
+            double durationMs = cJSON_GetNumberValue(duration_field);
+            if (durationMs <= 0) return INSTANT;
+            *duration = (int64_t)(durationMs * 1000);
+            #if PIXEL_BYTES == 0
+            // Pixels can only be on or off
+            if (transitionId == CROSSFADE) return DISSOLVE;
+            #endif
+            return transitionId;
         }
-        
+
+        default:
+            return INSTANT;
+    }
+}
+
+static void _transition_start(uint8_t* outPixBuf, uint8_t* newPixBuf, cJSON* transitionData, int64_t t) {
+    // The current output is the starting point, even if a transition was still running
+    memcpy(old_pix_buf, outPixBuf, DISPLAY_PIX_BUF_SIZE);
+    memcpy(new_pix_buf, newPixBuf, DISPLAY_PIX_BUF_SIZE);
+    transition_id = _transition_parse(transitionData, &transition_duration);
+    transition_start = t;
+    crossfade_alpha = 0;
+    num_done_pixels = 0;
+    num_pending_pixels = 0;
+
+    // Wipe and crossfade go through the pixels in buffer order, which is column by column
+    for (uint32_t i = 0; i < geometry.numPixels; i++) {
+        uint32_t index = (transition_id == DISSOLVE) ? dissolve_order[i] : i;
+        if (_pixel_differs(geometry.pixels[index].offset)) pending_pixels[num_pending_pixels++] = index;
+    }
+    transition_active = 1;
+}
+
+static uint8_t _transition_step(uint8_t* outPixBuf, int64_t t) {
+    int64_t elapsed = t - transition_start;
+    uint8_t finished = (transition_id == INSTANT) || (elapsed >= transition_duration);
+    if (elapsed < 0) elapsed = 0;
+    uint32_t numDonePrev = num_done_pixels;
+    uint8_t changed = 0;
+
+    switch (transition_id) {
         case WIPE_LTR: {
-            return;
-            /*cJSON* speed_field = cJSON_GetObjectItem(params, "speed");
-            if (!cJSON_IsNumber(speed_field)) return;
-            uint8_t speed = (uint8_t)cJSON_GetNumberValue(speed_field);
-            // Prevent 0
-            speed = speed ? speed : 1;
-
-            transition_wipe_ltr(oldPixBuf, newPixBuf, outPixBuf, pixBufSize, speed);
-            return color;*/
+            // Columns left of wipeX show the new frame
+            uint32_t wipeX = finished ? UINT32_MAX : (uint32_t)(elapsed * geometry.width / transition_duration);
+            while (num_done_pixels < num_pending_pixels && geometry.pixels[pending_pixels[num_done_pixels]].x < wipeX) {
+                _pixel_set_new(outPixBuf, geometry.pixels[pending_pixels[num_done_pixels]].offset);
+                num_done_pixels++;
+            }
+            break;
+        }
+
+        #if PIXEL_BYTES != 0
+        case CROSSFADE: {
+            // Every pending pixel changes with alpha, but nothing else does
+            uint16_t alpha = finished ? 256 : (uint16_t)(elapsed * 256 / transition_duration);
+            if (alpha == crossfade_alpha) break;
+            crossfade_alpha = alpha;
+            changed = 1;
+            for (uint32_t i = 0; i < num_pending_pixels; i++) {
+                _pixel_blend(outPixBuf, geometry.pixels[pending_pixels[i]].offset, alpha);
+            }
+            if (finished) num_done_pixels = num_pending_pixels;
+            break;
+        }
+        #endif
+
+        case DISSOLVE: {
+            uint32_t target = finished ? num_pending_pixels : (uint32_t)(elapsed * num_pending_pixels / transition_duration);
+            for (; num_done_pixels < target; num_done_pixels++) {
+                _pixel_set_new(outPixBuf, geometry.pixels[pending_pixels[num_done_pixels]].offset);
+            }
+            break;
+        }
+
+        default: {
+            for (; num_done_pixels < num_pending_pixels; num_done_pixels++) {
+                _pixel_set_new(outPixBuf, geometry.pixels[pending_pixels[num_done_pixels]].offset);
+            }
+            break;
         }
     }
 
-    return;
-}
\ No newline at end of file
+    if (num_done_pixels != numDonePrev) changed = 1;
+    if (finished) {
+        // Inactive pixels aren't tracked, they just take their new value
+        memcpy(outPixBuf, new_pix_buf, DISPLAY_PIX_BUF_SIZE);
+        transition_active = 0;
+        changed = 1;
+    }
+    return changed;
+}
+
+uint8_t transition_update(uint8_t* outPixBuf, uint8_t* newPixBuf, cJSON* transitionData, int64_t t) {
+    /*
+    Render the frame for time t (in microseconds) into outPixBuf.
+    outPixBuf holds the frame rendered by the previous call and must not be modified otherwise.
+    A transition starts whenever newPixBuf differs from the frame the previous one went to.
+    Each call only touches the pixels that change in this step.
+    Returns 1 if outPixBuf was modified.
+    */
+    if (old_pix_buf == NULL) {
+        // Not initialized, nothing to transition with
+        if (memcmp(outPixBuf, newPixBuf, DISPLAY_PIX_BUF_SIZE) == 0) return 0;
+        transition_instant(NULL, newPixBuf, outPixBuf, DISPLAY_PIX_BUF_SIZE);
+        return 1;
+    }
+
+    if (memcmp(newPixBuf, new_pix_buf, DISPLAY_PIX_BUF_SIZE) != 0) {
+        _transition_start(outPixBuf, newPixBuf, transitionData, t);
+    }
+    if (!transition_active) return 0;
+    return _transition_step(outPixBuf, t);
+}
+
+#endif
@@ -17,6 +17,25 @@ typedef enum {
     LINE_FLAG_INDICATOR_LIGHT = (1 << 0),
 } line_flag_t;
 
+// Copy of the last character output of a display, to only render when it changes
+typedef struct {
+    uint8_t* charBuf;
+    uint16_t* quirkFlagBuf;
+    size_t charBufSize;
+    uint8_t valid;
+} buffer_char_output_t;
+
+typedef struct {
+    uint8_t literal;    // Literal bytes left in the current packet
+    uint8_t run;        // Length of the pending run, waiting for its value byte
+} buffer_rle_state_t;
+
+typedef struct {
+    uint32_t bits;      // Sextets of the current quantum
+    uint8_t count;      // Number of sextets in bits
+    uint8_t padding;    // Number of '=' seen, nothing but padding may follow
+} buffer_base64_state_t;
+
 
 void buffer_8to1(uint8_t* buf8, uint8_t* buf1, uint16_t width, uint16_t height, buf_merge_t mergeType);
 void buffer_utf8_to_iso88591(char* dst, char* src);
@@ -24,4 +43,13 @@ void buffer_iso88591_to_utf8(char* dst, char* src);
 void buffer_textbuf_to_charbuf(uint8_t* display_text_buffer, uint8_t* display_char_buffer, uint16_t* display_quirk_flags_buffer, uint16_t textBufSize, uint16_t charBufSize);
 char* buffer_escape_string(char* input, char* charsToEscape, char escapePrefix, uint16_t numEscapeChars);
 esp_err_t buffer_from_string(const char* in_buf_str, uint8_t is_base64, uint8_t* out_buf, size_t out_buf_size, const char* log_tag);
-esp_err_t buffer_to_base64(uint8_t* buf, size_t buf_size, uint8_t** out);
\ No newline at end of file
+esp_err_t buffer_to_base64(uint8_t* buf, size_t buf_size, uint8_t** out);
+esp_err_t buffer_rle_decode(buffer_rle_state_t* state, const uint8_t* in, size_t inLen, uint8_t* out, size_t outSize, size_t* outPos);
+size_t buffer_rle_encode(const uint8_t* in, size_t inLen, size_t* inPos, uint8_t* out, size_t outSize);
+esp_err_t buffer_base64_decode(buffer_base64_state_t* state, const uint8_t* in, size_t inLen, uint8_t* out, size_t outSize, size_t* outPos);
+esp_err_t buffer_base64_decode_finish(buffer_base64_state_t* state, uint8_t* out, size_t outSize, size_t* outPos);
+esp_err_t buffer_char_output_init(buffer_char_output_t* output, size_t charBufSize);
+void buffer_char_output_invalidate(buffer_char_output_t* output);
+// The text buffer may change without changing what is shown, e.g. beyond the end of the display,
+// so character drivers check this instead of the text buffer before rendering
+uint8_t buffer_char_output_changed(buffer_char_output_t* output, const uint8_t* charBuf, const uint16_t* quirkFlagBuf, size_t charBufSize);
\ No newline at end of file
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * Typed registry of all configuration options.
+ * The values are loaded from NVS once at boot and served from RAM afterwards.
+ * Changes are made in transactions that are written to NVS as a whole,
+ * after which subscribers are notified of every key that changed.
+ */
+
+#include "esp_err.h"
+#include "nvs.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Maximum number of change callbacks that can be registered
+#define CFG_REG_MAX_SUBSCRIBERS 16
+
+
+typedef enum config_data_type {
+    CONFIG_TYPE_I8   = 10,
+    CONFIG_TYPE_I16  = 11,
+    CONFIG_TYPE_I32  = 12,
+    CONFIG_TYPE_I64  = 13,
+    CONFIG_TYPE_U8   = 14,
+    CONFIG_TYPE_U16  = 15,
+    CONFIG_TYPE_U32  = 16,
+    CONFIG_TYPE_U64  = 17,
+    CONFIG_TYPE_STR  = 18,
+    CONFIG_TYPE_BLOB = 19
+} config_data_type_t;
+
+typedef enum config_field_flags {
+    BC_FIELD_FLAGS_NONE = 0,
+    BC_FIELD_FLAGS_WRITE_ONLY = 1, // If set, fields.json will not contain the actual value. Good for things like passwords or access tokens. Only works for strings at the moment.
+    BC_FIELD_FLAGS_SPIFFS_FILE_SELECT = 2 // For CONFIG_TYPE_STR entries, makes the field show a select input populated with filenames from SPIFFS
+} config_field_flags_t;
+
+typedef struct config_entry {
+    char* key;
+    config_data_type_t dataType;
+    config_field_flags_t flags;
+    char* comment;
+} config_entry_t;
+
+// Called after a committed transaction changed the value of key
+typedef void (*config_change_cb_t)(const char* key, void* arg);
+
+
+esp_err_t config_init(nvs_handle_t* nvsHandle);
+const config_entry_t* config_get_entries(uint16_t* numEntries);
+const config_entry_t* config_find_entry(const char* key);
+
+esp_err_t config_get_int(const char* key, int64_t* value);
+esp_err_t config_get_u8(const char* key, uint8_t* value);
+esp_err_t config_get_u16(const char* key, uint16_t* value);
+esp_err_t config_get_str(const char* key, char* value, size_t* length);
+char* config_get_str_alloc(const char* key);
+
+esp_err_t config_begin(void);
+esp_err_t config_set_int(const char* key, int64_t value);
+esp_err_t config_set_str(const char* key, const char* value);
+esp_err_t config_commit(void);
+void config_abort(void);
+
+esp_err_t config_subscribe(const char* key, config_change_cb_t callback, void* arg);
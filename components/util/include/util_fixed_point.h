@@ -14,5 +14,7 @@ fx20_12_t sin_i16_to_fx20_12(int16_t i);
 fx20_12_t cos_i16_to_fx20_12(int16_t i);
 fx20_12_t sqrt_i32_to_fx20_12(int32_t v);
 color_rgb_u8_t hsv_fx20_12_to_rgb_u8(color_hsv_fx20_12_t hsv);
+void hsv_fx20_12_to_rgb_u8_array(const color_hsv_fx20_12_t* hsv, color_rgb_u8_t* rgb, uint32_t count);
+void hue_fx20_12_to_rgb_u8_array(const fx20_12_t* hue, fx20_12_t s, fx20_12_t v, color_rgb_u8_t* rgb, uint32_t count);
 color_hsv_fx20_12_t rgb_u8_to_hsv_fx20_12(color_rgb_u8_t rgb);
 int32_t interpolate_fx20_12_i32(fx20_12_t val, int32_t start, int32_t end);
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+/*
+ * Display geometry for code that writes to a byte-aligned pixel buffer (8bpp or 24bpp).
+ * Instead of iterating the buffer and deriving the coordinates of each pixel,
+ * users iterate a precomputed list of the active pixels, sorted by buffer offset.
+ */
+
+typedef struct {
+    uint16_t x;
+    uint16_t y;
+    uint32_t offset;            // Index of the first byte of the pixel in the pixel buffer
+} geometry_pixel_t;
+
+typedef struct {
+    uint16_t width;
+    uint16_t height;
+    geometry_pixel_t* pixels;   // Sorted by offset
+    uint32_t numPixels;
+} geometry_t;
+
+
+esp_err_t geometry_init(geometry_t* geometry, uint16_t width, uint16_t height, uint16_t columnBytes, uint8_t bytesPerPixel, const uint16_t* activeOffsets, uint32_t numActiveOffsets);
+void geometry_deinit(geometry_t* geometry);
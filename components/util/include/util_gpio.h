@@ -3,6 +3,22 @@
 #include "driver/gpio.h"
 #include "esp_system.h"
 
+// Bit for a GPIO in the 64 bit masks used by gpio_write_mask()
+#define GPIO_BIT(gpio_num) ((uint64_t)1 << (gpio_num))
+
+#define GPIO_BUS_MAX_PINS 8
+
+// A group of output pins that is written as one binary value
+typedef struct {
+    uint8_t numPins;
+    uint64_t mask;       // Bits of all pins on the bus
+    uint64_t* valueBits; // Bits that are set for each possible value
+} gpio_bus_t;
+
 esp_err_t gpio_pulse(gpio_num_t gpio_num, uint8_t level, uint32_t pulseWidth, uint32_t delayBefore, uint32_t delayAfter);
 esp_err_t gpio_pulse_inv(gpio_num_t gpio_num, uint8_t level, uint32_t pulseWidth, uint32_t delayBefore, uint32_t delayAfter, uint8_t activeLow);
-esp_err_t gpio_set(gpio_num_t gpio_num, uint8_t level, uint8_t activeLow);
\ No newline at end of file
+esp_err_t gpio_set(gpio_num_t gpio_num, uint8_t level, uint8_t activeLow);
+esp_err_t gpio_bus_init(gpio_bus_t* bus, const gpio_num_t* pins, uint8_t numPins);
+void gpio_bus_write(gpio_bus_t* bus, uint32_t value);
+void gpio_write_mask(uint64_t setBits, uint64_t clearBits);
+void gpio_pulse_mask(uint64_t bits, uint8_t level, uint32_t pulseWidth, uint32_t delayBefore, uint32_t delayAfter);
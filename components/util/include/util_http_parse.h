@@ -0,0 +1,39 @@
+#pragma once
+
+/*
+ * Parsers for HTTP request details that don't depend on the HTTP server,
+ * so they can be tested on the host.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+// RFC 2046 limits boundaries to 70 characters
+#define HTTP_MULTIPART_MAX_BOUNDARY_LEN 70
+#define HTTP_MULTIPART_MAX_LINE_LEN 128
+#define HTTP_MULTIPART_MAX_FILENAME_LEN 32
+
+typedef enum {
+    HTTP_MULTIPART_PREAMBLE = 0,
+    HTTP_MULTIPART_DELIMITER_END,   // After the first delimiter, "--" or a line break follows
+    HTTP_MULTIPART_HEADER,
+    HTTP_MULTIPART_BODY,
+    HTTP_MULTIPART_DONE,
+} http_multipart_state_t;
+
+typedef struct {
+    http_multipart_state_t state;
+    char delimiter[HTTP_MULTIPART_MAX_BOUNDARY_LEN + 5];  // "\r\n--" followed by the boundary
+    uint8_t delimiterLen;
+    uint8_t matched;                                      // Number of delimiter bytes matched so far
+    uint8_t dashes;                                       // Number of '-' after the first delimiter
+    uint8_t hasPart;                                      // The body of the first part has started
+    char line[HTTP_MULTIPART_MAX_LINE_LEN];               // Current part header line, truncated
+    uint8_t lineLen;
+    char filename[HTTP_MULTIPART_MAX_FILENAME_LEN + 1];   // From the part's Content-Disposition, truncated
+} http_multipart_t;
+
+int http_multipart_init(http_multipart_t* parser, const char* contentType);
+size_t http_multipart_parse(http_multipart_t* parser, const uint8_t* in, size_t inLen, const uint8_t** data, size_t* dataLen);
+int http_parse_range(const char* value, size_t size, size_t* start, size_t* end);
+int http_etag_match(const char* ifNoneMatch, const char* etag);
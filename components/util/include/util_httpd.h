@@ -1,10 +1,14 @@
 #pragma once
 
+#include "freertos/FreeRTOS.h"
 #include "esp_http_server.h"
 
 
 #define HTTPD_401 "401 Unauthorized"
 
+// Content-Encoding used for PackBits compressed buffer bodies
+#define HTTPD_ENCODING_RLE "x-packbits"
+
 
 typedef struct {
     char* username;
@@ -16,4 +20,12 @@ typedef struct {
 esp_err_t abortRequest(httpd_req_t *req, const char* message);
 esp_err_t post_recv_handler(const char* log_tag, httpd_req_t *req, uint8_t* dest, uint32_t max_size);
 char* http_auth_basic_digest(const char *username, const char *password);
-bool basic_auth_handler(httpd_req_t* req, const char* log_tag);
\ No newline at end of file
+bool basic_auth_handler(httpd_req_t* req, const char* log_tag);
+void httpd_set_asset_etag(const char* etag);
+esp_err_t httpd_send_asset(httpd_req_t* req, const char* type, const uint8_t* start, const uint8_t* end, bool gzipped);
+bool httpd_req_is_raw(httpd_req_t* req);
+bool httpd_req_accepts_raw(httpd_req_t* req);
+esp_err_t httpd_recv_to_buffer(const char* log_tag, httpd_req_t* req, uint8_t* dest, size_t max_size, portMUX_TYPE* lock, size_t* rx_len);
+esp_err_t httpd_recv_base64_to_buffer(const char* log_tag, httpd_req_t* req, uint8_t* dest, size_t max_size, portMUX_TYPE* lock, size_t* rx_len);
+esp_err_t httpd_send_buffer(const char* log_tag, httpd_req_t* req, uint8_t* src, size_t size, portMUX_TYPE* lock);
+esp_err_t httpd_send_file(const char* log_tag, httpd_req_t* req, const char* path);
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "esp_log.h"
 #include "mbedtls/base64.h"
 #include "sys/param.h"
+#include <stdlib.h>
 #include <string.h>
 
 
@@ -215,4 +216,163 @@ esp_err_t buffer_to_base64(uint8_t* buf, size_t buf_size, uint8_t** out) {
     } else {
         return ESP_FAIL;
     }
-}
\ No newline at end of file
+}
+esp_err_t buffer_rle_decode(buffer_rle_state_t* state, const uint8_t* in, size_t inLen, uint8_t* out, size_t outSize, size_t* outPos) {
+    /*
+    Decode PackBits data into out, starting at *outPos.
+    The state is kept between calls so the input can be fed in arbitrary chunks.
+    Header byte n: 0...127 = n+1 literal bytes follow, 129...255 = next byte repeated 257-n times, 128 = no-op
+    */
+    for (size_t i = 0; i < inLen; i++) {
+        uint8_t b = in[i];
+        if (state->literal) {
+            if (*outPos >= outSize) return ESP_ERR_INVALID_SIZE;
+            out[(*outPos)++] = b;
+            state->literal--;
+        } else if (state->run) {
+            if (state->run > outSize - *outPos) return ESP_ERR_INVALID_SIZE;
+            memset(&out[*outPos], b, state->run);
+            *outPos += state->run;
+            state->run = 0;
+        } else if (b < 128) {
+            state->literal = b + 1;
+        } else if (b > 128) {
+            state->run = 257 - b;
+        }
+    }
+    return ESP_OK;
+}
+
+static int8_t _buffer_base64_value(uint8_t c) {
+    if (c >= 'A' && c <= 'Z') return c - 'A';
+    if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+    if (c >= '0' && c <= '9') return c - '0' + 52;
+    if (c == '+') return 62;
+    if (c == '/') return 63;
+    return -1;
+}
+
+static esp_err_t _buffer_base64_flush(buffer_base64_state_t* state, uint8_t numBytes, uint8_t* out, size_t outSize, size_t* outPos) {
+    // Write the first numBytes of the current quantum, left aligned in 24 bits
+    uint32_t bits = state->bits << (6 * (4 - state->count));
+    if (numBytes > outSize - *outPos) return ESP_ERR_INVALID_SIZE;
+    for (uint8_t i = 0; i < numBytes; i++) {
+        out[(*outPos)++] = (bits >> (16 - 8 * i)) & 0xFF;
+    }
+    state->bits = 0;
+    state->count = 0;
+    return ESP_OK;
+}
+
+esp_err_t buffer_base64_decode(buffer_base64_state_t* state, const uint8_t* in, size_t inLen, uint8_t* out, size_t outSize, size_t* outPos) {
+    /*
+    Decode base64 data into out, starting at *outPos.
+    The state is kept between calls so the input can be fed in arbitrary chunks.
+    Whitespace is ignored. Call buffer_base64_decode_finish() after the last chunk.
+    */
+    esp_err_t ret;
+    for (size_t i = 0; i < inLen; i++) {
+        uint8_t c = in[i];
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') continue;
+        if (c == '=') {
+            // Padding ends the data, "xx==" or "xxx="
+            if (state->count < 2) return ESP_ERR_INVALID_ARG;
+            state->padding++;
+            if (state->count + state->padding == 4) {
+                ret = _buffer_base64_flush(state, state->count - 1, out, outSize, outPos);
+                if (ret != ESP_OK) return ret;
+            }
+            continue;
+        }
+        int8_t value = _buffer_base64_value(c);
+        if (value < 0 || state->padding) return ESP_ERR_INVALID_ARG;
+        state->bits = (state->bits << 6) | value;
+        state->count++;
+        if (state->count == 4) {
+            ret = _buffer_base64_flush(state, 3, out, outSize, outPos);
+            if (ret != ESP_OK) return ret;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t buffer_base64_decode_finish(buffer_base64_state_t* state, uint8_t* out, size_t outSize, size_t* outPos) {
+    // Unpadded input may end with 2 or 3 sextets, which hold 1 or 2 bytes
+    if (state->count == 0) return ESP_OK;
+    if (state->count == 1 || state->padding) return ESP_ERR_INVALID_ARG;
+    return _buffer_base64_flush(state, state->count - 1, out, outSize, outPos);
+}
+
+size_t buffer_rle_encode(const uint8_t* in, size_t inLen, size_t* inPos, uint8_t* out, size_t outSize) {
+    /*
+    Encode in as PackBits, starting at *inPos, until in is done or out is full.
+    Only whole packets are written, so outSize needs to be at least 129 bytes to always make progress.
+    Returns the number of bytes written to out and advances *inPos accordingly.
+    */
+    size_t outLen = 0;
+    size_t i = *inPos;
+    while (i < inLen) {
+        size_t run = 1;
+        while (i + run < inLen && run < 128 && in[i + run] == in[i]) run++;
+
+        if (run >= 3) {
+            if (outSize - outLen < 2) break;
+            out[outLen++] = 257 - run;
+            out[outLen++] = in[i];
+            i += run;
+        } else {
+            // Collect literals until a run of at least 3 bytes starts
+            size_t lit = 0;
+            while (i + lit < inLen && lit < 128) {
+                if (i + lit + 2 < inLen && in[i + lit] == in[i + lit + 1] && in[i + lit] == in[i + lit + 2]) break;
+                lit++;
+            }
+            if (outSize - outLen < lit + 1) break;
+            out[outLen++] = lit - 1;
+            memcpy(&out[outLen], &in[i], lit);
+            outLen += lit;
+            i += lit;
+        }
+    }
+    *inPos = i;
+    return outLen;
+}
+
+esp_err_t buffer_char_output_init(buffer_char_output_t* output, size_t charBufSize) {
+    output->charBuf = malloc(charBufSize);
+    output->quirkFlagBuf = malloc(charBufSize * sizeof(uint16_t));
+    output->charBufSize = charBufSize;
+    output->valid = 0;
+    if (charBufSize > 0 && (output->charBuf == NULL || output->quirkFlagBuf == NULL)) {
+        free(output->charBuf);
+        free(output->quirkFlagBuf);
+        output->charBuf = NULL;
+        output->quirkFlagBuf = NULL;
+        output->charBufSize = 0;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void buffer_char_output_invalidate(buffer_char_output_t* output) {
+    // Makes the next check report a change, e.g. when something else affecting the output has changed
+    output->valid = 0;
+}
+
+uint8_t buffer_char_output_changed(buffer_char_output_t* output, const uint8_t* charBuf, const uint16_t* quirkFlagBuf, size_t charBufSize) {
+    /*
+    Compare the final character output (after effects) against the one from the previous call.
+    Returns 1 if it differs, i.e. the display needs to be updated, and stores the new output.
+    Without memory for the copy (or if the size doesn't match), every call reports a change.
+    */
+    if (output->charBuf == NULL || charBufSize != output->charBufSize) return 1;
+    if (output->valid
+        && memcmp(output->charBuf, charBuf, charBufSize) == 0
+        && memcmp(output->quirkFlagBuf, quirkFlagBuf, charBufSize * sizeof(uint16_t)) == 0) {
+        return 0;
+    }
+    memcpy(output->charBuf, charBuf, charBufSize);
+    memcpy(output->quirkFlagBuf, quirkFlagBuf, charBufSize * sizeof(uint16_t));
+    output->valid = 1;
+    return 1;
+}
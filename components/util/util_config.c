@@ -0,0 +1,480 @@
+#include "util_config.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+
+#define LOG_TAG "Config"
+
+// NVS limits strings to 4000 bytes including the null terminator
+#define CFG_REG_MAX_STR_LENGTH 3999
+
+
+// List of all config options
+static const config_entry_t config_entries[] = {
+    {.key = "hostname",        .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Network hostname. A-Z, a-z, 0-9 and - allowed."},
+    {.key = "sta_ssid",        .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WiFi SSID to connect to"},
+    {.key = "sta_anon_ident",  .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Anonymous Identity"},
+    {.key = "sta_ident",       .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Identity"},
+    {.key = "sta_pass",        .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WiFi password"},
+    {.key = "sta_phase2",      .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Phase 2 Auth. 0=TLS, 1=PEAP, 2=TTLS"},
+    {.key = "sta_phase2_ttls", .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "802.1X Phase 2 TTLS. 0=None, 1=MSCHAPv2, 2=MSCHAP, 3=PAP, 4=CHAP"},
+    {.key = "sta_retries",     .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "Number of WiFi connection attempts before giving up and starting AP"},
+    {.key = "sta_fallb_ssid",  .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Secondary WiFi SSID if primary does not work"},
+    {.key = "sta_fallb_pass",  .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Secondary WiFi password"},
+    {.key = "ap_ssid",         .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "SSID of access-point WiFi when normal connection fails"},
+    {.key = "ap_pass",         .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Password of access-point WiFi"},
+    {.key = "ap_timeout",      .dataType = CONFIG_TYPE_U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "Timeout until AP WiFi shuts down if no connection is made (in seconds). 0 for no timeout."},
+    {.key = "tg_bot_token",    .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "Telegram Bot API token to use for controlling the display via Telegram"},
+    {.key = "tg_log_chnl_id",  .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "Telegram chat ID of channel to log received texts to"},
+    {.key = "tg_log_chnl_en",  .dataType = CONFIG_TYPE_U8 , .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to enable logging to Telegram channel, 0 to disable"},
+    {.key = "tg_deadtime",     .dataType = CONFIG_TYPE_U8 , .flags = BC_FIELD_FLAGS_NONE, .comment = "Minimum dead time between Telegram messages in seconds"},
+    {.key = "disp_led_gamma",  .dataType = CONFIG_TYPE_U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "Gamma value for LED color displays"},
+    {.key = "sel_conf_file",   .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Configuration file for selection display"},
+    {.key = "cnv_preset_file", .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Preset file for canvas"},
+    {.key = "startup_file",    .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Startup default settings file"},
+    {.key = "wg_private_key",  .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "WireGuard private key"},
+    {.key = "wg_public_key",   .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "WireGuard public key"},
+    {.key = "wg_allowed_ip",   .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard allowed IP base"},
+    {.key = "wg_allowed_mask", .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard allowed IP subnet mask"},
+    {.key = "wg_listen_port",  .dataType = CONFIG_TYPE_U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard listening port"},
+    {.key = "wg_endpoint",     .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard endpoint IP"},
+    {.key = "wg_endpnt_port",  .dataType = CONFIG_TYPE_U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard endpoint port"},
+    {.key = "wg_keepalive",    .dataType = CONFIG_TYPE_U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "WireGuard keepalive period (in seconds)"},
+    {.key = "playlist_active", .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to enable playlist playback, 0 to disable"},
+    {.key = "pl_poll_url",     .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_NONE, .comment = "URL to fetch a playlist file from"},
+    {.key = "pl_poll_token",   .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_WRITE_ONLY, .comment = "API token to fetch playlist from server"},
+    {.key = "pl_poll_intvl",   .dataType = CONFIG_TYPE_U16, .flags = BC_FIELD_FLAGS_NONE, .comment = "Playlist polling interval (in seconds). Refreshes the given playlist URL or file periodically. 0 to disable."},
+    {.key = "playlist_file",   .dataType = CONFIG_TYPE_STR, .flags = BC_FIELD_FLAGS_SPIFFS_FILE_SELECT, .comment = "Playlist file to use"},
+    {.key = "pl_save_to_file", .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to save downloaded playlist to specified playlist file, 0 to disable"},
+    {.key = "canvas_use_auth", .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "1 to require authentication to use the canvas, 0 to disable"},
+    {.key = "deflt_bright",    .dataType = CONFIG_TYPE_U8,  .flags = BC_FIELD_FLAGS_NONE, .comment = "Default brightness of the display"},
+};
+
+#define CFG_REG_NUM_ENTRIES (sizeof(config_entries) / sizeof(config_entries[0]))
+
+typedef struct {
+    uint8_t isSet;
+    int64_t number;     // All numeric types, sign or zero extended
+    char* string;
+} config_value_t;
+
+typedef struct {
+    const char* key;    // NULL for all keys
+    config_change_cb_t callback;
+    void* arg;
+} config_subscriber_t;
+
+static nvs_handle_t config_nvs_handle;
+static config_value_t config_values[CFG_REG_NUM_ENTRIES];
+static config_value_t config_staged[CFG_REG_NUM_ENTRIES];
+static config_subscriber_t config_subscribers[CFG_REG_MAX_SUBSCRIBERS];
+static volatile uint8_t config_num_subscribers = 0;
+
+// Held while reading or swapping values, never during flash access
+static SemaphoreHandle_t config_value_lock = NULL;
+// Held by the task running a transaction, from config_begin() until config_commit() or config_abort()
+static SemaphoreHandle_t config_txn_lock = NULL;
+
+
+static int _config_find_index(const char* key) {
+    for (uint16_t i = 0; i < CFG_REG_NUM_ENTRIES; i++) {
+        if (strcmp(config_entries[i].key, key) == 0) return i;
+    }
+    return -1;
+}
+
+static uint8_t _config_is_numeric(config_data_type_t type) {
+    return type >= CONFIG_TYPE_I8 && type <= CONFIG_TYPE_U64;
+}
+
+static uint8_t _config_in_range(config_data_type_t type, int64_t value) {
+    switch (type) {
+        case CONFIG_TYPE_I8:  return value >= INT8_MIN && value <= INT8_MAX;
+        case CONFIG_TYPE_U8:  return value >= 0 && value <= UINT8_MAX;
+        case CONFIG_TYPE_I16: return value >= INT16_MIN && value <= INT16_MAX;
+        case CONFIG_TYPE_U16: return value >= 0 && value <= UINT16_MAX;
+        case CONFIG_TYPE_I32: return value >= INT32_MIN && value <= INT32_MAX;
+        case CONFIG_TYPE_U32: return value >= 0 && value <= UINT32_MAX;
+        case CONFIG_TYPE_I64: return 1;
+        case CONFIG_TYPE_U64: return value >= 0;
+        default:  return 0;
+    }
+}
+
+static esp_err_t _config_read_nvs(uint16_t index, config_value_t* value) {
+    const char* key = config_entries[index].key;
+    esp_err_t ret;
+
+    switch (config_entries[index].dataType) {
+        case CONFIG_TYPE_I8: {
+            int8_t v;
+            ret = nvs_get_i8(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_U8: {
+            uint8_t v;
+            ret = nvs_get_u8(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_I16: {
+            int16_t v;
+            ret = nvs_get_i16(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_U16: {
+            uint16_t v;
+            ret = nvs_get_u16(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_I32: {
+            int32_t v;
+            ret = nvs_get_i32(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_U32: {
+            uint32_t v;
+            ret = nvs_get_u32(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_I64: {
+            int64_t v;
+            ret = nvs_get_i64(config_nvs_handle, key, &v);
+            value->number = v;
+            break;
+        }
+        case CONFIG_TYPE_U64: {
+            uint64_t v;
+            ret = nvs_get_u64(config_nvs_handle, key, &v);
+            value->number = (int64_t)v;
+            break;
+        }
+        case CONFIG_TYPE_STR: {
+            size_t length;
+            ret = nvs_get_str(config_nvs_handle, key, NULL, &length);
+            if (ret != ESP_OK) break;
+            value->string = malloc(length);
+            if (value->string == NULL) return ESP_ERR_NO_MEM;
+            ret = nvs_get_str(config_nvs_handle, key, value->string, &length);
+            if (ret != ESP_OK) {
+                free(value->string);
+                value->string = NULL;
+            }
+            break;
+        }
+        default: {
+            // CONFIG_TYPE_BLOB is not yet implemented
+            return ESP_ERR_NOT_SUPPORTED;
+        }
+    }
+
+    value->isSet = (ret == ESP_OK);
+    return ret;
+}
+
+static esp_err_t _config_write_nvs(uint16_t index, const config_value_t* value) {
+    const char* key = config_entries[index].key;
+
+    // Writing an unset value restores the state before the key was ever written
+    if (!value->isSet) {
+        esp_err_t ret = nvs_erase_key(config_nvs_handle, key);
+        return (ret == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : ret;
+    }
+
+    switch (config_entries[index].dataType) {
+        case CONFIG_TYPE_I8:  return nvs_set_i8(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_U8:  return nvs_set_u8(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_I16: return nvs_set_i16(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_U16: return nvs_set_u16(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_I32: return nvs_set_i32(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_U32: return nvs_set_u32(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_I64: return nvs_set_i64(config_nvs_handle, key, value->number);
+        case CONFIG_TYPE_U64: return nvs_set_u64(config_nvs_handle, key, (uint64_t)value->number);
+        case CONFIG_TYPE_STR: return nvs_set_str(config_nvs_handle, key, value->string);
+        default:  return ESP_ERR_NOT_SUPPORTED;
+    }
+}
+
+static uint8_t _config_value_equal(uint16_t index, const config_value_t* a, const config_value_t* b) {
+    if (a->isSet != b->isSet) return 0;
+    if (!a->isSet) return 1;
+    if (config_entries[index].dataType == CONFIG_TYPE_STR) return strcmp(a->string, b->string) == 0;
+    return a->number == b->number;
+}
+
+static void _config_clear_staged(void) {
+    for (uint16_t i = 0; i < CFG_REG_NUM_ENTRIES; i++) {
+        free(config_staged[i].string);
+        config_staged[i].string = NULL;
+        config_staged[i].isSet = 0;
+    }
+}
+
+static esp_err_t _config_check_txn(void) {
+    // Only the task that started the transaction may add to it
+    if (config_txn_lock == NULL || xSemaphoreGetMutexHolder(config_txn_lock) != xTaskGetCurrentTaskHandle()) {
+        ESP_LOGE(LOG_TAG, "Not in a transaction");
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t config_init(nvs_handle_t* nvsHandle) {
+    /*
+     * Load all config options from NVS. Must be called once at boot,
+     * before any other function of the registry is used.
+     */
+    config_nvs_handle = *nvsHandle;
+    config_value_lock = xSemaphoreCreateMutex();
+    config_txn_lock = xSemaphoreCreateMutex();
+    if (config_value_lock == NULL || config_txn_lock == NULL) return ESP_ERR_NO_MEM;
+
+    for (uint16_t i = 0; i < CFG_REG_NUM_ENTRIES; i++) {
+        if (config_entries[i].dataType == CONFIG_TYPE_BLOB) continue;
+        esp_err_t ret = _config_read_nvs(i, &config_values[i]);
+        if (ret != ESP_OK && ret != ESP_ERR_NVS_NOT_FOUND) {
+            // Treat it as unset, so the owner falls back to its default
+            ESP_LOGE(LOG_TAG, "Failed to load %s: %s", config_entries[i].key, esp_err_to_name(ret));
+        }
+    }
+    ESP_LOGI(LOG_TAG, "Loaded %d entries", (int)CFG_REG_NUM_ENTRIES);
+    return ESP_OK;
+}
+
+const config_entry_t* config_get_entries(uint16_t* numEntries) {
+    *numEntries = CFG_REG_NUM_ENTRIES;
+    return config_entries;
+}
+
+const config_entry_t* config_find_entry(const char* key) {
+    int index = _config_find_index(key);
+    return (index < 0) ? NULL : &config_entries[index];
+}
+
+static esp_err_t _config_get_number(const char* key, config_data_type_t type, int64_t* value) {
+    int index = _config_find_index(key);
+    if (index < 0 || config_value_lock == NULL) return ESP_ERR_NVS_NOT_FOUND;
+    if (type == 0 ? !_config_is_numeric(config_entries[index].dataType) : config_entries[index].dataType != type) {
+        return ESP_ERR_NVS_TYPE_MISMATCH;
+    }
+
+    esp_err_t ret = ESP_ERR_NVS_NOT_FOUND;
+    xSemaphoreTake(config_value_lock, portMAX_DELAY);
+    if (config_values[index].isSet) {
+        *value = config_values[index].number;
+        ret = ESP_OK;
+    }
+    xSemaphoreGive(config_value_lock);
+    return ret;
+}
+
+esp_err_t config_get_int(const char* key, int64_t* value) {
+    /*
+     * Get the value of a numeric option of any type.
+     * Returns ESP_ERR_NVS_NOT_FOUND if it has never been set.
+     */
+    return _config_get_number(key, 0, value);
+}
+
+esp_err_t config_get_u8(const char* key, uint8_t* value) {
+    int64_t number;
+    esp_err_t ret = _config_get_number(key, CONFIG_TYPE_U8, &number);
+    if (ret == ESP_OK) *value = number;
+    return ret;
+}
+
+esp_err_t config_get_u16(const char* key, uint16_t* value) {
+    int64_t number;
+    esp_err_t ret = _config_get_number(key, CONFIG_TYPE_U16, &number);
+    if (ret == ESP_OK) *value = number;
+    return ret;
+}
+
+esp_err_t config_get_str(const char* key, char* value, size_t* length) {
+    /*
+     * Copy a string option into value, which can hold length bytes.
+     * Behaves like nvs_get_str(): if value is NULL, only the required length is returned.
+     */
+    int index = _config_find_index(key);
+    if (index < 0 || config_value_lock == NULL) return ESP_ERR_NVS_NOT_FOUND;
+    if (config_entries[index].dataType != CONFIG_TYPE_STR) return ESP_ERR_NVS_TYPE_MISMATCH;
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(config_value_lock, portMAX_DELAY);
+    if (!config_values[index].isSet) {
+        ret = ESP_ERR_NVS_NOT_FOUND;
+    } else {
+        size_t required = strlen(config_values[index].string) + 1;
+        if (value != NULL) {
+            if (*length < required) ret = ESP_ERR_NVS_INVALID_LENGTH;
+            else memcpy(value, config_values[index].string, required);
+        }
+        if (ret == ESP_OK) *length = required;
+    }
+    xSemaphoreGive(config_value_lock);
+    return ret;
+}
+
+char* config_get_str_alloc(const char* key) {
+    /*
+     * Get a copy of a string option, which the caller has to free.
+     * Returns NULL if it has never been set.
+     */
+    int index = _config_find_index(key);
+    if (index < 0 || config_value_lock == NULL || config_entries[index].dataType != CONFIG_TYPE_STR) return NULL;
+
+    char* value = NULL;
+    xSemaphoreTake(config_value_lock, portMAX_DELAY);
+    if (config_values[index].isSet) value = strdup(config_values[index].string);
+    xSemaphoreGive(config_value_lock);
+    return value;
+}
+
+esp_err_t config_begin(void) {
+    /*
+     * Start a transaction. Other tasks starting a transaction wait until this one is
+     * committed or aborted, reading values is possible all the time.
+     */
+    if (config_txn_lock == NULL) return ESP_ERR_INVALID_STATE;
+    xSemaphoreTake(config_txn_lock, portMAX_DELAY);
+    return ESP_OK;
+}
+
+esp_err_t config_set_int(const char* key, int64_t value) {
+    /*
+     * Stage a new value for a numeric option in the current transaction.
+     * Returns ESP_ERR_INVALID_ARG if the value doesn't fit the option's type.
+     */
+    esp_err_t ret = _config_check_txn();
+    if (ret != ESP_OK) return ret;
+    int index = _config_find_index(key);
+    if (index < 0) return ESP_ERR_NVS_NOT_FOUND;
+    if (!_config_is_numeric(config_entries[index].dataType)) return ESP_ERR_NVS_TYPE_MISMATCH;
+    if (!_config_in_range(config_entries[index].dataType, value)) return ESP_ERR_INVALID_ARG;
+
+    config_staged[index].number = value;
+    config_staged[index].isSet = 1;
+    return ESP_OK;
+}
+
+esp_err_t config_set_str(const char* key, const char* value) {
+    /*
+     * Stage a new value for a string option in the current transaction.
+     */
+    esp_err_t ret = _config_check_txn();
+    if (ret != ESP_OK) return ret;
+    int index = _config_find_index(key);
+    if (index < 0) return ESP_ERR_NVS_NOT_FOUND;
+    if (config_entries[index].dataType != CONFIG_TYPE_STR) return ESP_ERR_NVS_TYPE_MISMATCH;
+    if (strlen(value) > CFG_REG_MAX_STR_LENGTH) return ESP_ERR_NVS_VALUE_TOO_LONG;
+
+    char* copy = strdup(value);
+    if (copy == NULL) return ESP_ERR_NO_MEM;
+    free(config_staged[index].string);
+    config_staged[index].string = copy;
+    config_staged[index].isSet = 1;
+    return ESP_OK;
+}
+
+esp_err_t config_commit(void) {
+    /*
+     * Write all staged values to NVS and end the transaction.
+     * Unchanged values are skipped to save flash writes. On write errors, the keys
+     * written so far are rolled back to their previous values. This is best effort:
+     * NVS stores each key on its own, so a failed rollback or a reset in between
+     * can leave some of the changes in flash. The values in RAM only change on success.
+     * Subscribers are called for every changed key once the new values are visible.
+     */
+    esp_err_t ret = _config_check_txn();
+    if (ret != ESP_OK) return ret;
+
+    uint8_t changed[CFG_REG_NUM_ENTRIES] = { 0 };
+    uint16_t i;
+    for (i = 0; i < CFG_REG_NUM_ENTRIES; i++) {
+        if (!config_staged[i].isSet || _config_value_equal(i, &config_staged[i], &config_values[i])) continue;
+        ret = _config_write_nvs(i, &config_staged[i]);
+        if (ret != ESP_OK) {
+            ESP_LOGE(LOG_TAG, "Failed to write %s: %s", config_entries[i].key, esp_err_to_name(ret));
+            break;
+        }
+        changed[i] = 1;
+    }
+    if (ret == ESP_OK) ret = nvs_commit(config_nvs_handle);
+
+    if (ret != ESP_OK) {
+        // Only this task writes, so the values in RAM still match what was in NVS before
+        for (uint16_t j = 0; j < CFG_REG_NUM_ENTRIES; j++) {
+            if (changed[j] && _config_write_nvs(j, &config_values[j]) != ESP_OK) {
+                ESP_LOGE(LOG_TAG, "Failed to restore %s", config_entries[j].key);
+            }
+        }
+        nvs_commit(config_nvs_handle);
+        _config_clear_staged();
+        xSemaphoreGive(config_txn_lock);
+        return ret;
+    }
+
+    xSemaphoreTake(config_value_lock, portMAX_DELAY);
+    for (i = 0; i < CFG_REG_NUM_ENTRIES; i++) {
+        if (!changed[i]) continue;
+        // Swap, so the old string is freed with the staging area
+        config_value_t old = config_values[i];
+        config_values[i] = config_staged[i];
+        config_staged[i] = old;
+    }
+    xSemaphoreGive(config_value_lock);
+    _config_clear_staged();
+    xSemaphoreGive(config_txn_lock);
+
+    // Outside of the locks, so callbacks can read values or start their own transaction
+    uint8_t numSubscribers = config_num_subscribers;
+    for (i = 0; i < CFG_REG_NUM_ENTRIES; i++) {
+        if (!changed[i]) continue;
+        ESP_LOGI(LOG_TAG, "Changed: %s", config_entries[i].key);
+        for (uint8_t s = 0; s < numSubscribers; s++) {
+            if (config_subscribers[s].key == NULL || strcmp(config_subscribers[s].key, config_entries[i].key) == 0) {
+                config_subscribers[s].callback(config_entries[i].key, config_subscribers[s].arg);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+void config_abort(void) {
+    /*
+     * Discard all staged values and end the transaction.
+     */
+    if (_config_check_txn() != ESP_OK) return;
+    _config_clear_staged();
+    xSemaphoreGive(config_txn_lock);
+}
+
+esp_err_t config_subscribe(const char* key, config_change_cb_t callback, void* arg) {
+    /*
+     * Register a callback for changes of key, or of any option if key is NULL.
+     * Callbacks run in the task that committed the change and should return quickly.
+     */
+    if (config_value_lock == NULL) return ESP_ERR_INVALID_STATE;
+
+    esp_err_t ret = ESP_OK;
+    xSemaphoreTake(config_value_lock, portMAX_DELAY);
+    if (config_num_subscribers >= CFG_REG_MAX_SUBSCRIBERS) {
+        ret = ESP_ERR_NO_MEM;
+    } else {
+        config_subscribers[config_num_subscribers].key = key;
+        config_subscribers[config_num_subscribers].callback = callback;
+        config_subscribers[config_num_subscribers].arg = arg;
+        // Only count it once it's complete, commits read the list without locking
+        config_num_subscribers++;
+    }
+    xSemaphoreGive(config_value_lock);
+    return ret;
+}
@@ -1,17 +1,18 @@
 #include "util_disp_selection.h"
 
 #include "esp_log.h"
+#include "util_config.h"
 #include "util_nvs.h"
 #include "macros.h"
 #include <stdio.h>
 
 
 // Load the configuration for a selection-based display from the JSON file in SPIFFS
-// whose name is stored in NVS and store the cJSON object in the given pointer
+// whose name is in the configuration and store the cJSON object in the given pointer
 esp_err_t display_selection_loadConfiguration(nvs_handle_t* nvsHandle, cJSON** json, const char* log_tag) {
-    char* confFile = get_string_from_nvs(nvsHandle, "sel_conf_file");
+    char* confFile = config_get_str_alloc("sel_conf_file");
     if (confFile == NULL) {
-        ESP_LOGE(log_tag, "Failed to get configuration file name from NVS");
+        ESP_LOGE(log_tag, "No configuration file name set");
         return ESP_FAIL;
     }
     esp_err_t ret = get_json_from_spiffs(confFile, json, log_tag);
@@ -20,7 +21,7 @@ esp_err_t display_selection_loadConfiguration(nvs_handle_t* nvsHandle, cJSON** j
 }
 
 // Load the configuration for a selection-based display from the JSON file in SPIFFS
-// whose name is stored in NVS and set the framebuffer mask and unit count based on the data therein.
+// whose name is in the configuration and set the framebuffer mask and unit count based on the data therein.
 esp_err_t display_selection_loadAndParseConfiguration(nvs_handle_t* nvsHandle, uint8_t* display_framebuf_mask, uint16_t* display_num_units, const char* log_tag) {
     cJSON* json;
     esp_err_t ret = display_selection_loadConfiguration(nvsHandle, &json, log_tag);
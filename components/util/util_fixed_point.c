@@ -1,5 +1,67 @@
 #include "util_fixed_point.h"
 
+#if defined(CONFIG_FIXED_POINT_MATH_FAST)
+// sin(x) for x = 0 ... pi/2 in 256 steps.
+// One extra entry so interpolating at pi/2 stays within the table.
+static const int16_t sin_table_fx20_12[258] = {
+       0,   25,   50,   75,  101,  126,  151,  176,  201,  226,  251,  276,  301,  326,  351,  376,
+     401,  426,  451,  476,  501,  526,  551,  576,  601,  626,  651,  675,  700,  725,  750,  774,
+     799,  824,  848,  873,  897,  922,  946,  971,  995, 1020, 1044, 1068, 1092, 1117, 1141, 1165,
+    1189, 1213, 1237, 1261, 1285, 1309, 1332, 1356, 1380, 1404, 1427, 1451, 1474, 1498, 1521, 1544,
+    1567, 1591, 1614, 1637, 1660, 1683, 1706, 1729, 1751, 1774, 1797, 1819, 1842, 1864, 1886, 1909,
+    1931, 1953, 1975, 1997, 2019, 2041, 2062, 2084, 2106, 2127, 2149, 2170, 2191, 2213, 2234, 2255,
+    2276, 2296, 2317, 2338, 2359, 2379, 2399, 2420, 2440, 2460, 2480, 2500, 2520, 2540, 2559, 2579,
+    2598, 2618, 2637, 2656, 2675, 2694, 2713, 2732, 2751, 2769, 2788, 2806, 2824, 2843, 2861, 2878,
+    2896, 2914, 2932, 2949, 2967, 2984, 3001, 3018, 3035, 3052, 3068, 3085, 3102, 3118, 3134, 3150,
+    3166, 3182, 3198, 3214, 3229, 3244, 3260, 3275, 3290, 3305, 3320, 3334, 3349, 3363, 3378, 3392,
+    3406, 3420, 3433, 3447, 3461, 3474, 3487, 3500, 3513, 3526, 3539, 3551, 3564, 3576, 3588, 3600,
+    3612, 3624, 3636, 3647, 3659, 3670, 3681, 3692, 3703, 3713, 3724, 3734, 3745, 3755, 3765, 3775,
+    3784, 3794, 3803, 3812, 3822, 3831, 3839, 3848, 3857, 3865, 3873, 3881, 3889, 3897, 3905, 3912,
+    3920, 3927, 3934, 3941, 3948, 3954, 3961, 3967, 3973, 3979, 3985, 3991, 3996, 4002, 4007, 4012,
+    4017, 4022, 4027, 4031, 4036, 4040, 4044, 4048, 4052, 4055, 4059, 4062, 4065, 4068, 4071, 4074,
+    4076, 4079, 4081, 4083, 4085, 4087, 4088, 4090, 4091, 4092, 4093, 4094, 4095, 4095, 4096, 4096,
+    4096, 4096,
+};
+
+// Initial estimates for sqrt(x) with x normalized to [2^30, 2^32),
+// indexed by the upper 8 bits of x (64 ... 255)
+static const uint16_t sqrt_seed_table[192] = {
+    32896, 33150, 33402, 33652, 33900, 34147, 34392, 34635, 34876, 35116, 35354, 35590,
+    35825, 36059, 36291, 36521, 36750, 36978, 37204, 37429, 37652, 37874, 38095, 38315,
+    38533, 38750, 38966, 39181, 39394, 39606, 39818, 40028, 40237, 40445, 40652, 40857,
+    41062, 41266, 41469, 41671, 41871, 42071, 42270, 42468, 42665, 42861, 43057, 43251,
+    43445, 43637, 43829, 44020, 44210, 44400, 44588, 44776, 44963, 45149, 45334, 45519,
+    45703, 45886, 46069, 46250, 46431, 46612, 46791, 46970, 47149, 47326, 47503, 47679,
+    47855, 48030, 48204, 48378, 48551, 48723, 48895, 49067, 49237, 49407, 49577, 49746,
+    49914, 50082, 50249, 50416, 50582, 50747, 50912, 51077, 51241, 51404, 51567, 51730,
+    51892, 52053, 52214, 52374, 52534, 52694, 52853, 53011, 53169, 53327, 53484, 53640,
+    53797, 53952, 54108, 54262, 54417, 54571, 54724, 54877, 55030, 55182, 55334, 55485,
+    55636, 55787, 55937, 56087, 56236, 56385, 56534, 56682, 56830, 56977, 57124, 57271,
+    57417, 57563, 57709, 57854, 57999, 58143, 58287, 58431, 58574, 58717, 58860, 59002,
+    59144, 59286, 59427, 59568, 59709, 59849, 59989, 60129, 60268, 60407, 60546, 60684,
+    60822, 60960, 61098, 61235, 61372, 61508, 61644, 61780, 61916, 62051, 62186, 62321,
+    62456, 62590, 62724, 62857, 62991, 63124, 63256, 63389, 63521, 63653, 63785, 63916,
+    64047, 64178, 64309, 64439, 64569, 64699, 64828, 64957, 65086, 65215, 65344, 65472,
+};
+#endif
+
+#if defined(CONFIG_FIXED_POINT_MATH_FAST)
+fx20_12_t sin_i16_to_fx20_12(int16_t i)
+{
+    // 0x8000 is a full period, so only the lower 15 bits matter.
+    // Quarter wave table lookup with linear interpolation between entries.
+    uint16_t u = (uint16_t)i & 0x7FFF;
+    uint16_t quadrant = u >> 13;
+    uint16_t pos = u & 0x1FFF;
+    if (quadrant & 1) pos = 0x2000 - pos;
+
+    uint16_t idx = pos >> 5;
+    int32_t frac = pos & 0x1F;
+    fx20_12_t y = sin_table_fx20_12[idx] + (((sin_table_fx20_12[idx + 1] - sin_table_fx20_12[idx]) * frac + 16) >> 5);
+
+    return (quadrant & 2) ? -y : y;
+}
+#else
 fx20_12_t sin_i16_to_fx20_12(int16_t i)
 {
     /* Convert (signed) input to a value between 0 and 8192. (8192 is pi/2, which is the region of the curve fit). */
@@ -29,12 +91,52 @@ fx20_12_t sin_i16_to_fx20_12(int16_t i)
 
     return c ? -y : y;
 }
+#endif
 
 fx20_12_t cos_i16_to_fx20_12(int16_t i)
 {
     return sin_i16_to_fx20_12(i + 0x2000);
 }
 
+#if defined(CONFIG_FIXED_POINT_MATH_FAST)
+fx20_12_t sqrt_i32_to_fx20_12(int32_t v) {
+    // Input is a regular integer, negative inputs return 0.
+    // Returns floor(sqrt(v) * 2^12), the exact result rounded down.
+    if (v <= 0) return 0;
+
+    // Normalize with an even shift, so sqrt(x) is in [2^15, 2^16)
+    uint8_t shift = __builtin_clz((uint32_t)v) & ~1;
+    uint32_t x = (uint32_t)v << shift;
+
+    // Table estimate and one Newton iteration get within a few units of sqrt(x),
+    // the remainder x - r^2 then corrects it to floor(sqrt(x))
+    uint32_t r = sqrt_seed_table[(x >> 24) - 64];
+    r = (r + x / r) >> 1;
+    if (r > 0xFFFF) r = 0xFFFF;
+    int64_t rem = (int64_t)x - r * r;
+    while (rem < 0) {
+        r--;
+        rem += 2 * r + 1;
+    }
+    while (rem > 2 * r) {
+        rem -= 2 * r + 1;
+        r++;
+    }
+
+    // sqrt(v) = sqrt(x) / 2^(shift / 2)
+    uint8_t k = shift / 2;
+    if (k >= 12) return (fx20_12_t)(r >> (k - 12));
+
+    // The remaining m fractional bits are rem / (sqrt(x) + r), which lies between
+    // rem / (2r + 1) and rem / 2r. These differ by less than one unit since r >= 2^15,
+    // so one division and one check of the next value give the exact floor.
+    // rem stays at most 2 * r, so rem << m fits in 32 bits.
+    uint8_t m = 12 - k;
+    uint32_t result = (r << m) + ((uint32_t)rem << m) / (2 * r + 1);
+    if ((uint64_t)(result + 1) * (result + 1) <= ((uint64_t)x << (2 * m))) result++;
+    return (fx20_12_t)result;
+}
+#else
 fx20_12_t sqrt_i32_to_fx20_12(int32_t v) {
     // sqrt with 16 fractional bits (gets converted to 12 bits), input is a regular integer
     uint32_t t, q, b, r;
@@ -56,6 +158,7 @@ fx20_12_t sqrt_i32_to_fx20_12(int32_t v) {
     if( r > q ) ++q;
     return (fx20_12_t)q >> 4;
 }
+#endif
 
 color_rgb_u8_t hsv_fx20_12_to_rgb_u8(color_hsv_fx20_12_t hsv) {
     fx20_12_t hue_fp, p_fp, q_fp, t_fp, remainder_fp;
@@ -156,4 +259,57 @@ int32_t interpolate_fx20_12_i32(fx20_12_t val, int32_t start, int32_t end) {
     fx20_12_t scaled_range_fx = val * range;
     int32_t result = start + UNFX20_12_ROUND(scaled_range_fx);
     return result;
-}
\ No newline at end of file
+}
+
+#if defined(CONFIG_FIXED_POINT_MATH_FAST)
+static inline void _hsv_to_rgb_u8_fast(fx20_12_t h, fx20_12_t v255, fx20_12_t p255, color_rgb_u8_t* out) {
+    /*
+    v255 and p255 are v * 255 and v * (1 - s) * 255.
+    Within each 60 degree sector, one channel is v, one is p and the third one
+    ramps linearly between them, so this works without branching on the sector.
+    */
+    static const uint8_t channels[6][3] = {
+        // Index into {v, p, ramp} for r, g and b
+        {0, 2, 1}, {2, 0, 1}, {1, 0, 2}, {1, 2, 0}, {2, 1, 0}, {0, 1, 2}
+    };
+    if (h < 0 || h >= FX20_12(360)) h = 0;
+    uint8_t sector = h / FX20_12(60);
+    fx20_12_t remainder_fx = (h - sector * FX20_12(60)) / 60;
+    // Ramp up in even sectors, down in odd sectors
+    if (sector & 1) remainder_fx = FX20_12(1) - remainder_fx;
+    fx20_12_t ramp255 = p255 + UNFX20_12((int64_t)(v255 - p255) * remainder_fx);
+
+    uint8_t values[3] = { UNFX20_12_ROUND(v255), UNFX20_12_ROUND(p255), UNFX20_12_ROUND(ramp255) };
+    out->r = values[channels[sector][0]];
+    out->g = values[channels[sector][1]];
+    out->b = values[channels[sector][2]];
+}
+#endif
+
+void hsv_fx20_12_to_rgb_u8_array(const color_hsv_fx20_12_t* hsv, color_rgb_u8_t* rgb, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        #if defined(CONFIG_FIXED_POINT_MATH_FAST)
+        fx20_12_t p255 = UNFX20_12(hsv[i].v * (FX20_12(1) - hsv[i].s)) * 255;
+        _hsv_to_rgb_u8_fast(hsv[i].h, hsv[i].v * 255, p255, &rgb[i]);
+        #else
+        rgb[i] = hsv_fx20_12_to_rgb_u8(hsv[i]);
+        #endif
+    }
+}
+
+void hue_fx20_12_to_rgb_u8_array(const fx20_12_t* hue, fx20_12_t s, fx20_12_t v, color_rgb_u8_t* rgb, uint32_t count) {
+    // Same as hsv_fx20_12_to_rgb_u8_array() with the same saturation and value for all colors
+    #if defined(CONFIG_FIXED_POINT_MATH_FAST)
+    fx20_12_t v255 = v * 255;
+    fx20_12_t p255 = UNFX20_12(v * (FX20_12(1) - s)) * 255;
+    for (uint32_t i = 0; i < count; i++) {
+        _hsv_to_rgb_u8_fast(hue[i], v255, p255, &rgb[i]);
+    }
+    #else
+    color_hsv_fx20_12_t hsv = {.s = s, .v = v};
+    for (uint32_t i = 0; i < count; i++) {
+        hsv.h = hue[i];
+        rgb[i] = hsv_fx20_12_to_rgb_u8(hsv);
+    }
+    #endif
+}
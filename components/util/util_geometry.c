@@ -0,0 +1,67 @@
+#include "util_geometry.h"
+#include <stdlib.h>
+
+
+static int geometry_compare_pixels(const void* a, const void* b) {
+    uint32_t offsetA = ((const geometry_pixel_t*)a)->offset;
+    uint32_t offsetB = ((const geometry_pixel_t*)b)->offset;
+    return (offsetA > offsetB) - (offsetA < offsetB);
+}
+
+esp_err_t geometry_init(geometry_t* geometry, uint16_t width, uint16_t height, uint16_t columnBytes, uint8_t bytesPerPixel, const uint16_t* activeOffsets, uint32_t numActiveOffsets) {
+    /*
+    Build the pixel list for a column-major buffer with columnBytes bytes per column.
+    If activeOffsets is NULL, every pixel of the frame is active. Otherwise it lists
+    the buffer offsets of the pixels that are actually visible (e.g. the pixels that have
+    an LED behind them), in any order. Offsets outside the frame and duplicates are ignored.
+    */
+    geometry->width = width;
+    geometry->height = height;
+    geometry->pixels = NULL;
+    geometry->numPixels = 0;
+    if (bytesPerPixel == 0 || columnBytes < height * bytesPerPixel) return ESP_ERR_INVALID_ARG;
+
+    uint32_t maxPixels = activeOffsets ? numActiveOffsets : (uint32_t)width * height;
+    if (maxPixels == 0) return ESP_OK;
+    geometry->pixels = malloc(maxPixels * sizeof(geometry_pixel_t));
+    if (geometry->pixels == NULL) return ESP_ERR_NO_MEM;
+
+    if (activeOffsets == NULL) {
+        // Column by column is already memory order
+        for (uint16_t x = 0; x < width; x++) {
+            for (uint16_t y = 0; y < height; y++) {
+                geometry_pixel_t* pixel = &geometry->pixels[geometry->numPixels++];
+                pixel->x = x;
+                pixel->y = y;
+                pixel->offset = x * columnBytes + y * bytesPerPixel;
+            }
+        }
+        return ESP_OK;
+    }
+
+    for (uint32_t i = 0; i < numActiveOffsets; i++) {
+        uint32_t offset = activeOffsets[i];
+        uint16_t x = offset / columnBytes;
+        uint16_t columnOffset = offset % columnBytes;
+        if (x >= width || columnOffset % bytesPerPixel != 0 || columnOffset / bytesPerPixel >= height) continue;
+        geometry_pixel_t* pixel = &geometry->pixels[geometry->numPixels++];
+        pixel->x = x;
+        pixel->y = columnOffset / bytesPerPixel;
+        pixel->offset = offset;
+    }
+
+    qsort(geometry->pixels, geometry->numPixels, sizeof(geometry_pixel_t), geometry_compare_pixels);
+    uint32_t numUnique = 0;
+    for (uint32_t i = 0; i < geometry->numPixels; i++) {
+        if (numUnique > 0 && geometry->pixels[numUnique - 1].offset == geometry->pixels[i].offset) continue;
+        geometry->pixels[numUnique++] = geometry->pixels[i];
+    }
+    geometry->numPixels = numUnique;
+    return ESP_OK;
+}
+
+void geometry_deinit(geometry_t* geometry) {
+    free(geometry->pixels);
+    geometry->pixels = NULL;
+    geometry->numPixels = 0;
+}
@@ -4,6 +4,9 @@
 
 #include "util_gpio.h"
 #include "rom/ets_sys.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include <stdlib.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -26,3 +29,56 @@ esp_err_t gpio_pulse_inv(gpio_num_t gpio_num, uint8_t level, uint32_t pulseWidth
 esp_err_t gpio_set(gpio_num_t gpio_num, uint8_t level, uint8_t activeLow) {
 	return gpio_set_level(gpio_num, activeLow ? !level : level);
 }
+
+esp_err_t gpio_bus_init(gpio_bus_t* bus, const gpio_num_t* pins, uint8_t numPins) {
+	/*
+	 * Set up the given pins as outputs and calculate the
+	 * register bits for every value, so writing a value is just a table lookup
+	 */
+
+	if (numPins == 0 || numPins > GPIO_BUS_MAX_PINS) return ESP_ERR_INVALID_ARG;
+	bus->valueBits = malloc((1 << numPins) * sizeof(uint64_t));
+	if (bus->valueBits == NULL) return ESP_ERR_NO_MEM;
+	bus->numPins = numPins;
+	bus->mask = 0;
+
+	for (uint8_t i = 0; i < numPins; i++) {
+		gpio_reset_pin(pins[i]);
+		gpio_set_direction(pins[i], GPIO_MODE_OUTPUT);
+		bus->mask |= GPIO_BIT(pins[i]);
+	}
+	for (uint32_t value = 0; value < (1 << numPins); value++) {
+		bus->valueBits[value] = 0;
+		for (uint8_t i = 0; i < numPins; i++) {
+			if (value & (1 << i)) bus->valueBits[value] |= GPIO_BIT(pins[i]);
+		}
+	}
+	return ESP_OK;
+}
+
+void gpio_bus_write(gpio_bus_t* bus, uint32_t value) {
+	uint64_t setBits = bus->valueBits[value & ((1 << bus->numPins) - 1)];
+	gpio_write_mask(setBits, bus->mask & ~setBits);
+}
+
+void gpio_write_mask(uint64_t setBits, uint64_t clearBits) {
+	/*
+	 * Change several outputs with one register write per bank
+	 * instead of a gpio_set_level() call per pin.
+	 * Outputs are cleared before others are set, so switching
+	 * between two enable lines never has both active.
+	 */
+
+	if ((uint32_t)clearBits) REG_WRITE(GPIO_OUT_W1TC_REG, (uint32_t)clearBits);
+	if (clearBits >> 32) REG_WRITE(GPIO_OUT1_W1TC_REG, (uint32_t)(clearBits >> 32));
+	if ((uint32_t)setBits) REG_WRITE(GPIO_OUT_W1TS_REG, (uint32_t)setBits);
+	if (setBits >> 32) REG_WRITE(GPIO_OUT1_W1TS_REG, (uint32_t)(setBits >> 32));
+}
+
+void gpio_pulse_mask(uint64_t bits, uint8_t level, uint32_t pulseWidth, uint32_t delayBefore, uint32_t delayAfter) {
+	if(delayBefore > 0) ets_delay_us(delayBefore);
+	gpio_write_mask(level ? bits : 0, level ? 0 : bits);
+	ets_delay_us(pulseWidth);
+	gpio_write_mask(level ? 0 : bits, level ? bits : 0);
+	if(delayAfter > 0) ets_delay_us(delayAfter);
+}
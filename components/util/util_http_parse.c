@@ -0,0 +1,241 @@
+#include "util_http_parse.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+int http_multipart_init(http_multipart_t* parser, const char* contentType) {
+    /*
+     * Prepare parsing a multipart body with the boundary from its Content-Type header.
+     * Returns 0 on success or -1 if there is no usable boundary.
+     */
+    memset(parser, 0x00, sizeof(http_multipart_t));
+
+    const char* start = strstr(contentType, "boundary=");
+    if (start == NULL) return -1;
+    start += 9;
+
+    size_t len;
+    if (*start == '"') {
+        start++;
+        const char* end = strchr(start, '"');
+        if (end == NULL) return -1;
+        len = end - start;
+    } else {
+        len = strcspn(start, "; \t");
+    }
+    if (len == 0 || len > HTTP_MULTIPART_MAX_BOUNDARY_LEN) return -1;
+
+    memcpy(parser->delimiter, "\r\n--", 4);
+    memcpy(&parser->delimiter[4], start, len);
+    parser->delimiterLen = len + 4;
+
+    // The first delimiter is usually at the very start of the body, without a line break before it
+    parser->matched = 2;
+    return 0;
+}
+
+static void _http_multipart_header_line(http_multipart_t* parser) {
+    // Only the file name is of interest, e.g. Content-Disposition: form-data; name="file"; filename="a.bin"
+    parser->line[parser->lineLen] = 0x00;
+    if (strncasecmp(parser->line, "Content-Disposition:", 20) != 0) return;
+
+    const char* start = strstr(parser->line, "filename=\"");
+    if (start == NULL) return;
+    start += 10;
+    size_t len = strcspn(start, "\"");
+    if (len > HTTP_MULTIPART_MAX_FILENAME_LEN) len = HTTP_MULTIPART_MAX_FILENAME_LEN;
+    memcpy(parser->filename, start, len);
+    parser->filename[len] = 0x00;
+}
+
+static size_t _http_multipart_body(http_multipart_t* parser, const uint8_t* in, size_t inLen, const uint8_t** data, size_t* dataLen) {
+    /*
+     * Find the end of the part body. Bytes that could be the start of the delimiter
+     * are held back until it is clear whether they are one.
+     */
+    size_t i = 0;
+
+    if (parser->matched > 0) {
+        // A possible delimiter was cut off at the end of the previous input, check if it continues
+        while (i < inLen && parser->matched < parser->delimiterLen && in[i] == parser->delimiter[parser->matched]) {
+            parser->matched++;
+            i++;
+        }
+        if (parser->matched == parser->delimiterLen) {
+            parser->state = HTTP_MULTIPART_DONE;
+        } else if (i < inLen) {
+            // It wasn't, so the held back bytes are data. They are just the start of the delimiter.
+            // Boundaries can't contain line breaks, so no other delimiter can start within them.
+            *data = (const uint8_t*)parser->delimiter;
+            *dataLen = parser->matched;
+            parser->matched = 0;
+        }
+        return i;
+    }
+
+    size_t matchStart = 0;
+    while (i < inLen) {
+        if (in[i] == parser->delimiter[parser->matched]) {
+            if (parser->matched == 0) matchStart = i;
+            parser->matched++;
+            i++;
+            if (parser->matched == parser->delimiterLen) {
+                parser->state = HTTP_MULTIPART_DONE;
+                *data = in;
+                *dataLen = matchStart;
+                return i;
+            }
+        } else if (parser->matched > 0) {
+            // Not the delimiter, check the current byte again as it may start one
+            parser->matched = 0;
+        } else {
+            i++;
+        }
+    }
+
+    *data = in;
+    *dataLen = (parser->matched > 0) ? matchStart : inLen;
+    return inLen;
+}
+
+size_t http_multipart_parse(http_multipart_t* parser, const uint8_t* in, size_t inLen, const uint8_t** data, size_t* dataLen) {
+    /*
+     * Parse the next piece of a multipart body, which may be split anywhere.
+     * Only the body of the first part is returned, everything after it is ignored.
+     * Returns the number of bytes of in that were consumed. If file data was found, data and dataLen
+     * are set to it, pointing either into in or into the parser. Call again with the rest of in
+     * until all of it is consumed. The body is complete once the state is HTTP_MULTIPART_DONE.
+     */
+    size_t i = 0;
+    *data = NULL;
+    *dataLen = 0;
+
+    while (i < inLen) {
+        uint8_t c = in[i];
+        switch (parser->state) {
+            case HTTP_MULTIPART_PREAMBLE: {
+                if (c == parser->delimiter[parser->matched]) {
+                    parser->matched++;
+                    if (parser->matched == parser->delimiterLen) {
+                        parser->matched = 0;
+                        parser->state = HTTP_MULTIPART_DELIMITER_END;
+                    }
+                } else if (parser->matched > 0) {
+                    parser->matched = 0;
+                    continue;
+                }
+                break;
+            }
+
+            case HTTP_MULTIPART_DELIMITER_END: {
+                // "--" right after the delimiter ends the body, so there are no parts at all
+                if (c == '-') {
+                    if (++parser->dashes == 2) parser->state = HTTP_MULTIPART_DONE;
+                } else if (c == '\n') {
+                    parser->state = HTTP_MULTIPART_HEADER;
+                }
+                break;
+            }
+
+            case HTTP_MULTIPART_HEADER: {
+                if (c == '\n') {
+                    if (parser->lineLen > 0 && parser->line[parser->lineLen - 1] == '\r') parser->lineLen--;
+                    if (parser->lineLen == 0) {
+                        // Empty line, the body follows
+                        parser->state = HTTP_MULTIPART_BODY;
+                        parser->hasPart = 1;
+                        return i + 1;
+                    }
+                    _http_multipart_header_line(parser);
+                    parser->lineLen = 0;
+                } else if (parser->lineLen < HTTP_MULTIPART_MAX_LINE_LEN - 1) {
+                    parser->line[parser->lineLen++] = c;
+                }
+                break;
+            }
+
+            case HTTP_MULTIPART_BODY: {
+                return i + _http_multipart_body(parser, &in[i], inLen - i, data, dataLen);
+            }
+
+            case HTTP_MULTIPART_DONE: {
+                return inLen;
+            }
+        }
+        i++;
+    }
+    return i;
+}
+
+static int _http_parse_number(const char** str, size_t* value) {
+    char* end;
+    if (!isdigit((unsigned char)**str)) return -1;
+    errno = 0;
+    unsigned long long result = strtoull(*str, &end, 10);
+    if (errno == ERANGE || result > SIZE_MAX) return -1;
+    *value = result;
+    *str = end;
+    return 0;
+}
+
+int http_parse_range(const char* value, size_t size, size_t* start, size_t* end) {
+    /*
+     * Parse a Range header for a resource of size bytes. Only a single byte range is supported:
+     * "bytes=<first>-<last>", "bytes=<first>-" or "bytes=-<suffix length>".
+     * On success start and end (inclusive) are set, with end limited to the resource.
+     * Returns 0 on success, -1 if the range can't be satisfied and -2 if the header
+     * isn't understood, in which case it should be ignored and the whole resource sent.
+     */
+    size_t first, last;
+
+    if (strncmp(value, "bytes=", 6) != 0) return -2;
+    value += 6;
+    if (strchr(value, ',') != NULL) return -2;
+
+    if (*value == '-') {
+        value++;
+        if (_http_parse_number(&value, &last) != 0 || *value != 0x00) return -2;
+        if (last == 0 || size == 0) return -1;
+        *start = (last < size) ? size - last : 0;
+        *end = size - 1;
+        return 0;
+    }
+
+    if (_http_parse_number(&value, &first) != 0 || *value++ != '-') return -2;
+    if (*value == 0x00) {
+        last = SIZE_MAX;
+    } else {
+        if (_http_parse_number(&value, &last) != 0 || *value != 0x00) return -2;
+        if (last < first) return -2;
+    }
+    if (first >= size) return -1;
+    *start = first;
+    *end = (last < size) ? last : size - 1;
+    return 0;
+}
+
+int http_etag_match(const char* ifNoneMatch, const char* etag) {
+    /*
+     * Check whether an If-None-Match header matches etag (including its quotes).
+     * The header may be "*" or a list of entity tags, which are compared weakly.
+     */
+    if (strncmp(etag, "W/", 2) == 0) etag += 2;
+    size_t etagLen = strlen(etag);
+
+    while (*ifNoneMatch != 0x00) {
+        ifNoneMatch += strspn(ifNoneMatch, " \t,");
+        size_t len = strcspn(ifNoneMatch, " \t,");
+        if (len == 1 && *ifNoneMatch == '*') return 1;
+        const char* tag = ifNoneMatch;
+        if (len > 2 && strncmp(tag, "W/", 2) == 0) {
+            tag += 2;
+            len -= 2;
+        }
+        if (len == etagLen && strncmp(tag, etag, len) == 0) return 1;
+        ifNoneMatch = tag + len;
+    }
+    return 0;
+}
@@ -1,11 +1,22 @@
 #include "esp_log.h"
 #include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 #include "sys/param.h"
 #include "esp_tls_crypto.h"
+#include "rom/miniz.h"
 
+#include "util_buffer.h"
+#include "util_http_parse.h"
 #include "util_httpd.h"
 
 
+#define RAW_CHUNK_SIZE 1024
+
+static const char* asset_etag = NULL;
+
+
 esp_err_t abortRequest(httpd_req_t *req, const char* message) {
     httpd_resp_set_status(req, message);
     httpd_resp_send_chunk(req, NULL, 0);
@@ -132,4 +143,309 @@ bool basic_auth_handler(httpd_req_t* req, const char* log_tag) {
     }
     free(auth_hdr);
     return authenticated;
-}
\ No newline at end of file
+}
+
+void httpd_set_asset_etag(const char* etag) {
+    // Must be a quoted string that stays valid, see httpd_init()
+    asset_etag = etag;
+}
+
+esp_err_t httpd_send_asset(httpd_req_t* req, const char* type, const uint8_t* start, const uint8_t* end, bool gzipped) {
+    /*
+    Send an embedded file. Clients have to revalidate on every load,
+    which is answered with 304 as long as the firmware hasn't changed.
+    gzipped assets are sent as-is since every browser accepts gzip.
+    */
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    if (asset_etag != NULL) {
+        httpd_resp_set_hdr(req, "ETag", asset_etag);
+        char ifNoneMatch[128];
+        if (httpd_req_get_hdr_value_str(req, "If-None-Match", ifNoneMatch, sizeof(ifNoneMatch)) == ESP_OK && http_etag_match(ifNoneMatch, asset_etag)) {
+            httpd_resp_set_status(req, "304 Not Modified");
+            return httpd_resp_send(req, NULL, 0);
+        }
+    }
+
+    httpd_resp_set_type(req, type);
+    if (gzipped) httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    return httpd_resp_send(req, (const char*)start, end - start);
+}
+
+static bool header_contains(httpd_req_t* req, const char* field, const char* value) {
+    char hdr[128];
+    if (httpd_req_get_hdr_value_str(req, field, hdr, sizeof(hdr)) != ESP_OK) return false;
+    return strstr(hdr, value) != NULL;
+}
+
+bool httpd_req_is_raw(httpd_req_t* req) {
+    return header_contains(req, "Content-Type", "application/octet-stream");
+}
+
+bool httpd_req_accepts_raw(httpd_req_t* req) {
+    return header_contains(req, "Accept", "application/octet-stream");
+}
+
+esp_err_t httpd_recv_to_buffer(const char* log_tag, httpd_req_t* req, uint8_t* dest, size_t max_size, portMUX_TYPE* lock, size_t* rx_len) {
+    /*
+    Receive a binary request body into dest, one chunk at a time.
+    Supported Content-Encodings are none, x-packbits and deflate (zlib format).
+    Encoded bodies are decoded into a staging buffer outside of the lock
+    and only copied to dest once they have been decoded completely.
+    Returns ESP_ERR_INVALID_SIZE if the decoded body doesn't fit into dest
+    and ESP_ERR_INVALID_ARG if it is corrupt or truncated. dest is left untouched in that case,
+    unless the body isn't encoded.
+    */
+    uint8_t recv_buf[RAW_CHUNK_SIZE];
+    size_t remaining = req->content_len;
+    size_t outPos = 0;
+    esp_err_t status = ESP_OK;
+    uint8_t done = 0;
+
+    uint8_t useRle = header_contains(req, "Content-Encoding", HTTPD_ENCODING_RLE);
+    uint8_t useDeflate = header_contains(req, "Content-Encoding", "deflate");
+    buffer_rle_state_t rleState = {0};
+    tinfl_decompressor* inflator = NULL;
+    uint8_t* staging = NULL;
+    if (useDeflate || useRle) {
+        staging = malloc(max_size);
+        if (staging == NULL) return ESP_ERR_NO_MEM;
+    }
+    if (useDeflate) {
+        // Too large for the HTTP server task's stack. The staging buffer
+        // serves as the dictionary, so this is the only other allocation needed.
+        inflator = malloc(sizeof(tinfl_decompressor));
+        if (inflator == NULL) {
+            free(staging);
+            return ESP_ERR_NO_MEM;
+        }
+        tinfl_init(inflator);
+    }
+
+    while (remaining > 0 && status == ESP_OK) {
+        int ret = httpd_req_recv(req, (char*)recv_buf, MIN(remaining, sizeof(recv_buf)));
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                ESP_LOGI(log_tag, "Socket timeout, continuing");
+                continue;
+            }
+            ESP_LOGE(log_tag, "Receive error, aborting");
+            status = ESP_FAIL;
+            break;
+        }
+        remaining -= ret;
+        if (done) continue; // Discard anything after the end of the deflate stream
+
+        if (useDeflate) {
+            size_t inPos = 0;
+            while (inPos < (size_t)ret) {
+                size_t inBytes = ret - inPos;
+                size_t outBytes = max_size - outPos;
+                mz_uint32 flags = TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF;
+                if (remaining > 0) flags |= TINFL_FLAG_HAS_MORE_INPUT;
+                tinfl_status result = tinfl_decompress(inflator, &recv_buf[inPos], &inBytes, staging, staging + outPos, &outBytes, flags);
+                inPos += inBytes;
+                outPos += outBytes;
+                if (result == TINFL_STATUS_DONE) {
+                    done = 1;
+                    break;
+                } else if (result == TINFL_STATUS_HAS_MORE_OUTPUT) {
+                    status = ESP_ERR_INVALID_SIZE;
+                    break;
+                } else if (result < 0) {
+                    ESP_LOGI(log_tag, "Inflate failed: %d", result);
+                    status = ESP_ERR_INVALID_ARG;
+                    break;
+                } else if (result == TINFL_STATUS_NEEDS_MORE_INPUT) {
+                    break;
+                }
+            }
+        } else if (useRle) {
+            status = buffer_rle_decode(&rleState, recv_buf, ret, staging, max_size, &outPos);
+        } else {
+            if ((size_t)ret > max_size - outPos) {
+                status = ESP_ERR_INVALID_SIZE;
+                break;
+            }
+            taskENTER_CRITICAL(lock);
+            memcpy(&dest[outPos], recv_buf, ret);
+            taskEXIT_CRITICAL(lock);
+            outPos += ret;
+        }
+    }
+
+    if (status == ESP_OK && ((useDeflate && !done) || (useRle && (rleState.literal || rleState.run)))) {
+        ESP_LOGI(log_tag, "Request body ends in the middle of the encoded data");
+        status = ESP_ERR_INVALID_ARG;
+    }
+    if (status == ESP_OK && staging != NULL) {
+        taskENTER_CRITICAL(lock);
+        memcpy(dest, staging, outPos);
+        taskEXIT_CRITICAL(lock);
+    }
+
+    free(inflator);
+    free(staging);
+    if (rx_len != NULL) *rx_len = outPos;
+    ESP_LOGD(log_tag, "Received %d bytes into buffer", outPos);
+    return status;
+}
+
+esp_err_t httpd_recv_base64_to_buffer(const char* log_tag, httpd_req_t* req, uint8_t* dest, size_t max_size, portMUX_TYPE* lock, size_t* rx_len) {
+    /*
+    Receive a base64 request body, decoded one chunk at a time into a staging buffer outside of the lock.
+    dest is only written once the whole body has been decoded.
+    Returns ESP_ERR_INVALID_SIZE if the decoded body doesn't fit into dest
+    and ESP_ERR_INVALID_ARG if it isn't valid base64. dest is left untouched in both cases.
+    */
+    uint8_t recv_buf[RAW_CHUNK_SIZE];
+    size_t remaining = req->content_len;
+    size_t outPos = 0;
+    esp_err_t status = ESP_OK;
+    buffer_base64_state_t b64State = {0};
+
+    uint8_t* staging = malloc(max_size);
+    if (staging == NULL) return ESP_ERR_NO_MEM;
+
+    while (remaining > 0 && status == ESP_OK) {
+        int ret = httpd_req_recv(req, (char*)recv_buf, MIN(remaining, sizeof(recv_buf)));
+        if (ret <= 0) {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+                ESP_LOGI(log_tag, "Socket timeout, continuing");
+                continue;
+            }
+            ESP_LOGE(log_tag, "Receive error, aborting");
+            status = ESP_FAIL;
+            break;
+        }
+        remaining -= ret;
+        status = buffer_base64_decode(&b64State, recv_buf, ret, staging, max_size, &outPos);
+    }
+
+    if (status == ESP_OK) status = buffer_base64_decode_finish(&b64State, staging, max_size, &outPos);
+    if (status == ESP_OK) {
+        taskENTER_CRITICAL(lock);
+        memcpy(dest, staging, outPos);
+        taskEXIT_CRITICAL(lock);
+    }
+
+    free(staging);
+    if (rx_len != NULL) *rx_len = outPos;
+    ESP_LOGD(log_tag, "Decoded %d bytes into buffer", outPos);
+    return status;
+}
+
+esp_err_t httpd_send_buffer(const char* log_tag, httpd_req_t* req, uint8_t* src, size_t size, portMUX_TYPE* lock) {
+    /*
+    Send a buffer as application/octet-stream, copied out under the lock in chunks.
+    The response is PackBits encoded if the client accepts x-packbits.
+    */
+    uint8_t send_buf[RAW_CHUNK_SIZE];
+    size_t pos = 0;
+    uint8_t useRle = header_contains(req, "Accept-Encoding", HTTPD_ENCODING_RLE);
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    if (useRle) httpd_resp_set_hdr(req, "Content-Encoding", HTTPD_ENCODING_RLE);
+
+    while (pos < size) {
+        size_t chunkLen;
+        taskENTER_CRITICAL(lock);
+        if (useRle) {
+            chunkLen = buffer_rle_encode(src, size, &pos, send_buf, sizeof(send_buf));
+        } else {
+            chunkLen = MIN(size - pos, sizeof(send_buf));
+            memcpy(send_buf, &src[pos], chunkLen);
+            pos += chunkLen;
+        }
+        taskEXIT_CRITICAL(lock);
+
+        if (httpd_resp_send_chunk(req, (char*)send_buf, chunkLen) != ESP_OK) {
+            ESP_LOGE(log_tag, "Send error, aborting");
+            return ESP_FAIL;
+        }
+    }
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+esp_err_t httpd_send_file(const char* log_tag, httpd_req_t* req, const char* path) {
+    /*
+    Send a file from a mounted filesystem, supporting conditional and single range requests.
+    The ETag is made from the file size and modification time.
+    The file is read straight into the send buffer, without stdio buffering in between.
+    */
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        ESP_LOGE(log_tag, "Failed to stat %s", path);
+        return abortRequest(req, HTTPD_404);
+    }
+    size_t size = st.st_size;
+
+    // Header values have to stay valid until the response is sent
+    char etag[32];
+    char contentRange[48];
+    char hdr[128];
+    snprintf(etag, sizeof(etag), "\"%lx-%llx\"", (unsigned long)size, (unsigned long long)st.st_mtime);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Accept-Ranges", "bytes");
+
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", hdr, sizeof(hdr)) == ESP_OK && http_etag_match(hdr, etag)) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    size_t start = 0;
+    size_t end = size - 1;
+    if (httpd_req_get_hdr_value_str(req, "Range", hdr, sizeof(hdr)) == ESP_OK) {
+        int ret = http_parse_range(hdr, size, &start, &end);
+        if (ret == -1) {
+            snprintf(contentRange, sizeof(contentRange), "bytes */%lu", (unsigned long)size);
+            httpd_resp_set_hdr(req, "Content-Range", contentRange);
+            return abortRequest(req, "416 Range Not Satisfiable");
+        } else if (ret == 0) {
+            snprintf(contentRange, sizeof(contentRange), "bytes %lu-%lu/%lu", (unsigned long)start, (unsigned long)end, (unsigned long)size);
+            httpd_resp_set_hdr(req, "Content-Range", contentRange);
+            httpd_resp_set_status(req, "206 Partial Content");
+        }
+    }
+    size_t remaining = (size > 0) ? (end - start + 1) : 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ESP_LOGE(log_tag, "Failed to open %s", path);
+        return abortRequest(req, HTTPD_500);
+    }
+    if (start > 0 && lseek(fd, start, SEEK_SET) != (off_t)start) {
+        ESP_LOGE(log_tag, "Failed to seek in %s", path);
+        close(fd);
+        return abortRequest(req, HTTPD_500);
+    }
+
+    uint8_t* buf = malloc(CONFIG_HTTPD_FILE_BUFFER_SIZE);
+    if (buf == NULL) {
+        close(fd);
+        return abortRequest(req, HTTPD_500);
+    }
+
+    esp_err_t ret = ESP_OK;
+    while (remaining > 0) {
+        ssize_t len = read(fd, buf, MIN(remaining, CONFIG_HTTPD_FILE_BUFFER_SIZE));
+        if (len <= 0) {
+            ESP_LOGE(log_tag, "Failed to read %s", path);
+            ret = ESP_FAIL;
+            break;
+        }
+        if (httpd_resp_send_chunk(req, (char*)buf, len) != ESP_OK) {
+            ESP_LOGE(log_tag, "Send error, aborting");
+            ret = ESP_FAIL;
+            break;
+        }
+        remaining -= len;
+    }
+    free(buf);
+    close(fd);
+
+    // Returning an error closes the connection, so an incomplete response can't be mistaken for a complete one
+    if (ret != ESP_OK) return ret;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -1,24 +1,9 @@
 #include "util_nvs.h"
 #include "esp_log.h"
+#include <stdlib.h>
 #include <string.h>
 
 
-char* get_string_from_nvs(nvs_handle_t* nvsHandle, const char* key) {
-    // Query string length
-    size_t valueLength;
-    char* value;
-    esp_err_t ret = nvs_get_str(*nvsHandle, key, NULL, &valueLength);
-    if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        return NULL;
-    } else {
-        ESP_ERROR_CHECK(ret);
-        value = malloc(valueLength);
-        // Read value
-        ESP_ERROR_CHECK(nvs_get_str(*nvsHandle, key, value, &valueLength));
-    }
-    return value;
-}
-
 // Load a JSON file from SPIFFS and store the cJSON object in the given pointer
 esp_err_t get_json_from_spiffs(const char* spiffsFileName, cJSON** json, const char* log_tag) {
     char file_path[21]; // "/spiffs/" + 8.3 filename + null
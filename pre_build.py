@@ -1,5 +1,6 @@
 Import("env")
 
+import gzip
 import os
 import subprocess
 
@@ -16,4 +17,31 @@ try:
     with open("include/git_version.h", 'w') as f:
         f.write("#pragma once\n\n#define GIT_VERSION \"{}\"\n".format(version))
 except:
-    print("Failed to get output")
\ No newline at end of file
+    print("Failed to get output")
+
+print("Compressing static web assets")
+GZIP_ASSETS = [
+    "src/static/jquery.min.js",
+    "src/static/util.js",
+    "src/static/simple.css",
+    "components/browser_config/static/browser_config.html",
+    "components/browser_ota/static/browser_ota.html",
+    "components/browser_spiffs/static/browser_spiffs.html",
+    "components/input_browser_canvas/static/browser_canvas.html",
+]
+for asset in GZIP_ASSETS:
+    with open(asset, 'rb') as f:
+        content = f.read()
+    gz_path = asset + ".gz"
+    # The .gz files are committed. Compare the content rather than the compressed bytes,
+    # so a different zlib version doesn't make the tree dirty.
+    try:
+        with open(gz_path, 'rb') as f:
+            if gzip.decompress(f.read()) == content:
+                continue
+    except (FileNotFoundError, OSError, EOFError):
+        pass
+    print("Updating", gz_path)
+    with open(gz_path, 'wb') as f:
+        # mtime=0 keeps the output identical for identical input
+        f.write(gzip.compress(content, compresslevel=9, mtime=0))
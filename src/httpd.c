@@ -4,6 +4,7 @@
 #include "httpd.h"
 #include "cJSON.h"
 #include "esp_ota_ops.h"
+#include "esp_app_desc.h"
 #include "esp_spiffs.h"
 #include "esp_mac.h"
 #include "wg.h"
@@ -11,18 +12,19 @@
 
 #include "config_global.h"
 #include "util_disp_selection.h"
+#include "util_httpd.h"
 
 #define LOG_TAG "HTTPD"
 
 // Embedded files - refer to CMakeLists.txt
 extern const uint8_t favicon_ico_start[] asm("_binary_favicon_ico_start");
 extern const uint8_t favicon_ico_end[]   asm("_binary_favicon_ico_end");
-extern const uint8_t jquery_min_js_start[] asm("_binary_jquery_min_js_start");
-extern const uint8_t jquery_min_js_end[]   asm("_binary_jquery_min_js_end");
-extern const uint8_t util_js_start[] asm("_binary_util_js_start");
-extern const uint8_t util_js_end[]   asm("_binary_util_js_end");
-extern const uint8_t simple_css_start[] asm("_binary_simple_css_start");
-extern const uint8_t simple_css_end[]   asm("_binary_simple_css_end");
+extern const uint8_t jquery_min_js_gz_start[] asm("_binary_jquery_min_js_gz_start");
+extern const uint8_t jquery_min_js_gz_end[]   asm("_binary_jquery_min_js_gz_end");
+extern const uint8_t util_js_gz_start[] asm("_binary_util_js_gz_start");
+extern const uint8_t util_js_gz_end[]   asm("_binary_util_js_gz_end");
+extern const uint8_t simple_css_gz_start[] asm("_binary_simple_css_gz_start");
+extern const uint8_t simple_css_gz_end[]   asm("_binary_simple_css_gz_end");
 
 extern esp_netif_t* netif_wifi_sta;
 extern esp_netif_t* netif_wifi_ap;
@@ -32,6 +34,9 @@ extern char hostname[63];
 
 nvs_handle_t httpd_nvs_handle;
 
+// Quoted git version plus ELF hash, so every build gets its own tag even with a dirty tree
+static char httpd_asset_etag[64];
+
 
 static esp_err_t root_get_handler(httpd_req_t *req) {
     httpd_resp_set_status(req, "302 Found");
@@ -41,27 +46,19 @@ static esp_err_t root_get_handler(httpd_req_t *req) {
 }
 
 static esp_err_t favicon_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "image/x-icon");
-    httpd_resp_send(req, (const char *)favicon_ico_start, favicon_ico_end - favicon_ico_start);
-    return ESP_OK;
+    return httpd_send_asset(req, "image/x-icon", favicon_ico_start, favicon_ico_end, false);
 }
 
 static esp_err_t jquery_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "application/javascript");
-    httpd_resp_send(req, (const char *)jquery_min_js_start, (jquery_min_js_end - jquery_min_js_start)-1);
-    return ESP_OK;
+    return httpd_send_asset(req, "application/javascript", jquery_min_js_gz_start, jquery_min_js_gz_end, true);
 }
 
 static esp_err_t util_js_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "application/javascript");
-    httpd_resp_send(req, (const char *)util_js_start, (util_js_end - util_js_start)-1);
-    return ESP_OK;
+    return httpd_send_asset(req, "application/javascript", util_js_gz_start, util_js_gz_end, true);
 }
 
 static esp_err_t simplecss_get_handler(httpd_req_t *req) {
-    httpd_resp_set_type(req, "text/css");
-    httpd_resp_send(req, (const char *)simple_css_start, (simple_css_end - simple_css_start)-1);
-    return ESP_OK;
+    return httpd_send_asset(req, "text/css", simple_css_gz_start, simple_css_gz_end, true);
 }
 
 static esp_err_t device_info_get_handler(httpd_req_t *req) {
@@ -315,6 +312,11 @@ httpd_handle_t httpd_init(nvs_handle_t* nvsHandle) {
 
     httpd_nvs_handle = *nvsHandle;
 
+    char elfSha[17];
+    esp_app_get_elf_sha256(elfSha, sizeof(elfSha));
+    snprintf(httpd_asset_etag, sizeof(httpd_asset_etag), "\"%s-%s\"", GIT_VERSION, elfSha);
+    httpd_set_asset_etag(httpd_asset_etag);
+
     config.max_uri_handlers = 128;
 
     ESP_LOGI(LOG_TAG, "Starting HTTP server on port %d", config.server_port);
@@ -21,6 +21,7 @@
 #include "browser_config.h"
 #include "browser_spiffs.h"
 #include "browser_ota.h"
+#include "display_sync.h"
 #include "git_version.h"
 #include "httpd.h"
 #include "i2s_microphone.h"
@@ -32,6 +33,7 @@
 #include "wifi.h"
 #include "util_brightness.h"
 #include "util_buffer.h"
+#include "util_config.h"
 #include "util_fan.h"
 #include "util_generic.h"
 #include "util_gpio.h"
@@ -202,7 +204,7 @@ static void display_refresh_task(void* arg) {
 
     while (1) {
         #if defined(DISPLAY_HAS_PIXEL_BUFFER)
-        bitmap_generator_current(time_getSystemTime_us());
+        bitmap_generator_current(sync_get_time_us());
         #endif
 
         #if defined(CONFIG_DISPLAY_TYPE_PIXEL)
@@ -231,6 +233,10 @@ static void display_refresh_task(void* arg) {
             display_update(display_unit_buffer, display_prev_unit_buffer, DISPLAY_UNIT_BUF_SIZE, &display_unit_buffer_lock, display_framebuf_mask, display_num_units);
         #endif
 
+        #if defined(CONFIG_HTTPD_WS_SUPPORT)
+        browser_canvas_notify_frame();
+        #endif
+
         #if defined(CONFIG_FAN_ENABLED)
         fan_set_target_speed(display_get_fan_speed());
         #endif
@@ -315,8 +321,11 @@ void app_main(void) {
     ret = nvs_open("cheetah", NVS_READWRITE, &nvs_handle);
     ESP_ERROR_CHECK(ret);
 
-    ret = nvs_get_str(nvs_handle, "hostname", hostname, &hostname_length);
-    hostname_length = 64; // Reset after nvs_get_str modified it
+    // Load all config options into RAM, everything else reads them from there
+    ESP_ERROR_CHECK(config_init(&nvs_handle));
+
+    ret = config_get_str("hostname", hostname, &hostname_length);
+    hostname_length = 64; // Reset after config_get_str modified it
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         hostname[hostname_length - 1] = 0x00;
         strncpy(hostname, CONFIG_PROJ_DEFAULT_HOSTNAME, hostname_length - 1);
@@ -380,6 +389,10 @@ void app_main(void) {
     tcp_log_start();
     #endif
 
+    #if defined(CONFIG_SYNC_ENABLED)
+    sync_init();
+    #endif
+
     #if defined(CONFIG_ETHERNET_ENABLED)
     ethernet_init();
     #endif
@@ -397,6 +410,15 @@ void app_main(void) {
     i2s_mic_init();
     #endif
 
+    #if defined(DISPLAY_HAS_PIXEL_BUFFER)
+    // Displays that don't show every pixel tell the generators which ones they do show
+    const uint16_t* display_active_pixels = NULL;
+    uint32_t display_num_active_pixels = 0;
+    #if defined(CONFIG_DISPLAY_DRIVER_CHAR_16SEG_LED_WS281X_HYBRID)
+    display_active_pixels = display_get_active_pixels(&display_num_active_pixels);
+    #endif
+    #endif
+
     #if defined(DISPLAY_HAS_PIXEL_BUFFER) && defined(CONFIG_DISPLAY_PIX_BUF_INIT_WHITE)
     memset(display_pixel_buffer, 0xFF, DISPLAY_PIX_BUF_SIZE);
     #endif
@@ -412,7 +434,7 @@ void app_main(void) {
         artnet_init(display_pixel_buffer, artnet_output_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, ARTNET_FRAMEBUF_SIZE);
         browser_canvas_init(&server, &nvs_handle, display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, NULL);
         playlist_init(&nvs_handle, display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, NULL, 0, NULL, NULL, 0, NULL, NULL, 0, NULL);
-        bitmap_generators_init(display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, DISPLAY_VIEWPORT_WIDTH_PIXEL, DISPLAY_VIEWPORT_HEIGHT_PIXEL);
+        bitmap_generators_init(display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, DISPLAY_VIEWPORT_WIDTH_PIXEL, DISPLAY_VIEWPORT_HEIGHT_PIXEL, display_active_pixels, display_num_active_pixels);
         #endif
         
         #if defined(CONFIG_DISPLAY_TYPE_CHARACTER)
@@ -426,7 +448,7 @@ void app_main(void) {
         artnet_init(display_pixel_buffer, artnet_output_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, ARTNET_FRAMEBUF_SIZE);
         browser_canvas_init(&server, &nvs_handle, display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, display_text_buffer, DISPLAY_TEXT_BUF_SIZE, &display_text_buffer_lock, NULL, 0, NULL, display_line_flags_buffer, DISPLAY_LINE_FLAGS_BUF_SIZE, &display_line_flags_buffer_lock);
         playlist_init(&nvs_handle, display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, display_text_buffer, DISPLAY_TEXT_BUF_SIZE, &display_text_buffer_lock, display_line_flags_buffer, DISPLAY_LINE_FLAGS_BUF_SIZE, &display_line_flags_buffer_lock, NULL, 0, NULL);
-        bitmap_generators_init(display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, DISPLAY_VIEWPORT_WIDTH_PIXEL, DISPLAY_VIEWPORT_HEIGHT_PIXEL);
+        bitmap_generators_init(display_pixel_buffer, DISPLAY_PIX_BUF_SIZE, &display_pixel_buffer_lock, DISPLAY_VIEWPORT_WIDTH_PIXEL, DISPLAY_VIEWPORT_HEIGHT_PIXEL, display_active_pixels, display_num_active_pixels);
         #endif
         
         #if defined(CONFIG_DISPLAY_TYPE_SELECTION)
@@ -473,7 +495,7 @@ void app_main(void) {
 
         // Load startup defaults
         cJSON* startupData;
-        char* startupFile = get_string_from_nvs(&nvs_handle, "startup_file");
+        char* startupFile = config_get_str_alloc("startup_file");
         if (startupFile == NULL || strlen(startupFile) == 0) {
             ESP_LOGI(LOG_TAG, "Not using startup file");
         } else {
@@ -1,5 +1,6 @@
 #include "wg.h"
 #include "esp_log.h"
+#include "util_config.h"
 #include <string.h>
 
 
@@ -26,36 +27,36 @@ esp_err_t wg_init(nvs_handle_t* nvsHandle) {
     ESP_LOGI(LOG_TAG, "Initializing");
 
     uint16_t listenPort;
-    ret = nvs_get_u16(*nvsHandle, "wg_listen_port", &listenPort);
+    ret = config_get_u16("wg_listen_port", &listenPort);
     if (ret != ESP_OK) return ESP_FAIL;
 
     uint16_t endpointPort;
-    ret = nvs_get_u16(*nvsHandle, "wg_endpnt_port", &endpointPort);
+    ret = config_get_u16("wg_endpnt_port", &endpointPort);
     if (ret != ESP_OK) return ret;
 
     uint16_t keepalive;
-    ret = nvs_get_u16(*nvsHandle, "wg_keepalive", &keepalive);
+    ret = config_get_u16("wg_keepalive", &keepalive);
     if (ret != ESP_OK) return ret;
 
-    char* privateKey = get_string_from_nvs(nvsHandle, "wg_private_key");
+    char* privateKey = config_get_str_alloc("wg_private_key");
     if (privateKey == NULL || strlen(privateKey) == 0) {
         return ESP_FAIL;
     }
 
-    char* publicKey = get_string_from_nvs(nvsHandle, "wg_public_key");
+    char* publicKey = config_get_str_alloc("wg_public_key");
     if (publicKey == NULL || strlen(publicKey) == 0) {
         free(privateKey);
         return ESP_FAIL;
     }
 
-    char* allowedIp = get_string_from_nvs(nvsHandle, "wg_allowed_ip");
+    char* allowedIp = config_get_str_alloc("wg_allowed_ip");
     if (allowedIp == NULL || strlen(allowedIp) == 0) {
         free(privateKey);
         free(publicKey);
         return ESP_FAIL;
     }
 
-    char* allowedIpMask = get_string_from_nvs(nvsHandle, "wg_allowed_mask");
+    char* allowedIpMask = config_get_str_alloc("wg_allowed_mask");
     if (allowedIpMask == NULL || strlen(allowedIpMask) == 0) {
         free(privateKey);
         free(publicKey);
@@ -63,7 +64,7 @@ esp_err_t wg_init(nvs_handle_t* nvsHandle) {
         return ESP_FAIL;
     }
 
-    char* endpoint = get_string_from_nvs(nvsHandle, "wg_endpoint");
+    char* endpoint = config_get_str_alloc("wg_endpoint");
     if (endpoint == NULL || strlen(endpoint) == 0) {
         free(privateKey);
         free(publicKey);
@@ -11,6 +11,7 @@
 #include "wifi.h"
 #include "ntp.h"
 #include "wg.h"
+#include "util_config.h"
 
 #define LOG_TAG "WiFi"
 
@@ -156,7 +157,7 @@ void wifi_init_ap(void) {
 }
 
 void wifi_init(nvs_handle_t* nvsHandle) {
-    // Read STA and AP SSID and password from NVS
+    // Read STA and AP SSID and password from the config registry
     esp_err_t ret;
     uint8_t sta_enterprise = 1;
     uint8_t sta_credentials_valid = 1;
@@ -169,7 +170,7 @@ void wifi_init(nvs_handle_t* nvsHandle) {
     memset(sta_fallb_pass, 0x00, sta_fallb_pass_len);
     memset(ap_ssid, 0x00, ap_ssid_len);
     memset(ap_pass, 0x00, ap_pass_len);
-    ret = nvs_get_u16(*nvsHandle, "ap_timeout", &ap_timeout);
+    ret = config_get_u16("ap_timeout", &ap_timeout);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         ap_timeout = 0;
     } else {
@@ -177,20 +178,20 @@ void wifi_init(nvs_handle_t* nvsHandle) {
         // If not 0, force at least 10 seconds timeout to be safe
         if (ap_timeout != 0 && ap_timeout < 10) ap_timeout = 10;
     }
-    ret = nvs_get_str(*nvsHandle, "sta_ssid", sta_ssid, &sta_ssid_len);
+    ret = config_get_str("sta_ssid", sta_ssid, &sta_ssid_len);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_credentials_valid = 0;
     } else {
         ESP_ERROR_CHECK(ret);
     }
-    ret = nvs_get_str(*nvsHandle, "sta_ident", sta_ident, &sta_ident_len);
+    ret = config_get_str("sta_ident", sta_ident, &sta_ident_len);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_enterprise = 0;
     } else {
         ESP_ERROR_CHECK(ret);
         if (strlen(sta_ident) == 0) sta_enterprise = 0;
     }
-    ret = nvs_get_str(*nvsHandle, "sta_anon_ident", sta_anon_ident, &sta_anon_ident_len);
+    ret = config_get_str("sta_anon_ident", sta_anon_ident, &sta_anon_ident_len);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         strncpy((char*)sta_anon_ident, sta_ident, sta_ident_len - 1);
     } else {
@@ -199,38 +200,38 @@ void wifi_init(nvs_handle_t* nvsHandle) {
             strncpy((char*)sta_anon_ident, sta_ident, sta_ident_len - 1);
         }
     }
-    ret = nvs_get_str(*nvsHandle, "sta_pass", sta_pass, &sta_pass_len);
+    ret = config_get_str("sta_pass", sta_pass, &sta_pass_len);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_credentials_valid = 0;
     } else {
         ESP_ERROR_CHECK(ret);
     }
     if (strlen(sta_ssid) == 0) sta_credentials_valid = 0;
-    ret = nvs_get_u8(*nvsHandle, "sta_retries", &sta_retries);
+    ret = config_get_u8("sta_retries", &sta_retries);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_retries = 5;
     } else {
         ESP_ERROR_CHECK(ret);
     }
-    ret = nvs_get_u8(*nvsHandle, "sta_phase2", &sta_phase2);
+    ret = config_get_u8("sta_phase2", &sta_phase2);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_enterprise = 0;
     } else {
         ESP_ERROR_CHECK(ret);
     }
-    ret = nvs_get_u8(*nvsHandle, "sta_phase2_ttls", &sta_phase2_ttls);
+    ret = config_get_u8("sta_phase2_ttls", &sta_phase2_ttls);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_phase2_ttls = WPA2E_PH2_TTLS_NONE;
     } else {
         ESP_ERROR_CHECK(ret);
     }
-    ret = nvs_get_str(*nvsHandle, "sta_fallb_ssid", sta_fallb_ssid, &sta_fallb_ssid_len);
+    ret = config_get_str("sta_fallb_ssid", sta_fallb_ssid, &sta_fallb_ssid_len);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_fallback_credentials_valid = 0;
     } else {
         ESP_ERROR_CHECK(ret);
     }
-    ret = nvs_get_str(*nvsHandle, "sta_fallb_pass", sta_fallb_pass, &sta_fallb_pass_len);
+    ret = config_get_str("sta_fallb_pass", sta_fallb_pass, &sta_fallb_pass_len);
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         sta_fallback_credentials_valid = 0;
     } else {
@@ -238,10 +239,10 @@ void wifi_init(nvs_handle_t* nvsHandle) {
     }
     if (strlen(sta_fallb_ssid) == 0) sta_fallback_credentials_valid = 0;
 
-    ret = nvs_get_str(*nvsHandle, "ap_ssid", ap_ssid, &ap_ssid_len);
-    ap_ssid_len = 33; // Reset after nvs_get_str modified it
+    ret = config_get_str("ap_ssid", ap_ssid, &ap_ssid_len);
+    ap_ssid_len = 33; // Reset after config_get_str modified it
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
-        ESP_LOGI(LOG_TAG, "AP SSID not found in NVS");
+        ESP_LOGI(LOG_TAG, "AP SSID not configured");
         ap_ssid[ap_ssid_len - 1] = 0x00;
         strncpy(ap_ssid, CONFIG_PROJ_DEFAULT_AP_SSID, ap_ssid_len - 1);
         ESP_LOGI(LOG_TAG, "Fallback: %s", ap_ssid);
@@ -253,8 +254,8 @@ void wifi_init(nvs_handle_t* nvsHandle) {
         }
         ESP_ERROR_CHECK(ret);
     }
-    ret = nvs_get_str(*nvsHandle, "ap_pass", ap_pass, &ap_pass_len);
-    ap_pass_len = 65; // Reset after nvs_get_str modified it
+    ret = config_get_str("ap_pass", ap_pass, &ap_pass_len);
+    ap_pass_len = 65; // Reset after config_get_str modified it
     if (ret == ESP_ERR_NVS_NOT_FOUND) {
         ap_pass[ap_pass_len - 1] = 0x00;
         strncpy(ap_pass, CONFIG_PROJ_DEFAULT_AP_PASS, ap_pass_len - 1);
@@ -0,0 +1,281 @@
+#include "cJSON.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static cJSON* _create(int type) {
+    cJSON* item = calloc(1, sizeof(cJSON));
+    if (item != NULL) item->type = type;
+    return item;
+}
+
+cJSON* cJSON_CreateObject(void) { return _create(cJSON_Object); }
+cJSON* cJSON_CreateArray(void) { return _create(cJSON_Array); }
+cJSON* cJSON_CreateBool(cJSON_bool boolean) { return _create(boolean ? cJSON_True : cJSON_False); }
+
+cJSON* cJSON_CreateNumber(double num) {
+    cJSON* item = _create(cJSON_Number);
+    if (item != NULL) cJSON_SetNumberHelper(item, num);
+    return item;
+}
+
+cJSON* cJSON_CreateString(const char* string) {
+    cJSON* item = _create(cJSON_String);
+    if (item != NULL) item->valuestring = strdup(string);
+    return item;
+}
+
+void cJSON_Delete(cJSON* item) {
+    while (item != NULL) {
+        cJSON* next = item->next;
+        cJSON_Delete(item->child);
+        free(item->valuestring);
+        free(item->string);
+        free(item);
+        item = next;
+    }
+}
+
+cJSON* cJSON_Duplicate(const cJSON* item, cJSON_bool recurse) {
+    if (item == NULL) return NULL;
+    cJSON* copy = _create(item->type);
+    if (copy == NULL) return NULL;
+    copy->valueint = item->valueint;
+    copy->valuedouble = item->valuedouble;
+    if (item->valuestring != NULL) copy->valuestring = strdup(item->valuestring);
+    if (item->string != NULL) copy->string = strdup(item->string);
+    if (!recurse) return copy;
+    for (cJSON* child = item->child; child != NULL; child = child->next) {
+        cJSON* childCopy = cJSON_Duplicate(child, 1);
+        if (childCopy == NULL) {
+            cJSON_Delete(copy);
+            return NULL;
+        }
+        cJSON_AddItemToArray(copy, childCopy);
+    }
+    return copy;
+}
+
+cJSON_bool cJSON_AddItemToArray(cJSON* array, cJSON* item) {
+    if (array == NULL || item == NULL) return 0;
+    if (array->child == NULL) {
+        array->child = item;
+        item->prev = item;
+    } else {
+        // Like cJSON, the first child's prev points to the last one
+        cJSON* last = array->child->prev;
+        last->next = item;
+        item->prev = last;
+        array->child->prev = item;
+    }
+    return 1;
+}
+
+cJSON_bool cJSON_AddItemToObject(cJSON* object, const char* name, cJSON* item) {
+    if (object == NULL || name == NULL || item == NULL) return 0;
+    free(item->string);
+    item->string = strdup(name);
+    return cJSON_AddItemToArray(object, item);
+}
+
+static cJSON* _add(cJSON* object, const char* name, cJSON* item) {
+    if (!cJSON_AddItemToObject(object, name, item)) {
+        cJSON_Delete(item);
+        return NULL;
+    }
+    return item;
+}
+
+cJSON* cJSON_AddArrayToObject(cJSON* object, const char* name) { return _add(object, name, cJSON_CreateArray()); }
+cJSON* cJSON_AddObjectToObject(cJSON* object, const char* name) { return _add(object, name, cJSON_CreateObject()); }
+cJSON* cJSON_AddBoolToObject(cJSON* object, const char* name, cJSON_bool boolean) { return _add(object, name, cJSON_CreateBool(boolean)); }
+cJSON* cJSON_AddNumberToObject(cJSON* object, const char* name, double number) { return _add(object, name, cJSON_CreateNumber(number)); }
+cJSON* cJSON_AddStringToObject(cJSON* object, const char* name, const char* string) { return _add(object, name, cJSON_CreateString(string)); }
+
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* name) {
+    if (object == NULL || name == NULL) return NULL;
+    for (cJSON* item = object->child; item != NULL; item = item->next) {
+        if (item->string != NULL && strcasecmp(item->string, name) == 0) return item;
+    }
+    return NULL;
+}
+
+cJSON* cJSON_GetArrayItem(const cJSON* array, int index) {
+    if (array == NULL || index < 0) return NULL;
+    cJSON* item = array->child;
+    while (item != NULL && index-- > 0) item = item->next;
+    return item;
+}
+
+int cJSON_GetArraySize(const cJSON* array) {
+    int size = 0;
+    if (array == NULL) return 0;
+    for (cJSON* item = array->child; item != NULL; item = item->next) size++;
+    return size;
+}
+
+double cJSON_GetNumberValue(const cJSON* item) { return cJSON_IsNumber(item) ? item->valuedouble : NAN; }
+char* cJSON_GetStringValue(const cJSON* item) { return cJSON_IsString(item) ? item->valuestring : NULL; }
+
+double cJSON_SetNumberHelper(cJSON* object, double number) {
+    // valueint saturates like in cJSON
+    if (number >= 2147483647.0) object->valueint = 2147483647;
+    else if (number <= -2147483648.0) object->valueint = -2147483647 - 1;
+    else object->valueint = (int)number;
+    return object->valuedouble = number;
+}
+
+static void _print_string(FILE* out, const char* string) {
+    fputc('"', out);
+    for (const char* c = string; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static void _print(FILE* out, const cJSON* item) {
+    if (item->type & cJSON_False) fputs("false", out);
+    else if (item->type & cJSON_True) fputs("true", out);
+    else if (item->type & cJSON_NULL) fputs("null", out);
+    else if (item->type & cJSON_Number) {
+        if (item->valuedouble == (double)item->valueint) fprintf(out, "%d", item->valueint);
+        else fprintf(out, "%.17g", item->valuedouble);
+    } else if (item->type & cJSON_String) _print_string(out, item->valuestring);
+    else {
+        fputc((item->type & cJSON_Array) ? '[' : '{', out);
+        for (cJSON* child = item->child; child != NULL; child = child->next) {
+            if (child != item->child) fputc(',', out);
+            if (item->type & cJSON_Object) {
+                _print_string(out, child->string);
+                fputc(':', out);
+            }
+            _print(out, child);
+        }
+        fputc((item->type & cJSON_Array) ? ']' : '}', out);
+    }
+}
+
+static cJSON* _parse(const char** pos);
+
+static const char* _skip(const char* pos) {
+    while (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n') pos++;
+    return pos;
+}
+
+static char* _parse_string(const char** pos) {
+    // *pos is at the opening quote
+    const char* c = *pos + 1;
+    char* result = malloc(strlen(c) + 1);
+    size_t len = 0;
+    while (*c != '"') {
+        if (*c == 0x00 || (*c == '\\' && c[1] == 0x00)) {
+            free(result);
+            return NULL;
+        }
+        if (*c == '\\') {
+            c++;
+            if (*c == 'n') result[len++] = '\n';
+            else if (*c == 't') result[len++] = '\t';
+            else if (*c == 'r') result[len++] = '\r';
+            else result[len++] = *c;
+        } else {
+            result[len++] = *c;
+        }
+        c++;
+    }
+    result[len] = 0x00;
+    *pos = c + 1;
+    return result;
+}
+
+static cJSON* _parse_container(const char** pos, int type, char close) {
+    cJSON* item = _create(type);
+    *pos = _skip(*pos + 1);
+    if (**pos == close) {
+        (*pos)++;
+        return item;
+    }
+    while (1) {
+        char* name = NULL;
+        if (type == cJSON_Object) {
+            if (**pos != '"' || (name = _parse_string(pos)) == NULL) break;
+            *pos = _skip(*pos);
+            if (**pos != ':') {
+                free(name);
+                break;
+            }
+            *pos = _skip(*pos + 1);
+        }
+        cJSON* child = _parse(pos);
+        if (child == NULL) {
+            free(name);
+            break;
+        }
+        child->string = name;
+        cJSON_AddItemToArray(item, child);
+        *pos = _skip(*pos);
+        if (**pos == close) {
+            (*pos)++;
+            return item;
+        }
+        if (**pos != ',') break;
+        *pos = _skip(*pos + 1);
+    }
+    cJSON_Delete(item);
+    return NULL;
+}
+
+static cJSON* _parse(const char** pos) {
+    const char* c = *pos;
+    if (*c == '{') return _parse_container(pos, cJSON_Object, '}');
+    if (*c == '[') return _parse_container(pos, cJSON_Array, ']');
+    if (*c == '"') {
+        char* string = _parse_string(pos);
+        if (string == NULL) return NULL;
+        cJSON* item = _create(cJSON_String);
+        item->valuestring = string;
+        return item;
+    }
+    if (!strncmp(c, "true", 4)) { *pos += 4; return cJSON_CreateBool(1); }
+    if (!strncmp(c, "false", 5)) { *pos += 5; return cJSON_CreateBool(0); }
+    if (!strncmp(c, "null", 4)) { *pos += 4; return _create(cJSON_NULL); }
+    char* end;
+    double number = strtod(c, &end);
+    if (end == c || !(*c == '-' || (*c >= '0' && *c <= '9'))) return NULL;
+    *pos = end;
+    return cJSON_CreateNumber(number);
+}
+
+cJSON* cJSON_Parse(const char* value) {
+    if (value == NULL) return NULL;
+    const char* pos = _skip(value);
+    cJSON* item = _parse(&pos);
+    if (item != NULL && *_skip(pos) != 0x00) {
+        cJSON_Delete(item);
+        return NULL;
+    }
+    return item;
+}
+
+char* cJSON_PrintUnformatted(const cJSON* item) {
+    char* result = NULL;
+    size_t len;
+    if (item == NULL) return NULL;
+    FILE* out = open_memstream(&result, &len);
+    _print(out, item);
+    fclose(out);
+    return result;
+}
+
+char* cJSON_Print(const cJSON* item) { return cJSON_PrintUnformatted(item); }
+void cJSON_free(void* object) { free(object); }
+
+cJSON_bool cJSON_IsBool(const cJSON* item) { return item != NULL && (item->type & (cJSON_True | cJSON_False)); }
+cJSON_bool cJSON_IsTrue(const cJSON* item) { return item != NULL && (item->type & cJSON_True); }
+cJSON_bool cJSON_IsNumber(const cJSON* item) { return item != NULL && (item->type & cJSON_Number); }
+cJSON_bool cJSON_IsString(const cJSON* item) { return item != NULL && (item->type & cJSON_String); }
+cJSON_bool cJSON_IsArray(const cJSON* item) { return item != NULL && (item->type & cJSON_Array); }
+cJSON_bool cJSON_IsObject(const cJSON* item) { return item != NULL && (item->type & cJSON_Object); }
@@ -0,0 +1,219 @@
+#include "esp_http_server.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+
+static const httpd_uri_t* handlers[HTTPD_FAKE_MAX_HANDLERS];
+static httpd_work_fn_t work_fns[HTTPD_FAKE_MAX_WORK];
+static void* work_args[HTTPD_FAKE_MAX_WORK];
+static unsigned work_count = 0;
+
+httpd_fake_sock_t httpd_fake_socks[HTTPD_FAKE_MAX_SOCKS];
+
+void httpd_fake_req_init(httpd_req_t* req, const void* body, size_t len) {
+    memset(req, 0, sizeof(*req));
+    req->method = HTTP_POST;
+    req->body = body;
+    req->content_len = len;
+    strcpy(req->status, "200 OK");
+}
+
+void httpd_fake_req_set_hdr(httpd_req_t* req, const char* name, const char* value) {
+    for (unsigned i = 0; i < HTTPD_FAKE_MAX_HEADERS; i++) {
+        if (req->hdrNames[i] == NULL) {
+            req->hdrNames[i] = name;
+            req->hdrValues[i] = value;
+            return;
+        }
+    }
+    abort();
+}
+
+const char* httpd_fake_resp_hdr(httpd_req_t* req, const char* name) {
+    for (unsigned i = 0; i < req->respHdrCount; i++) {
+        if (!strcasecmp(req->respHdrNames[i], name)) return req->respHdrValues[i];
+    }
+    return NULL;
+}
+
+void httpd_fake_req_free(httpd_req_t* req) {
+    free(req->resp);
+    req->resp = NULL;
+    req->respLen = 0;
+}
+
+const httpd_uri_t* httpd_fake_handler(const char* uri, httpd_method_t method) {
+    for (unsigned i = 0; i < HTTPD_FAKE_MAX_HANDLERS; i++) {
+        if (handlers[i] != NULL && handlers[i]->method == method && !strcmp(handlers[i]->uri, uri)) return handlers[i];
+    }
+    return NULL;
+}
+
+unsigned httpd_fake_run_work(void) {
+    // Runs the queued work like the server task would, returns the number of items
+    unsigned count = work_count;
+    work_count = 0;
+    for (unsigned i = 0; i < count; i++) work_fns[i](work_args[i]);
+    return count;
+}
+
+void httpd_fake_socks_reset(void) {
+    for (unsigned i = 0; i < HTTPD_FAKE_MAX_SOCKS; i++) free(httpd_fake_socks[i].last);
+    memset(httpd_fake_socks, 0, sizeof(httpd_fake_socks));
+}
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler) {
+    if (httpd_fake_handler(uri_handler->uri, uri_handler->method) != NULL) return ESP_FAIL;
+    for (unsigned i = 0; i < HTTPD_FAKE_MAX_HANDLERS; i++) {
+        if (handlers[i] == NULL) {
+            handlers[i] = uri_handler;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle, const char* uri, httpd_method_t method) {
+    for (unsigned i = 0; i < HTTPD_FAKE_MAX_HANDLERS; i++) {
+        if (handlers[i] != NULL && handlers[i]->method == method && !strcmp(handlers[i]->uri, uri)) {
+            handlers[i] = NULL;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+static const char* _find_hdr(httpd_req_t* req, const char* field) {
+    for (unsigned i = 0; i < HTTPD_FAKE_MAX_HEADERS && req->hdrNames[i] != NULL; i++) {
+        if (!strcasecmp(req->hdrNames[i], field)) return req->hdrValues[i];
+    }
+    return NULL;
+}
+
+int httpd_req_recv(httpd_req_t* req, char* buf, size_t len) {
+    if (req->timeoutEvery && ++req->recvCalls % req->timeoutEvery == 0) return HTTPD_SOCK_ERR_TIMEOUT;
+    size_t left = req->content_len - req->bodyPos;
+    if (len > left) len = left;
+    if (req->recvChunk && len > req->recvChunk) len = req->recvChunk;
+    if (req->failAt && req->bodyPos + len >= req->failAt) return HTTPD_SOCK_ERR_FAIL;
+    if (len == 0) return 0;
+    memcpy(buf, &req->body[req->bodyPos], len);
+    req->bodyPos += len;
+    return len;
+}
+
+size_t httpd_req_get_hdr_value_len(httpd_req_t* req, const char* field) {
+    const char* value = _find_hdr(req, field);
+    return value == NULL ? 0 : strlen(value);
+}
+
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* req, const char* field, char* val, size_t len) {
+    const char* value = _find_hdr(req, field);
+    if (value == NULL) return ESP_ERR_NOT_FOUND;
+    strncpy(val, value, len - 1);
+    val[len - 1] = 0;
+    return strlen(value) < len ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+size_t httpd_req_get_url_query_len(httpd_req_t* req) {
+    return req->query == NULL ? 0 : strlen(req->query);
+}
+
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* req, char* buf, size_t buf_len) {
+    if (req->query == NULL) return ESP_ERR_NOT_FOUND;
+    strncpy(buf, req->query, buf_len - 1);
+    buf[buf_len - 1] = 0;
+    return strlen(req->query) < buf_len ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+}
+
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size) {
+    size_t keyLen = strlen(key);
+    for (const char* pos = qry; pos != NULL && *pos; pos = strchr(pos, '&') ? strchr(pos, '&') + 1 : NULL) {
+        if (strncmp(pos, key, keyLen) || pos[keyLen] != '=') continue;
+        const char* value = &pos[keyLen + 1];
+        size_t valueLen = strchr(value, '&') ? (size_t)(strchr(value, '&') - value) : strlen(value);
+        size_t copyLen = valueLen < val_size ? valueLen : val_size - 1;
+        memcpy(val, value, copyLen);
+        val[copyLen] = 0;
+        return valueLen < val_size ? ESP_OK : ESP_ERR_HTTPD_RESULT_TRUNC;
+    }
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t httpd_resp_set_status(httpd_req_t* req, const char* status) {
+    strncpy(req->status, status, sizeof(req->status) - 1);
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type) {
+    return httpd_resp_set_hdr(req, "Content-Type", type);
+}
+
+esp_err_t httpd_resp_set_hdr(httpd_req_t* req, const char* field, const char* value) {
+    if (req->respHdrCount >= HTTPD_FAKE_MAX_HEADERS) return ESP_ERR_NO_MEM;
+    strncpy(req->respHdrNames[req->respHdrCount], field, sizeof(req->respHdrNames[0]) - 1);
+    strncpy(req->respHdrValues[req->respHdrCount], value, sizeof(req->respHdrValues[0]) - 1);
+    req->respHdrCount++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len) {
+    if (req->respDone) return ESP_FAIL;
+    if (buf == NULL) {
+        req->respDone = true;
+        return ESP_OK;
+    }
+    if (len == HTTPD_RESP_USE_STRLEN) len = strlen(buf);
+    req->resp = realloc(req->resp, req->respLen + len);
+    memcpy(&req->resp[req->respLen], buf, len);
+    req->respLen += len;
+    return ESP_OK;
+}
+
+esp_err_t httpd_resp_send(httpd_req_t* req, const char* buf, ssize_t len) {
+    if (buf != NULL && httpd_resp_send_chunk(req, buf, len) != ESP_OK) return ESP_FAIL;
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+int httpd_req_to_sockfd(httpd_req_t* req) {
+    return req->fd;
+}
+
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg) {
+    if (work_count >= HTTPD_FAKE_MAX_WORK) return ESP_FAIL;
+    work_fns[work_count] = work;
+    work_args[work_count] = arg;
+    work_count++;
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_recv_frame(httpd_req_t* req, httpd_ws_frame_t* pkt, size_t max_len) {
+    // max_len = 0 only reads the frame header, like the real server
+    pkt->final = true;
+    pkt->fragmented = false;
+    pkt->type = req->wsType;
+    pkt->len = req->content_len;
+    if (max_len == 0) return ESP_OK;
+    if (max_len < req->content_len) return ESP_ERR_INVALID_SIZE;
+    if (req->failAt && req->failAt <= req->content_len) return ESP_FAIL;
+    memcpy(pkt->payload, req->body, req->content_len);
+    req->bodyPos = req->content_len;
+    return ESP_OK;
+}
+
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t* frame) {
+    if (fd < 0 || fd >= HTTPD_FAKE_MAX_SOCKS) return ESP_ERR_INVALID_ARG;
+    httpd_fake_sock_t* sock = &httpd_fake_socks[fd];
+    if (sock->info != HTTPD_WS_CLIENT_WEBSOCKET || sock->sendFails) return ESP_FAIL;
+    sock->last = realloc(sock->last, frame->len);
+    memcpy(sock->last, frame->payload, frame->len);
+    sock->lastLen = frame->len;
+    sock->sent++;
+    return ESP_OK;
+}
+
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd) {
+    if (fd < 0 || fd >= HTTPD_FAKE_MAX_SOCKS) return HTTPD_WS_CLIENT_INVALID;
+    return httpd_fake_socks[fd].info;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+/*
+ * Fake of the parts of the ESP-IDF HTTP server the firmware uses.
+ * Request bodies are served from memory in chunks of recvChunk bytes
+ * and everything sent back is recorded in the request for inspection.
+ * Registered URI handlers are kept in a table the tests can look them up in.
+ * WebSocket frames are received from the request body, the state of every
+ * socket and the frames sent to it are kept in httpd_fake_socks.
+ */
+
+#include "esp_err.h"
+// Pulled in by ESP-IDF's esp_http_server.h as well
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#define HTTPD_400 "400 Bad Request"
+#define HTTPD_404 "404 Not Found"
+#define HTTPD_500 "500 Internal Server Error"
+#define HTTPD_SOCK_ERR_FAIL -1
+#define HTTPD_SOCK_ERR_TIMEOUT -3
+#define HTTPD_RESP_USE_STRLEN -1
+#define ESP_ERR_HTTPD_RESULT_TRUNC 0xb00c
+
+#define HTTPD_FAKE_MAX_HEADERS 8
+#define HTTPD_FAKE_MAX_HANDLERS 16
+#define HTTPD_FAKE_MAX_SOCKS 16
+#define HTTPD_FAKE_MAX_WORK 4
+
+typedef void* httpd_handle_t;
+typedef enum { HTTP_GET, HTTP_POST, HTTP_PUT, HTTP_DELETE } httpd_method_t;
+typedef void (*httpd_work_fn_t)(void* arg);
+
+typedef enum {
+    HTTPD_WS_TYPE_CONTINUE = 0x0,
+    HTTPD_WS_TYPE_TEXT = 0x1,
+    HTTPD_WS_TYPE_BINARY = 0x2,
+    HTTPD_WS_TYPE_CLOSE = 0x8,
+    HTTPD_WS_TYPE_PING = 0x9,
+    HTTPD_WS_TYPE_PONG = 0xA
+} httpd_ws_type_t;
+
+typedef enum {
+    HTTPD_WS_CLIENT_INVALID = 0x0,
+    HTTPD_WS_CLIENT_HTTP = 0x1,
+    HTTPD_WS_CLIENT_WEBSOCKET = 0x2
+} httpd_ws_client_info_t;
+
+typedef struct httpd_ws_frame {
+    bool final;
+    bool fragmented;
+    httpd_ws_type_t type;
+    uint8_t* payload;
+    size_t len;
+} httpd_ws_frame_t;
+
+typedef struct httpd_req {
+    httpd_method_t method;
+    size_t content_len;
+    void* user_ctx;
+
+    // Request
+    const char* hdrNames[HTTPD_FAKE_MAX_HEADERS];
+    const char* hdrValues[HTTPD_FAKE_MAX_HEADERS];
+    const char* query;      // URL query string without the '?', NULL = none
+    const uint8_t* body;
+    size_t bodyPos;
+    size_t recvChunk;       // Maximum bytes returned per httpd_req_recv() call, 0 = unlimited
+    size_t failAt;          // httpd_req_recv() fails once this many bytes were read, 0 = never
+    unsigned timeoutEvery;  // Every n-th httpd_req_recv() call times out, 0 = never
+    unsigned recvCalls;
+    int fd;
+    httpd_ws_type_t wsType; // Type of the WebSocket frame, whose payload is the body.
+                            // Reading the payload fails if failAt lies within it.
+
+    // Response
+    char status[48];
+    char respHdrNames[HTTPD_FAKE_MAX_HEADERS][32];
+    char respHdrValues[HTTPD_FAKE_MAX_HEADERS][64];
+    unsigned respHdrCount;
+    unsigned char* resp;
+    size_t respLen;
+    bool respDone;
+} httpd_req_t;
+
+typedef struct {
+    const char* uri;
+    httpd_method_t method;
+    esp_err_t (*handler)(httpd_req_t* req);
+    void* user_ctx;
+    bool is_websocket;
+} httpd_uri_t;
+
+typedef struct {
+    httpd_ws_client_info_t info;    // Set by the tests, HTTPD_WS_CLIENT_INVALID = closed
+    bool sendFails;                 // httpd_ws_send_frame_async() fails even though the socket is open
+    unsigned sent;                  // Frames sent with httpd_ws_send_frame_async()
+    uint8_t* last;                  // Payload of the last one
+    size_t lastLen;
+} httpd_fake_sock_t;
+
+extern httpd_fake_sock_t httpd_fake_socks[HTTPD_FAKE_MAX_SOCKS];
+
+void httpd_fake_req_init(httpd_req_t* req, const void* body, size_t len);
+void httpd_fake_req_set_hdr(httpd_req_t* req, const char* name, const char* value);
+const char* httpd_fake_resp_hdr(httpd_req_t* req, const char* name);
+void httpd_fake_req_free(httpd_req_t* req);
+const httpd_uri_t* httpd_fake_handler(const char* uri, httpd_method_t method);
+unsigned httpd_fake_run_work(void);
+void httpd_fake_socks_reset(void);
+
+esp_err_t httpd_register_uri_handler(httpd_handle_t handle, const httpd_uri_t* uri_handler);
+esp_err_t httpd_unregister_uri_handler(httpd_handle_t handle, const char* uri, httpd_method_t method);
+
+int httpd_req_recv(httpd_req_t* req, char* buf, size_t len);
+size_t httpd_req_get_hdr_value_len(httpd_req_t* req, const char* field);
+esp_err_t httpd_req_get_hdr_value_str(httpd_req_t* req, const char* field, char* val, size_t len);
+size_t httpd_req_get_url_query_len(httpd_req_t* req);
+esp_err_t httpd_req_get_url_query_str(httpd_req_t* req, char* buf, size_t buf_len);
+esp_err_t httpd_query_key_value(const char* qry, const char* key, char* val, size_t val_size);
+esp_err_t httpd_resp_set_status(httpd_req_t* req, const char* status);
+esp_err_t httpd_resp_set_type(httpd_req_t* req, const char* type);
+esp_err_t httpd_resp_set_hdr(httpd_req_t* req, const char* field, const char* value);
+esp_err_t httpd_resp_send(httpd_req_t* req, const char* buf, ssize_t len);
+esp_err_t httpd_resp_send_chunk(httpd_req_t* req, const char* buf, ssize_t len);
+
+int httpd_req_to_sockfd(httpd_req_t* req);
+esp_err_t httpd_queue_work(httpd_handle_t handle, httpd_work_fn_t work, void* arg);
+esp_err_t httpd_ws_recv_frame(httpd_req_t* req, httpd_ws_frame_t* pkt, size_t max_len);
+esp_err_t httpd_ws_send_frame_async(httpd_handle_t hd, int fd, httpd_ws_frame_t* frame);
+httpd_ws_client_info_t httpd_ws_get_fd_info(httpd_handle_t hd, int fd);
@@ -0,0 +1,3 @@
+#pragma once
+
+// Included by the web interface components, nothing of it is used on the host
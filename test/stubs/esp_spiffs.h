@@ -0,0 +1,3 @@
+#pragma once
+
+// Not exercised by the host tests, the tests map /spiffs/ to a temporary directory
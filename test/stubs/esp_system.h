@@ -0,0 +1,7 @@
+#pragma once
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+void esp_restart(void);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Provided by the test, so it can control the time
+int64_t esp_timer_get_time(void);
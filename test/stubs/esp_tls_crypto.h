@@ -0,0 +1,11 @@
+#pragma once
+
+// Not exercised by the host tests, only needed to link
+
+#include <stddef.h>
+
+static inline int esp_crypto_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen) {
+    (void)dst; (void)dlen; (void)src; (void)slen;
+    *olen = 0;
+    return -1;
+}
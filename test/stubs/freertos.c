@@ -0,0 +1,220 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/event_groups.h"
+#include "freertos/semphr.h"
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+
+struct tskTaskControlBlock {
+    pthread_t thread;
+    TaskFunction_t task;
+    void* arg;
+};
+
+struct QueueDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    uint8_t* items;
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    UBaseType_t head;
+    UBaseType_t count;
+};
+
+struct SemaphoreDefinition {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    TaskHandle_t holder;
+};
+
+struct EventGroupDef_t {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    EventBits_t bits;
+};
+
+static __thread TaskHandle_t current_task = NULL;
+
+static void* _task_entry(void* arg) {
+    TaskHandle_t handle = arg;
+    current_task = handle;
+    handle->task(handle->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stackDepth, void* arg, UBaseType_t priority, TaskHandle_t* handle) {
+    TaskHandle_t newHandle = calloc(1, sizeof(*newHandle));
+    newHandle->task = task;
+    newHandle->arg = arg;
+    if (pthread_create(&newHandle->thread, NULL, _task_entry, newHandle) != 0) {
+        free(newHandle);
+        return pdFALSE;
+    }
+    pthread_detach(newHandle->thread);
+    if (handle != NULL) *handle = newHandle;
+    return pdTRUE;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth, void* arg, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core) {
+    return xTaskCreate(task, name, stackDepth, arg, priority, handle);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == NULL) pthread_exit(NULL);
+}
+
+void vTaskDelay(TickType_t ticks) {
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    if (current_task == NULL) {
+        current_task = calloc(1, sizeof(*current_task));
+        current_task->thread = pthread_self();
+    }
+    return current_task;
+}
+
+static int _wait(pthread_cond_t* cond, pthread_mutex_t* lock, TickType_t ticksToWait) {
+    // Returns 0 if woken up, non-zero on timeout
+    if (ticksToWait == 0) return 1;
+    if (ticksToWait == portMAX_DELAY) return pthread_cond_wait(cond, lock);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticksToWait / 1000;
+    deadline.tv_nsec += (ticksToWait % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(cond, lock, &deadline);
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+    QueueHandle_t queue = calloc(1, sizeof(*queue));
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->changed, NULL);
+    queue->items = malloc(length * itemSize);
+    queue->length = length;
+    queue->itemSize = itemSize;
+    return queue;
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+    // Deleted tasks keep running and may still wait on the queue, so it is never freed
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void* item, TickType_t ticksToWait) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        if (_wait(&queue->changed, &queue->lock, ticksToWait) != 0) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->itemSize], item, queue->itemSize);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void* item, TickType_t ticksToWait) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        if (_wait(&queue->changed, &queue->lock, ticksToWait) != 0) {
+            pthread_mutex_unlock(&queue->lock);
+            return pdFALSE;
+        }
+    }
+    memcpy(item, &queue->items[queue->head * queue->itemSize], queue->itemSize);
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return pdTRUE;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    SemaphoreHandle_t semaphore = calloc(1, sizeof(*semaphore));
+    pthread_mutex_init(&semaphore->lock, NULL);
+    pthread_cond_init(&semaphore->changed, NULL);
+    return semaphore;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+    free(semaphore);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait) {
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    pthread_mutex_lock(&semaphore->lock);
+    while (semaphore->holder != NULL) {
+        if (_wait(&semaphore->changed, &semaphore->lock, ticksToWait) != 0) {
+            pthread_mutex_unlock(&semaphore->lock);
+            return pdFALSE;
+        }
+    }
+    semaphore->holder = task;
+    pthread_mutex_unlock(&semaphore->lock);
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    // Like FreeRTOS, only the holder can give a mutex
+    BaseType_t result = pdFALSE;
+    pthread_mutex_lock(&semaphore->lock);
+    if (semaphore->holder == xTaskGetCurrentTaskHandle()) {
+        semaphore->holder = NULL;
+        pthread_cond_broadcast(&semaphore->changed);
+        result = pdTRUE;
+    }
+    pthread_mutex_unlock(&semaphore->lock);
+    return result;
+}
+
+TaskHandle_t xSemaphoreGetMutexHolder(SemaphoreHandle_t semaphore) {
+    pthread_mutex_lock(&semaphore->lock);
+    TaskHandle_t holder = semaphore->holder;
+    pthread_mutex_unlock(&semaphore->lock);
+    return holder;
+}
+
+EventGroupHandle_t xEventGroupCreate(void) {
+    EventGroupHandle_t group = calloc(1, sizeof(*group));
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->changed, NULL);
+    return group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    if (group == NULL) return 0;
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t result = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    if (group == NULL) return 0;
+    pthread_mutex_lock(&group->lock);
+    EventBits_t result = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clearOnExit, BaseType_t waitForAll, TickType_t ticksToWait) {
+    pthread_mutex_lock(&group->lock);
+    while (waitForAll ? (group->bits & bits) != bits : (group->bits & bits) == 0) {
+        if (_wait(&group->changed, &group->lock, ticksToWait) != 0) break;
+    }
+    EventBits_t result = group->bits;
+    if (clearOnExit) group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return result;
+}
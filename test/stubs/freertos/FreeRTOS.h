@@ -0,0 +1,27 @@
+#pragma once
+
+// Critical sections and delays do nothing on the host.
+// Tasks, queues, mutexes and event groups are backed by POSIX threads, see freertos.c.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+// Pulled in through portmacro.h in ESP-IDF
+#include "esp_system.h"
+
+typedef struct { int unused; } portMUX_TYPE;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define pdTRUE 1
+#define pdFALSE 0
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) (ms)
+#define BIT0 (1 << 0)
+
+#define taskENTER_CRITICAL(lock) (void)(lock)
+#define taskEXIT_CRITICAL(lock) (void)(lock)
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+// Every task runs in its own thread. Deleting another task only forgets its handle, the thread keeps running.
+BaseType_t xTaskCreate(TaskFunction_t task, const char* name, uint32_t stackDepth, void* arg, UBaseType_t priority, TaskHandle_t* handle);
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t task, const char* name, uint32_t stackDepth, void* arg, UBaseType_t priority, TaskHandle_t* handle, BaseType_t core);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+// Threads that weren't created as tasks get a handle on their first call
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
@@ -0,0 +1,70 @@
+#include "gpio_stub.h"
+#include "rom/ets_sys.h"
+#include "soc/soc.h"
+#include "soc/gpio_reg.h"
+#include <string.h>
+
+uint8_t gpio_stub_levels[GPIO_NUM_MAX];
+uint8_t gpio_stub_outputs[GPIO_NUM_MAX];
+uint64_t gpio_stub_time_us;
+uint32_t gpio_stub_reg_writes;
+uint32_t gpio_stub_set_level_calls;
+void (*gpio_stub_on_transition)(uint8_t pin, uint8_t level);
+gpio_stub_transition_t gpio_stub_transitions[GPIO_STUB_MAX_TRANSITIONS];
+uint32_t gpio_stub_num_transitions;
+
+void gpio_stub_reset(void) {
+    memset(gpio_stub_levels, 0, sizeof(gpio_stub_levels));
+    memset(gpio_stub_outputs, 0, sizeof(gpio_stub_outputs));
+    gpio_stub_time_us = 0;
+    gpio_stub_reg_writes = 0;
+    gpio_stub_set_level_calls = 0;
+    gpio_stub_on_transition = NULL;
+    gpio_stub_num_transitions = 0;
+}
+
+static void _set(uint8_t pin, uint8_t level) {
+    if (gpio_stub_levels[pin] == level) return;
+    gpio_stub_levels[pin] = level;
+    gpio_stub_transitions[gpio_stub_num_transitions % GPIO_STUB_MAX_TRANSITIONS] = (gpio_stub_transition_t){
+        .time_us = gpio_stub_time_us, .pin = pin, .level = level
+    };
+    gpio_stub_num_transitions++;
+    if (gpio_stub_on_transition) gpio_stub_on_transition(pin, level);
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio_num) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    gpio_stub_outputs[gpio_num] = 0;
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio_num, int mode) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    gpio_stub_outputs[gpio_num] = (mode == GPIO_MODE_OUTPUT);
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (gpio_num < 0 || gpio_num >= GPIO_NUM_MAX) return ESP_ERR_INVALID_ARG;
+    gpio_stub_set_level_calls++;
+    _set(gpio_num, level ? 1 : 0);
+    return ESP_OK;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    return gpio_stub_levels[gpio_num];
+}
+
+void gpio_stub_reg_write(uint32_t reg, uint32_t value) {
+    uint8_t bank = (reg == GPIO_OUT1_W1TS_REG || reg == GPIO_OUT1_W1TC_REG) ? 32 : 0;
+    uint8_t level = (reg == GPIO_OUT_W1TS_REG || reg == GPIO_OUT1_W1TS_REG);
+    gpio_stub_reg_writes++;
+    for (uint8_t i = 0; i < 32; i++) {
+        if (value & ((uint32_t)1 << i)) _set(bank + i, level);
+    }
+}
+
+void ets_delay_us(uint32_t us) {
+    gpio_stub_time_us += us;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "driver/gpio.h"
+
+/*
+ * Records every level change of the GPIOs, whether it comes from
+ * gpio_set_level() or from a write to the W1TS/W1TC registers.
+ * ets_delay_us() advances the time stamp of the transitions.
+ */
+
+typedef struct {
+    uint64_t time_us;
+    uint8_t pin;
+    uint8_t level;
+} gpio_stub_transition_t;
+
+#define GPIO_STUB_MAX_TRANSITIONS 4096
+
+extern uint8_t gpio_stub_levels[GPIO_NUM_MAX];
+extern uint8_t gpio_stub_outputs[GPIO_NUM_MAX];
+extern uint64_t gpio_stub_time_us;
+extern uint32_t gpio_stub_reg_writes;
+extern uint32_t gpio_stub_set_level_calls;
+
+// Called for every transition, after the level has changed
+extern void (*gpio_stub_on_transition)(uint8_t pin, uint8_t level);
+
+// The most recent transitions, up to GPIO_STUB_MAX_TRANSITIONS
+extern gpio_stub_transition_t gpio_stub_transitions[GPIO_STUB_MAX_TRANSITIONS];
+extern uint32_t gpio_stub_num_transitions;
+
+void gpio_stub_reset(void);
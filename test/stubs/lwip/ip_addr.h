@@ -0,0 +1,7 @@
+#pragma once
+
+#include "lwip/arch.h"
+
+typedef struct {
+    u32_t addr;
+} ip_addr_t;
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "lwip/ip_addr.h"
+
+struct netif;
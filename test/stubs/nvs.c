@@ -0,0 +1,116 @@
+#include "nvs.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define NVS_STUB_MAX_ITEMS 64
+#define NVS_STUB_MAX_KEY_LEN 15
+
+typedef enum {
+    NVS_STUB_I8 = 1, NVS_STUB_U8, NVS_STUB_I16, NVS_STUB_U16,
+    NVS_STUB_I32, NVS_STUB_U32, NVS_STUB_I64, NVS_STUB_U64, NVS_STUB_STR
+} nvs_stub_type_t;
+
+typedef struct {
+    char key[NVS_STUB_MAX_KEY_LEN + 1];
+    nvs_stub_type_t type;
+    int64_t number;
+    char* string;
+} nvs_stub_item_t;
+
+static nvs_stub_item_t items[NVS_STUB_MAX_ITEMS];
+static unsigned num_items = 0;
+
+unsigned nvs_stub_reads = 0;
+unsigned nvs_stub_writes = 0;
+unsigned nvs_stub_fail_write = 0;
+
+
+void nvs_stub_reset(void) {
+    for (unsigned i = 0; i < num_items; i++) free(items[i].string);
+    num_items = 0;
+    nvs_stub_reads = 0;
+    nvs_stub_writes = 0;
+    nvs_stub_fail_write = 0;
+}
+
+static nvs_stub_item_t* _find(const char* key) {
+    for (unsigned i = 0; i < num_items; i++) {
+        if (!strcmp(items[i].key, key)) return &items[i];
+    }
+    return NULL;
+}
+
+static esp_err_t _get(const char* key, nvs_stub_type_t type, nvs_stub_item_t** item) {
+    nvs_stub_reads++;
+    *item = _find(key);
+    if (*item == NULL) return ESP_ERR_NVS_NOT_FOUND;
+    if ((*item)->type != type) return ESP_ERR_NVS_TYPE_MISMATCH;
+    return ESP_OK;
+}
+
+static esp_err_t _set(const char* key, nvs_stub_type_t type, int64_t number, const char* string) {
+    if (++nvs_stub_writes == nvs_stub_fail_write) return ESP_FAIL;
+    if (strlen(key) > NVS_STUB_MAX_KEY_LEN) return ESP_ERR_INVALID_ARG;
+    nvs_stub_item_t* item = _find(key);
+    if (item == NULL) {
+        if (num_items == NVS_STUB_MAX_ITEMS) return ESP_ERR_NO_MEM;
+        item = &items[num_items++];
+        strcpy(item->key, key);
+    } else {
+        free(item->string);
+    }
+    item->type = type;
+    item->number = number;
+    item->string = (string != NULL) ? strdup(string) : NULL;
+    return ESP_OK;
+}
+
+#define NVS_STUB_NUMBER(name, ctype, type) \
+    esp_err_t nvs_get_##name(nvs_handle_t handle, const char* key, ctype* out_value) { \
+        nvs_stub_item_t* item; \
+        esp_err_t ret = _get(key, type, &item); \
+        if (ret == ESP_OK) *out_value = (ctype)item->number; \
+        return ret; \
+    } \
+    esp_err_t nvs_set_##name(nvs_handle_t handle, const char* key, ctype value) { \
+        return _set(key, type, (int64_t)value, NULL); \
+    }
+
+NVS_STUB_NUMBER(i8, int8_t, NVS_STUB_I8)
+NVS_STUB_NUMBER(u8, uint8_t, NVS_STUB_U8)
+NVS_STUB_NUMBER(i16, int16_t, NVS_STUB_I16)
+NVS_STUB_NUMBER(u16, uint16_t, NVS_STUB_U16)
+NVS_STUB_NUMBER(i32, int32_t, NVS_STUB_I32)
+NVS_STUB_NUMBER(u32, uint32_t, NVS_STUB_U32)
+NVS_STUB_NUMBER(i64, int64_t, NVS_STUB_I64)
+NVS_STUB_NUMBER(u64, uint64_t, NVS_STUB_U64)
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* out_value, size_t* length) {
+    nvs_stub_item_t* item;
+    esp_err_t ret = _get(key, NVS_STUB_STR, &item);
+    if (ret != ESP_OK) return ret;
+    size_t required = strlen(item->string) + 1;
+    if (out_value != NULL) {
+        if (*length < required) return ESP_ERR_NVS_INVALID_LENGTH;
+        memcpy(out_value, item->string, required);
+    }
+    *length = required;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value) {
+    if (strlen(value) >= 4000) return ESP_ERR_NVS_VALUE_TOO_LONG;
+    return _set(key, NVS_STUB_STR, 0, value);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char* key) {
+    nvs_stub_item_t* item = _find(key);
+    if (item == NULL) return ESP_ERR_NVS_NOT_FOUND;
+    free(item->string);
+    *item = items[--num_items];
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle) {
+    return ESP_OK;
+}
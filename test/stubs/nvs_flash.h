@@ -0,0 +1,4 @@
+#pragma once
+
+// ESP-IDF's nvs_flash.h pulls in nvs.h
+#include "nvs.h"
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Advances the time of the GPIO stub, see gpio_stub.h
+void ets_delay_us(uint32_t us);
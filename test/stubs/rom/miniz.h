@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ * The subset of the tinfl API the firmware uses, on top of zlib.
+ * Only non-wrapping output buffers are supported.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef uint32_t mz_uint32;
+
+#define TINFL_FLAG_PARSE_ZLIB_HEADER 1
+#define TINFL_FLAG_HAS_MORE_INPUT 2
+#define TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF 4
+
+typedef enum {
+    TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS = -4,
+    TINFL_STATUS_BAD_PARAM = -3,
+    TINFL_STATUS_ADLER32_MISMATCH = -2,
+    TINFL_STATUS_FAILED = -1,
+    TINFL_STATUS_DONE = 0,
+    TINFL_STATUS_NEEDS_MORE_INPUT = 1,
+    TINFL_STATUS_HAS_MORE_OUTPUT = 2
+} tinfl_status;
+
+typedef struct {
+    z_stream stream;
+    int initialized;
+} tinfl_decompressor;
+
+static inline void tinfl_init(tinfl_decompressor* r) {
+    r->initialized = 0;
+}
+
+static inline tinfl_status tinfl_decompress(tinfl_decompressor* r, const uint8_t* pIn_buf_next, size_t* pIn_buf_size,
+                                            uint8_t* pOut_buf_start, uint8_t* pOut_buf_next, size_t* pOut_buf_size, mz_uint32 decomp_flags) {
+    (void)pOut_buf_start;
+    if (!(decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)) return TINFL_STATUS_BAD_PARAM;
+    z_stream* s = &r->stream;
+    if (!r->initialized) {
+        *s = (z_stream){0};
+        if (inflateInit2(s, (decomp_flags & TINFL_FLAG_PARSE_ZLIB_HEADER) ? 15 : -15) != Z_OK) return TINFL_STATUS_FAILED;
+        r->initialized = 1;
+    }
+    s->next_in = (Bytef*)pIn_buf_next;
+    s->avail_in = *pIn_buf_size;
+    s->next_out = pOut_buf_next;
+    s->avail_out = *pOut_buf_size;
+    int ret = inflate(s, Z_NO_FLUSH);
+    *pIn_buf_size -= s->avail_in;
+    *pOut_buf_size -= s->avail_out;
+
+    tinfl_status status;
+    if (ret == Z_STREAM_END) {
+        status = TINFL_STATUS_DONE;
+    } else if (ret == Z_DATA_ERROR) {
+        status = s->msg != NULL && !strcmp(s->msg, "incorrect data check") ? TINFL_STATUS_ADLER32_MISMATCH : TINFL_STATUS_FAILED;
+    } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+        status = TINFL_STATUS_FAILED;
+    } else if (s->avail_out == 0 && (s->avail_in > 0 || !(decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) || ret == Z_BUF_ERROR)) {
+        status = TINFL_STATUS_HAS_MORE_OUTPUT;
+    } else if (decomp_flags & TINFL_FLAG_HAS_MORE_INPUT) {
+        status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    } else {
+        status = TINFL_STATUS_FAILED_CANNOT_MAKE_PROGRESS;
+    }
+    if (status != TINFL_STATUS_NEEDS_MORE_INPUT && status != TINFL_STATUS_HAS_MORE_OUTPUT) {
+        inflateEnd(s);
+        r->initialized = 0;
+    }
+    return status;
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+// The Kconfig values are set per test target in CMakeLists.txt
@@ -0,0 +1,5 @@
+#pragma once
+
+// The real file holds the credentials and isn't part of the repository
+#define HTTPD_CONFIG_USERNAME "user"
+#define HTTPD_CONFIG_PASSWORD "password"
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stdint.h>
+
+// Register writes go to the GPIO stub, see gpio_stub.h
+void gpio_stub_reg_write(uint32_t reg, uint32_t value);
+#define REG_WRITE(reg, value) gpio_stub_reg_write((reg), (value))
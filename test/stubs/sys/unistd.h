@@ -0,0 +1,5 @@
+#pragma once
+
+// Newlib has it under sys/, glibc only at the top level
+
+#include <unistd.h>
@@ -0,0 +1,311 @@
+#include "test_common.h"
+#include "freertos/FreeRTOS.h"
+#include "bitmap_generators.h"
+#include "i2s_microphone.h"
+#include "macros.h"
+#include "util_fixed_point.h"
+#include "char_16seg_mapping.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * The gradient and plasma generators precalculate their spatial terms.
+ * The output is compared against the original per pixel calculation,
+ * which is kept here as the reference.
+ * Both are timed on the 2062 LEDs of the 16 segment hybrid display,
+ * the timings are informational only, they don't fail the test.
+ */
+
+#define WIDTH DISPLAY_FRAME_WIDTH_PIXEL
+#define HEIGHT DISPLAY_FRAME_HEIGHT_PIXEL
+#define OFFSET(x, y) ((x) * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + (y) * 3)
+
+static uint8_t pixel_buffer[DISPLAY_PIX_BUF_SIZE];
+static uint8_t reference_buffer[DISPLAY_PIX_BUF_SIZE];
+static portMUX_TYPE pixel_buffer_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Pixels calculated by the reference implementations, as pixel buffer offsets
+static uint16_t reference_pixels[WIDTH * HEIGHT];
+static uint32_t reference_num_pixels;
+
+// The individual generators are only called through bitmap_generator_current() in the firmware
+void bitmap_generator_rainbow_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint8_t s, uint8_t v);
+void bitmap_generator_hard_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint16_t numColors, color_rgb_u8_t* colors);
+void bitmap_generator_soft_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint16_t numColors, color_rgb_u8_t* colors);
+void bitmap_generator_plasma(int64_t t, uint16_t speed, uint16_t scale, uint8_t s, uint8_t v);
+void bitmap_generator_plasma_2(int64_t t, uint16_t speed, uint16_t scale, color_rgb_u8_t color1, color_rgb_u8_t color2);
+
+// Not used by the 24 bpp generators
+int64_t esp_timer_get_time(void) { return 0; }
+void i2s_mic_get_fft_bins(float* bins, uint16_t numBins, uint8_t x_log, float lin_log_factor, float minSampleNormFactor, float maxSampleNormFactor, float maxSampleNormFactorIncrease, float maxSampleNormFactorDecrease) {}
+void i2s_mic_get_beat(i2s_mic_beat_t* beat) { memset(beat, 0, sizeof(*beat)); }
+
+static void _reference_use_pixels(const uint16_t* pixels, uint32_t numPixels) {
+    // NULL selects the full frame
+    reference_num_pixels = 0;
+    for (uint32_t i = 0; i < (pixels ? numPixels : WIDTH * HEIGHT); i++) {
+        reference_pixels[reference_num_pixels++] = pixels ? pixels[i] : OFFSET(i / HEIGHT, i % HEIGHT);
+    }
+}
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _set_pixel(uint16_t x, uint16_t y, color_rgb_u8_t color) {
+    reference_buffer[OFFSET(x, y)] = color.r;
+    reference_buffer[OFFSET(x, y) + 1] = color.g;
+    reference_buffer[OFFSET(x, y) + 2] = color.b;
+}
+
+static fx52_12_t _reference_gradient_pos(int64_t t, fx20_12_t normalized_speed_fx, uint16_t angle, uint16_t scale, uint16_t range, uint16_t x, uint16_t y) {
+    int32_t angle_units = (angle * 0x8000) / 360;
+    fx20_12_t sin_angle_fx = sin_i16_to_fx20_12(angle_units);
+    fx20_12_t cos_angle_fx = cos_i16_to_fx20_12(angle_units);
+    fx20_12_t normalized_scale_fx = FX20_12(scale) / 100;
+    fx20_12_t diagonal_length_fx = sqrt_i32_to_fx20_12(WIDTH * WIDTH + HEIGHT * HEIGHT);
+
+    fx20_12_t distance_along_gradient_fx = x * cos_angle_fx + y * sin_angle_fx;
+    fx20_12_t normalized_distance_fx = FX20_12((int64_t)distance_along_gradient_fx) / diagonal_length_fx;
+    fx20_12_t offset_fx = (normalized_distance_fx + FX20_12(1)) * range;
+    offset_fx = UNFX20_12((int64_t)offset_fx * normalized_scale_fx);
+    fx52_12_t t_sec_fx = FX52_12(t) / 1000000;
+    return (UNFX52_12((int64_t)normalized_speed_fx * t_sec_fx) + offset_fx) % FX20_12(range);
+}
+
+static void _reference_rainbow_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint8_t s, uint8_t v) {
+    fx20_12_t normalized_speed_fx = speed * (FX20_12(scale) / 100);
+    for (uint32_t i = 0; i < reference_num_pixels; i++) {
+        uint16_t x = reference_pixels[i] / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
+        uint16_t y = reference_pixels[i] % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES / 3;
+        color_hsv_fx20_12_t hsv_fx;
+        hsv_fx.h = _reference_gradient_pos(t, normalized_speed_fx, angle, scale, 360, x, y);
+        hsv_fx.s = FX20_12(s) / 255;
+        hsv_fx.v = FX20_12(v) / 255;
+        _set_pixel(x, y, hsv_fx20_12_to_rgb_u8(hsv_fx));
+    }
+}
+
+static void _reference_hard_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint16_t numColors, color_rgb_u8_t* colors) {
+    fx20_12_t normalized_speed_fx = (speed * (FX20_12(scale) / 100)) / 100;
+    for (uint32_t i = 0; i < reference_num_pixels; i++) {
+        uint16_t x = reference_pixels[i] / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
+        uint16_t y = reference_pixels[i] % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES / 3;
+        fx52_12_t temp_fx = _reference_gradient_pos(t, normalized_speed_fx, angle, scale, 1, x, y);
+        uint16_t segment_index = (uint16_t)UNFX20_12_ROUND(temp_fx * numColors) % numColors;
+        _set_pixel(x, y, colors[segment_index]);
+    }
+}
+
+static void _reference_soft_gradient(int64_t t, uint16_t speed, uint16_t angle, uint16_t scale, uint16_t numColors, color_rgb_u8_t* colors) {
+    fx20_12_t normalized_speed_fx = (speed * (FX20_12(scale) / 100)) / 100;
+    for (uint32_t i = 0; i < reference_num_pixels; i++) {
+        uint16_t x = reference_pixels[i] / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
+        uint16_t y = reference_pixels[i] % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES / 3;
+        fx52_12_t temp_fx = _reference_gradient_pos(t, normalized_speed_fx, angle, scale, 1, x, y);
+        fx20_12_t segment_index_fx = temp_fx * numColors;
+        uint16_t segment_index_base = (uint16_t)UNFX20_12(segment_index_fx) % numColors;
+        uint16_t next_segment_index = (segment_index_base + 1) % numColors;
+        fx20_12_t segment_fraction_fx = segment_index_fx % FX20_12(1);
+        color_rgb_u8_t color1 = colors[segment_index_base];
+        color_rgb_u8_t color2 = colors[next_segment_index];
+        color_rgb_u8_t color = {
+            .r = interpolate_fx20_12_i32(segment_fraction_fx, color1.r, color2.r),
+            .g = interpolate_fx20_12_i32(segment_fraction_fx, color1.g, color2.g),
+            .b = interpolate_fx20_12_i32(segment_fraction_fx, color1.b, color2.b)
+        };
+        _set_pixel(x, y, color);
+    }
+}
+
+static fx20_12_t _reference_plasma_value(int64_t t, uint16_t speed, uint16_t scale, uint16_t x, uint16_t y) {
+    int32_t x_units = (x * 0x4000) / WIDTH - 0x2000;
+    int32_t y_units = (y * 0x4000) / HEIGHT - 0x2000;
+    x_units = x_units * scale / 10;
+    y_units = y_units * scale / 10;
+
+    fx52_12_t t_sec_fx = FX52_12(t) / 1000000;
+    fx52_12_t t_speed_fx = t_sec_fx * 1000 * speed;
+
+    fx20_12_t sin_x_fx = sin_i16_to_fx20_12(x_units + UNFX52_12(t_speed_fx * 5 / 10));
+    fx20_12_t sin_2x_fx = sin_i16_to_fx20_12(x_units * 2 + UNFX52_12(t_speed_fx * 6 / 10));
+    fx20_12_t sin_y_fx = sin_i16_to_fx20_12(y_units + UNFX52_12(t_speed_fx * 7 / 10));
+    fx20_12_t sin_2y_fx = sin_i16_to_fx20_12(y_units * 2 + UNFX52_12(t_speed_fx * 8 / 10));
+    fx20_12_t sin_circ_fx = sin_i16_to_fx20_12(UNFX20_12_ROUND(sqrt_i32_to_fx20_12(x_units*x_units + y_units*y_units)) * 2 + UNFX52_12(t_speed_fx * 9 / 10));
+    return (sin_x_fx + sin_2x_fx + sin_y_fx + sin_2y_fx + sin_circ_fx) / 5;
+}
+
+static void _reference_plasma(int64_t t, uint16_t speed, uint16_t scale, uint8_t s, uint8_t v) {
+    for (uint32_t i = 0; i < reference_num_pixels; i++) {
+        uint16_t x = reference_pixels[i] / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
+        uint16_t y = reference_pixels[i] % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES / 3;
+        fx20_12_t hue_fx = (_reference_plasma_value(t, speed, scale, x, y) + FX20_12(1)) * 180;
+        color_hsv_fx20_12_t hsv_fx;
+        hsv_fx.h = hue_fx % FX20_12(360);
+        hsv_fx.s = FX20_12(s) / 255;
+        hsv_fx.v = FX20_12(v) / 255;
+        _set_pixel(x, y, hsv_fx20_12_to_rgb_u8(hsv_fx));
+    }
+}
+
+static void _reference_plasma_2(int64_t t, uint16_t speed, uint16_t scale, color_rgb_u8_t color1, color_rgb_u8_t color2) {
+    for (uint32_t i = 0; i < reference_num_pixels; i++) {
+        uint16_t x = reference_pixels[i] / DISPLAY_FRAME_HEIGHT_PIXEL_BYTES;
+        uint16_t y = reference_pixels[i] % DISPLAY_FRAME_HEIGHT_PIXEL_BYTES / 3;
+        fx20_12_t gradient_pos_fx = (_reference_plasma_value(t, speed, scale, x, y) + FX20_12(1)) / 2;
+        color_rgb_u8_t color = {
+            .r = interpolate_fx20_12_i32(gradient_pos_fx, color1.r, color2.r),
+            .g = interpolate_fx20_12_i32(gradient_pos_fx, color1.g, color2.g),
+            .b = interpolate_fx20_12_i32(gradient_pos_fx, color1.b, color2.b)
+        };
+        _set_pixel(x, y, color);
+    }
+}
+
+static int _max_difference(void) {
+    int maxDiff = 0;
+    for (uint32_t i = 0; i < sizeof(pixel_buffer); i++) {
+        int diff = abs(pixel_buffer[i] - reference_buffer[i]);
+        if (diff > maxDiff) maxDiff = diff;
+    }
+    return maxDiff;
+}
+
+static uint32_t _differing_pixels(void) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < sizeof(pixel_buffer); i += 3) {
+        if (memcmp(&pixel_buffer[i], &reference_buffer[i], 3) != 0) count++;
+    }
+    return count;
+}
+
+static const int64_t times[] = {0, 1234567, 1700000000123456LL};
+static const uint16_t angles[] = {0, 45, 130, 270};
+static const uint16_t scales[] = {10, 100, 250};
+static color_rgb_u8_t colors[3] = {{.r = 255, .g = 0, .b = 0}, {.r = 0, .g = 255, .b = 40}, {.r = 20, .g = 10, .b = 200}};
+
+static void test_gradients(void) {
+    /*
+    Rounding the column and row terms separately can move a value by 1 LSB,
+    which shows as a colour difference of one step at most. A hard gradient
+    can switch to the neighbouring colour exactly at a segment boundary.
+    */
+    bitmap_generators_init(pixel_buffer, sizeof(pixel_buffer), &pixel_buffer_lock, WIDTH, HEIGHT, NULL, 0);
+    _reference_use_pixels(NULL, 0);
+    for (uint32_t ti = 0; ti < sizeof(times) / sizeof(times[0]); ti++) {
+        for (uint32_t ai = 0; ai < sizeof(angles) / sizeof(angles[0]); ai++) {
+            for (uint32_t si = 0; si < sizeof(scales) / sizeof(scales[0]); si++) {
+                int64_t t = times[ti];
+                uint16_t angle = angles[ai];
+                uint16_t scale = scales[si];
+
+                bitmap_generator_rainbow_gradient(t, 20, angle, scale, 255, 200);
+                _reference_rainbow_gradient(t, 20, angle, scale, 255, 200);
+                CHECK(_max_difference() <= 1);
+
+                bitmap_generator_soft_gradient(t, 30, angle, scale, 3, colors);
+                _reference_soft_gradient(t, 30, angle, scale, 3, colors);
+                CHECK(_max_difference() <= 1);
+
+                bitmap_generator_hard_gradient(t, 30, angle, scale, 3, colors);
+                _reference_hard_gradient(t, 30, angle, scale, 3, colors);
+                CHECK(_differing_pixels() <= WIDTH * HEIGHT / 100);
+            }
+        }
+    }
+}
+
+static void test_plasma(void) {
+    bitmap_generators_init(pixel_buffer, sizeof(pixel_buffer), &pixel_buffer_lock, WIDTH, HEIGHT, NULL, 0);
+    _reference_use_pixels(NULL, 0);
+    for (uint32_t ti = 0; ti < sizeof(times) / sizeof(times[0]); ti++) {
+        for (uint32_t si = 0; si < sizeof(scales) / sizeof(scales[0]); si++) {
+            int64_t t = times[ti];
+            uint16_t scale = scales[si];
+
+            bitmap_generator_plasma(t, 5, scale, 255, 255);
+            _reference_plasma(t, 5, scale, 255, 255);
+            CHECK(memcmp(pixel_buffer, reference_buffer, sizeof(pixel_buffer)) == 0);
+
+            bitmap_generator_plasma_2(t, 5, scale, colors[0], colors[2]);
+            _reference_plasma_2(t, 5, scale, colors[0], colors[2]);
+            CHECK(memcmp(pixel_buffer, reference_buffer, sizeof(pixel_buffer)) == 0);
+        }
+    }
+}
+
+static void test_active_pixels(void) {
+    // Only the listed pixels are written, in the same colours as on a full frame
+    static uint16_t activePixels[WIDTH * HEIGHT / 7 + 1];
+    uint32_t numActivePixels = 0;
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; i += 7) {
+        activePixels[numActivePixels++] = OFFSET(i / HEIGHT, i % HEIGHT);
+    }
+
+    bitmap_generators_init(pixel_buffer, sizeof(pixel_buffer), &pixel_buffer_lock, WIDTH, HEIGHT, NULL, 0);
+    bitmap_generator_plasma(1234567, 5, 100, 255, 255);
+    memcpy(reference_buffer, pixel_buffer, sizeof(pixel_buffer));
+
+    bitmap_generators_init(pixel_buffer, sizeof(pixel_buffer), &pixel_buffer_lock, WIDTH, HEIGHT, activePixels, numActivePixels);
+    memset(pixel_buffer, 0, sizeof(pixel_buffer));
+    bitmap_generator_plasma(1234567, 5, 100, 255, 255);
+    uint32_t mismatches = 0;
+    uint32_t written = 0;
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) {
+        uint32_t offset = OFFSET(i / HEIGHT, i % HEIGHT);
+        bool active = (i % 7) == 0;
+        if (active && memcmp(&pixel_buffer[offset], &reference_buffer[offset], 3) != 0) mismatches++;
+        if (!active && (pixel_buffer[offset] | pixel_buffer[offset + 1] | pixel_buffer[offset + 2])) written++;
+    }
+    CHECK_EQ_INT(mismatches, 0);
+    CHECK_EQ_INT(written, 0);
+}
+
+static void benchmark(void) {
+    // Frames per second on the LEDs of the hybrid display, precalculated and per pixel
+    const int n = 200;
+    const int64_t frameTime = 1000000 / 60;
+    bitmap_generators_init(pixel_buffer, sizeof(pixel_buffer), &pixel_buffer_lock, WIDTH, HEIGHT, LED_TO_BITMAP_MAPPING, MAPPING_LENGTH);
+    _reference_use_pixels(LED_TO_BITMAP_MAPPING, MAPPING_LENGTH);
+    memset(pixel_buffer, 0, sizeof(pixel_buffer));
+    memset(reference_buffer, 0, sizeof(reference_buffer));
+    printf("%u LEDs, frames/s precalculated / per pixel:\n", MAPPING_LENGTH);
+
+    double t0 = _now();
+    for (int i = 0; i < n; i++) bitmap_generator_rainbow_gradient(i * frameTime, 20, 130, 100, 255, 200);
+    double t1 = _now();
+    for (int i = 0; i < n; i++) _reference_rainbow_gradient(i * frameTime, 20, 130, 100, 255, 200);
+    printf("rainbow_gradient: %.0f / %.0f\n", n / (t1 - t0), n / (_now() - t1));
+
+    t0 = _now();
+    for (int i = 0; i < n; i++) bitmap_generator_soft_gradient(i * frameTime, 30, 130, 100, 3, colors);
+    t1 = _now();
+    for (int i = 0; i < n; i++) _reference_soft_gradient(i * frameTime, 30, 130, 100, 3, colors);
+    printf("soft_gradient: %.0f / %.0f\n", n / (t1 - t0), n / (_now() - t1));
+
+    t0 = _now();
+    for (int i = 0; i < n; i++) bitmap_generator_plasma(i * frameTime, 5, 100, 255, 255);
+    t1 = _now();
+    for (int i = 0; i < n; i++) _reference_plasma(i * frameTime, 5, 100, 255, 255);
+    printf("plasma: %.0f / %.0f\n", n / (t1 - t0), n / (_now() - t1));
+
+    t0 = _now();
+    for (int i = 0; i < n; i++) bitmap_generator_plasma_2(i * frameTime, 5, 100, colors[0], colors[2]);
+    t1 = _now();
+    for (int i = 0; i < n; i++) _reference_plasma_2(i * frameTime, 5, 100, colors[0], colors[2]);
+    printf("plasma_2: %.0f / %.0f\n", n / (t1 - t0), n / (_now() - t1));
+
+    // Both rendered the same frame last
+    CHECK(memcmp(pixel_buffer, reference_buffer, sizeof(pixel_buffer)) == 0);
+}
+
+int main(void) {
+    test_gradients();
+    test_plasma();
+    test_active_pixels();
+    benchmark();
+    return TEST_RESULT();
+}
@@ -0,0 +1,331 @@
+#include "test_common.h"
+#include "browser_canvas.h"
+#include "macros.h"
+#include <string.h>
+
+/*
+ * The live frame WebSocket on /canvas/ws: parsing and bounds checks of the
+ * FULL, RANGE, RECT and SUBSCRIBE messages, pushing changed buffers to
+ * subscribed clients, the client slot limit and releasing the slots of
+ * connections that closed, failed or went away without a CLOSE frame.
+ */
+
+#define MAX_CLIENTS 4
+
+// Embedded files
+const uint8_t browser_canvas_html_gz_start[1] asm("_binary_browser_canvas_html_gz_start");
+const uint8_t browser_canvas_html_gz_end[1] asm("_binary_browser_canvas_html_gz_end");
+
+// The canvas only pushes frames while it has a server
+static int server_instance;
+static httpd_handle_t server = &server_instance;
+static nvs_handle_t nvs = 1;
+static uint8_t pixel_buf[DISPLAY_FRAME_WIDTH_PIXEL * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES];
+static uint8_t text_buf[48];
+static uint8_t unit_buf[8];
+static uint8_t line_flags_buf[2];
+static portMUX_TYPE pixel_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE text_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE unit_lock = portMUX_INITIALIZER_UNLOCKED;
+static portMUX_TYPE line_flags_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void _start(void) {
+    memset(pixel_buf, 0, sizeof(pixel_buf));
+    memset(text_buf, 0, sizeof(text_buf));
+    memset(unit_buf, 0, sizeof(unit_buf));
+    memset(line_flags_buf, 0, sizeof(line_flags_buf));
+    httpd_fake_socks_reset();
+    browser_canvas_init(&server, &nvs, pixel_buf, sizeof(pixel_buf), &pixel_lock, text_buf, sizeof(text_buf), &text_lock,
+        unit_buf, sizeof(unit_buf), &unit_lock, line_flags_buf, sizeof(line_flags_buf), &line_flags_lock);
+}
+
+static void _stop(void) {
+    browser_canvas_stop();
+    httpd_fake_run_work();
+}
+
+static esp_err_t _connect(int fd) {
+    // Handshake of a new connection, which the server has already upgraded
+    httpd_req_t req;
+    httpd_fake_req_init(&req, NULL, 0);
+    req.method = HTTP_GET;
+    req.fd = fd;
+    httpd_fake_socks[fd].info = HTTPD_WS_CLIENT_WEBSOCKET;
+    esp_err_t ret = httpd_fake_handler("/canvas/ws", HTTP_GET)->handler(&req);
+    httpd_fake_req_free(&req);
+    return ret;
+}
+
+static esp_err_t _frame(int fd, httpd_ws_type_t type, const uint8_t* msg, size_t len, size_t failAt) {
+    httpd_req_t req;
+    httpd_fake_req_init(&req, msg, len);
+    req.fd = fd;
+    req.wsType = type;
+    req.failAt = failAt;
+    esp_err_t ret = httpd_fake_handler("/canvas/ws", HTTP_GET)->handler(&req);
+    httpd_fake_req_free(&req);
+    return ret;
+}
+
+static esp_err_t _send(int fd, const uint8_t* msg, size_t len) {
+    return _frame(fd, HTTPD_WS_TYPE_BINARY, msg, len, 0);
+}
+
+static esp_err_t _subscribe(int fd, uint8_t mask) {
+    uint8_t msg[] = {0x10, 0, mask};
+    return _send(fd, msg, sizeof(msg));
+}
+
+static size_t _range(uint8_t* msg, uint8_t id, uint32_t offset, const uint8_t* data, size_t len) {
+    msg[0] = 0x01;
+    msg[1] = id;
+    for (int i = 0; i < 4; i++) msg[2 + i] = offset >> (8 * i);
+    memcpy(&msg[6], data, len);
+    return 6 + len;
+}
+
+static size_t _rect(uint8_t* msg, uint8_t id, uint16_t x, uint16_t y, uint16_t w, uint16_t h, size_t len) {
+    // The data is 1, 2, 3, ... for len bytes
+    uint16_t values[4] = {x, y, w, h};
+    msg[0] = 0x02;
+    msg[1] = id;
+    for (int i = 0; i < 4; i++) {
+        msg[2 + 2 * i] = values[i] & 0xFF;
+        msg[3 + 2 * i] = values[i] >> 8;
+    }
+    for (size_t i = 0; i < len; i++) msg[10 + i] = i + 1;
+    return 10 + len;
+}
+
+static void test_full(void) {
+    uint8_t msg[2 + sizeof(pixel_buf) + 1];
+    _start();
+    CHECK_EQ_INT(_connect(3), ESP_OK);
+
+    // Shorter text ends the string
+    memset(text_buf, 'x', sizeof(text_buf));
+    memcpy(msg, "\x00\x01Hello", 7);
+    CHECK_EQ_INT(_send(3, msg, 7), ESP_OK);
+    CHECK(!strcmp((char*)text_buf, "Hello"));
+
+    // Whole pixel buffer
+    msg[0] = 0x00;
+    msg[1] = 0;
+    for (size_t i = 0; i < sizeof(pixel_buf); i++) msg[2 + i] = i * 7;
+    CHECK_EQ_INT(_send(3, msg, 2 + sizeof(pixel_buf)), ESP_OK);
+    CHECK(!memcmp(pixel_buf, &msg[2], sizeof(pixel_buf)));
+
+    // One byte too many is rejected as a whole
+    memset(&msg[2], 0xAA, sizeof(pixel_buf) + 1);
+    CHECK_EQ_INT(_send(3, msg, sizeof(msg)), ESP_OK);
+    CHECK(pixel_buf[0] == 0 && pixel_buf[1] == 7);
+
+    // Unknown buffers and types, too short and non-binary messages change nothing
+    uint8_t before[sizeof(pixel_buf)];
+    memcpy(before, pixel_buf, sizeof(pixel_buf));
+    uint8_t unknownBuffer[] = {0x00, 4, 0xAA};
+    uint8_t unknownType[] = {0x05, 0, 0xAA, 0xAA, 0xAA, 0xAA, 0xAA};
+    uint8_t tooShort[] = {0x00};
+    CHECK_EQ_INT(_send(3, unknownBuffer, sizeof(unknownBuffer)), ESP_OK);
+    CHECK_EQ_INT(_send(3, unknownType, sizeof(unknownType)), ESP_OK);
+    CHECK_EQ_INT(_send(3, tooShort, sizeof(tooShort)), ESP_OK);
+    msg[0] = 0x00;
+    msg[1] = 0;
+    CHECK_EQ_INT(_frame(3, HTTPD_WS_TYPE_TEXT, msg, 10, 0), ESP_OK);
+    CHECK(!memcmp(pixel_buf, before, sizeof(pixel_buf)));
+    _stop();
+}
+
+static void test_range(void) {
+    uint8_t msg[64];
+    uint8_t data[] = {1, 2, 3, 4};
+    _start();
+    CHECK_EQ_INT(_connect(3), ESP_OK);
+
+    CHECK_EQ_INT(_send(3, msg, _range(msg, 0, 300, data, 4)), ESP_OK);
+    CHECK(!memcmp(&pixel_buf[300], data, 4));
+    CHECK(pixel_buf[299] == 0 && pixel_buf[304] == 0);
+
+    // Up to the very end of the buffer, and an empty range right after it
+    CHECK_EQ_INT(_send(3, msg, _range(msg, 2, sizeof(unit_buf) - 4, data, 4)), ESP_OK);
+    CHECK(!memcmp(&unit_buf[sizeof(unit_buf) - 4], data, 4));
+    CHECK_EQ_INT(_send(3, msg, _range(msg, 2, sizeof(unit_buf), data, 0)), ESP_OK);
+
+    // Past the end, also with an offset that overflows when the length is added
+    memset(unit_buf, 0, sizeof(unit_buf));
+    CHECK_EQ_INT(_send(3, msg, _range(msg, 2, sizeof(unit_buf) - 3, data, 4)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _range(msg, 2, sizeof(unit_buf) + 1, data, 0)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _range(msg, 2, 0xFFFFFFFE, data, 4)), ESP_OK);
+    CHECK(!memcmp(unit_buf, "\0\0\0\0\0\0\0\0", 8));
+
+    // Offset cut short
+    memset(line_flags_buf, 0, sizeof(line_flags_buf));
+    CHECK_EQ_INT(_send(3, msg, 5), ESP_OK);
+    _range(msg, 3, 0, data, 2);
+    CHECK_EQ_INT(_send(3, msg, 5), ESP_OK);
+    CHECK(line_flags_buf[0] == 0 && line_flags_buf[1] == 0);
+    CHECK_EQ_INT(_send(3, msg, 8), ESP_OK);
+    CHECK(line_flags_buf[0] == 1 && line_flags_buf[1] == 2);
+    _stop();
+}
+
+static void test_rect(void) {
+    uint8_t msg[10 + sizeof(pixel_buf) + 1];
+    _start();
+    CHECK_EQ_INT(_connect(3), ESP_OK);
+
+    // Column by column, h bytes each
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, 2, 3, 3, 4, 12)), ESP_OK);
+    for (int x = 0; x < DISPLAY_FRAME_WIDTH_PIXEL; x++) {
+        for (int y = 0; y < DISPLAY_FRAME_HEIGHT_PIXEL_BYTES; y++) {
+            uint8_t inside = x >= 2 && x < 5 && y >= 3 && y < 7;
+            uint8_t expected = inside ? (x - 2) * 4 + (y - 3) + 1 : 0;
+            CHECK_EQ_INT(pixel_buf[x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y], expected);
+        }
+    }
+
+    // Whole frame
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, 0, 0, DISPLAY_FRAME_WIDTH_PIXEL, DISPLAY_FRAME_HEIGHT_PIXEL_BYTES, sizeof(pixel_buf))), ESP_OK);
+    CHECK(!memcmp(pixel_buf, &msg[10], sizeof(pixel_buf)));
+
+    // Outside of the frame, wrong data length, other buffers and a cut off header
+    memset(pixel_buf, 0, sizeof(pixel_buf));
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, DISPLAY_FRAME_WIDTH_PIXEL - 2, 0, 3, 1, 3)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, 0, DISPLAY_FRAME_HEIGHT_PIXEL_BYTES - 1, 1, 2, 2)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, 0xFFFF, 0, 2, 1, 2)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, 0, 0, 2, 2, 3)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 0, 0, 0, 2, 2, 5)), ESP_OK);
+    CHECK_EQ_INT(_send(3, msg, _rect(msg, 1, 0, 0, 1, 1, 1)), ESP_OK);
+    _rect(msg, 0, 0, 0, 1, 1, 1);
+    CHECK_EQ_INT(_send(3, msg, 9), ESP_OK);
+    for (size_t i = 0; i < sizeof(pixel_buf); i++) CHECK_EQ_INT(pixel_buf[i], 0);
+    CHECK_EQ_INT(text_buf[0], 0);
+    _stop();
+}
+
+static void test_push(void) {
+    _start();
+    CHECK_EQ_INT(_connect(3), ESP_OK);
+
+    // Nothing to do without subscriptions, also not after a SUBSCRIBE without mask
+    uint8_t text[] = {0x00, 1, 0x02};
+    uint8_t shortSubscribe[] = {0x10, 0};
+    CHECK_EQ_INT(_send(3, text, sizeof(text)), ESP_OK);
+    CHECK_EQ_INT(_send(3, shortSubscribe, sizeof(shortSubscribe)), ESP_OK);
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 0);
+
+    // Subscribed buffers are sent once after subscribing, even if unchanged.
+    // Bits of buffers that don't exist are ignored.
+    CHECK_EQ_INT(_subscribe(3, 0x01 | 0x02 | 0x80), ESP_OK);
+    memcpy(text_buf, "Hi", 3);
+    browser_canvas_notify_frame();
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[3].sent, 2);
+    CHECK_EQ_INT(httpd_fake_socks[3].lastLen, 2 + sizeof(text_buf));
+    CHECK(httpd_fake_socks[3].last[0] == 0x00 && httpd_fake_socks[3].last[1] == 1);
+    CHECK(!memcmp(&httpd_fake_socks[3].last[2], text_buf, sizeof(text_buf)));
+
+    // Then only when they change
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[3].sent, 2);
+    pixel_buf[5] = 42;
+    unit_buf[0] = 1;
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[3].sent, 3);
+    CHECK_EQ_INT(httpd_fake_socks[3].lastLen, 2 + sizeof(pixel_buf));
+    CHECK(httpd_fake_socks[3].last[1] == 0 && httpd_fake_socks[3].last[2 + 5] == 42);
+
+    // A client subscribing later gets the current state, the others nothing new
+    CHECK_EQ_INT(_connect(4), ESP_OK);
+    CHECK_EQ_INT(_subscribe(4, 0x02), ESP_OK);
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[3].sent, 3);
+    CHECK_EQ_INT(httpd_fake_socks[4].sent, 1);
+    CHECK(!memcmp(&httpd_fake_socks[4].last[2], "Hi", 3));
+
+    // Changes made over the WebSocket are pushed back too
+    uint8_t msg[] = {0x00, 1, 'Y', 'o'};
+    CHECK_EQ_INT(_send(4, msg, sizeof(msg)), ESP_OK);
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[3].sent, 4);
+    CHECK_EQ_INT(httpd_fake_socks[4].sent, 2);
+    CHECK(!memcmp(&httpd_fake_socks[4].last[2], "Yo", 3));
+
+    // No more work once everyone unsubscribed
+    CHECK_EQ_INT(_subscribe(3, 0), ESP_OK);
+    CHECK_EQ_INT(_subscribe(4, 0), ESP_OK);
+    text_buf[0] = 'Z';
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 0);
+    _stop();
+}
+
+static void test_slots(void) {
+    _start();
+    for (int fd = 3; fd < 3 + MAX_CLIENTS; fd++) CHECK_EQ_INT(_connect(fd), ESP_OK);
+    CHECK_EQ_INT(_connect(7), ESP_FAIL);
+
+    // A reused socket number takes over its old slot
+    CHECK_EQ_INT(_connect(3), ESP_OK);
+    CHECK_EQ_INT(_connect(7), ESP_FAIL);
+
+    // CLOSE frame, the server closes the socket only after the handler
+    CHECK_EQ_INT(_frame(4, HTTPD_WS_TYPE_CLOSE, NULL, 0, 0), ESP_OK);
+    CHECK_EQ_INT(_connect(7), ESP_OK);
+    CHECK_EQ_INT(_connect(8), ESP_FAIL);
+
+    // Gone without a CLOSE frame, or the socket now serves plain HTTP
+    httpd_fake_socks[5].info = HTTPD_WS_CLIENT_INVALID;
+    CHECK_EQ_INT(_connect(8), ESP_OK);
+    httpd_fake_socks[6].info = HTTPD_WS_CLIENT_HTTP;
+    CHECK_EQ_INT(_connect(9), ESP_OK);
+    CHECK_EQ_INT(_connect(10), ESP_FAIL);
+
+    // Receive error
+    uint8_t msg[] = {0x00, 1, 'a'};
+    CHECK_EQ_INT(_frame(7, HTTPD_WS_TYPE_BINARY, msg, sizeof(msg), 1), ESP_FAIL);
+    CHECK_EQ_INT(_connect(10), ESP_OK);
+    CHECK_EQ_INT(_connect(11), ESP_FAIL);
+
+    // Frame larger than any buffer
+    static uint8_t large[2 + sizeof(pixel_buf) + 16];
+    CHECK_EQ_INT(_send(8, large, sizeof(large)), ESP_FAIL);
+    CHECK_EQ_INT(_connect(11), ESP_OK);
+    CHECK_EQ_INT(_connect(12), ESP_FAIL);
+
+    // Sending a pushed frame fails
+    CHECK_EQ_INT(_subscribe(9, 0x02), ESP_OK);
+    httpd_fake_socks[9].sendFails = true;
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[9].sent, 0);
+    CHECK_EQ_INT(_connect(12), ESP_OK);
+    CHECK_EQ_INT(_connect(13), ESP_FAIL);
+
+    // Closed while subscribed, the push skips it and releases the slot
+    CHECK_EQ_INT(_subscribe(10, 0x02), ESP_OK);
+    text_buf[0] = 'c';
+    httpd_fake_socks[10].info = HTTPD_WS_CLIENT_INVALID;
+    browser_canvas_notify_frame();
+    CHECK_EQ_INT(httpd_fake_run_work(), 1);
+    CHECK_EQ_INT(httpd_fake_socks[10].sent, 0);
+    CHECK_EQ_INT(_connect(13), ESP_OK);
+    _stop();
+}
+
+int main(void) {
+    test_full();
+    test_range();
+    test_rect();
+    test_push();
+    test_slots();
+    CHECK(httpd_fake_handler("/canvas/ws", HTTP_GET) == NULL);
+    httpd_fake_socks_reset();
+    return TEST_RESULT();
+}
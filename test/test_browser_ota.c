@@ -0,0 +1,393 @@
+#include "test_common.h"
+#include "browser_ota.h"
+#include "ota_upload.h"
+#include "esp_ota_ops.h"
+#include "mbedtls/sha256.h"
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * OTA uploads through the registered handlers: raw with digest and resume,
+ * multipart split into receive chunks of various sizes, and the error paths.
+ * The partition is faked in memory, the flash writer runs in its own thread.
+ */
+
+#define PARTITION_SIZE 1000000
+#define IMAGE_SIZE 300001
+#define BOUNDARY "----WebKitFormBoundaryAbCdEf0123456789"
+
+// Embedded files
+const uint8_t browser_ota_html_gz_start[1] asm("_binary_browser_ota_html_gz_start");
+const uint8_t browser_ota_html_gz_end[1] asm("_binary_browser_ota_html_gz_end");
+const uint8_t spinner_gif_start[1] asm("_binary_spinner_gif_start");
+const uint8_t spinner_gif_end[1] asm("_binary_spinner_gif_end");
+
+static uint8_t flash[PARTITION_SIZE];
+static size_t flash_pos = 0;
+static int flash_open = 0;
+static int flash_errors = 0;
+static size_t flash_fail_at = 0;
+static int boot_set = 0;
+static volatile int restarts = 0;
+static esp_partition_t partition = {.type = 0, .subtype = 16, .address = 0x110000, .size = PARTITION_SIZE};
+
+const esp_partition_t* esp_ota_get_next_update_partition(const esp_partition_t* start_from) { return &partition; }
+const esp_partition_t* esp_ota_get_boot_partition(void) { return &partition; }
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t* p) { boot_set++; return ESP_OK; }
+esp_err_t esp_ota_mark_app_valid_cancel_rollback(void) { return ESP_OK; }
+void esp_restart(void) { restarts++; }
+
+esp_err_t esp_ota_begin(const esp_partition_t* p, size_t image_size, esp_ota_handle_t* out_handle) {
+    if (flash_open || image_size != OTA_WITH_SEQUENTIAL_WRITES) flash_errors++;
+    flash_open = 1;
+    flash_pos = 0;
+    memset(flash, 0xFF, sizeof(flash));
+    *out_handle = 42;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void* data, size_t size) {
+    if (!flash_open || handle != 42 || flash_pos + size > sizeof(flash)) flash_errors++;
+    if (flash_fail_at && flash_pos + size > flash_fail_at) return ESP_FAIL;
+    memcpy(&flash[flash_pos], data, size);
+    flash_pos += size;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle) {
+    if (!flash_open) flash_errors++;
+    flash_open = 0;
+    return ESP_OK;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle) {
+    if (!flash_open) flash_errors++;
+    flash_open = 0;
+    return ESP_OK;
+}
+
+static uint8_t image[IMAGE_SIZE];
+static char image_sha[65];
+static uint8_t* form;
+static size_t form_len;
+static char form_type[128];
+
+static char status[48];
+
+static void _post(const void* body, size_t len, const char* type, const char* range, const char* sha, size_t recvChunk, size_t failAt) {
+    httpd_req_t req;
+    httpd_fake_req_init(&req, body, len);
+    httpd_fake_req_set_hdr(&req, "Content-Type", type);
+    if (range != NULL) httpd_fake_req_set_hdr(&req, "Content-Range", range);
+    if (sha != NULL) httpd_fake_req_set_hdr(&req, "X-OTA-SHA256", sha);
+    req.recvChunk = recvChunk;
+    req.failAt = failAt;
+    req.timeoutEvery = 7;
+    httpd_fake_handler("/ota", HTTP_POST)->handler(&req);
+    strcpy(status, req.status);
+    httpd_fake_req_free(&req);
+}
+
+static void _post_raw(const void* body, size_t len, const char* range, const char* sha, size_t failAt) {
+    _post(body, len, "application/octet-stream", range, sha, 1500, failAt);
+}
+
+static long _status(const char* key) {
+    /*
+     * Get a number or boolean from /ota/status
+     */
+    httpd_req_t req;
+    char name[32];
+    httpd_fake_req_init(&req, NULL, 0);
+    req.method = HTTP_GET;
+    httpd_fake_handler("/ota/status", HTTP_GET)->handler(&req);
+    req.resp = realloc(req.resp, req.respLen + 1);
+    req.resp[req.respLen] = 0x00;
+    snprintf(name, sizeof(name), "\"%s\":", key);
+    const char* value = strstr((const char*)req.resp, name);
+    long result = -1;
+    if (value != NULL) {
+        value += strlen(name);
+        if (!strncmp(value, "true", 4)) result = 1;
+        else if (!strncmp(value, "false", 5)) result = 0;
+        else result = strtol(value, NULL, 10);
+    }
+    httpd_fake_req_free(&req);
+    return result;
+}
+
+static void _setup(void) {
+    srand(1);
+    for (size_t i = 0; i < IMAGE_SIZE; i++) image[i] = rand();
+    uint8_t digest[32];
+    mbedtls_sha256(image, IMAGE_SIZE, digest, 0);
+    for (int i = 0; i < 32; i++) sprintf(&image_sha[i * 2], "%02X", digest[i]);
+
+    char head[256];
+    char tail[64];
+    size_t headLen = snprintf(head, sizeof(head), "--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"a.bin\"\r\nContent-Type: application/octet-stream\r\n\r\n");
+    size_t tailLen = snprintf(tail, sizeof(tail), "\r\n--" BOUNDARY "--\r\n");
+    form_len = headLen + IMAGE_SIZE + tailLen;
+    form = malloc(form_len);
+    memcpy(form, head, headLen);
+    memcpy(&form[headLen], image, IMAGE_SIZE);
+    memcpy(&form[headLen + IMAGE_SIZE], tail, tailLen);
+    snprintf(form_type, sizeof(form_type), "multipart/form-data; boundary=" BOUNDARY);
+}
+
+static int _image_flashed(void) {
+    return flash_pos == IMAGE_SIZE && !memcmp(flash, image, IMAGE_SIZE) && !flash_open;
+}
+
+static void test_content_range(void) {
+    size_t start, end, total;
+    CHECK_EQ_INT(ota_parse_content_range("bytes 0-99/100", &start, &end, &total), 0);
+    CHECK(start == 0 && end == 99 && total == 100);
+    CHECK_EQ_INT(ota_parse_content_range("bytes 12345-300000/300001", &start, &end, &total), 0);
+    CHECK(start == 12345 && end == 300000 && total == 300001);
+    CHECK_EQ_INT(ota_parse_content_range("bytes 5-5/6", &start, &end, &total), 0);
+
+    const char* invalid[] = {
+        "", "bytes", "bytes ", "0-99/100", "bits 0-99/100", "bytes  0-99/100", "bytes 0-99/100 ",
+        "bytes -1-99/100", "bytes 0--99/100", "bytes +0-99/100", "bytes 0-99/*", "bytes */100",
+        "bytes 0-99", "bytes 0/100", "bytes 10-9/100", "bytes 0-100/100", "bytes 0-99/100x",
+        "bytes 0-99/99999999999999999999999"
+    };
+    for (unsigned i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++) {
+        CHECK_EQ_INT(ota_parse_content_range(invalid[i], &start, &end, &total), -1);
+    }
+}
+
+static void test_sha256(void) {
+    uint8_t out[OTA_SHA256_LEN];
+    CHECK_EQ_INT(ota_parse_sha256("000102030405060708090a0b0c0d0e0f101112131415161718191A1B1C1D1E1F", out), 0);
+    for (int i = 0; i < OTA_SHA256_LEN; i++) CHECK_EQ_INT(out[i], i);
+    CHECK_EQ_INT(ota_parse_sha256(image_sha, out), 0);
+
+    CHECK_EQ_INT(ota_parse_sha256("", out), -1);
+    CHECK_EQ_INT(ota_parse_sha256("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1", out), -1);
+    CHECK_EQ_INT(ota_parse_sha256("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f0", out), -1);
+    CHECK_EQ_INT(ota_parse_sha256("000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1g", out), -1);
+    CHECK_EQ_INT(ota_parse_sha256(" 00102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f", out), -1);
+}
+
+static void test_check_resume(void) {
+    // Starting at 0 always begins a new update
+    CHECK_EQ_INT(ota_check_resume(0, 0, 0, 0, 99, 100, 100), OTA_RESUME_NEW);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 0, 99, 100, 100), OTA_RESUME_NEW);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 0, 49, 200, 50), OTA_RESUME_NEW);
+
+    // The body has to match the range
+    CHECK_EQ_INT(ota_check_resume(0, 0, 0, 0, 99, 100, 99), OTA_RESUME_INVALID);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 50, 99, 100, 51), OTA_RESUME_INVALID);
+    CHECK_EQ_INT(ota_check_resume(0, 0, 0, 0, 0, 1, 0), OTA_RESUME_INVALID);
+
+    // Continuing needs the same image and exactly the written offset
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 50, 99, 100, 50), OTA_RESUME_CONTINUE);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 50, 59, 100, 10), OTA_RESUME_CONTINUE);
+    CHECK_EQ_INT(ota_check_resume(0, 50, 100, 50, 99, 100, 50), OTA_RESUME_INVALID);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 49, 99, 100, 51), OTA_RESUME_INVALID);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 51, 99, 100, 49), OTA_RESUME_INVALID);
+    CHECK_EQ_INT(ota_check_resume(1, 50, 100, 50, 99, 101, 50), OTA_RESUME_INVALID);
+}
+
+static void test_raw(void) {
+    // With digest, in one request
+    _post_raw(image, IMAGE_SIZE, NULL, image_sha, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_image_flashed());
+    CHECK_EQ_INT(boot_set, 1);
+    CHECK_EQ_INT(_status("success"), 1);
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK_EQ_INT(_status("written"), IMAGE_SIZE);
+    CHECK_EQ_INT(_status("received"), IMAGE_SIZE);
+    CHECK_EQ_INT(_status("payload_length"), IMAGE_SIZE);
+
+    // Without digest
+    _post_raw(image, IMAGE_SIZE, NULL, NULL, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_image_flashed());
+    CHECK_EQ_INT(boot_set, 2);
+
+    // Wrong and malformed digests
+    char wrong[65];
+    strcpy(wrong, image_sha);
+    wrong[10] = wrong[10] == '0' ? '1' : '0';
+    _post_raw(image, IMAGE_SIZE, NULL, wrong, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK_EQ_INT(_status("success"), 0);
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK(!flash_open);
+    _post_raw(image, IMAGE_SIZE, NULL, "xyz", 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK(!flash_open);
+    CHECK_EQ_INT(boot_set, 2);
+}
+
+static void test_resume(void) {
+    char range[64];
+
+    // The connection drops, everything received until then is written
+    _post_raw(image, IMAGE_SIZE, NULL, image_sha, 12345);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK_EQ_INT(_status("pending"), 1);
+    size_t written = _status("written");
+    CHECK(written > 0 && written < 12345);
+    CHECK_EQ_INT(_status("received"), written);
+    CHECK_EQ_INT(flash_pos, written);
+
+    // Drops again while resuming
+    snprintf(range, sizeof(range), "bytes %zu-%d/%d", written, IMAGE_SIZE - 1, IMAGE_SIZE);
+    _post_raw(&image[written], IMAGE_SIZE - written, range, NULL, 100000);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK_EQ_INT(_status("pending"), 1);
+    CHECK(_status("written") > (long)written);
+    written = _status("written");
+
+    // Not where the pending update stopped, or a different image
+    snprintf(range, sizeof(range), "bytes %zu-%d/%d", written - 1, IMAGE_SIZE - 1, IMAGE_SIZE);
+    _post_raw(&image[written - 1], IMAGE_SIZE - written + 1, range, NULL, 0);
+    CHECK(!strcmp(status, "416 Range Not Satisfiable"));
+    snprintf(range, sizeof(range), "bytes %zu-%d/%d", written, IMAGE_SIZE, IMAGE_SIZE + 1);
+    _post_raw(&image[written], IMAGE_SIZE - written + 1, range, NULL, 0);
+    CHECK(!strcmp(status, "416 Range Not Satisfiable"));
+    snprintf(range, sizeof(range), "bytes %zu-%d/%d", written, IMAGE_SIZE - 1, IMAGE_SIZE);
+    _post_raw(&image[written], 10, range, NULL, 0);
+    CHECK(!strcmp(status, "416 Range Not Satisfiable"));
+    _post_raw(image, IMAGE_SIZE, "bytes 0-", NULL, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK_EQ_INT(_status("pending"), 1);
+    CHECK_EQ_INT(_status("written"), written);
+
+    // A range that doesn't reach the end, then the rest
+    snprintf(range, sizeof(range), "bytes %zu-%zu/%d", written, written + 999, IMAGE_SIZE);
+    _post_raw(&image[written], 1000, range, NULL, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK_EQ_INT(_status("pending"), 1);
+    CHECK_EQ_INT(_status("written"), written + 1000);
+    CHECK_EQ_INT(_status("received"), written + 1000);
+    CHECK_EQ_INT(boot_set, 2);
+    written += 1000;
+    snprintf(range, sizeof(range), "bytes %zu-%d/%d", written, IMAGE_SIZE - 1, IMAGE_SIZE);
+    _post_raw(&image[written], IMAGE_SIZE - written, range, NULL, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_image_flashed());
+    CHECK_EQ_INT(boot_set, 3);
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK_EQ_INT(_status("success"), 1);
+
+    // The digest from the first request is checked once the last part arrived
+    char wrong[65];
+    strcpy(wrong, image_sha);
+    wrong[63] = wrong[63] == '0' ? '1' : '0';
+    _post_raw(image, IMAGE_SIZE, NULL, wrong, 5000);
+    CHECK(!strcmp(status, HTTPD_500));
+    written = _status("written");
+    snprintf(range, sizeof(range), "bytes %zu-%d/%d", written, IMAGE_SIZE - 1, IMAGE_SIZE);
+    _post_raw(&image[written], IMAGE_SIZE - written, range, NULL, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK(!flash_open);
+    CHECK_EQ_INT(boot_set, 3);
+}
+
+static void test_multipart(void) {
+    // Receive chunks from single bytes to larger than the receive buffer, so the boundaries end up split everywhere
+    size_t recvChunks[] = {1, 13, 1000, 1500, 0};
+    for (unsigned i = 0; i < sizeof(recvChunks) / sizeof(recvChunks[0]); i++) {
+        flash_pos = 0;
+        _post(form, form_len, form_type, NULL, NULL, recvChunks[i], 0);
+        CHECK(!strcmp(status, "200 OK"));
+        CHECK(_image_flashed());
+        CHECK_EQ_INT(boot_set, 4 + i);
+        CHECK_EQ_INT(_status("payload_length"), IMAGE_SIZE);
+        CHECK_EQ_INT(_status("received"), IMAGE_SIZE);
+    }
+
+    // Quoted boundary
+    _post(form, form_len, "multipart/form-data; boundary=\"" BOUNDARY "\"", NULL, NULL, 1500, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_image_flashed());
+    CHECK_EQ_INT(boot_set, 9);
+
+    // No boundary, or the body ends before the closing boundary
+    _post(form, form_len, "multipart/form-data", NULL, NULL, 1500, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    _post(form, form_len - 10, form_type, NULL, NULL, 1500, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK(!flash_open);
+
+    // A form upload replaces a pending raw one, a dropped form upload can't be resumed
+    _post_raw(image, IMAGE_SIZE, NULL, NULL, 5000);
+    CHECK_EQ_INT(_status("pending"), 1);
+    _post(form, form_len, form_type, NULL, NULL, 1500, 9000);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK(!flash_open);
+    _post(form, form_len, form_type, NULL, NULL, 1500, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_image_flashed());
+    CHECK_EQ_INT(boot_set, 10);
+}
+
+static void test_errors(void) {
+    // Flash write error
+    flash_fail_at = 50000;
+    _post_raw(image, IMAGE_SIZE, NULL, NULL, 0);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK(!flash_open);
+    _post(form, form_len, form_type, NULL, NULL, 1500, 0);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK_EQ_INT(_status("pending"), 0);
+    CHECK(!flash_open);
+    flash_fail_at = 0;
+
+    // Too large for the partition, and empty
+    uint8_t* tooLarge = calloc(PARTITION_SIZE + 1, 1);
+    _post_raw(tooLarge, PARTITION_SIZE + 1, NULL, NULL, 0);
+    CHECK(!strcmp(status, "413 Payload Too Large"));
+    free(tooLarge);
+    _post_raw(image, 0, NULL, NULL, 0);
+    CHECK(!strcmp(status, "416 Range Not Satisfiable"));
+    CHECK(!flash_open);
+    CHECK_EQ_INT(boot_set, 10);
+}
+
+static void test_restart(void) {
+    // A successful update already requested a restart, the restart handler requests another one
+    httpd_req_t req;
+    for (int i = 0; i < 1000 && restarts == 0; i++) usleep(1000);
+    int before = restarts;
+    CHECK(before > 0);
+    httpd_fake_req_init(&req, NULL, 0);
+    req.method = HTTP_GET;
+    httpd_fake_handler("/ota/restart", HTTP_GET)->handler(&req);
+    CHECK(!strcmp(req.status, "200 OK"));
+    httpd_fake_req_free(&req);
+    for (int i = 0; i < 1000 && restarts == before; i++) usleep(1000);
+    CHECK_EQ_INT(restarts, before + 1);
+}
+
+int main(void) {
+    httpd_handle_t server = NULL;
+    _setup();
+    test_content_range();
+    test_sha256();
+    test_check_resume();
+
+    browser_ota_init(&server);
+    CHECK(httpd_fake_handler("/ota", HTTP_POST) != NULL);
+    CHECK(httpd_fake_handler("/ota/status", HTTP_GET) != NULL);
+    test_raw();
+    test_resume();
+    test_multipart();
+    test_errors();
+    test_restart();
+    CHECK_EQ_INT(flash_errors, 0);
+    browser_ota_deinit();
+    CHECK(httpd_fake_handler("/ota", HTTP_POST) == NULL);
+    free(form);
+    return TEST_RESULT();
+}
@@ -0,0 +1,240 @@
+#include "test_common.h"
+#include "browser_spiffs.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * SPIFFS uploads through the registered handlers: the file name from the
+ * metadata or the form, and the partial file being removed after truncated
+ * bodies, receive errors and write errors.
+ * /spiffs/ is mapped to a temporary directory by wrapping open(), write() and unlink().
+ */
+
+#define BOUNDARY "----WebKitFormBoundaryAbCdEf0123456789"
+#define FORM_TYPE "multipart/form-data; boundary=" BOUNDARY
+#define FILE_SIZE 10000
+
+// Embedded files
+const uint8_t browser_spiffs_html_gz_start[1] asm("_binary_browser_spiffs_html_gz_start");
+const uint8_t browser_spiffs_html_gz_end[1] asm("_binary_browser_spiffs_html_gz_end");
+
+static char spiffs_dir[64];
+static size_t write_limit = 0;  // Writes fail once this many bytes were written, 0 = never
+static size_t written = 0;
+
+int __real_open(const char* path, int flags, ...);
+ssize_t __real_write(int fd, const void* buf, size_t count);
+int __real_unlink(const char* path);
+
+static const char* _map_path(const char* path, char* buf, size_t len) {
+    if (strncmp(path, "/spiffs/", 8)) return path;
+    snprintf(buf, len, "%s/%s", spiffs_dir, &path[8]);
+    return buf;
+}
+
+int __wrap_open(const char* path, int flags, ...) {
+    char buf[128];
+    va_list args;
+    va_start(args, flags);
+    mode_t mode = (flags & O_CREAT) ? va_arg(args, int) : 0;
+    va_end(args);
+    return __real_open(_map_path(path, buf, sizeof(buf)), flags, mode);
+}
+
+ssize_t __wrap_write(int fd, const void* buf, size_t count) {
+    if (write_limit && written + count > write_limit) {
+        errno = ENOSPC;
+        return -1;
+    }
+    written += count;
+    return __real_write(fd, buf, count);
+}
+
+int __wrap_unlink(const char* path) {
+    char buf[128];
+    return __real_unlink(_map_path(path, buf, sizeof(buf)));
+}
+
+static uint8_t file_data[FILE_SIZE];
+static char status[48];
+
+static uint8_t* _form(const char* file_name, size_t* len) {
+    char head[256];
+    char tail[64];
+    size_t headLen = snprintf(head, sizeof(head), "--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"%s\"\r\nContent-Type: application/octet-stream\r\n\r\n", file_name);
+    size_t tailLen = snprintf(tail, sizeof(tail), "\r\n--" BOUNDARY "--\r\n");
+    *len = headLen + FILE_SIZE + tailLen;
+    uint8_t* form = malloc(*len);
+    memcpy(form, head, headLen);
+    memcpy(&form[headLen], file_data, FILE_SIZE);
+    memcpy(&form[headLen + FILE_SIZE], tail, tailLen);
+    return form;
+}
+
+static void _post(const char* uri, const void* body, size_t len, const char* type, size_t recvChunk, size_t failAt) {
+    httpd_req_t req;
+    httpd_fake_req_init(&req, body, len);
+    if (type != NULL) httpd_fake_req_set_hdr(&req, "Content-Type", type);
+    req.recvChunk = recvChunk;
+    req.failAt = failAt;
+    req.timeoutEvery = 5;
+    httpd_fake_handler(uri, HTTP_POST)->handler(&req);
+    strcpy(status, req.status);
+    httpd_fake_req_free(&req);
+}
+
+static void _upload(const char* file_name, size_t cutAt, size_t recvChunk, size_t failAt) {
+    // cutAt ends the body early, 0 = send all of it
+    size_t len;
+    uint8_t* form = _form(file_name, &len);
+    _post("/spiffs/upload", form, cutAt ? cutAt : len, FORM_TYPE, recvChunk, failAt);
+    free(form);
+}
+
+static void _announce(const char* file_name) {
+    char json[64];
+    snprintf(json, sizeof(json), "{\"file_name\":\"%s\",\"file_size\":%d}", file_name, FILE_SIZE);
+    _post("/spiffs/upload-metadata.json", json, strlen(json), "application/json", 0, 0);
+    CHECK(!strcmp(status, "200 OK"));
+}
+
+static int _file_exists(const char* file_name) {
+    char path[128];
+    struct stat st;
+    snprintf(path, sizeof(path), "%s/%s", spiffs_dir, file_name);
+    return stat(path, &st) == 0;
+}
+
+static int _file_uploaded(const char* file_name) {
+    char path[128];
+    uint8_t buf[FILE_SIZE + 1];
+    snprintf(path, sizeof(path), "%s/%s", spiffs_dir, file_name);
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return 0;
+    size_t len = fread(buf, 1, sizeof(buf), f);
+    fclose(f);
+    return len == FILE_SIZE && !memcmp(buf, file_data, FILE_SIZE);
+}
+
+static void _remove(const char* file_name) {
+    char path[128];
+    snprintf(path, sizeof(path), "%s/%s", spiffs_dir, file_name);
+    __real_unlink(path);
+}
+
+static void test_upload(void) {
+    // Receive chunks from single bytes to larger than the file buffer
+    size_t recvChunks[] = {1, 7, 1000, 5000, 0};
+    for (unsigned i = 0; i < sizeof(recvChunks) / sizeof(recvChunks[0]); i++) {
+        _remove("a.bin");
+        _upload("a.bin", 0, recvChunks[i], 0);
+        CHECK(!strcmp(status, "200 OK"));
+        CHECK(_file_uploaded("a.bin"));
+    }
+    _remove("a.bin");
+}
+
+static void test_file_name(void) {
+    // The announced name takes precedence over the one in the form
+    _announce("meta.bin");
+    _upload("form.bin", 0, 1000, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_file_uploaded("meta.bin"));
+    CHECK(!_file_exists("form.bin"));
+
+    // It only applies to one upload, the next one falls back to the form
+    _upload("form.bin", 0, 1000, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_file_uploaded("form.bin"));
+    _remove("meta.bin");
+    _remove("form.bin");
+
+    // Neither gives a usable name
+    _upload("", 0, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    _upload("toolongname.bin", 0, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK(!_file_exists("toolongname.bin"));
+
+    // Also after a failed upload, the announced name is gone
+    _announce("meta.bin");
+    _upload("form.bin", 5000, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    _upload("", 0, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK(!_file_exists("meta.bin"));
+    CHECK(!_file_exists("form.bin"));
+
+    // No multipart boundary
+    size_t len;
+    uint8_t* form = _form("a.bin", &len);
+    _post("/spiffs/upload", form, len, "multipart/form-data", 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    _post("/spiffs/upload", form, len, NULL, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    free(form);
+    CHECK(!_file_exists("a.bin"));
+}
+
+static void test_truncated(void) {
+    // The body ends within the file data, and within the delimiter after it
+    _upload("cut.bin", 5000, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK(!_file_exists("cut.bin"));
+    size_t len;
+    free(_form("cut.bin", &len));
+    _upload("cut.bin", len - 10, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_400));
+    CHECK(!_file_exists("cut.bin"));
+
+    // The connection drops
+    _upload("cut.bin", 0, 1000, 6000);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK(!_file_exists("cut.bin"));
+
+    // A complete upload afterwards still works
+    _upload("cut.bin", 0, 1000, 0);
+    CHECK(!strcmp(status, "200 OK"));
+    CHECK(_file_uploaded("cut.bin"));
+    _remove("cut.bin");
+}
+
+static void test_write_error(void) {
+    // The filesystem is full after part of the file
+    written = 0;
+    write_limit = 3000;
+    _upload("full.bin", 0, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK(!_file_exists("full.bin"));
+
+    // Already at the first write
+    written = 0;
+    write_limit = 1;
+    _upload("full.bin", 0, 1000, 0);
+    CHECK(!strcmp(status, HTTPD_500));
+    CHECK(!_file_exists("full.bin"));
+    write_limit = 0;
+}
+
+int main(void) {
+    httpd_handle_t server = NULL;
+    strcpy(spiffs_dir, "/tmp/cheetah_spiffs_XXXXXX");
+    if (mkdtemp(spiffs_dir) == NULL) return 1;
+    srand(1);
+    for (size_t i = 0; i < FILE_SIZE; i++) file_data[i] = rand();
+
+    browser_spiffs_init(&server);
+    CHECK(httpd_fake_handler("/spiffs/upload", HTTP_POST) != NULL);
+    test_upload();
+    test_file_name();
+    test_truncated();
+    test_write_error();
+    browser_spiffs_deinit();
+    CHECK(httpd_fake_handler("/spiffs/upload", HTTP_POST) == NULL);
+    rmdir(spiffs_dir);
+    return TEST_RESULT();
+}
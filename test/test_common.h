@@ -0,0 +1,28 @@
+#pragma once
+
+/*
+ * Minimal assertion helpers for the host tests.
+ * Each test is a separate executable, a non-zero exit code marks it as failed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define CHECK_EQ_INT(a, b) do { \
+    long long _a = (long long)(a), _b = (long long)(b); \
+    if (_a != _b) { \
+        printf("%s:%d: %s == %s failed: %lld != %lld\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+        test_failures++; \
+    } \
+} while (0)
+
+#define TEST_RESULT() (printf("%s\n", test_failures ? "FAILED" : "OK"), test_failures ? 1 : 0)
@@ -0,0 +1,143 @@
+#include "test_common.h"
+#include "effect_glitches.h"
+#include <string.h>
+
+/*
+ * Glitch scheduling with 1000 characters over 60 s at 60 fps.
+ */
+
+#define NUM_CHARS 1000
+#define FRAME_US 16667
+#define RUN_US 60000000
+
+static const glitch_params_t params = {
+    .probability = 100,
+    .duration_avg_ms = 50,
+    .duration_spread_ms = 20,
+    .interval_avg_ms = 1000,
+    .interval_spread_ms = 500,
+    .glitch_non_blank = 1,
+    .glitch_blank = 0
+};
+
+static uint8_t text[NUM_CHARS];
+static uint8_t buf_a[NUM_CHARS];
+static uint8_t buf_b[NUM_CHARS];
+
+static int _heap_ok(const glitch_state_t* state) {
+    for (uint32_t i = 1; i < state->numChars; i++) {
+        if (state->events[i].time_us < state->events[(i - 1) / 2].time_us) return 0;
+    }
+    return 1;
+}
+
+static void test_schedule(void) {
+    for (int i = 0; i < NUM_CHARS; i++) text[i] = (i % 3) ? 'A' + i % 26 : ' ';
+    glitch_state_t* s1 = glitches_create(&params, NUM_CHARS, 1234, 0);
+    glitch_state_t* s2 = glitches_create(&params, NUM_CHARS, 1234, 0);
+    CHECK(s1 != NULL && s2 != NULL);
+
+    static int64_t start[NUM_CHARS];
+    static uint8_t glitching[NUM_CHARS];
+    uint32_t glitches = 0;
+    uint32_t differentOutput = 0;
+    uint32_t ineligible = 0;
+    uint32_t tooLong = 0;
+    uint32_t brokenHeap = 0;
+    for (int64_t t = 0; t <= RUN_US; t += FRAME_US) {
+        memcpy(buf_a, text, NUM_CHARS);
+        memcpy(buf_b, text, NUM_CHARS);
+        uint8_t modifiedA = glitches_process(s1, buf_a, t);
+        uint8_t modifiedB = glitches_process(s2, buf_b, t);
+        if (modifiedA != modifiedB || memcmp(buf_a, buf_b, NUM_CHARS) != 0) differentOutput++;
+        if (!_heap_ok(s1)) brokenHeap++;
+        if (modifiedA != (s1->numActive > 0)) differentOutput++;
+
+        for (int i = 0; i < NUM_CHARS; i++) {
+            uint8_t g = s1->charVals[i] != 0;
+            if (g && text[i] == ' ') ineligible++;
+            if (g && buf_a[i] != s1->charVals[i]) differentOutput++;
+            if (!g && buf_a[i] != text[i]) differentOutput++;
+            if (g && !glitching[i]) {
+                start[i] = t;
+                glitches++;
+            }
+            // A glitch ends with the first frame after its duration
+            if (!g && glitching[i] && t - start[i] > (params.duration_avg_ms + params.duration_spread_ms) * 1000LL + FRAME_US) tooLong++;
+            glitching[i] = g;
+        }
+    }
+    // Same seed, same output
+    CHECK_EQ_INT(differentOutput, 0);
+    CHECK_EQ_INT(ineligible, 0);
+    CHECK_EQ_INT(tooLong, 0);
+    CHECK_EQ_INT(brokenHeap, 0);
+    // 667 eligible characters, one check per second at 1 %, about 400 glitches in 60 s
+    printf("%u glitches\n", glitches);
+    CHECK(glitches > 300 && glitches < 500);
+    glitches_free(s1);
+    glitches_free(s2);
+}
+
+static void test_probability(void) {
+    glitch_params_t p = params;
+
+    // Never
+    p.probability = 0;
+    glitch_state_t* state = glitches_create(&p, NUM_CHARS, 5, 0);
+    uint32_t modified = 0;
+    for (int64_t t = 0; t <= 10000000; t += FRAME_US) {
+        memcpy(buf_a, text, NUM_CHARS);
+        modified += glitches_process(state, buf_a, t);
+    }
+    CHECK_EQ_INT(modified, 0);
+    glitches_free(state);
+
+    // Always, and only the blanks
+    p.probability = 10000;
+    p.glitch_non_blank = 0;
+    p.glitch_blank = 1;
+    state = glitches_create(&p, NUM_CHARS, 5, 0);
+    memcpy(buf_a, text, NUM_CHARS);
+    CHECK_EQ_INT(glitches_process(state, buf_a, 0), 1);
+    CHECK_EQ_INT(state->numActive, (NUM_CHARS + 2) / 3);
+    uint32_t wrong = 0;
+    for (int i = 0; i < NUM_CHARS; i++) {
+        if (text[i] == ' ' && (buf_a[i] < 32 || buf_a[i] >= 128)) wrong++;
+        if (text[i] != ' ' && buf_a[i] != text[i]) wrong++;
+    }
+    CHECK_EQ_INT(wrong, 0);
+    glitches_free(state);
+}
+
+static void test_different_seeds(void) {
+    glitch_state_t* s1 = glitches_create(&params, NUM_CHARS, 1, 0);
+    glitch_state_t* s2 = glitches_create(&params, NUM_CHARS, 2, 0);
+    uint32_t differentFrames = 0;
+    for (int64_t t = 0; t <= 5000000; t += FRAME_US) {
+        memcpy(buf_a, text, NUM_CHARS);
+        memcpy(buf_b, text, NUM_CHARS);
+        glitches_process(s1, buf_a, t);
+        glitches_process(s2, buf_b, t);
+        if (memcmp(buf_a, buf_b, NUM_CHARS) != 0) differentFrames++;
+    }
+    CHECK(differentFrames > 0);
+    glitches_free(s1);
+    glitches_free(s2);
+}
+
+static void test_empty(void) {
+    glitch_state_t* state = glitches_create(&params, 0, 0, 0);
+    CHECK(state != NULL);
+    CHECK_EQ_INT(glitches_process(state, buf_a, 1000000), 0);
+    glitches_free(state);
+    glitches_free(NULL);
+}
+
+int main(void) {
+    test_schedule();
+    test_probability();
+    test_different_seeds();
+    test_empty();
+    return TEST_RESULT();
+}
@@ -0,0 +1,169 @@
+#include "test_common.h"
+#include "util_fixed_point.h"
+#include <math.h>
+#include <time.h>
+
+/*
+ * Accuracy of the fixed point functions against double precision and the
+ * bitwise square root, with the bounds given in the Kconfig help.
+ * Built once per implementation, see CMakeLists.txt.
+ * The timing loop only runs with CHEETAH_BENCHMARKS, it doesn't fail the test.
+ */
+
+#if defined(CONFIG_FIXED_POINT_MATH_FAST)
+// Table based sine, floor of the square root for every input
+#define SIN_MAX_ERROR 1.0
+#define SQRT_MAX_ERROR 0
+#define SQRT_MAX_INPUT INT32_MAX
+#else
+// Polynomial sine, the bitwise square root overflows from 2^30 on
+#define SIN_MAX_ERROR 1.5
+#define SQRT_MAX_ERROR 1
+#define SQRT_MAX_INPUT ((1 << 30) - 1)
+#endif
+
+static fx20_12_t _sqrt_bitwise(int32_t v) {
+    // The exact implementation of sqrt_i32_to_fx20_12()
+    uint32_t t, q, b, r;
+    if (v == 0) return 0;
+    r = v;
+    b = 0x40000000;
+    q = 0;
+    while (b > 0) {
+        t = q + b;
+        if (r >= t) {
+            r -= t;
+            q = t + b;
+        }
+        r <<= 1;
+        b >>= 1;
+    }
+    if (r > q) ++q;
+    return (fx20_12_t)q >> 4;
+}
+
+static int64_t _floor_sqrt(int32_t v) {
+    // floor(sqrt(v) * 2^12), so result^2 <= v * 2^24 < (result + 1)^2
+    uint64_t n = (uint64_t)v << 24;
+    uint64_t r = (uint64_t)sqrt((double)n);
+    while (r * r > n) r--;
+    while ((r + 1) * (r + 1) <= n) r++;
+    return r;
+}
+
+static void test_sin(void) {
+    double maxError = 0.0;
+    for (int32_t i = -0x8000; i < 0x8000; i++) {
+        double error = fabs(sin_i16_to_fx20_12(i) - 4096.0 * sin(i * 2 * M_PI / 0x8000));
+        if (error > maxError) maxError = error;
+    }
+    printf("sin: max error %.2f LSB\n", maxError);
+    CHECK(maxError <= SIN_MAX_ERROR);
+    CHECK_EQ_INT(sin_i16_to_fx20_12(0x2000), FX20_12(1));
+    CHECK_EQ_INT(cos_i16_to_fx20_12(0), FX20_12(1));
+    CHECK_EQ_INT(sin_i16_to_fx20_12(-0x2000), -FX20_12(1));
+}
+
+static void test_sqrt(void) {
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(0), 0);
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(1), FX20_12(1));
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(1 << 16), FX20_12(256));
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(1 << 24), FX20_12(4096));
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(1 << 28), FX20_12(16384));
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(99980001), FX20_12(9999));
+    #if defined(CONFIG_FIXED_POINT_MATH_FAST)
+    CHECK_EQ_INT(sqrt_i32_to_fx20_12(-5), 0);
+    #endif
+
+    // Every input below 2^20 and a dense sample of the rest, including the largest one
+    uint32_t offByMore = 0;
+    uint32_t notBitwise = 0;
+    int64_t maxError = 0;
+    for (int64_t v = 1; v <= (int64_t)SQRT_MAX_INPUT + 1; v += (v < (1 << 20)) ? 1 : (v >> 14) + 1) {
+        int32_t input = (v > SQRT_MAX_INPUT) ? SQRT_MAX_INPUT : (int32_t)v;
+        fx20_12_t result = sqrt_i32_to_fx20_12(input);
+        int64_t error = llabs(result - _floor_sqrt(input));
+        if (error > maxError) maxError = error;
+        if (error > SQRT_MAX_ERROR) offByMore++;
+        // The bitwise version overflows from 2^30 on
+        if (input < (1 << 30) && abs(result - _sqrt_bitwise(input)) > 1) notBitwise++;
+    }
+    printf("sqrt: max error %lld LSB\n", (long long)maxError);
+    CHECK_EQ_INT(offByMore, 0);
+    CHECK_EQ_INT(notBitwise, 0);
+}
+
+static void test_hsv(void) {
+    // The array conversions against the per color one, for all sectors and edge cases
+    uint32_t count = 0;
+    int maxDiff = 0;
+    for (fx20_12_t s = 0; s <= FX20_12(1); s += 128) {
+        for (fx20_12_t v = 0; v <= FX20_12(1); v += 128) {
+            for (fx20_12_t h = -FX20_12(1); h < FX20_12(361); h += 997) {
+                color_hsv_fx20_12_t hsv = {.h = h, .s = s, .v = v};
+                color_rgb_u8_t expected = hsv_fx20_12_to_rgb_u8(hsv);
+                color_rgb_u8_t fromHsv;
+                color_rgb_u8_t fromHue;
+                hsv_fx20_12_to_rgb_u8_array(&hsv, &fromHsv, 1);
+                hue_fx20_12_to_rgb_u8_array(&h, s, v, &fromHue, 1);
+                int diffs[6] = {
+                    fromHsv.r - expected.r, fromHsv.g - expected.g, fromHsv.b - expected.b,
+                    fromHue.r - expected.r, fromHue.g - expected.g, fromHue.b - expected.b
+                };
+                for (int i = 0; i < 6; i++) {
+                    if (abs(diffs[i]) > maxDiff) maxDiff = abs(diffs[i]);
+                }
+                count++;
+            }
+        }
+    }
+    printf("hsv: max difference %d LSB over %u colors\n", maxDiff, count);
+    CHECK(maxDiff <= 1);
+}
+
+#if defined(CHEETAH_BENCHMARKS)
+static volatile int32_t sink;
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void benchmark(void) {
+    const int32_t n = 10000000;
+    int32_t acc = 0;
+
+    double t0 = _now();
+    for (int32_t i = 0; i < n; i++) acc += sin_i16_to_fx20_12(i * 7);
+    printf("sin_i16_to_fx20_12: %.1f ns\n", (_now() - t0) / n * 1e9);
+
+    t0 = _now();
+    for (int32_t i = 1; i < n; i++) acc += sqrt_i32_to_fx20_12(i * 97);
+    printf("sqrt_i32_to_fx20_12: %.1f ns (bitwise: ", (_now() - t0) / n * 1e9);
+    t0 = _now();
+    for (int32_t i = 1; i < n; i++) acc += _sqrt_bitwise(i * 97);
+    printf("%.1f ns)\n", (_now() - t0) / n * 1e9);
+
+    static fx20_12_t hues[1024];
+    static color_rgb_u8_t colors[1024];
+    for (int32_t i = 0; i < 1024; i++) hues[i] = (i * 1441) % FX20_12(360);
+    t0 = _now();
+    for (int32_t k = 0; k < n / 1024; k++) {
+        hue_fx20_12_to_rgb_u8_array(hues, FX20_12(1) * 3 / 4, FX20_12(1), colors, 1024);
+        acc += colors[k & 1023].r;
+    }
+    printf("hue_fx20_12_to_rgb_u8_array: %.1f ns per color\n", (_now() - t0) / (n / 1024 * 1024) * 1e9);
+    sink = acc;
+}
+#endif
+
+int main(void) {
+    test_sin();
+    test_sqrt();
+    test_hsv();
+    #if defined(CHEETAH_BENCHMARKS)
+    benchmark();
+    #endif
+    return TEST_RESULT();
+}
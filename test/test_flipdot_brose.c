@@ -0,0 +1,246 @@
+#include "test_common.h"
+#include "freertos/FreeRTOS.h"
+#include "gpio_stub.h"
+#include "flipdot_brose.h"
+#include "macros.h"
+#include <string.h>
+#if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+#include "cJSON.h"
+#endif
+
+/*
+ * BROSE flipdot driver against a model of the panels, which decodes the
+ * FP2800 column and row address lines at every enable pulse and flips the
+ * addressed dot. Built for several panel configurations, see CMakeLists.txt.
+ * With transitions, frames change instantly unless a transition is set.
+ */
+
+#define WIDTH DISPLAY_FRAME_WIDTH_PIXEL
+#define HEIGHT DISPLAY_FRAME_HEIGHT_PIXEL
+#define UNKNOWN 2
+
+static const uint8_t panelEnableIOs[] = {
+    CONFIG_BROSE_PAN_E_IO, CONFIG_BROSE_PAN2_E_IO, CONFIG_BROSE_PAN3_E_IO, CONFIG_BROSE_PAN4_E_IO,
+    CONFIG_BROSE_PAN5_E_IO, CONFIG_BROSE_PAN6_E_IO, CONFIG_BROSE_PAN7_E_IO, CONFIG_BROSE_PAN8_E_IO
+};
+
+#if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+static int64_t fake_time_us = 0;
+int64_t esp_timer_get_time(void) { return fake_time_us; }
+#endif
+
+static uint8_t dots[WIDTH][HEIGHT];
+static uint32_t flips;
+static uint32_t invalidFlips;
+static uint32_t colorChanges;
+static uint32_t pulses;
+static uint8_t enabled;
+static uint8_t maxEnabled;
+
+static void _on_transition(uint8_t pin, uint8_t level) {
+    if ((pin == CONFIG_BROSE_RD_EN_S_IO || pin == CONFIG_BROSE_RD_EN_R_IO) && level) colorChanges++;
+    for (uint8_t panel = 0; panel < CONFIG_BROSE_NUM_PANELS; panel++) {
+        if (pin != panelEnableIOs[panel]) continue;
+        if (!level) {
+            enabled--;
+            continue;
+        }
+        // Enable lines switched on by the same write count as one pulse
+        if (enabled++ == 0) pulses++;
+        if (enabled > maxEnabled) maxEnabled = enabled;
+        uint8_t address = gpio_stub_levels[CONFIG_BROSE_COL_A0_IO]
+            | (gpio_stub_levels[CONFIG_BROSE_COL_A1_IO] << 1)
+            | (gpio_stub_levels[CONFIG_BROSE_COL_A2_IO] << 2)
+            | (gpio_stub_levels[CONFIG_BROSE_COL_B0_IO] << 3)
+            | (gpio_stub_levels[CONFIG_BROSE_COL_B1_IO] << 4);
+        uint8_t row = gpio_stub_levels[CONFIG_BROSE_RD_A0_IO]
+            | (gpio_stub_levels[CONFIG_BROSE_RD_A1_IO] << 1)
+            | (gpio_stub_levels[CONFIG_BROSE_RD_A2_IO] << 2);
+        uint8_t set = gpio_stub_levels[CONFIG_BROSE_RD_EN_S_IO];
+        uint8_t reset = gpio_stub_levels[CONFIG_BROSE_RD_EN_R_IO];
+        // The FP2800 doesn't use the addresses 7, 15, 23 and 31, there is no row 7,
+        // and exactly one of the row drivers has to be enabled, with the column driver matching it
+        if ((address & 7) == 7 || row == 7 || set == reset || gpio_stub_levels[CONFIG_BROSE_PAN_CS_IO] != set) {
+            invalidFlips++;
+            continue;
+        }
+        // The leftmost column has the highest address
+        uint8_t column = CONFIG_BROSE_PANEL_WIDTH - 1 - (address - address / 8);
+        uint16_t x = panel * CONFIG_BROSE_PANEL_WIDTH + column;
+        if (x < WIDTH && row < HEIGHT) dots[x][row] = set;
+        flips++;
+    }
+}
+
+static uint32_t _mismatches(const uint8_t* pixBuf) {
+    uint32_t mismatches = 0;
+    for (uint16_t x = 0; x < WIDTH; x++) {
+        for (uint8_t y = 0; y < HEIGHT; y++) {
+            if (dots[x][y] != PIX_BUF_VAL(pixBuf, x, y)) mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+static uint32_t _changes(const uint8_t* pixBuf, const uint8_t* prevPixBuf) {
+    uint32_t changes = 0;
+    for (uint16_t x = 0; x < WIDTH; x++) {
+        for (uint8_t y = 0; y < HEIGHT; y++) {
+            if (PIX_BUF_VAL(pixBuf, x, y) != PIX_BUF_VAL(prevPixBuf, x, y)) changes++;
+        }
+    }
+    return changes;
+}
+
+#if defined(CONFIG_BROSE_PARALLEL_PANELS)
+static uint32_t _pulses(const uint8_t* pixBuf, const uint8_t* prevPixBuf) {
+    // Dots at the same position on several panels share a pulse when flipping in parallel
+    uint32_t pulses = 0;
+    for (uint8_t column = 0; column < CONFIG_BROSE_PANEL_WIDTH; column++) {
+        for (uint8_t y = 0; y < HEIGHT; y++) {
+            uint8_t colors = 0;
+            for (uint16_t x = column; x < WIDTH; x += CONFIG_BROSE_PANEL_WIDTH) {
+                #if defined(CONFIG_BROSE_UPDATE_CHANGED_ONLY)
+                if (PIX_BUF_VAL(pixBuf, x, y) == PIX_BUF_VAL(prevPixBuf, x, y)) continue;
+                #endif
+                colors |= 1 << PIX_BUF_VAL(pixBuf, x, y);
+            }
+            pulses += (colors & 1) + (colors >> 1);
+        }
+    }
+    return pulses;
+}
+#endif
+
+static void _toggle(uint8_t* pixBuf, uint16_t x, uint8_t y) {
+    pixBuf[x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y / 8] ^= 1 << (y % 8);
+}
+
+static void test_frames(void) {
+    static uint8_t pixBuf[DISPLAY_PIX_BUF_SIZE];
+    static uint8_t prevPixBuf[DISPLAY_PIX_BUF_SIZE];
+    static uint8_t expectedPrev[DISPLAY_PIX_BUF_SIZE];
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+    gpio_stub_reset();
+    gpio_stub_on_transition = _on_transition;
+    memset(dots, UNKNOWN, sizeof(dots));
+    CHECK_EQ_INT(display_init(NULL), ESP_OK);
+
+    // The first update flips every dot, since the state of the panel is unknown
+    srand(1);
+    for (uint32_t i = 0; i < sizeof(pixBuf); i++) pixBuf[i] = rand();
+    flips = 0;
+    display_update(pixBuf, NULL, sizeof(pixBuf), &lock);
+    CHECK_EQ_INT(flips, WIDTH * HEIGHT);
+    CHECK_EQ_INT(_mismatches(pixBuf), 0);
+    memcpy(prevPixBuf, pixBuf, sizeof(pixBuf));
+
+    uint32_t mismatchedFrames = 0;
+    uint32_t wrongFlipCount = 0;
+    uint32_t tooManyColorChanges = 0;
+    uint32_t wrongPulseCount = 0;
+    for (int frame = 0; frame < 500; frame++) {
+        int n = rand() % 40;
+        for (int i = 0; i < n; i++) _toggle(pixBuf, rand() % WIDTH, rand() % HEIGHT);
+        uint32_t changes = _changes(pixBuf, prevPixBuf);
+        memcpy(expectedPrev, pixBuf, sizeof(pixBuf));
+        #if defined(CONFIG_BROSE_PARALLEL_PANELS)
+        uint32_t expectedPulses = changes ? _pulses(pixBuf, prevPixBuf) : 0;
+        #endif
+        flips = 0;
+        pulses = 0;
+        colorChanges = 0;
+        display_update(pixBuf, prevPixBuf, sizeof(pixBuf), &lock);
+        if (_mismatches(pixBuf) != 0) mismatchedFrames++;
+        #if defined(CONFIG_BROSE_UPDATE_CHANGED_ONLY)
+        // One flip per changed dot
+        if (flips != changes) wrongFlipCount++;
+        #else
+        if (flips != (changes ? WIDTH * HEIGHT : 0)) wrongFlipCount++;
+        #endif
+        // All black dots, then all yellow dots
+        if (colorChanges > 2) tooManyColorChanges++;
+        #if defined(CONFIG_BROSE_PARALLEL_PANELS)
+        if (pulses != expectedPulses) wrongPulseCount++;
+        #else
+        if (pulses != flips) wrongPulseCount++;
+        #endif
+        CHECK(memcmp(prevPixBuf, expectedPrev, sizeof(pixBuf)) == 0);
+    }
+    CHECK_EQ_INT(mismatchedFrames, 0);
+    CHECK_EQ_INT(wrongFlipCount, 0);
+    CHECK_EQ_INT(tooManyColorChanges, 0);
+    CHECK_EQ_INT(wrongPulseCount, 0);
+    CHECK_EQ_INT(invalidFlips, 0);
+    // One panel at a time, unless flipping in parallel
+    #if defined(CONFIG_BROSE_PARALLEL_PANELS)
+    CHECK_EQ_INT(maxEnabled, CONFIG_BROSE_NUM_PANELS);
+    #else
+    CHECK_EQ_INT(maxEnabled, 1);
+    #endif
+
+    // All lines are released after an update
+    CHECK_EQ_INT(gpio_stub_levels[CONFIG_BROSE_RD_EN_S_IO], 0);
+    CHECK_EQ_INT(gpio_stub_levels[CONFIG_BROSE_RD_EN_R_IO], 0);
+    for (uint8_t panel = 0; panel < CONFIG_BROSE_NUM_PANELS; panel++) CHECK_EQ_INT(gpio_stub_levels[panelEnableIOs[panel]], 0);
+}
+
+#if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+static void test_dissolve(void) {
+    // Each changed dot is flipped exactly once, spread over the duration, and nothing else is
+    static uint8_t pixBuf[DISPLAY_PIX_BUF_SIZE];
+    static uint8_t before[DISPLAY_PIX_BUF_SIZE];
+    portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+    uint8_t shown[WIDTH][HEIGHT];
+
+    // Without a transition, the starting frame is shown instantly
+    fake_time_us += 1000000;
+    display_update(pixBuf, NULL, sizeof(pixBuf), &lock);
+    CHECK_EQ_INT(_mismatches(pixBuf), 0);
+    memcpy(before, pixBuf, sizeof(pixBuf));
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "transition", 3);
+    cJSON_AddNumberToObject(cJSON_AddObjectToObject(json, "params"), "duration", 1000);
+    display_set_transition(json);
+    for (uint32_t i = 0; i < sizeof(pixBuf); i++) pixBuf[i] = rand();
+    uint32_t changes = _changes(pixBuf, before);
+    CHECK(changes > 100);
+
+    uint32_t totalFlips = 0;
+    uint32_t steps = 0;
+    uint32_t wrongFlips = 0;
+    int64_t start = fake_time_us;
+    for (; fake_time_us <= start + 1100000; fake_time_us += 20000) {
+        memcpy(shown, dots, sizeof(dots));
+        flips = 0;
+        display_update(pixBuf, NULL, sizeof(pixBuf), &lock);
+        for (uint16_t x = 0; x < WIDTH; x++) {
+            for (uint8_t y = 0; y < HEIGHT; y++) {
+                // Dots only ever go from the old to the new frame
+                if (shown[x][y] != dots[x][y] && dots[x][y] != PIX_BUF_VAL(pixBuf, x, y)) wrongFlips++;
+            }
+        }
+        if (fake_time_us < start + 1000000 && flips > changes / 10) wrongFlips++;
+        if (flips) steps++;
+        totalFlips += flips;
+    }
+    CHECK_EQ_INT(wrongFlips, 0);
+    CHECK_EQ_INT(totalFlips, changes);
+    CHECK(steps > 20);
+    CHECK_EQ_INT(_mismatches(pixBuf), 0);
+    CHECK_EQ_INT(invalidFlips, 0);
+
+    display_set_transition(NULL);
+    cJSON_Delete(json);
+}
+#endif
+
+int main(void) {
+    test_frames();
+    #if defined(CONFIG_DISPLAY_HAS_TRANSITIONS)
+    test_dissolve();
+    #endif
+    return TEST_RESULT();
+}
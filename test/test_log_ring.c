@@ -0,0 +1,194 @@
+#include "test_common.h"
+#include "log_ring.h"
+#include <pthread.h>
+#include <string.h>
+
+/*
+ * Log ring records in order, across the wrap, with slow and fast readers,
+ * and under concurrent writers and readers.
+ */
+
+#define RING_SIZE 1024
+#define NUM_WRITERS 4
+#define NUM_READERS 2
+#define LINES_PER_WRITER 50000
+
+static uint8_t ring_data[RING_SIZE] __attribute__((aligned(LOG_RING_ALIGN)));
+static log_ring_t ring;
+
+static int _read_line(log_ring_reader_t* reader, char* out, size_t outSize) {
+    // Returns the line length, -1 if there is none and -2 if it was overwritten while reading
+    size_t len;
+    const uint8_t* data = log_ring_peek(&ring, reader, &len);
+    if (data == NULL) return -1;
+    if (len >= outSize) len = outSize - 1;
+    memcpy(out, data, len);
+    out[len] = 0;
+    return log_ring_advance(&ring, reader) ? (int)len : -2;
+}
+
+static void test_init(void) {
+    static uint8_t odd[100] __attribute__((aligned(LOG_RING_ALIGN)));
+    CHECK(!log_ring_init(&ring, odd, sizeof(odd)));
+    CHECK(!log_ring_init(&ring, &ring_data[1], 512));
+    CHECK(log_ring_init(&ring, ring_data, sizeof(ring_data)));
+}
+
+static void test_order_and_wrap(void) {
+    log_ring_init(&ring, ring_data, sizeof(ring_data));
+    log_ring_reader_t reader;
+    log_ring_reader_init(&ring, &reader);
+    char line[64];
+    char out[64];
+
+    // Odd lengths so records end up at every offset and the padding record gets used
+    for (int i = 0; i < 500; i++) {
+        int len = snprintf(line, sizeof(line), "line %d %.*s", i, i % 37, "abcdefghijklmnopqrstuvwxyz0123456789");
+        CHECK(log_ring_write(&ring, line, len));
+        CHECK_EQ_INT(_read_line(&reader, out, sizeof(out)), len);
+        CHECK(!strcmp(out, line));
+        CHECK_EQ_INT(_read_line(&reader, out, sizeof(out)), -1);
+    }
+    CHECK_EQ_INT(reader.lost, 0);
+    CHECK_EQ_INT(log_ring_get_dropped(&ring), 0);
+
+    // Too large for the ring
+    static char big[RING_SIZE];
+    memset(big, 'x', sizeof(big));
+    CHECK(!log_ring_write(&ring, big, sizeof(big)));
+    CHECK_EQ_INT(log_ring_get_dropped(&ring), 1);
+}
+
+static void test_backlog_and_lost(void) {
+    log_ring_init(&ring, ring_data, sizeof(ring_data));
+    char line[64];
+    char out[64];
+
+    log_ring_write(&ring, "first", 5);
+    log_ring_write(&ring, "second", 6);
+    log_ring_reader_t slow;
+    log_ring_reader_init(&ring, &slow);
+    CHECK_EQ_INT(_read_line(&slow, out, sizeof(out)), 5);
+    CHECK(!strcmp(out, "first"));
+
+    // Overwrite everything the slow reader hasn't seen yet
+    int last = 0;
+    for (int i = 0; i < 100; i++) {
+        last = i;
+        log_ring_write(&ring, line, snprintf(line, sizeof(line), "filler %d", i));
+    }
+    CHECK(_read_line(&slow, out, sizeof(out)) > 0);
+    CHECK(slow.lost > 0);
+    CHECK(strcmp(out, "second"));
+
+    // The rest comes in order, up to the last line
+    int prev = -1;
+    int n;
+    while (_read_line(&slow, out, sizeof(out)) > 0) {
+        CHECK(sscanf(out, "filler %d", &n) == 1);
+        CHECK(n > prev);
+        prev = n;
+    }
+    CHECK_EQ_INT(prev, last);
+}
+
+static void test_uncommitted_blocks(void) {
+    log_ring_init(&ring, ring_data, sizeof(ring_data));
+    log_ring_record_t pending;
+    CHECK(log_ring_reserve(&ring, 100, &pending));
+
+    // Writers go on until they would have to reclaim the pending record, then drop instead of waiting
+    int written = 0;
+    while (log_ring_write(&ring, "0123456789012345678901234567890123456789", 40) && written < 100) written++;
+    CHECK(written > 0 && written < 100);
+    CHECK_EQ_INT(log_ring_get_dropped(&ring), 1);
+
+    // Readers stop at the pending record
+    log_ring_reader_t reader;
+    log_ring_reader_init(&ring, &reader);
+    char out[128];
+    CHECK_EQ_INT(_read_line(&reader, out, sizeof(out)), -1);
+
+    memset(pending.payload, 'p', 10);
+    pending.len = 10;
+    log_ring_commit(&ring, &pending);
+    CHECK_EQ_INT(_read_line(&reader, out, sizeof(out)), 10);
+    CHECK(!strcmp(out, "pppppppppp"));
+    CHECK(log_ring_write(&ring, "after", 5));
+}
+
+static volatile int writers_done = 0;
+
+static void* _writer(void* arg) {
+    long id = (long)arg;
+    char line[160];
+    uint32_t rng = id * 7 + 1;
+    for (int i = 0; i < LINES_PER_WRITER; i++) {
+        rng = rng * 1103515245 + 12345;
+        int pad = 5 + (rng >> 8) % 120;
+        int len = snprintf(line, sizeof(line), "%ld:%d:", id, i);
+        for (int k = 0; k < pad; k++) line[len + k] = 'a' + (id + i + k) % 26;
+        len += pad;
+        log_ring_write(&ring, line, len);
+    }
+    return NULL;
+}
+
+static void* _reader(void* arg) {
+    // Every line that is read completely must be intact and in order per writer
+    long* corrupt = arg;
+    log_ring_reader_t reader;
+    log_ring_reader_init(&ring, &reader);
+    int last[NUM_WRITERS];
+    for (int i = 0; i < NUM_WRITERS; i++) last[i] = -1;
+    char line[200];
+
+    while (1) {
+        int len = _read_line(&reader, line, sizeof(line));
+        if (len == -1) {
+            if (writers_done) break;
+            continue;
+        }
+        if (len == -2) continue;
+        long id;
+        int i;
+        int n;
+        if (sscanf(line, "%ld:%d:%n", &id, &i, &n) < 2 || id < 0 || id >= NUM_WRITERS || i <= last[id]) {
+            (*corrupt)++;
+            continue;
+        }
+        for (int k = n; k < len; k++) {
+            if (line[k] != 'a' + (id + i + k - n) % 26) {
+                (*corrupt)++;
+                break;
+            }
+        }
+        last[id] = i;
+    }
+    return NULL;
+}
+
+static void test_concurrent(void) {
+    log_ring_init(&ring, ring_data, sizeof(ring_data));
+    pthread_t writers[NUM_WRITERS];
+    pthread_t readers[NUM_READERS];
+    long corrupt[NUM_READERS] = {0};
+
+    for (long i = 0; i < NUM_READERS; i++) pthread_create(&readers[i], NULL, _reader, &corrupt[i]);
+    for (long i = 0; i < NUM_WRITERS; i++) pthread_create(&writers[i], NULL, _writer, (void*)i);
+    for (int i = 0; i < NUM_WRITERS; i++) pthread_join(writers[i], NULL);
+    writers_done = 1;
+    for (int i = 0; i < NUM_READERS; i++) {
+        pthread_join(readers[i], NULL);
+        CHECK_EQ_INT(corrupt[i], 0);
+    }
+}
+
+int main(void) {
+    test_init();
+    test_order_and_wrap();
+    test_backlog_and_lost();
+    test_uncommitted_blocks();
+    test_concurrent();
+    return TEST_RESULT();
+}
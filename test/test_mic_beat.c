@@ -0,0 +1,144 @@
+#include "test_common.h"
+#include "mic_beat.h"
+#include "mic_dsp.h"
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Onsets and tempo of synthesized drum patterns, fed through the whole
+ * microphone pipeline like the analysis task does.
+ */
+
+#define SAMPLE_RATE 44100
+#define BLOCK_SIZE 256
+#define SECONDS 20
+#define MAX_BEATS 100
+
+static mic_dsp_t dsp;
+static mic_ring_t ring;
+static int32_t ring_data[MIC_DSP_FRAME_SIZE * 2];
+static mic_beat_t beat;
+static float signal[SECONDS * SAMPLE_RATE];
+static uint32_t rng_state = 1;
+
+static float _noise(void) {
+    rng_state = rng_state * 1103515245 + 12345;
+    return (float)(rng_state >> 8) / (1 << 23) - 1.0f;
+}
+
+static uint32_t _synthesize(float bpm, bool rock, bool pad, float gain, float* beats) {
+    /*
+    Kick drum on every beat, or kick and snare alternating for rock,
+    over either a quiet noise floor or a sustained chord.
+    Returns the number of beats, their times are stored in beats.
+    */
+    uint32_t n = SECONDS * SAMPLE_RATE;
+    uint32_t numBeats = 0;
+    memset(signal, 0, sizeof(signal));
+    for (float t0 = 0.5f; t0 < SECONDS - 0.5f && numBeats < MAX_BEATS; t0 += 60 / bpm, numBeats++) {
+        beats[numBeats] = t0;
+        uint32_t start = t0 * SAMPLE_RATE;
+        for (uint32_t k = 0; k < 0.4f * SAMPLE_RATE && start + k < n; k++) {
+            float t = (float)k / SAMPLE_RATE;
+            float kick = sinf(2 * M_PI * (50 + 80 * expf(-t * 30)) * t) * expf(-t * 12);
+            if (!rock || numBeats % 2 == 0) signal[start + k] += kick;
+            else signal[start + k] += _noise() * expf(-t * 25) * 0.6f + 0.3f * kick;
+        }
+    }
+    float max = 0.0f;
+    for (uint32_t k = 0; k < n; k++) {
+        float t = (float)k / SAMPLE_RATE;
+        if (pad) signal[k] += 0.15f * (sinf(2 * M_PI * 220 * t) + sinf(2 * M_PI * 277 * t) + sinf(2 * M_PI * 330 * t)) * (1 + 0.2f * sinf(2 * M_PI * 0.3f * t)) + 0.01f * _noise();
+        else signal[k] += 0.02f * _noise();
+        if (fabsf(signal[k]) > max) max = fabsf(signal[k]);
+    }
+    for (uint32_t k = 0; k < n; k++) signal[k] *= 0.5f * gain / max;
+    return numBeats;
+}
+
+static void _run(const char* name, float bpm, bool rock, bool pad, float gain, float expectedBpm) {
+    // At least 90% of the beats must be found within 70 ms, with hardly any false onsets
+    float beats[MAX_BEATS];
+    uint32_t numBeats = _synthesize(bpm, rock, pad, gain, beats);
+
+    mic_ring_init(&ring, ring_data, sizeof(ring_data) / sizeof(ring_data[0]));
+    mic_dsp_init(&dsp);
+    mic_beat_config_t config;
+    mic_beat_get_default_config(&config);
+    mic_beat_init(&beat, &config, (float)SAMPLE_RATE / MIC_DSP_HOP_SIZE);
+
+    uint32_t onsets = 0;
+    uint32_t hits = 0;
+    uint32_t nextBeat = 0;
+    int32_t block[BLOCK_SIZE];
+    for (uint32_t pos = 0; pos + BLOCK_SIZE <= SECONDS * SAMPLE_RATE; pos += BLOCK_SIZE) {
+        for (uint32_t i = 0; i < BLOCK_SIZE; i++) block[i] = (int32_t)(signal[pos + i] * 2147483647.0f);
+        mic_ring_push(&ring, block, BLOCK_SIZE);
+        const float* power;
+        float peak;
+        float strength;
+        while ((power = mic_dsp_process(&dsp, &ring, &peak)) != NULL) {
+            if (!mic_beat_process(&beat, power, &strength)) continue;
+            // Onsets are reported one hop late, timed at the middle of their frame
+            float t = (float)(pos + BLOCK_SIZE - 2 * MIC_DSP_HOP_SIZE - MIC_DSP_FRAME_SIZE / 2) / SAMPLE_RATE;
+            onsets++;
+            CHECK(strength > 1.0f);
+            while (nextBeat < numBeats && beats[nextBeat] < t - 0.07f) nextBeat++;
+            if (nextBeat < numBeats && fabsf(beats[nextBeat] - t) < 0.07f) {
+                hits++;
+                nextBeat++;
+            }
+        }
+    }
+
+    float detectedBpm = mic_beat_get_bpm(&beat);
+    printf("%-12s beats %u, onsets %u, hits %u, %.1f BPM\n", name, numBeats, onsets, hits, detectedBpm);
+    CHECK(hits >= numBeats * 9 / 10);
+    CHECK(onsets <= hits + numBeats / 20);
+    CHECK(fabsf(detectedBpm - expectedBpm) < expectedBpm * 0.03f);
+}
+
+static void _run_without_beat(const char* name, bool pad) {
+    // Steady sounds must neither trigger onsets nor report a tempo
+    uint32_t n = SECONDS * SAMPLE_RATE;
+    for (uint32_t k = 0; k < n; k++) {
+        float t = (float)k / SAMPLE_RATE;
+        signal[k] = pad ? 0.2f * (sinf(2 * M_PI * 220 * t) + sinf(2 * M_PI * 277 * t)) * (1 + 0.2f * sinf(2 * M_PI * 0.3f * t)) + 0.001f * _noise() : 0.001f * _noise();
+    }
+
+    mic_ring_init(&ring, ring_data, sizeof(ring_data) / sizeof(ring_data[0]));
+    mic_dsp_init(&dsp);
+    mic_beat_config_t config;
+    mic_beat_get_default_config(&config);
+    mic_beat_init(&beat, &config, (float)SAMPLE_RATE / MIC_DSP_HOP_SIZE);
+
+    uint32_t onsets = 0;
+    int32_t block[BLOCK_SIZE];
+    for (uint32_t pos = 0; pos + BLOCK_SIZE <= n; pos += BLOCK_SIZE) {
+        for (uint32_t i = 0; i < BLOCK_SIZE; i++) block[i] = (int32_t)(signal[pos + i] * 2147483647.0f);
+        mic_ring_push(&ring, block, BLOCK_SIZE);
+        const float* power;
+        float peak;
+        float strength;
+        while ((power = mic_dsp_process(&dsp, &ring, &peak)) != NULL) {
+            if (mic_beat_process(&beat, power, &strength)) onsets++;
+        }
+    }
+    printf("%-12s onsets %u, %.1f BPM\n", name, onsets, mic_beat_get_bpm(&beat));
+    CHECK(onsets <= 2);
+    CHECK_EQ_INT(mic_beat_get_bpm(&beat), 0);
+}
+
+int main(void) {
+    _run("kick 120", 120, false, false, 1.0f, 120);
+    _run("kick 84", 84, false, true, 1.0f, 84);
+    // The preference for tempos around 120 BPM picks half of very fast tempos
+    _run("kick 170", 170, false, false, 1.0f, 85);
+    _run("rock 95", 95, true, true, 1.0f, 95);
+    _run("rock 70", 70, true, true, 1.0f, 70);
+    _run("rock 128", 128, true, true, 0.05f, 128);
+    _run_without_beat("noise", false);
+    _run_without_beat("pad", true);
+    return TEST_RESULT();
+}
@@ -0,0 +1,146 @@
+#include "test_common.h"
+#include "mic_dsp.h"
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+
+/*
+ * Sample ring, framing and FFT of the microphone pipeline,
+ * and the spectrum sequence lock under a concurrent reader.
+ */
+
+#define SAMPLE_RATE 44100
+#define BLOCK_SIZE 256
+
+static mic_dsp_t dsp;
+static mic_ring_t ring;
+static int32_t ring_data[MIC_DSP_FRAME_SIZE * 2];
+static mic_spectrum_t spectrum;
+static float power_copy[MIC_DSP_SPECTRUM_SIZE];
+
+static void test_ring(void) {
+    int32_t in[100];
+    int32_t out[100];
+    int32_t data[64];
+    CHECK(!mic_ring_init(&ring, data, 60));
+    CHECK(mic_ring_init(&ring, data, 64));
+
+    for (int i = 0; i < 100; i++) in[i] = i * 3 - 50;
+    CHECK_EQ_INT(mic_ring_push(&ring, in, 40), 40);
+    CHECK_EQ_INT(mic_ring_pop(&ring, out, 30), 30);
+    CHECK_EQ_INT(out[29], in[29]);
+
+    // Wraps, and whatever doesn't fit is dropped and counted
+    CHECK_EQ_INT(mic_ring_push(&ring, in, 60), 54);
+    CHECK_EQ_INT(ring.overruns, 6);
+    CHECK_EQ_INT(mic_ring_available(&ring), 64);
+    CHECK_EQ_INT(mic_ring_pop(&ring, out, 100), 64);
+    CHECK_EQ_INT(out[0], in[30]);
+    CHECK_EQ_INT(out[10], in[0]);
+    CHECK_EQ_INT(out[63], in[53]);
+}
+
+static uint32_t _feed_sine(double freq, double amplitude, uint32_t blocks, long* n) {
+    // Returns the number of frames published
+    int32_t block[BLOCK_SIZE];
+    uint32_t frames = 0;
+    float peak;
+    for (uint32_t b = 0; b < blocks; b++) {
+        for (int i = 0; i < BLOCK_SIZE; i++, (*n)++) block[i] = (int32_t)(amplitude * sin(2 * M_PI * freq * *n / SAMPLE_RATE));
+        mic_ring_push(&ring, block, BLOCK_SIZE);
+        const float* power;
+        while ((power = mic_dsp_process(&dsp, &ring, &peak)) != NULL) {
+            mic_spectrum_publish(&spectrum, power, peak);
+            frames++;
+        }
+    }
+    return frames;
+}
+
+static void test_sine(void) {
+    mic_ring_init(&ring, ring_data, sizeof(ring_data) / sizeof(ring_data[0]));
+    CHECK(mic_dsp_init(&dsp));
+    memset(&spectrum, 0, sizeof(spectrum));
+    float peak;
+    CHECK_EQ_INT(mic_spectrum_read(&spectrum, power_copy, &peak), 0);
+
+    // Nothing until the first frame is full, then one frame per hop
+    long n = 0;
+    CHECK_EQ_INT(_feed_sine(1000, 1e8, MIC_DSP_FRAME_SIZE / BLOCK_SIZE - 1, &n), 0);
+    CHECK_EQ_INT(_feed_sine(1000, 1e8, 1, &n), 1);
+    CHECK_EQ_INT(_feed_sine(1000, 1e8, 16, &n), 16 * BLOCK_SIZE / MIC_DSP_HOP_SIZE);
+    CHECK_EQ_INT(ring.overruns, 0);
+
+    uint32_t frame = mic_spectrum_read(&spectrum, power_copy, &peak);
+    CHECK_EQ_INT(frame, 1 + 16 * BLOCK_SIZE / MIC_DSP_HOP_SIZE);
+    CHECK(peak > 0.99e8 && peak <= 1e8);
+
+    uint32_t maxBin = 0;
+    for (uint32_t i = 1; i < MIC_DSP_SPECTRUM_SIZE; i++) {
+        if (power_copy[i] > power_copy[maxBin]) maxBin = i;
+    }
+    CHECK_EQ_INT(maxBin, (uint32_t)lround(1000.0 * MIC_DSP_FRAME_SIZE / SAMPLE_RATE));
+    // Far away from the tone, only window leakage is left
+    CHECK(power_copy[maxBin * 4] < power_copy[maxBin] * 1e-4f);
+
+    // At the full adaptation rate the factor scales the peak to full scale,
+    // the same frame again only applies the limits
+    mic_norm_t norm;
+    mic_norm_init(&norm);
+    float factor = mic_norm_update(&norm, frame, peak, 1.0f, 500.0f, 1.0f, 1.0f);
+    CHECK(fabsf(factor - (float)0x7FFFFFFF / peak) < 1.0f);
+    CHECK_EQ_INT(mic_norm_update(&norm, frame, peak, 1.0f, 10.0f, 1.0f, 1.0f), 10);
+
+    // Linear bins hold the loudest power of their range in dB
+    float bins[16];
+    mic_dsp_get_bins(power_copy, 1.0f, bins, 16, 0, 1.0f);
+    uint32_t maxOut = 0;
+    for (uint32_t i = 0; i < 16; i++) {
+        if (bins[i] > bins[maxOut]) maxOut = i;
+    }
+    CHECK_EQ_INT(maxOut, maxBin / (MIC_DSP_SPECTRUM_SIZE / 16));
+    CHECK(fabsf(bins[maxOut] - 10 * log10f(power_copy[maxBin])) < 0.01f);
+}
+
+static volatile int publishing = 1;
+
+static void* _reader(void* arg) {
+    // Every power value of a published spectrum equals its frame number, so torn reads show up
+    long* torn = arg;
+    static float copy[MIC_DSP_SPECTRUM_SIZE];
+    while (publishing) {
+        float peak;
+        uint32_t frame = mic_spectrum_read(&spectrum, copy, &peak);
+        if (frame == 0) continue;
+        if (peak != (float)frame) (*torn)++;
+        for (uint32_t i = 0; i < MIC_DSP_SPECTRUM_SIZE; i++) {
+            if (copy[i] != (float)frame) {
+                (*torn)++;
+                break;
+            }
+        }
+    }
+    return NULL;
+}
+
+static void test_spectrum_concurrent(void) {
+    static float power[MIC_DSP_SPECTRUM_SIZE];
+    memset(&spectrum, 0, sizeof(spectrum));
+    long torn = 0;
+    pthread_t reader;
+    pthread_create(&reader, NULL, _reader, &torn);
+    for (uint32_t frame = 1; frame <= 100000; frame++) {
+        for (uint32_t i = 0; i < MIC_DSP_SPECTRUM_SIZE; i++) power[i] = frame;
+        mic_spectrum_publish(&spectrum, power, frame);
+    }
+    publishing = 0;
+    pthread_join(reader, NULL);
+    CHECK_EQ_INT(torn, 0);
+}
+
+int main(void) {
+    test_ring();
+    test_sine();
+    test_spectrum_concurrent();
+    return TEST_RESULT();
+}
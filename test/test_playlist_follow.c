@@ -0,0 +1,145 @@
+#include "test_common.h"
+#include "playlist_follow.h"
+
+/*
+ * A follower tracking the leader's playlist position:
+ * jumps, switches predicted in sequential mode, and the fallback to local timing
+ * while the leader provides no usable position.
+ */
+
+#define NUM_ENTRIES 4
+#define DURATION_MS 1000
+
+static pl_follow_t follow;
+static uint16_t cur_buffer = 0;
+
+static bool _update(const pl_follow_leader_t* leader, bool sequential, int64_t now, pl_follow_action_t* action, int64_t* next) {
+    // Apply the action to the simulated local playlist with a single group
+    bool following = pl_follow_update(&follow, leader, sequential, 0, cur_buffer, now, action, next);
+    if (*action == PL_FOLLOW_NEXT) cur_buffer = (cur_buffer + 1) % NUM_ENTRIES;
+    if (*action == PL_FOLLOW_JUMP) cur_buffer = leader->buffer;
+    return following;
+}
+
+static pl_follow_leader_t _leader(uint16_t buffer, int64_t switch_us) {
+    pl_follow_leader_t leader = {
+        .valid = true,
+        .in_playlist = buffer < NUM_ENTRIES,
+        .group = 0,
+        .buffer = buffer,
+        .switch_us = switch_us,
+        .duration_ms = DURATION_MS,
+    };
+    return leader;
+}
+
+static void test_states(void) {
+    pl_follow_action_t action;
+    int64_t next;
+    pl_follow_init(&follow);
+
+    // Nothing received yet
+    pl_follow_leader_t leader = {0};
+    CHECK(!_update(&leader, true, 0, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+    CHECK_EQ_INT(next, 0);
+
+    // The first position is jumped to
+    leader = _leader(2, 1000000);
+    CHECK(_update(&leader, true, 1100000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_JUMP);
+    CHECK_EQ_INT(cur_buffer, 2);
+    CHECK_EQ_INT(next, 2000000);
+    CHECK(_update(&leader, true, 1500000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+    CHECK_EQ_INT(next, 2000000);
+
+    // Sequential mode switches on time without waiting for the leader
+    CHECK(_update(&leader, true, 2000000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_NEXT);
+    CHECK_EQ_INT(cur_buffer, 3);
+    CHECK_EQ_INT(next, 0);
+    CHECK(_update(&leader, true, 2001000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+
+    // The leader confirms, nothing to do
+    leader = _leader(3, 2000000);
+    CHECK(_update(&leader, true, 2005000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+    CHECK_EQ_INT(next, 3000000);
+
+    // The prediction was wrong
+    CHECK(_update(&leader, true, 3000000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_NEXT);
+    CHECK_EQ_INT(cur_buffer, 0);
+    leader = _leader(1, 3000000);
+    CHECK(_update(&leader, true, 3005000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_JUMP);
+    CHECK_EQ_INT(cur_buffer, 1);
+
+    // Random mode waits for the leader, the overdue switch time is reported as such
+    CHECK(_update(&leader, false, 4002000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+    CHECK_EQ_INT(next, 4000000);
+
+    // An entry missing from the local playlist means local timing, until the leader is back on a known one
+    leader = _leader(NUM_ENTRIES, 4000000);
+    CHECK(!_update(&leader, true, 4005000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+    CHECK(!_update(&leader, true, 5500000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_KEEP);
+    CHECK_EQ_INT(cur_buffer, 1);
+    leader = _leader(2, 5000000);
+    CHECK(_update(&leader, true, 5505000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_JUMP);
+    CHECK_EQ_INT(cur_buffer, 2);
+
+    // Losing the leader means local timing, its position is jumped to again once it's back
+    pl_follow_leader_t lost = {0};
+    CHECK(!_update(&lost, true, 5600000, &action, &next));
+    cur_buffer = 0;
+    CHECK(_update(&leader, true, 5700000, &action, &next));
+    CHECK_EQ_INT(action, PL_FOLLOW_JUMP);
+    CHECK_EQ_INT(cur_buffer, 2);
+}
+
+static void test_simulated(void) {
+    /*
+    The leader switches every DURATION_MS, its announcements arrive
+    with a network delay of up to 30 ms. The follower runs every 5 ms.
+    Once in step, it has to switch in the same step as the leader, every time.
+    */
+    uint32_t rng = 1;
+    pl_follow_init(&follow);
+    cur_buffer = 0;
+    uint16_t leaderBuffer = 0;
+    int64_t leaderSwitch = 500000;
+    pl_follow_leader_t received = {0};
+    int64_t arrival = leaderSwitch + 10000;
+    uint32_t late = 0;
+    uint32_t jumps = 0;
+
+    for (int64_t now = 0; now < 60000000; now += 5000) {
+        if (now >= leaderSwitch + DURATION_MS * 1000) {
+            leaderSwitch += DURATION_MS * 1000;
+            leaderBuffer = (leaderBuffer + 1) % NUM_ENTRIES;
+            rng = rng * 1103515245 + 12345;
+            arrival = leaderSwitch + (rng >> 8) % 30000;
+        }
+        if (now >= arrival) received = _leader(leaderBuffer, leaderSwitch);
+
+        pl_follow_action_t action;
+        int64_t next;
+        CHECK(_update(&received, true, now, &action, &next) || now < arrival);
+        if (action == PL_FOLLOW_JUMP) jumps++;
+        if (now > 2000000 && cur_buffer != leaderBuffer) late++;
+    }
+    CHECK_EQ_INT(jumps, 1);
+    CHECK_EQ_INT(late, 0);
+}
+
+int main(void) {
+    test_states();
+    test_simulated();
+    return TEST_RESULT();
+}
@@ -0,0 +1,78 @@
+#include "test_common.h"
+#include "shader_cache.h"
+#include <string.h>
+
+/*
+ * Hits and misses of the shader color cache for each dependency.
+ */
+
+static uint8_t store[8];
+static shader_cache_t cache = {.chars = store, .size = sizeof(store)};
+static int shaderA;
+static int shaderB;
+
+static void test_static(void) {
+    uint8_t a[8] = "ABCDEFG";
+    uint8_t b[8] = "ABCDEFX";
+    CHECK(!shader_cache_lookup(&cache, &shaderA, 0, 0, a, 8, 8));
+    // Without dependencies, time, characters and buffer size don't matter
+    CHECK(shader_cache_lookup(&cache, &shaderA, 0, 5, b, 3, 8));
+    CHECK(!shader_cache_lookup(&cache, &shaderB, 0, 5, b, 3, 8));
+    CHECK(!shader_cache_lookup(&cache, &shaderB, 0, 5, b, 3, 4));
+    CHECK(shader_cache_lookup(&cache, &shaderB, 0, 5, b, 3, 4));
+}
+
+static void test_time(void) {
+    uint8_t a[8] = "ABCDEFG";
+    uint8_t b[8] = "ABCDEFX";
+    CHECK(!shader_cache_lookup(&cache, &shaderB, SHADER_DEPENDS_TIME, 5, b, 3, 4));
+    CHECK(shader_cache_lookup(&cache, &shaderB, SHADER_DEPENDS_TIME, 5, a, 8, 4));
+    CHECK(!shader_cache_lookup(&cache, &shaderB, SHADER_DEPENDS_TIME, 6, a, 8, 4));
+    CHECK(shader_cache_lookup(&cache, &shaderB, SHADER_DEPENDS_TIME, 6, a, 8, 4));
+}
+
+static void test_position(void) {
+    uint8_t a[8] = "ABCDEFG";
+    uint8_t b[8] = "ABCDEFX";
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_POSITION, 0, a, 8, 8));
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_POSITION, 9, b, 8, 8));
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_POSITION, 9, b, 7, 8));
+}
+
+static void test_character(void) {
+    uint8_t a[8] = "ABCDEFG";
+    uint8_t b[8] = "ABCDEFX";
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 8, 8));
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 8));
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, b, 3, 8));
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, b, 3, 8));
+
+    // The characters are compared by content, not by address
+    a[6] = 'X';
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 8));
+
+    // Only the characters that have colors count
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 4));
+    a[5] = 'Y';
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 4));
+}
+
+static void test_invalidate(void) {
+    uint8_t a[8] = "ABCDEFG";
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 8));
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 8));
+    shader_cache_invalidate(&cache);
+    CHECK(!shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 8));
+
+    // More colors than the cache holds are clamped to its size
+    CHECK(shader_cache_lookup(&cache, &shaderA, SHADER_DEPENDS_CHARACTER, 0, a, 3, 20));
+}
+
+int main(void) {
+    test_static();
+    test_time();
+    test_position();
+    test_character();
+    test_invalidate();
+    return TEST_RESULT();
+}
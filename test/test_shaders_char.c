@@ -0,0 +1,231 @@
+#include "test_common.h"
+#include "shaders_char.h"
+#include "display_sync.h"
+#include "i2s_microphone.h"
+#include "macros.h"
+#include <math.h>
+#include <string.h>
+
+/*
+ * Character shaders in fixed point, compared against the original per character
+ * floating point implementation, which is kept here as the reference.
+ */
+
+#define NUM_CHARS DISPLAY_CHAR_BUF_SIZE
+
+static int64_t fake_time_us = 0;
+static uint32_t fake_beat_count = 0;
+
+int64_t sync_get_time_us(void) { return fake_time_us; }
+void i2s_mic_get_beat(i2s_mic_beat_t* beat) {
+    memset(beat, 0, sizeof(*beat));
+    beat->count = fake_beat_count;
+}
+
+static int max_diff = 0;
+
+static void _compare(color_rgb_t expected, color_rgb_u8_t actual) {
+    // The float version truncated when converting to 8 bits
+    int diffs[3] = {
+        (uint8_t)(expected.r * 255) - actual.r,
+        (uint8_t)(expected.g * 255) - actual.g,
+        (uint8_t)(expected.b * 255) - actual.b
+    };
+    for (int i = 0; i < 3; i++) {
+        if (abs(diffs[i]) > max_diff) max_diff = abs(diffs[i]);
+    }
+}
+
+static uint16_t _span(uint8_t repeats) {
+    uint16_t span = DISPLAY_VIEWPORT_WIDTH_CHAR / repeats;
+    return span ? span : 1;
+}
+
+static color_rgb_t _reference_hue(double hue) {
+    color_hsv_t hsv = {.h = hue, .s = 1.0, .v = 1.0};
+    return hsv2rgb(hsv);
+}
+
+static color_rgb_t _reference_static_rainbow(uint16_t i, uint8_t repeats) {
+    uint16_t span = _span(repeats);
+    return _reference_hue((i % span) * (360 / span));
+}
+
+static color_rgb_t _reference_sweeping_rainbow(uint16_t i, uint16_t charBufSize, uint16_t speed, uint8_t repeats, uint8_t rtl) {
+    uint16_t span = _span(repeats);
+    double hue;
+    if (rtl) {
+        hue = (i % span) * (360 / span);
+    } else {
+        hue = ((charBufSize - i) % span) * (360 / span);
+    }
+    hue += (double)speed * (double)fake_time_us / 1000000.0;
+    return _reference_hue((uint16_t)fmod(hue, 360.0));
+}
+
+static color_rgb_t _reference_sweeping_single_color_rainbow(uint16_t speed) {
+    return _reference_hue((uint16_t)fmod((double)speed * (double)fake_time_us / 1000000.0, 360.0));
+}
+
+static color_rgb_t _reference_linear_gradient(uint16_t i, color_rgb_t start, color_rgb_t end, uint8_t repeats) {
+    uint16_t span = _span(repeats);
+    color_rgb_t color;
+    color.r = map_double(i % span, 0, span - 1, start.r, end.r);
+    color.g = map_double(i % span, 0, span - 1, start.g, end.g);
+    color.b = map_double(i % span, 0, span - 1, start.b, end.b);
+    return color;
+}
+
+static color_rgb_t _reference_beat_rainbow(uint16_t i, uint8_t step, uint8_t repeats) {
+    uint16_t span = _span(repeats);
+    return _reference_hue(((i % span) * (360 / span) + fake_beat_count * step) % 360);
+}
+
+static void test_against_float(void) {
+    color_rgb_u8_t colors[NUM_CHARS];
+    color_rgb_u8_t start = {.r = 255, .g = 51, .b = 0};
+    color_rgb_u8_t end = {.r = 0, .g = 127, .b = 255};
+    color_rgb_t startFloat = {.r = 1.0, .g = 0.2, .b = 0.0};
+    color_rgb_t endFloat = {.r = 0.0, .g = 127 / 255.0, .b = 1.0};
+
+    for (uint8_t repeats = 1; repeats <= 5; repeats++) {
+        shader_static_rainbow(colors, NUM_CHARS, repeats);
+        for (uint16_t i = 0; i < NUM_CHARS; i++) _compare(_reference_static_rainbow(i, repeats), colors[i]);
+
+        shader_linear_gradient(colors, NUM_CHARS, start, end, repeats);
+        for (uint16_t i = 0; i < NUM_CHARS; i++) _compare(_reference_linear_gradient(i, startFloat, endFloat, repeats), colors[i]);
+
+        for (fake_time_us = 0; fake_time_us < 20000000; fake_time_us += 123457) {
+            for (uint8_t rtl = 0; rtl < 2; rtl++) {
+                shader_sweeping_rainbow(colors, NUM_CHARS, NUM_CHARS, fake_time_us, 37, repeats, rtl);
+                for (uint16_t i = 0; i < NUM_CHARS; i++) _compare(_reference_sweeping_rainbow(i, NUM_CHARS, 37, repeats, rtl), colors[i]);
+            }
+            shader_sweeping_single_color_rainbow(colors, NUM_CHARS, fake_time_us, 37);
+            for (uint16_t i = 0; i < NUM_CHARS; i++) _compare(_reference_sweeping_single_color_rainbow(37), colors[i]);
+        }
+
+        for (fake_beat_count = 0; fake_beat_count < 50; fake_beat_count += 7) {
+            shader_beat_rainbow(colors, NUM_CHARS, fake_beat_count, 13, repeats);
+            for (uint16_t i = 0; i < NUM_CHARS; i++) _compare(_reference_beat_rainbow(i, 13, repeats), colors[i]);
+        }
+    }
+    CHECK(max_diff <= 1);
+}
+
+static cJSON* _shader_json(int shader) {
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "shader", shader);
+    cJSON_AddObjectToObject(json, "params");
+    return json;
+}
+
+static void test_from_json(void) {
+    color_rgb_u8_t colors[NUM_CHARS];
+    color_rgb_u8_t expected[NUM_CHARS];
+    uint8_t chars[NUM_CHARS];
+    memset(chars, 'A', sizeof(chars));
+    fake_time_us = 1700000000123456LL;
+
+    // Sweeping rainbow, the time comes from the sync clock
+    cJSON* json = _shader_json(2);
+    cJSON* params = cJSON_GetObjectItem(json, "params");
+    cJSON_AddNumberToObject(params, "speed", 45);
+    cJSON_AddNumberToObject(params, "repeats", 2);
+    cJSON_AddBoolToObject(params, "right_to_left", 1);
+    shader_invalidate_cache();
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    shader_sweeping_rainbow(expected, NUM_CHARS, NUM_CHARS, fake_time_us, 45, 2, 1);
+    CHECK(memcmp(colors, expected, sizeof(colors)) == 0);
+    cJSON_Delete(json);
+
+    // Linear gradient
+    json = _shader_json(4);
+    params = cJSON_GetObjectItem(json, "params");
+    cJSON* start = cJSON_AddObjectToObject(params, "start");
+    cJSON_AddNumberToObject(start, "r", 10);
+    cJSON_AddNumberToObject(start, "g", 20);
+    cJSON_AddNumberToObject(start, "b", 30);
+    cJSON* end = cJSON_AddObjectToObject(params, "end");
+    cJSON_AddNumberToObject(end, "r", 200);
+    cJSON_AddNumberToObject(end, "g", 100);
+    cJSON_AddNumberToObject(end, "b", 0);
+    cJSON_AddNumberToObject(params, "repeats", 1);
+    shader_invalidate_cache();
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    shader_linear_gradient(expected, NUM_CHARS, (color_rgb_u8_t){10, 20, 30}, (color_rgb_u8_t){200, 100, 0}, 1);
+    CHECK(memcmp(colors, expected, sizeof(colors)) == 0);
+    cJSON_Delete(json);
+
+    // Missing parameters and unknown shaders fall back to white, only the requested colors are written
+    json = _shader_json(5);
+    memset(colors, 0, sizeof(colors));
+    shader_invalidate_cache();
+    shader_fromJSON(json, chars, NUM_CHARS, colors, 3);
+    CHECK(colors[0].r == 255 && colors[0].g == 255 && colors[0].b == 255);
+    CHECK(colors[2].r == 255 && colors[2].g == 255 && colors[2].b == 255);
+    CHECK(colors[3].r == 0 && colors[3].g == 0 && colors[3].b == 0);
+    cJSON_Delete(json);
+
+    json = _shader_json(99);
+    shader_invalidate_cache();
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(colors[NUM_CHARS - 1].r == 255 && colors[NUM_CHARS - 1].g == 255 && colors[NUM_CHARS - 1].b == 255);
+    cJSON_Delete(json);
+
+    shader_invalidate_cache();
+    shader_fromJSON(NULL, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(colors[0].r == 255 && colors[0].g == 255 && colors[0].b == 255);
+}
+
+static void test_cache(void) {
+    color_rgb_u8_t colors[NUM_CHARS];
+    color_rgb_u8_t first[NUM_CHARS];
+    uint8_t chars[NUM_CHARS];
+    memset(chars, 'A', sizeof(chars));
+
+    cJSON* json = _shader_json(3);
+    cJSON* speed = cJSON_AddNumberToObject(cJSON_GetObjectItem(json, "params"), "speed", 10);
+    shader_invalidate_cache();
+
+    // At 10 degrees per second, the hue only changes every 100 ms
+    fake_time_us = 1000000;
+    shader_fromJSON(json, chars, NUM_CHARS, first, NUM_CHARS);
+    fake_time_us = 1099999;
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(memcmp(colors, first, sizeof(colors)) == 0);
+    fake_time_us = 1100000;
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(memcmp(colors, first, sizeof(colors)) != 0);
+
+    // The parameters are only parsed again after invalidating the cache
+    cJSON_SetNumberHelper(speed, 100);
+    fake_time_us = 1000000;
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(memcmp(colors, first, sizeof(colors)) == 0);
+    shader_invalidate_cache();
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(memcmp(colors, first, sizeof(colors)) != 0);
+    cJSON_Delete(json);
+
+    // A static shader doesn't change with the characters
+    json = _shader_json(0);
+    cJSON* color = cJSON_AddObjectToObject(cJSON_GetObjectItem(json, "params"), "color");
+    cJSON_AddNumberToObject(color, "r", 1);
+    cJSON_AddNumberToObject(color, "g", 2);
+    cJSON_AddNumberToObject(color, "b", 3);
+    shader_invalidate_cache();
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    chars[0] = 'B';
+    memset(colors, 0, sizeof(colors));
+    shader_fromJSON(json, chars, NUM_CHARS, colors, NUM_CHARS);
+    CHECK(colors[0].r == 1 && colors[0].g == 2 && colors[0].b == 3);
+    CHECK(colors[NUM_CHARS - 1].r == 1 && colors[NUM_CHARS - 1].g == 2 && colors[NUM_CHARS - 1].b == 3);
+    cJSON_Delete(json);
+}
+
+int main(void) {
+    test_against_float();
+    test_from_json();
+    test_cache();
+    return TEST_RESULT();
+}
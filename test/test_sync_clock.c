@@ -0,0 +1,133 @@
+#include "test_common.h"
+#include "sync_clock.h"
+
+/*
+ * Simulated leader and followers: the leader broadcasts its time base, each follower
+ * receives it with its own clock offset and a random network delay.
+ */
+
+#define NUM_NODES 3
+#define STEP_THRESHOLD_US 20000
+#define SLEW_SHIFT 3
+
+static uint32_t rng_state = 12345;
+
+static uint32_t _rand(void) {
+    rng_state = rng_state * 1103515245 + 12345;
+    return rng_state >> 8;
+}
+
+static void test_packet_roundtrip(void) {
+    sync_packet_t in = {
+        .flags = SYNC_FLAG_PLAYLIST_VALID,
+        .sequence = 0xBEEF,
+        .epoch_us = -1234567890123LL,
+        .pl_group = 7,
+        .pl_buffer = 65535,
+        .pl_switch_us = 1700000000000000LL,
+        .pl_duration_ms = 123456,
+    };
+    sync_packet_t out;
+    uint8_t buf[SYNC_PACKET_LENGTH];
+    sync_packet_encode(buf, &in);
+    CHECK(sync_packet_decode(buf, sizeof(buf), &out));
+    CHECK_EQ_INT(out.flags, in.flags);
+    CHECK_EQ_INT(out.sequence, in.sequence);
+    CHECK_EQ_INT(out.epoch_us, in.epoch_us);
+    CHECK_EQ_INT(out.pl_group, in.pl_group);
+    CHECK_EQ_INT(out.pl_buffer, in.pl_buffer);
+    CHECK_EQ_INT(out.pl_switch_us, in.pl_switch_us);
+    CHECK_EQ_INT(out.pl_duration_ms, in.pl_duration_ms);
+    CHECK(!sync_packet_decode(buf, sizeof(buf) - 1, &out));
+    buf[0] = 'X';
+    CHECK(!sync_packet_decode(buf, sizeof(buf), &out));
+}
+
+static void test_followers_converge(int64_t max_delay_us) {
+    sync_clock_t clocks[NUM_NODES];
+    int64_t local_offset[NUM_NODES] = { 1000, 777777, -5000000 };
+    for (int i = 0; i < NUM_NODES; i++) sync_clock_init(&clocks[i]);
+    int64_t worst = 0;
+    uint32_t steps_after_lock[NUM_NODES];
+
+    for (int k = 1; k <= 4000; k++) {
+        int64_t leader = 1700000000000000LL + k * 250000LL;
+        for (int i = 0; i < NUM_NODES; i++) {
+            int64_t delay = 500 + _rand() % max_delay_us;
+            int64_t local_rx = leader - 1700000000000000LL + local_offset[i] + delay;
+            CHECK(sync_clock_update(&clocks[i], k, leader, local_rx, STEP_THRESHOLD_US, SLEW_SHIFT));
+
+            if (k == 50) steps_after_lock[i] = clocks[i].num_steps;
+            if (k > 200) {
+                int64_t error = sync_clock_to_shared(&clocks[i], local_rx - delay) - leader;
+                if (error < 0) error = -error;
+                if (error > worst) worst = error;
+            }
+        }
+    }
+    printf("max delay %lld us: worst error %lld us\n", (long long)max_delay_us, (long long)worst);
+    // The minimum delay filter has to remove most of the delay
+    CHECK(worst < max_delay_us / 2);
+    for (int i = 0; i < NUM_NODES; i++) {
+        // Steps are only allowed while acquiring, delay spikes must not cause them later
+        CHECK(steps_after_lock[i] >= 1);
+        CHECK_EQ_INT(clocks[i].num_steps, steps_after_lock[i]);
+        CHECK(clocks[i].jitter_us > 0);
+        CHECK(sync_clock_to_local(&clocks[i], sync_clock_to_shared(&clocks[i], 42)) == 42);
+    }
+}
+
+static void test_leader_jump(void) {
+    sync_clock_t clock;
+    sync_clock_init(&clock);
+    int64_t jump = 0;
+    for (int k = 1; k <= 200; k++) {
+        // The leader's time base jumps, e.g. because it synced via NTP
+        if (k == 100) jump = 3000000;
+        int64_t local = k * 100000LL;
+        sync_clock_update(&clock, k, local + 5000000 + jump, local + 1000, STEP_THRESHOLD_US, SLEW_SHIFT);
+    }
+    CHECK_EQ_INT(clock.num_steps, 2);
+    CHECK_EQ_INT(clock.offset_us, 5000000 + 3000000 - 1000);
+}
+
+static void test_small_error_slews(void) {
+    sync_clock_t clock;
+    sync_clock_init(&clock);
+    for (int k = 1; k <= 20; k++) sync_clock_update(&clock, k, k * 100000LL, k * 100000LL, STEP_THRESHOLD_US, SLEW_SHIFT);
+    // A 10 ms drift is below the step threshold and is corrected gradually
+    int64_t before = clock.offset_us;
+    for (int k = 21; k <= 22; k++) sync_clock_update(&clock, k, k * 100000LL + 10000, k * 100000LL, STEP_THRESHOLD_US, SLEW_SHIFT);
+    CHECK(clock.offset_us > before && clock.offset_us < before + 10000);
+    for (int k = 23; k <= 400; k++) sync_clock_update(&clock, k, k * 100000LL + 10000, k * 100000LL, STEP_THRESHOLD_US, SLEW_SHIFT);
+    CHECK_EQ_INT(clock.num_steps, 1);
+    CHECK(clock.offset_us >= 9990 && clock.offset_us <= 10000);
+}
+
+static void test_ordering_and_timeout(void) {
+    sync_clock_t clock;
+    sync_clock_init(&clock);
+    CHECK(sync_clock_update(&clock, 65534, 1000, 0, STEP_THRESHOLD_US, SLEW_SHIFT));
+    CHECK(sync_clock_update(&clock, 65535, 2000, 1000, STEP_THRESHOLD_US, SLEW_SHIFT));
+    // Wraparound is accepted, duplicates and reordered packets are not
+    CHECK(sync_clock_update(&clock, 0, 3000, 2000, STEP_THRESHOLD_US, SLEW_SHIFT));
+    CHECK(!sync_clock_update(&clock, 0, 3000, 2000, STEP_THRESHOLD_US, SLEW_SHIFT));
+    CHECK(!sync_clock_update(&clock, 65535, 3000, 2000, STEP_THRESHOLD_US, SLEW_SHIFT));
+    CHECK_EQ_INT(clock.num_dropped, 2);
+
+    CHECK(sync_clock_check_timeout(&clock, 500000, 1000000));
+    CHECK(!sync_clock_check_timeout(&clock, 2000000, 1000000));
+    CHECK_EQ_INT(clock.num_samples, 0);
+    // After losing the lock, any sequence number is accepted again
+    CHECK(sync_clock_update(&clock, 10, 3000, 2000, STEP_THRESHOLD_US, SLEW_SHIFT));
+}
+
+int main(void) {
+    test_packet_roundtrip();
+    test_followers_converge(8000);
+    test_followers_converge(40000);
+    test_leader_jump();
+    test_small_error_slews();
+    test_ordering_and_timeout();
+    return TEST_RESULT();
+}
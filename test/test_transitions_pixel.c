@@ -0,0 +1,201 @@
+#include "test_common.h"
+#include "transitions_pixel.h"
+#include "macros.h"
+#include <string.h>
+
+/*
+ * Pixel transitions, checked frame by frame.
+ * Built once per pixel buffer type, see CMakeLists.txt.
+ */
+
+#define WIDTH DISPLAY_FRAME_WIDTH_PIXEL
+#define HEIGHT DISPLAY_FRAME_HEIGHT_PIXEL
+#define DURATION_US 100000
+#define START_US 10000
+
+#if defined(CONFIG_DISPLAY_PIX_BUF_TYPE_1BPP)
+#define PIXEL_BYTES 0
+static int _get(const uint8_t* buf, int x, int y) { return PIX_BUF_VAL(buf, x, y); }
+static void _copy(uint8_t* dst, const uint8_t* src, int x, int y) {
+    uint8_t* byte = &dst[x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y / 8];
+    *byte = (*byte & ~(1 << (y % 8))) | (src[x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y / 8] & (1 << (y % 8)));
+}
+#else
+#define PIXEL_BYTES (DISPLAY_FRAME_HEIGHT_PIXEL_BYTES / HEIGHT)
+static int _get(const uint8_t* buf, int x, int y) {
+    int value = 0;
+    for (int i = 0; i < PIXEL_BYTES; i++) value = value * 256 + buf[x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y * PIXEL_BYTES + i];
+    return value;
+}
+static void _copy(uint8_t* dst, const uint8_t* src, int x, int y) {
+    int offset = x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y * PIXEL_BYTES;
+    memcpy(&dst[offset], &src[offset], PIXEL_BYTES);
+}
+#endif
+
+static uint8_t frame_a[DISPLAY_PIX_BUF_SIZE];
+static uint8_t frame_b[DISPLAY_PIX_BUF_SIZE];
+static uint8_t out[DISPLAY_PIX_BUF_SIZE];
+static uint8_t prev[DISPLAY_PIX_BUF_SIZE];
+
+static cJSON* _transition_json(int transition, double durationMs) {
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "transition", transition);
+    cJSON* params = cJSON_AddObjectToObject(json, "params");
+    cJSON_AddNumberToObject(params, "duration", durationMs);
+    return json;
+}
+
+static void _run(int transition) {
+    /*
+    Go from frame A to frame B and check every step:
+    - only pixels that differ between the frames change, each of them towards B
+    - wipe has replaced exactly the columns left of the wipe position
+    - crossfade blends with the alpha for the elapsed time
+    - the number of finished pixels never decreases
+    - a step that reports no change didn't change anything
+    - the final frame is B
+    */
+    CHECK_EQ_INT(transition_init(WIDTH, HEIGHT, NULL, 0), ESP_OK);
+    memset(out, 0, sizeof(out));
+    CHECK_EQ_INT(transition_update(out, frame_a, NULL, 0), 1);
+    CHECK(memcmp(out, frame_a, sizeof(out)) == 0);
+    CHECK_EQ_INT(transition_update(out, frame_a, NULL, 1000), 0);
+
+    cJSON* json = _transition_json(transition, DURATION_US / 1000);
+    uint32_t errors = 0;
+    int prevDone = -1;
+    uint32_t steps = 0;
+    for (int64_t t = START_US; t <= START_US + DURATION_US + 10000; t += 2500) {
+        memcpy(prev, out, sizeof(out));
+        uint8_t changed = transition_update(out, frame_b, json, t);
+        int64_t elapsed = t - START_US;
+        int running = elapsed < DURATION_US;
+        int done = 0;
+        int touched = 0;
+        for (int x = 0; x < WIDTH; x++) {
+            for (int y = 0; y < HEIGHT; y++) {
+                int differs = _get(frame_a, x, y) != _get(frame_b, x, y);
+                if (_get(prev, x, y) != _get(out, x, y)) {
+                    touched++;
+                    if (running && !differs) errors++;
+                }
+                if (!differs) {
+                    if (running && _get(out, x, y) != _get(frame_a, x, y)) errors++;
+                    continue;
+                }
+                if (_get(out, x, y) == _get(frame_b, x, y)) done++;
+                if (transition == 1 && running && (_get(out, x, y) == _get(frame_b, x, y)) != (x < elapsed * WIDTH / DURATION_US)) errors++;
+                #if PIXEL_BYTES != 0
+                if (transition == 2 && running) {
+                    int alpha = elapsed * 256 / DURATION_US;
+                    for (int i = 0; i < PIXEL_BYTES; i++) {
+                        int offset = x * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + y * PIXEL_BYTES + i;
+                        if (out[offset] != (uint8_t)(frame_a[offset] + (((frame_b[offset] - frame_a[offset]) * alpha) >> 8))) errors++;
+                    }
+                }
+                #endif
+            }
+        }
+        if (touched) steps++;
+        if (!changed && memcmp(prev, out, sizeof(out)) != 0) errors++;
+        if (transition != 2 && done < prevDone) errors++;
+        prevDone = done;
+    }
+    CHECK_EQ_INT(errors, 0);
+    CHECK(memcmp(out, frame_b, sizeof(out)) == 0);
+    // Instant finishes in the first step, the others take several
+    if (transition == 0) CHECK_EQ_INT(steps, 1);
+    else CHECK(steps > 10);
+
+    // Nothing changes once the transition is done
+    CHECK_EQ_INT(transition_update(out, frame_b, json, START_US + 2 * DURATION_US), 0);
+    cJSON_Delete(json);
+    transition_deinit();
+}
+
+static void test_transitions(void) {
+    srand(1);
+    for (uint32_t i = 0; i < sizeof(frame_a); i++) frame_a[i] = rand();
+    for (uint32_t i = 0; i < sizeof(frame_b); i++) frame_b[i] = rand();
+    // Every other column is the same in both frames
+    for (int x = 0; x < WIDTH; x += 2) {
+        for (int y = 0; y < HEIGHT; y++) _copy(frame_b, frame_a, x, y);
+    }
+    #if PIXEL_BYTES == 0
+    // Padding bits that aren't pixels
+    for (int x = 0; x < WIDTH; x++) {
+        for (int y = HEIGHT; y < DISPLAY_FRAME_HEIGHT_PIXEL_BYTES * 8; y++) _copy(frame_b, frame_a, x, y);
+    }
+    #endif
+
+    for (int transition = 0; transition <= 3; transition++) _run(transition);
+}
+
+static void test_interrupted(void) {
+    // A new frame during a transition starts the next one from the current output
+    CHECK_EQ_INT(transition_init(WIDTH, HEIGHT, NULL, 0), ESP_OK);
+    cJSON* json = _transition_json(3, DURATION_US / 1000);
+    transition_update(out, frame_a, NULL, 0);
+    transition_update(out, frame_b, json, START_US);
+    transition_update(out, frame_b, json, START_US + DURATION_US / 2);
+    CHECK(memcmp(out, frame_a, sizeof(out)) != 0);
+    CHECK(memcmp(out, frame_b, sizeof(out)) != 0);
+    CHECK_EQ_INT(transition_update(out, frame_a, json, START_US + DURATION_US), 0);
+    CHECK_EQ_INT(transition_update(out, frame_a, json, START_US + DURATION_US * 3 / 2), 1);
+    CHECK(memcmp(out, frame_a, sizeof(out)) != 0);
+    transition_update(out, frame_a, json, START_US + 2 * DURATION_US);
+    CHECK(memcmp(out, frame_a, sizeof(out)) == 0);
+    cJSON_Delete(json);
+    transition_deinit();
+}
+
+static void test_invalid(void) {
+    // Unknown transitions and missing durations switch instantly
+    CHECK_EQ_INT(transition_init(WIDTH, HEIGHT, NULL, 0), ESP_OK);
+    transition_update(out, frame_a, NULL, 0);
+    cJSON* json = _transition_json(42, 100);
+    CHECK_EQ_INT(transition_update(out, frame_b, json, START_US), 1);
+    CHECK(memcmp(out, frame_b, sizeof(out)) == 0);
+    cJSON_Delete(json);
+    json = _transition_json(1, 0);
+    CHECK_EQ_INT(transition_update(out, frame_a, json, START_US), 1);
+    CHECK(memcmp(out, frame_a, sizeof(out)) == 0);
+    cJSON_Delete(json);
+    transition_deinit();
+
+    // Without init, frames are copied as they are
+    memset(out, 0, sizeof(out));
+    CHECK_EQ_INT(transition_update(out, frame_b, NULL, 0), 1);
+    CHECK(memcmp(out, frame_b, sizeof(out)) == 0);
+    CHECK_EQ_INT(transition_update(out, frame_b, NULL, 0), 0);
+}
+
+#if PIXEL_BYTES != 0
+static void test_active_pixels(void) {
+    // Inactive pixels keep the old value until the transition ends
+    uint16_t activePixels[] = {0, 3 * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + PIXEL_BYTES, 5 * DISPLAY_FRAME_HEIGHT_PIXEL_BYTES + 2 * PIXEL_BYTES};
+    CHECK_EQ_INT(transition_init(WIDTH, HEIGHT, activePixels, 3), ESP_OK);
+    cJSON* json = _transition_json(1, DURATION_US / 1000);
+    transition_update(out, frame_a, NULL, 0);
+    transition_update(out, frame_b, json, START_US);
+    transition_update(out, frame_b, json, START_US + DURATION_US - 1);
+    CHECK_EQ_INT(_get(out, 3, 1), _get(frame_b, 3, 1));
+    CHECK_EQ_INT(_get(out, 5, 2), _get(frame_b, 5, 2));
+    CHECK_EQ_INT(_get(out, 7, 3), _get(frame_a, 7, 3));
+    transition_update(out, frame_b, json, START_US + DURATION_US);
+    CHECK(memcmp(out, frame_b, sizeof(out)) == 0);
+    cJSON_Delete(json);
+    transition_deinit();
+}
+#endif
+
+int main(void) {
+    test_transitions();
+    test_interrupted();
+    test_invalid();
+    #if PIXEL_BYTES != 0
+    test_active_pixels();
+    #endif
+    return TEST_RESULT();
+}
@@ -0,0 +1,69 @@
+#include "test_common.h"
+#include "util_buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Change detection on the final character output of character displays.
+ */
+
+#define SIZE 16
+
+static void test_changes(void) {
+    buffer_char_output_t output;
+    uint8_t chars[SIZE];
+    uint16_t quirkFlags[SIZE];
+    memset(chars, 'A', sizeof(chars));
+    memset(quirkFlags, 0, sizeof(quirkFlags));
+    CHECK_EQ_INT(buffer_char_output_init(&output, SIZE), ESP_OK);
+
+    // The first output is always a change
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 0);
+
+    // A change and going back are both picked up
+    chars[SIZE - 1] = 'B';
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 0);
+    chars[SIZE - 1] = 'A';
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 0);
+
+    // Quirk flags count as output
+    quirkFlags[3] = 0x100;
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 0);
+
+    // The stored output is a copy, not the caller's buffer
+    uint8_t other[SIZE];
+    memcpy(other, chars, sizeof(other));
+    CHECK_EQ_INT(buffer_char_output_changed(&output, other, quirkFlags, SIZE), 0);
+
+    // Something else affecting the output changed
+    buffer_char_output_invalidate(&output);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 0);
+
+    // A buffer of a different size can't be compared
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE - 1), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE - 1), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 0);
+
+    free(output.charBuf);
+    free(output.quirkFlagBuf);
+}
+
+static void test_no_memory(void) {
+    // Without a copy, every call is a change
+    buffer_char_output_t output = {0};
+    uint8_t chars[SIZE] = {0};
+    uint16_t quirkFlags[SIZE] = {0};
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+    CHECK_EQ_INT(buffer_char_output_changed(&output, chars, quirkFlags, SIZE), 1);
+}
+
+int main(void) {
+    test_changes();
+    test_no_memory();
+    return TEST_RESULT();
+}
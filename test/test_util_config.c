@@ -0,0 +1,266 @@
+#include "test_common.h"
+#include "util_config.h"
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * The config registry on top of an in-memory NVS: typed reads from RAM,
+ * type and range checks, transactions across threads, rollback and notifications.
+ */
+
+static nvs_handle_t handle = 1;
+
+static int changes_playlist = 0;
+static int changes_hostname = 0;
+static int changes_any = 0;
+static char last_key[32];
+
+static void _on_change(const char* key, void* arg) {
+    (*(int*)arg)++;
+    snprintf(last_key, sizeof(last_key), "%s", key);
+}
+
+static void _on_any_change(const char* key, void* arg) {
+    // Runs outside of the locks, so reading and starting a transaction work
+    uint8_t value;
+    config_get_u8("playlist_active", &value);
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    config_abort();
+    changes_any++;
+}
+
+static esp_err_t other_ret;
+static volatile int other_done;
+
+static void* _set_from_other_thread(void* arg) {
+    other_ret = config_set_int("deflt_bright", 1);
+    return NULL;
+}
+
+static void* _transaction_from_other_thread(void* arg) {
+    config_begin();
+    config_set_int("tg_deadtime", 7);
+    other_ret = config_commit();
+    other_done = 1;
+    return NULL;
+}
+
+static char* _nvs_str(const char* key) {
+    static char value[64];
+    size_t length = sizeof(value);
+    if (nvs_get_str(handle, key, value, &length) != ESP_OK) return NULL;
+    return value;
+}
+
+static int _str_is(const char* key, const char* expected) {
+    char* value = config_get_str_alloc(key);
+    int result = value != NULL && !strcmp(value, expected);
+    free(value);
+    return result;
+}
+
+static void test_init(void) {
+    nvs_stub_reset();
+    nvs_set_u8(handle, "playlist_active", 1);
+    nvs_set_str(handle, "hostname", "cheetah");
+    nvs_set_u16(handle, "ap_timeout", 300);
+    nvs_set_str(handle, "unknown_key", "x");
+    // Stored with the wrong type, so it counts as unset
+    nvs_set_u16(handle, "sta_retries", 3);
+    CHECK_EQ_INT(config_init(&handle), ESP_OK);
+
+    uint16_t numEntries;
+    const config_entry_t* entries = config_get_entries(&numEntries);
+    CHECK(numEntries > 30);
+    CHECK(entries[0].key != NULL);
+    CHECK(config_find_entry("wg_endpoint") != NULL && config_find_entry("wg_endpoint")->dataType == CONFIG_TYPE_STR);
+    CHECK(config_find_entry("deflt_bright") != NULL && config_find_entry("deflt_bright")->dataType == CONFIG_TYPE_U8);
+    CHECK(config_find_entry("unknown_key") == NULL);
+}
+
+static void test_read(void) {
+    uint8_t u8 = 0;
+    uint16_t u16 = 0;
+    int64_t number = 0;
+    char buf[64];
+    size_t length = sizeof(buf);
+    unsigned reads = nvs_stub_reads;
+
+    CHECK_EQ_INT(config_get_u8("playlist_active", &u8), ESP_OK);
+    CHECK_EQ_INT(u8, 1);
+    CHECK_EQ_INT(config_get_u16("ap_timeout", &u16), ESP_OK);
+    CHECK_EQ_INT(u16, 300);
+    CHECK_EQ_INT(config_get_int("playlist_active", &number), ESP_OK);
+    CHECK_EQ_INT(number, 1);
+    CHECK_EQ_INT(config_get_u8("sta_retries", &u8), ESP_ERR_NVS_NOT_FOUND);
+    CHECK_EQ_INT(config_get_u8("unknown_key", &u8), ESP_ERR_NVS_NOT_FOUND);
+
+    // The getters have to match the option's type
+    CHECK_EQ_INT(config_get_u16("playlist_active", &u16), ESP_ERR_NVS_TYPE_MISMATCH);
+    CHECK_EQ_INT(config_get_int("hostname", &number), ESP_ERR_NVS_TYPE_MISMATCH);
+    CHECK_EQ_INT(config_get_str("ap_timeout", buf, &length), ESP_ERR_NVS_TYPE_MISMATCH);
+    CHECK(config_get_str_alloc("ap_timeout") == NULL);
+
+    // Strings behave like nvs_get_str()
+    CHECK_EQ_INT(config_get_str("hostname", buf, &length), ESP_OK);
+    CHECK(!strcmp(buf, "cheetah"));
+    CHECK_EQ_INT(length, 8);
+    length = 4;
+    CHECK_EQ_INT(config_get_str("hostname", buf, &length), ESP_ERR_NVS_INVALID_LENGTH);
+    length = 0;
+    CHECK_EQ_INT(config_get_str("hostname", NULL, &length), ESP_OK);
+    CHECK_EQ_INT(length, 8);
+    CHECK_EQ_INT(config_get_str("ap_ssid", buf, &length), ESP_ERR_NVS_NOT_FOUND);
+    CHECK(_str_is("hostname", "cheetah"));
+    CHECK(config_get_str_alloc("ap_ssid") == NULL);
+
+    // Everything comes from RAM
+    for (int i = 0; i < 1000; i++) config_get_u8("playlist_active", &u8);
+    CHECK_EQ_INT(nvs_stub_reads, reads);
+}
+
+static void test_checks(void) {
+    pthread_t thread;
+
+    // Only inside a transaction, and only by the task that started it
+    CHECK_EQ_INT(config_set_int("deflt_bright", 5), ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(config_set_str("hostname", "x"), ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(config_commit(), ESP_ERR_INVALID_STATE);
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    pthread_create(&thread, NULL, _set_from_other_thread, NULL);
+    pthread_join(thread, NULL);
+    CHECK_EQ_INT(other_ret, ESP_ERR_INVALID_STATE);
+
+    CHECK_EQ_INT(config_set_int("ap_timeout", 65535), ESP_OK);
+    CHECK_EQ_INT(config_set_int("ap_timeout", 65536), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(config_set_int("deflt_bright", -1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(config_set_int("deflt_bright", 256), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(config_set_int("hostname", 1), ESP_ERR_NVS_TYPE_MISMATCH);
+    CHECK_EQ_INT(config_set_str("ap_timeout", "1"), ESP_ERR_NVS_TYPE_MISMATCH);
+    CHECK_EQ_INT(config_set_int("bogus", 1), ESP_ERR_NVS_NOT_FOUND);
+    CHECK_EQ_INT(config_set_str("bogus", "1"), ESP_ERR_NVS_NOT_FOUND);
+
+    // NVS limits strings to 4000 bytes including the terminator
+    char* longString = malloc(4001);
+    memset(longString, 'a', 4000);
+    longString[4000] = 0x00;
+    CHECK_EQ_INT(config_set_str("hostname", longString), ESP_ERR_NVS_VALUE_TOO_LONG);
+    longString[3999] = 0x00;
+    CHECK_EQ_INT(config_set_str("hostname", longString), ESP_OK);
+    free(longString);
+    config_abort();
+    CHECK(_str_is("hostname", "cheetah"));
+}
+
+static void test_commit(void) {
+    uint8_t u8 = 0;
+    CHECK_EQ_INT(config_subscribe("playlist_active", _on_change, &changes_playlist), ESP_OK);
+    CHECK_EQ_INT(config_subscribe("hostname", _on_change, &changes_hostname), ESP_OK);
+    CHECK_EQ_INT(config_subscribe(NULL, _on_any_change, NULL), ESP_OK);
+
+    // Unchanged values aren't written, the last staged value counts
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    CHECK_EQ_INT(config_set_int("playlist_active", 1), ESP_OK);
+    CHECK_EQ_INT(config_set_int("playlist_active", 0), ESP_OK);
+    CHECK_EQ_INT(config_set_str("hostname", "cheetah"), ESP_OK);
+    // Staged values aren't visible before the commit
+    CHECK_EQ_INT(config_get_u8("playlist_active", &u8), ESP_OK);
+    CHECK_EQ_INT(u8, 1);
+    nvs_stub_writes = 0;
+    CHECK_EQ_INT(config_commit(), ESP_OK);
+    CHECK_EQ_INT(nvs_stub_writes, 1);
+    CHECK_EQ_INT(changes_playlist, 1);
+    CHECK_EQ_INT(changes_hostname, 0);
+    CHECK_EQ_INT(changes_any, 1);
+    CHECK(!strcmp(last_key, "playlist_active"));
+    CHECK_EQ_INT(config_get_u8("playlist_active", &u8), ESP_OK);
+    CHECK_EQ_INT(u8, 0);
+    nvs_get_u8(handle, "playlist_active", &u8);
+    CHECK_EQ_INT(u8, 0);
+
+    // Strings
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    config_set_str("hostname", "other");
+    config_set_str("hostname", "final");
+    CHECK_EQ_INT(config_commit(), ESP_OK);
+    CHECK_EQ_INT(changes_hostname, 1);
+    CHECK(_str_is("hostname", "final"));
+    CHECK(!strcmp(_nvs_str("hostname"), "final"));
+
+    // Aborted and empty transactions change nothing
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    config_set_str("hostname", "zzz");
+    config_set_int("playlist_active", 1);
+    config_abort();
+    CHECK(_str_is("hostname", "final"));
+    nvs_stub_writes = 0;
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    CHECK_EQ_INT(config_commit(), ESP_OK);
+    CHECK_EQ_INT(nvs_stub_writes, 0);
+    CHECK_EQ_INT(changes_any, 2);
+}
+
+static void test_rollback(void) {
+    uint8_t u8 = 0;
+    uint16_t u16 = 0;
+
+    // The third write fails, the two before it are restored, the unset option is removed again
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    config_set_str("hostname", "new");
+    config_set_int("playlist_active", 1);
+    config_set_str("ap_ssid", "AP");
+    config_set_int("wg_keepalive", 25);
+    nvs_stub_writes = 0;
+    nvs_stub_fail_write = 3;
+    CHECK_EQ_INT(config_commit(), ESP_FAIL);
+    nvs_stub_fail_write = 0;
+
+    CHECK(!strcmp(_nvs_str("hostname"), "final"));
+    nvs_get_u8(handle, "playlist_active", &u8);
+    CHECK_EQ_INT(u8, 0);
+    CHECK(_nvs_str("ap_ssid") == NULL);
+    CHECK_EQ_INT(nvs_get_u16(handle, "wg_keepalive", &u16), ESP_ERR_NVS_NOT_FOUND);
+    CHECK(_str_is("hostname", "final"));
+    CHECK_EQ_INT(config_get_u8("playlist_active", &u8), ESP_OK);
+    CHECK_EQ_INT(u8, 0);
+    CHECK(config_get_str_alloc("ap_ssid") == NULL);
+    CHECK_EQ_INT(changes_playlist, 1);
+    CHECK_EQ_INT(changes_hostname, 1);
+    CHECK_EQ_INT(changes_any, 2);
+
+    // The staged values are gone, the next transaction starts empty
+    nvs_stub_writes = 0;
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    CHECK_EQ_INT(config_commit(), ESP_OK);
+    CHECK_EQ_INT(nvs_stub_writes, 0);
+}
+
+static void test_threads(void) {
+    pthread_t thread;
+    uint8_t u8 = 0;
+
+    // A second transaction waits until the first one has ended
+    CHECK_EQ_INT(config_begin(), ESP_OK);
+    other_done = 0;
+    pthread_create(&thread, NULL, _transaction_from_other_thread, NULL);
+    usleep(50000);
+    CHECK_EQ_INT(other_done, 0);
+    config_set_int("tg_deadtime", 3);
+    CHECK_EQ_INT(config_commit(), ESP_OK);
+    pthread_join(thread, NULL);
+    CHECK_EQ_INT(other_done, 1);
+    CHECK_EQ_INT(other_ret, ESP_OK);
+    CHECK_EQ_INT(config_get_u8("tg_deadtime", &u8), ESP_OK);
+    CHECK_EQ_INT(u8, 7);
+}
+
+int main(void) {
+    test_init();
+    test_read();
+    test_checks();
+    test_commit();
+    test_rollback();
+    test_threads();
+    return TEST_RESULT();
+}
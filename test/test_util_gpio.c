@@ -0,0 +1,119 @@
+#include "test_common.h"
+#include "gpio_stub.h"
+#include "util_gpio.h"
+
+/*
+ * GPIO bus and mask writes, checked against the transitions recorded by the GPIO stub.
+ */
+
+static void test_bus_init(void) {
+    const gpio_num_t pins[9] = {1, 2, 3, 4, 5, 6, 7, 8, 9};
+    gpio_bus_t bus;
+    gpio_stub_reset();
+    CHECK_EQ_INT(gpio_bus_init(&bus, pins, 0), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(gpio_bus_init(&bus, pins, 9), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(gpio_bus_init(&bus, pins, 8), ESP_OK);
+    for (int i = 0; i < 8; i++) CHECK_EQ_INT(gpio_stub_outputs[pins[i]], 1);
+    CHECK_EQ_INT(gpio_stub_outputs[pins[8]], 0);
+    free(bus.valueBits);
+}
+
+static void test_bus_write(void) {
+    // Pins in both banks and out of order
+    const gpio_num_t pins[5] = {33, 2, 21, 39, 0};
+    gpio_bus_t bus;
+    gpio_stub_reset();
+    CHECK_EQ_INT(gpio_bus_init(&bus, pins, 5), ESP_OK);
+    gpio_stub_levels[1] = 1;
+    gpio_stub_levels[34] = 1;
+
+    uint32_t wrongLevels = 0;
+    uint32_t tooManyWrites = 0;
+    for (uint32_t value = 0; value < 64; value++) {
+        uint32_t regWrites = gpio_stub_reg_writes;
+        gpio_bus_write(&bus, value);
+        // A clear and a set per bank at most
+        if (gpio_stub_reg_writes - regWrites > 4) tooManyWrites++;
+        // Bits beyond the bus are ignored
+        for (int i = 0; i < 5; i++) {
+            if (gpio_stub_levels[pins[i]] != ((value >> i) & 1)) wrongLevels++;
+        }
+    }
+    CHECK_EQ_INT(wrongLevels, 0);
+    CHECK_EQ_INT(tooManyWrites, 0);
+    // Other pins keep their level
+    CHECK_EQ_INT(gpio_stub_levels[1], 1);
+    CHECK_EQ_INT(gpio_stub_levels[34], 1);
+    CHECK_EQ_INT(gpio_stub_levels[3], 0);
+
+    // Writing the same value again doesn't cause any transitions
+    gpio_bus_write(&bus, 0x15);
+    uint32_t transitions = gpio_stub_num_transitions;
+    gpio_bus_write(&bus, 0x15);
+    CHECK_EQ_INT(gpio_stub_num_transitions, transitions);
+    free(bus.valueBits);
+}
+
+static void test_clear_before_set(void) {
+    // Switching between two enable lines never has both active, in the same bank or across banks
+    const gpio_num_t pins[3] = {5, 6, 35};
+    gpio_bus_t bus;
+    gpio_stub_reset();
+    CHECK_EQ_INT(gpio_bus_init(&bus, pins, 3), ESP_OK);
+    gpio_bus_write(&bus, 1 << 0);
+    uint32_t start = gpio_stub_num_transitions;
+    gpio_bus_write(&bus, 1 << 1);
+    gpio_bus_write(&bus, 1 << 2);
+    gpio_bus_write(&bus, 1 << 0);
+    CHECK_EQ_INT(gpio_stub_num_transitions - start, 6);
+    for (uint32_t i = start; i < gpio_stub_num_transitions; i += 2) {
+        CHECK_EQ_INT(gpio_stub_transitions[i].level, 0);
+        CHECK_EQ_INT(gpio_stub_transitions[i + 1].level, 1);
+    }
+    free(bus.valueBits);
+}
+
+static void test_write_mask(void) {
+    gpio_stub_reset();
+    gpio_write_mask(GPIO_BIT(3) | GPIO_BIT(40), 0);
+    CHECK_EQ_INT(gpio_stub_levels[3], 1);
+    CHECK_EQ_INT(gpio_stub_levels[40], 1);
+    CHECK_EQ_INT(gpio_stub_reg_writes, 2);
+    gpio_write_mask(GPIO_BIT(4), GPIO_BIT(3) | GPIO_BIT(40));
+    CHECK_EQ_INT(gpio_stub_levels[3], 0);
+    CHECK_EQ_INT(gpio_stub_levels[4], 1);
+    CHECK_EQ_INT(gpio_stub_levels[40], 0);
+    // Empty masks don't write anything
+    gpio_write_mask(0, 0);
+    CHECK_EQ_INT(gpio_stub_reg_writes, 5);
+}
+
+static void test_pulse_mask(void) {
+    gpio_stub_reset();
+    gpio_pulse_mask(GPIO_BIT(7) | GPIO_BIT(36), 1, 5, 10, 20);
+    CHECK_EQ_INT(gpio_stub_num_transitions, 4);
+    CHECK_EQ_INT(gpio_stub_transitions[0].time_us, 10);
+    CHECK_EQ_INT(gpio_stub_transitions[0].level, 1);
+    CHECK_EQ_INT(gpio_stub_transitions[3].time_us, 15);
+    CHECK_EQ_INT(gpio_stub_transitions[3].level, 0);
+    CHECK_EQ_INT(gpio_stub_time_us, 35);
+
+    // Active low
+    gpio_stub_reset();
+    gpio_write_mask(GPIO_BIT(7), 0);
+    gpio_pulse_mask(GPIO_BIT(7), 0, 5, 0, 0);
+    CHECK_EQ_INT(gpio_stub_num_transitions, 3);
+    CHECK_EQ_INT(gpio_stub_transitions[1].level, 0);
+    CHECK_EQ_INT(gpio_stub_transitions[2].level, 1);
+    CHECK_EQ_INT(gpio_stub_transitions[2].time_us - gpio_stub_transitions[1].time_us, 5);
+    CHECK_EQ_INT(gpio_stub_levels[7], 1);
+}
+
+int main(void) {
+    test_bus_init();
+    test_bus_write();
+    test_clear_before_set();
+    test_write_mask();
+    test_pulse_mask();
+    return TEST_RESULT();
+}
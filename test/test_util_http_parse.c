@@ -0,0 +1,164 @@
+#include "test_common.h"
+#include "util_http_parse.h"
+#include <string.h>
+
+/*
+ * Multipart bodies fed to the parser in pieces of every size, so the delimiters
+ * and part headers end up split at every position, and the Range and If-None-Match parsers.
+ */
+
+#define BOUNDARY "----WebKitFormBoundaryAbCdEf0123456789"
+#define CONTENT_TYPE "multipart/form-data; boundary=" BOUNDARY
+
+static uint8_t body[8000];
+static uint8_t file[4000];
+static uint8_t out[8000];
+
+static int _parse(http_multipart_t* parser, const char* contentType, const uint8_t* in, size_t len, size_t piece, size_t* outLen) {
+    /*
+     * Parse in pieces of the given size, 0 for random sizes up to 50 bytes.
+     * Returns -1 if the parser got stuck, otherwise whether the body is complete.
+     */
+    if (http_multipart_init(parser, contentType) != 0) return -1;
+    size_t pos = 0;
+    *outLen = 0;
+    while (pos < len) {
+        size_t n = piece ? piece : 1 + rand() % 50;
+        if (n > len - pos) n = len - pos;
+        size_t done = 0;
+        while (done < n) {
+            const uint8_t* data;
+            size_t dataLen;
+            size_t consumed = http_multipart_parse(parser, &in[pos + done], n - done, &data, &dataLen);
+            if (consumed == 0 && dataLen == 0) return -1;
+            memcpy(&out[*outLen], data, dataLen);
+            *outLen += dataLen;
+            done += consumed;
+        }
+        pos += n;
+    }
+    return parser->state == HTTP_MULTIPART_DONE;
+}
+
+static void test_multipart_split(void) {
+    const size_t pieces[] = {1, 2, 3, 7, 41, 42, 43, 44, 45, 1024, 0};
+    uint32_t failures = 0;
+    srand(3);
+    for (int trial = 0; trial < 300; trial++) {
+        // Mostly bytes that appear in the delimiter
+        size_t n = rand() % sizeof(file);
+        for (size_t i = 0; i < n; i++) {
+            int r = rand() % 10;
+            file[i] = r < 2 ? '\r' : r < 4 ? '\n' : r < 6 ? '-' : r < 7 ? BOUNDARY[rand() % strlen(BOUNDARY)] : rand();
+        }
+        // Plus a delimiter that is cut off after 0 to all but one of its bytes
+        if (n > 200) {
+            size_t at = rand() % (n - 100);
+            size_t k = rand() % (strlen(BOUNDARY) + 4);
+            memcpy(&file[at], "\r\n--" BOUNDARY, k);
+        }
+
+        size_t len = 0;
+        if (trial % 3 == 0) len += sprintf((char*)body, "preamble\r\n");
+        len += sprintf((char*)&body[len], "--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"file\"; filename=\"PLAY%d.TXT\"\r\nContent-Type: application/octet-stream\r\n\r\n", trial);
+        memcpy(&body[len], file, n);
+        len += n;
+        len += sprintf((char*)&body[len], "\r\n--" BOUNDARY "\r\nContent-Disposition: form-data; name=\"x\"\r\n\r\nignored\r\n--" BOUNDARY "--\r\n");
+
+        char filename[16];
+        sprintf(filename, "PLAY%d.TXT", trial);
+        for (unsigned i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+            http_multipart_t parser;
+            size_t outLen;
+            int ret = _parse(&parser, CONTENT_TYPE, body, len, pieces[i], &outLen);
+            if (ret != 1 || outLen != n || memcmp(out, file, n) != 0 || !parser.hasPart || strcmp(parser.filename, filename) != 0) {
+                printf("Trial %d, pieces of %zu bytes: %d, %zu of %zu bytes\n", trial, pieces[i], ret, outLen, n);
+                failures++;
+            }
+        }
+    }
+    CHECK_EQ_INT(failures, 0);
+}
+
+static void test_multipart_edge_cases(void) {
+    http_multipart_t parser;
+    size_t outLen;
+
+    // Truncated before the closing delimiter, the data up to the partial delimiter is returned
+    const char* truncated = "--abc\r\n\r\nDATA\r\n--ab";
+    CHECK_EQ_INT(_parse(&parser, "multipart/form-data; boundary=\"abc\"", (const uint8_t*)truncated, strlen(truncated), 1, &outLen), 0);
+    CHECK_EQ_INT(outLen, 4);
+    CHECK(!memcmp(out, "DATA", 4));
+
+    // No parts at all
+    const char* empty = "--abc--\r\n";
+    CHECK_EQ_INT(_parse(&parser, "multipart/form-data; boundary=abc", (const uint8_t*)empty, strlen(empty), 3, &outLen), 1);
+    CHECK_EQ_INT(outLen, 0);
+    CHECK(!parser.hasPart);
+
+    // Parameters after the boundary, and a long file name
+    const char* longName = "--abc\r\nContent-Disposition: form-data; name=\"f\"; filename=\"0123456789012345678901234567890123456789\"\r\n\r\nX\r\n--abc--";
+    CHECK_EQ_INT(_parse(&parser, "multipart/form-data; boundary=abc; charset=utf-8", (const uint8_t*)longName, strlen(longName), 5, &outLen), 1);
+    CHECK_EQ_INT(outLen, 1);
+    CHECK_EQ_INT(strlen(parser.filename), HTTP_MULTIPART_MAX_FILENAME_LEN);
+
+    // Unusable boundaries
+    CHECK_EQ_INT(http_multipart_init(&parser, "multipart/form-data"), -1);
+    CHECK_EQ_INT(http_multipart_init(&parser, "multipart/form-data; boundary="), -1);
+    CHECK_EQ_INT(http_multipart_init(&parser, "multipart/form-data; boundary=\"abc"), -1);
+    CHECK_EQ_INT(http_multipart_init(&parser, "multipart/form-data; boundary=01234567890123456789012345678901234567890123456789012345678901234567890"), -1);
+}
+
+static void test_range(void) {
+    size_t start = 0, end = 0;
+    CHECK_EQ_INT(http_parse_range("bytes=0-9", 100, &start, &end), 0);
+    CHECK(start == 0 && end == 9);
+    CHECK_EQ_INT(http_parse_range("bytes=90-200", 100, &start, &end), 0);
+    CHECK(start == 90 && end == 99);
+    CHECK_EQ_INT(http_parse_range("bytes=90-", 100, &start, &end), 0);
+    CHECK(start == 90 && end == 99);
+    CHECK_EQ_INT(http_parse_range("bytes=99-99", 100, &start, &end), 0);
+    CHECK(start == 99 && end == 99);
+    CHECK_EQ_INT(http_parse_range("bytes=-10", 100, &start, &end), 0);
+    CHECK(start == 90 && end == 99);
+    CHECK_EQ_INT(http_parse_range("bytes=-1000", 100, &start, &end), 0);
+    CHECK(start == 0 && end == 99);
+
+    // Not satisfiable
+    CHECK_EQ_INT(http_parse_range("bytes=100-", 100, &start, &end), -1);
+    CHECK_EQ_INT(http_parse_range("bytes=100-200", 100, &start, &end), -1);
+    CHECK_EQ_INT(http_parse_range("bytes=-0", 100, &start, &end), -1);
+    CHECK_EQ_INT(http_parse_range("bytes=0-0", 0, &start, &end), -1);
+    CHECK_EQ_INT(http_parse_range("bytes=-5", 0, &start, &end), -1);
+
+    // Ignored, the whole resource is sent
+    const char* ignored[] = {
+        "bytes=5-4", "bytes=0-1,5-6", "items=0-1", "bytes=a-1", "bytes=0-1x", "bytes=", "bytes=-",
+        "bytes= 0-1", "bytes=0-99999999999999999999999", "bytes=-99999999999999999999999"
+    };
+    for (unsigned i = 0; i < sizeof(ignored) / sizeof(ignored[0]); i++) {
+        CHECK_EQ_INT(http_parse_range(ignored[i], 100, &start, &end), -2);
+    }
+}
+
+static void test_etag(void) {
+    CHECK(http_etag_match("\"1a-2b\"", "\"1a-2b\""));
+    CHECK(http_etag_match("W/\"1a-2b\"", "\"1a-2b\""));
+    CHECK(http_etag_match("\"1a-2b\"", "W/\"1a-2b\""));
+    CHECK(http_etag_match("\"x\", \"1a-2b\"", "\"1a-2b\""));
+    CHECK(http_etag_match("\"x\",W/\"1a-2b\" ", "\"1a-2b\""));
+    CHECK(http_etag_match("*", "\"1a-2b\""));
+    CHECK(!http_etag_match("\"1a-2c\"", "\"1a-2b\""));
+    CHECK(!http_etag_match("\"1a-2b", "\"1a-2b\""));
+    CHECK(!http_etag_match("\"1a-2b\"x", "\"1a-2b\""));
+    CHECK(!http_etag_match("**", "\"1a-2b\""));
+    CHECK(!http_etag_match("", "\"1a-2b\""));
+}
+
+int main(void) {
+    test_multipart_split();
+    test_multipart_edge_cases();
+    test_range();
+    test_etag();
+    return TEST_RESULT();
+}
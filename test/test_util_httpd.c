@@ -0,0 +1,273 @@
+#include "test_common.h"
+#include "util_buffer.h"
+#include "util_httpd.h"
+#include <string.h>
+#include <sys/param.h>
+#include <unistd.h>
+#include <zlib.h>
+
+/*
+ * Binary request bodies received into a display buffer,
+ * plain, PackBits, deflate and base64 encoded, split into small receive chunks.
+ * Files sent with ETag and single ranges, from a temporary directory.
+ */
+
+#define BUF_SIZE 3000
+
+static uint8_t expected[BUF_SIZE];
+static uint8_t dest[BUF_SIZE];
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+static void _fill_expected(void) {
+    // Runs and noise, so both encodings have something to do
+    for (size_t i = 0; i < BUF_SIZE; i++) {
+        expected[i] = (i / 100) % 2 ? (uint8_t)(i * 37 + (i >> 3)) : (uint8_t)(i / 100);
+    }
+}
+
+static esp_err_t _recv(const uint8_t* body, size_t len, const char* encoding, size_t chunk, size_t* rxLen) {
+    httpd_req_t req;
+    httpd_fake_req_init(&req, body, len);
+    httpd_fake_req_set_hdr(&req, "Content-Type", "application/octet-stream");
+    if (encoding != NULL) httpd_fake_req_set_hdr(&req, "Content-Encoding", encoding);
+    req.recvChunk = chunk;
+    esp_err_t ret = httpd_recv_to_buffer("test", &req, dest, sizeof(dest), &lock, rxLen);
+    httpd_fake_req_free(&req);
+    return ret;
+}
+
+static esp_err_t _recv_base64(const char* body, size_t chunk, size_t* rxLen) {
+    httpd_req_t req;
+    httpd_fake_req_init(&req, body, strlen(body));
+    req.recvChunk = chunk;
+    esp_err_t ret = httpd_recv_base64_to_buffer("test", &req, dest, sizeof(dest), &lock, rxLen);
+    httpd_fake_req_free(&req);
+    return ret;
+}
+
+static size_t _rle_encode(uint8_t* out, size_t outSize) {
+    size_t inPos = 0;
+    size_t len = 0;
+    while (inPos < BUF_SIZE) len += buffer_rle_encode(expected, BUF_SIZE, &inPos, &out[len], MIN(outSize - len, 200));
+    return len;
+}
+
+static void test_plain(void) {
+    size_t rxLen = 0;
+    memset(dest, 0, sizeof(dest));
+    CHECK_EQ_INT(_recv(expected, 1000, NULL, 7, &rxLen), ESP_OK);
+    CHECK_EQ_INT(rxLen, 1000);
+    CHECK(!memcmp(dest, expected, 1000));
+
+    uint8_t tooLarge[BUF_SIZE + 1] = {0};
+    CHECK_EQ_INT(_recv(tooLarge, sizeof(tooLarge), NULL, 0, &rxLen), ESP_ERR_INVALID_SIZE);
+}
+
+static void test_rle(void) {
+    uint8_t encoded[BUF_SIZE * 2];
+    size_t len = _rle_encode(encoded, sizeof(encoded));
+    CHECK(len < BUF_SIZE);
+
+    size_t chunks[] = {1, 2, 3, 129, 1024};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        size_t rxLen = 0;
+        memset(dest, 0, sizeof(dest));
+        CHECK_EQ_INT(_recv(encoded, len, HTTPD_ENCODING_RLE, chunks[i], &rxLen), ESP_OK);
+        CHECK_EQ_INT(rxLen, BUF_SIZE);
+        CHECK(!memcmp(dest, expected, BUF_SIZE));
+    }
+
+    // Ending within a literal or before the value of a run
+    uint8_t literal[] = {0x03, 'a', 'b'};
+    uint8_t run[] = {0x00, 'a', 0xFE};
+    memset(dest, 0x55, sizeof(dest));
+    CHECK_EQ_INT(_recv(literal, sizeof(literal), HTTPD_ENCODING_RLE, 0, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(_recv(run, sizeof(run), HTTPD_ENCODING_RLE, 0, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(dest[0], 0x55);
+
+    uint8_t tooLarge[] = {0x81, 'a', 0x81, 'b', 0x81, 'c', 0x81, 'd', 0x81, 'e', 0x81, 'f', 0x81, 'g', 0x81, 'h', 0x81, 'i', 0x81, 'j', 0x81, 'k', 0x81, 'l', 0x81, 'm', 0x81, 'n', 0x81, 'o', 0x81, 'p', 0x81, 'q', 0x81, 'r', 0x81, 's', 0x81, 't', 0x81, 'u', 0x81, 'v', 0x81, 'w', 0x81, 'x'};
+    CHECK_EQ_INT(_recv(tooLarge, sizeof(tooLarge), HTTPD_ENCODING_RLE, 0, NULL), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ_INT(dest[0], 0x55);
+}
+
+static void test_deflate(void) {
+    uint8_t encoded[BUF_SIZE * 2];
+    uLongf len = sizeof(encoded);
+    CHECK_EQ_INT(compress2(encoded, &len, expected, BUF_SIZE, 9), Z_OK);
+
+    size_t chunks[] = {1, 5, 64, 1024};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        size_t rxLen = 0;
+        memset(dest, 0, sizeof(dest));
+        CHECK_EQ_INT(_recv(encoded, len, "deflate", chunks[i], &rxLen), ESP_OK);
+        CHECK_EQ_INT(rxLen, BUF_SIZE);
+        CHECK(!memcmp(dest, expected, BUF_SIZE));
+    }
+
+    // Truncated, corrupt and larger than the buffer, none of which may touch it
+    memset(dest, 0x55, sizeof(dest));
+    CHECK_EQ_INT(_recv(encoded, len - 10, "deflate", 64, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(_recv(encoded, len / 2, "deflate", 64, NULL), ESP_ERR_INVALID_ARG);
+    uint8_t corrupt[sizeof(encoded)];
+    memcpy(corrupt, encoded, len);
+    corrupt[len - 1] ^= 0xFF;
+    CHECK_EQ_INT(_recv(corrupt, len, "deflate", 64, NULL), ESP_ERR_INVALID_ARG);
+
+    uint8_t big[BUF_SIZE + 100] = {0};
+    len = sizeof(encoded);
+    CHECK_EQ_INT(compress2(encoded, &len, big, sizeof(big), 9), Z_OK);
+    CHECK_EQ_INT(_recv(encoded, len, "deflate", 64, NULL), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ_INT(dest[0], 0x55);
+    CHECK_EQ_INT(dest[BUF_SIZE - 1], 0x55);
+}
+
+static void test_base64(void) {
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    static char encoded[BUF_SIZE / 3 * 4 + BUF_SIZE / 76 + 8];
+    size_t len = 0;
+    for (size_t i = 0; i < BUF_SIZE; i += 3) {
+        uint32_t bits = (expected[i] << 16) | (expected[i + 1] << 8) | expected[i + 2];
+        for (int j = 3; j >= 0; j--) encoded[len++] = alphabet[(bits >> (6 * j)) & 0x3F];
+        // Line breaks as some encoders add them
+        if (i % 57 == 54) encoded[len++] = '\n';
+    }
+    encoded[len] = 0x00;
+
+    // Chunk sizes that split the quantums everywhere
+    size_t chunks[] = {1, 2, 3, 5, 1024};
+    for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        size_t rxLen = 0;
+        memset(dest, 0, sizeof(dest));
+        CHECK_EQ_INT(_recv_base64(encoded, chunks[i], &rxLen), ESP_OK);
+        CHECK_EQ_INT(rxLen, BUF_SIZE);
+        CHECK(!memcmp(dest, expected, BUF_SIZE));
+    }
+
+    // Padded and unpadded endings
+    size_t rxLen = 0;
+    CHECK_EQ_INT(_recv_base64("YWJjZA==", 1, &rxLen), ESP_OK);
+    CHECK_EQ_INT(rxLen, 4);
+    CHECK(!memcmp(dest, "abcd", 4));
+    CHECK_EQ_INT(_recv_base64("YWJjZGU=", 3, &rxLen), ESP_OK);
+    CHECK_EQ_INT(rxLen, 5);
+    CHECK(!memcmp(dest, "abcde", 5));
+    CHECK_EQ_INT(_recv_base64("YWJjZGU", 2, &rxLen), ESP_OK);
+    CHECK_EQ_INT(rxLen, 5);
+    CHECK(!memcmp(dest, "abcde", 5));
+
+    // Invalid characters, misplaced padding, truncation and too much data, none of which may touch the buffer
+    memset(dest, 0x55, sizeof(dest));
+    CHECK_EQ_INT(_recv_base64("YWJj*A==", 0, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(_recv_base64("YWJjZA==YWJj", 0, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(_recv_base64("YWJjZ===", 0, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(_recv_base64("YWJjZA=", 0, NULL), ESP_ERR_INVALID_ARG);
+    CHECK_EQ_INT(_recv_base64("YWJjZ", 0, NULL), ESP_ERR_INVALID_ARG);
+    encoded[len - 1] = '!';
+    CHECK_EQ_INT(_recv_base64(encoded, 64, NULL), ESP_ERR_INVALID_ARG);
+    encoded[len - 1] = 'A';
+    char* tooLarge = malloc(len + 5);
+    memcpy(tooLarge, encoded, len);
+    memcpy(&tooLarge[len], "AAAA", 5);
+    CHECK_EQ_INT(_recv_base64(tooLarge, 64, NULL), ESP_ERR_INVALID_SIZE);
+    free(tooLarge);
+    CHECK_EQ_INT(dest[0], 0x55);
+    CHECK_EQ_INT(dest[BUF_SIZE - 1], 0x55);
+}
+
+static void test_receive_error(void) {
+    httpd_req_t req;
+    httpd_fake_req_init(&req, expected, 1000);
+    req.recvChunk = 100;
+    req.failAt = 500;
+    CHECK_EQ_INT(httpd_recv_to_buffer("test", &req, dest, sizeof(dest), &lock, NULL), ESP_FAIL);
+    httpd_fake_req_free(&req);
+}
+
+static const char* _send_file(httpd_req_t* req, const char* path, const char* name, const char* value) {
+    // Returns the status, the response stays in req until httpd_fake_req_free()
+    httpd_fake_req_init(req, NULL, 0);
+    req->method = HTTP_GET;
+    if (name != NULL) httpd_fake_req_set_hdr(req, name, value);
+    httpd_send_file("test", req, path);
+    return req->status;
+}
+
+static void test_send_file(void) {
+    char dir[] = "/tmp/test_util_httpd_XXXXXX";
+    char path[64];
+    char emptyPath[64];
+    httpd_req_t req;
+    CHECK(mkdtemp(dir) != NULL);
+    snprintf(path, sizeof(path), "%s/FILE.BIN", dir);
+    snprintf(emptyPath, sizeof(emptyPath), "%s/EMPTY", dir);
+
+    // More than one file buffer
+    uint8_t file[5000];
+    for (size_t i = 0; i < sizeof(file); i++) file[i] = i * 7 + (i >> 8);
+    FILE* f = fopen(path, "wb");
+    fwrite(file, 1, sizeof(file), f);
+    fclose(f);
+    fclose(fopen(emptyPath, "wb"));
+
+    CHECK(!strcmp(_send_file(&req, path, NULL, NULL), "200 OK"));
+    CHECK(req.respDone);
+    CHECK_EQ_INT(req.respLen, sizeof(file));
+    CHECK(!memcmp(req.resp, file, sizeof(file)));
+    CHECK(!strcmp(httpd_fake_resp_hdr(&req, "Accept-Ranges"), "bytes"));
+    char etag[64];
+    snprintf(etag, sizeof(etag), "%s", httpd_fake_resp_hdr(&req, "ETag"));
+    CHECK(etag[0] == '"' && etag[strlen(etag) - 1] == '"');
+    httpd_fake_req_free(&req);
+
+    // Conditional
+    CHECK(!strcmp(_send_file(&req, path, "If-None-Match", etag), "304 Not Modified"));
+    CHECK_EQ_INT(req.respLen, 0);
+    CHECK(req.respDone);
+    httpd_fake_req_free(&req);
+    CHECK(!strcmp(_send_file(&req, path, "If-None-Match", "\"nope\""), "200 OK"));
+    CHECK_EQ_INT(req.respLen, sizeof(file));
+    httpd_fake_req_free(&req);
+
+    // Ranges
+    CHECK(!strcmp(_send_file(&req, path, "Range", "bytes=1000-4999"), "206 Partial Content"));
+    CHECK_EQ_INT(req.respLen, 4000);
+    CHECK(!memcmp(req.resp, &file[1000], 4000));
+    CHECK(!strcmp(httpd_fake_resp_hdr(&req, "Content-Range"), "bytes 1000-4999/5000"));
+    httpd_fake_req_free(&req);
+    CHECK(!strcmp(_send_file(&req, path, "Range", "bytes=-10"), "206 Partial Content"));
+    CHECK_EQ_INT(req.respLen, 10);
+    CHECK(!memcmp(req.resp, &file[sizeof(file) - 10], 10));
+    httpd_fake_req_free(&req);
+    CHECK(!strcmp(_send_file(&req, path, "Range", "bytes=5000-"), "416 Range Not Satisfiable"));
+    CHECK(!strcmp(httpd_fake_resp_hdr(&req, "Content-Range"), "bytes */5000"));
+    httpd_fake_req_free(&req);
+    CHECK(!strcmp(_send_file(&req, path, "Range", "bytes=0-1,4-5"), "200 OK"));
+    CHECK_EQ_INT(req.respLen, sizeof(file));
+    CHECK(httpd_fake_resp_hdr(&req, "Content-Range") == NULL);
+    httpd_fake_req_free(&req);
+
+    // Empty and missing files
+    CHECK(!strcmp(_send_file(&req, emptyPath, NULL, NULL), "200 OK"));
+    CHECK_EQ_INT(req.respLen, 0);
+    CHECK(req.respDone);
+    httpd_fake_req_free(&req);
+    CHECK(!strcmp(_send_file(&req, emptyPath, "Range", "bytes=0-"), "416 Range Not Satisfiable"));
+    httpd_fake_req_free(&req);
+    unlink(emptyPath);
+    CHECK(!strcmp(_send_file(&req, emptyPath, NULL, NULL), HTTPD_404));
+    httpd_fake_req_free(&req);
+
+    unlink(path);
+    rmdir(dir);
+}
+
+int main(void) {
+    _fill_expected();
+    test_plain();
+    test_rle();
+    test_deflate();
+    test_base64();
+    test_receive_error();
+    test_send_file();
+    return TEST_RESULT();
+}
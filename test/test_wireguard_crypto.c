@@ -0,0 +1,321 @@
+#include "test_common.h"
+#include "crypto/opt/blake2s-opt.h"
+#include "crypto/opt/chacha20poly1305-opt.h"
+#include "crypto/opt/x25519-opt.h"
+#include "crypto/refc/blake2s.h"
+#include "crypto/refc/chacha20poly1305.h"
+#include "crypto/refc/x25519.h"
+#include "nacl/crypto_scalarmult/curve25519/ref/crypto_scalarmult.h"
+#include <string.h>
+#include <time.h>
+
+/*
+ * Known answer tests for the optimized WireGuard crypto, and a comparison
+ * against the reference implementations for all lengths and alignments.
+ * The X25519 is also compared against the NaCl one the firmware can use.
+ * All of them are timed, the timings are informational only.
+ */
+
+static volatile uint8_t sink;
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t _hex(const char* str, uint8_t* out) {
+    size_t len = strlen(str) / 2;
+    for (size_t i = 0; i < len; i++) {
+        unsigned int value;
+        sscanf(&str[i * 2], "%2x", &value);
+        out[i] = value;
+    }
+    return len;
+}
+
+static void test_aead_vector(void) {
+    // RFC 8439 appendix A.5, the only AEAD vector with the 64 bit nonce WireGuard uses
+    const char* plaintext = "Internet-Drafts are draft documents valid for a maximum of six months and may be "
+        "updated, replaced, or obsoleted by other documents at any time. It is inappropriate to use "
+        "Internet-Drafts as reference material or to cite them other than as /\xe2\x80\x9cwork in progress./\xe2\x80\x9d";
+    uint8_t key[32];
+    uint8_t ad[12];
+    uint8_t expected[300];
+    uint8_t buf[300];
+    _hex("1c9240a5eb55d38af333888604f6b5f0473917c1402b80099dca5cbc207075c0", key);
+    _hex("f33388860000000000004e91", ad);
+    size_t len = _hex(
+        "64a0861575861af460f062c79be643bd5e805cfd345cf389f108670ac76c8cb24c6cfc18755d43eea09ee94e382d26b0"
+        "bdb7b73c321b0100d4f03b7f355894cf332f830e710b97ce98c8a84abd0b948114ad176e008d33bd60f982b1ff37c855"
+        "9797a06ef4f0ef61c186324e2b3506383606907b6a7c02b0f9f6157b53c867e4b9166c767b804d46a59b5216cde7a4e9"
+        "9040c5a40433225ee282a1b0a06c523eaf4534d7f83fa1155b0047718cbc546a0d072b04b3564eea1b422273f548271a"
+        "0bb2316053fa76991955ebd63159434ecebb4e466dae5a1073a6727627097a1049e617d91d361094fa68f0ff77987130"
+        "305beaba2eda04df997b714d6c6f2c29a6ad5cb4022b02709beead9d67890cbb22392336fea1851f38", expected);
+    uint64_t nonce = 0x0807060504030201ULL;
+    CHECK_EQ_INT(len, strlen(plaintext) + 16);
+
+    chacha20poly1305_opt_encrypt(buf, (const uint8_t*)plaintext, len - 16, ad, sizeof(ad), nonce, key);
+    CHECK(memcmp(buf, expected, len) == 0);
+    CHECK(chacha20poly1305_opt_decrypt(buf, expected, len, ad, sizeof(ad), nonce, key));
+    CHECK(memcmp(buf, plaintext, len - 16) == 0);
+
+    // In place
+    memcpy(buf, expected, len);
+    CHECK(chacha20poly1305_opt_decrypt(buf, buf, len, ad, sizeof(ad), nonce, key));
+    CHECK(memcmp(buf, plaintext, len - 16) == 0);
+
+    // Wrong tag, associated data or nonce, and input shorter than a tag
+    memcpy(buf, expected, len);
+    buf[len - 1] ^= 0x80;
+    CHECK(!chacha20poly1305_opt_decrypt(buf, buf, len, ad, sizeof(ad), nonce, key));
+    CHECK(!chacha20poly1305_opt_decrypt(buf, expected, len, ad, sizeof(ad) - 1, nonce, key));
+    CHECK(!chacha20poly1305_opt_decrypt(buf, expected, len, ad, sizeof(ad), nonce + 1, key));
+    CHECK(!chacha20poly1305_opt_decrypt(buf, expected, 15, ad, sizeof(ad), nonce, key));
+}
+
+static void test_xaead_vector(void) {
+    // draft-irtf-cfrg-xchacha-03 appendix A.3.1
+    const char* plaintext = "Ladies and Gentlemen of the class of '99: If I could offer you only one tip for the future, sunscreen would be it.";
+    uint8_t key[32];
+    uint8_t nonce[24];
+    uint8_t ad[12];
+    uint8_t expected[200];
+    uint8_t buf[200];
+    for (int i = 0; i < 32; i++) key[i] = 0x80 + i;
+    for (int i = 0; i < 24; i++) nonce[i] = 0x40 + i;
+    _hex("50515253c0c1c2c3c4c5c6c7", ad);
+    size_t len = _hex(
+        "bd6d179d3e83d43b9576579493c0e939572a1700252bfaccbed2902c21396cbb731c7f1b0b4aa6440bf3a82f4eda7e39"
+        "ae64c6708c54c216cb96b72e1213b4522f8c9ba40db5d945b11b69b982c1bb9e3f3fac2bc369488f76b2383565d3fff9"
+        "21f9664c97637da9768812f615c68b13b52ec0875924c1c7987947deafd8780acf49", expected);
+    CHECK_EQ_INT(len, strlen(plaintext) + 16);
+
+    xchacha20poly1305_opt_encrypt(buf, (const uint8_t*)plaintext, len - 16, ad, sizeof(ad), nonce, key);
+    CHECK(memcmp(buf, expected, len) == 0);
+    CHECK(xchacha20poly1305_opt_decrypt(buf, expected, len, ad, sizeof(ad), nonce, key));
+    CHECK(memcmp(buf, plaintext, len - 16) == 0);
+    nonce[23] ^= 1;
+    CHECK(!xchacha20poly1305_opt_decrypt(buf, expected, len, ad, sizeof(ad), nonce, key));
+}
+
+static void test_blake2s_vectors(void) {
+    uint8_t key[32];
+    uint8_t in[255];
+    uint8_t expected[32];
+    uint8_t out[32];
+    for (int i = 0; i < 32; i++) key[i] = i;
+    for (int i = 0; i < 255; i++) in[i] = i;
+
+    // RFC 7693 appendix B
+    _hex("508c5e8c327c14e2e1a72ba34eeb452f37458b209ed63a294d999b4c86675982", expected);
+    blake2s_opt(out, 32, NULL, 0, "abc", 3);
+    CHECK(memcmp(out, expected, 32) == 0);
+
+    // The keyed known answers from the BLAKE2 reference, first and last
+    _hex("48a8997da407876b3d79c0d92325ad3b89cbb754d86ab71aee047ad345fd2c49", expected);
+    blake2s_opt(out, 32, key, 32, in, 0);
+    CHECK(memcmp(out, expected, 32) == 0);
+    _hex("3fb735061abc519dfe979e54c1ee5bfad0a9d858b3315bad34bde999efd724dd", expected);
+    blake2s_opt(out, 32, key, 32, in, 255);
+    CHECK(memcmp(out, expected, 32) == 0);
+
+    // The same in uneven pieces
+    blake2s_opt_ctx ctx;
+    blake2s_opt_init(&ctx, 32, key, 32);
+    for (size_t pos = 0, step = 1; pos < 255; pos += step, step = step * 2 + 1) {
+        blake2s_opt_update(&ctx, &in[pos], (pos + step > 255) ? 255 - pos : step);
+    }
+    blake2s_opt_final(&ctx, out);
+    CHECK(memcmp(out, expected, 32) == 0);
+}
+
+static void test_against_reference(void) {
+    static uint8_t in[1700];
+    static uint8_t refOut[1700];
+    static uint8_t optOut[1700];
+    uint8_t key[32];
+    uint8_t ad[48];
+    uint32_t mismatches = 0;
+    uint32_t failed = 0;
+    srand(1);
+    for (int n = 0; n < 3000; n++) {
+        size_t len = rand() % 1600;
+        size_t adLen = rand() % sizeof(ad);
+        int inOffset = rand() % 4;
+        int outOffset = rand() % 4;
+        uint64_t nonce = ((uint64_t)rand() << 32) | rand();
+        for (size_t i = 0; i < len + inOffset; i++) in[i] = rand();
+        for (size_t i = 0; i < adLen; i++) ad[i] = rand();
+        for (int i = 0; i < 32; i++) key[i] = rand();
+
+        chacha20poly1305_encrypt(refOut, &in[inOffset], len, ad, adLen, nonce, key);
+        chacha20poly1305_opt_encrypt(&optOut[outOffset], &in[inOffset], len, ad, adLen, nonce, key);
+        if (memcmp(refOut, &optOut[outOffset], len + 16) != 0) mismatches++;
+        if (!chacha20poly1305_opt_decrypt(&optOut[outOffset], &optOut[outOffset], len + 16, ad, adLen, nonce, key)) failed++;
+        if (memcmp(&optOut[outOffset], &in[inOffset], len) != 0) mismatches++;
+
+        uint8_t refHash[32];
+        uint8_t optHash[32];
+        size_t keyLen = rand() % 33;
+        size_t hashLen = 1 + rand() % 32;
+        blake2s_ctx refCtx;
+        blake2s_opt_ctx optCtx;
+        blake2s_init(&refCtx, hashLen, key, keyLen);
+        blake2s_opt_init(&optCtx, hashLen, key, keyLen);
+        for (size_t pos = 0, step; pos < len; pos += step) {
+            step = 1 + rand() % (len - pos);
+            blake2s_update(&refCtx, &in[inOffset + pos], step);
+            blake2s_opt_update(&optCtx, &in[inOffset + pos], step);
+        }
+        blake2s_final(&refCtx, refHash);
+        blake2s_opt_final(&optCtx, optHash);
+        if (memcmp(refHash, optHash, hashLen) != 0) mismatches++;
+    }
+    CHECK_EQ_INT(mismatches, 0);
+    CHECK_EQ_INT(failed, 0);
+}
+
+static void test_x25519_vectors(void) {
+    // RFC 7748 section 5.2, the second one has the top bit of u set, which has to be ignored
+    // Then the key pairs and the shared secret from section 6.1
+    const char* vectors[][3] = {
+        {"a546e36bf0527c9d3b16154b82465edd62144c0ac1fc5a18506a2244ba449ac4", "e6db6867583030db3594c1a424b15f7c726624ec26b3353b10a903a6d0ab1c4c", "c3da55379de9c6908e94ea4df28d084f32eccf03491c71f754b4075577a28552"},
+        {"4b66e9d4d1b4673c5ad22691957d6af5c11b6421e0ea01d42ca4169e7918ba0d", "e5210f12786811d3f4b7959d0538ae2c31dbe7106fc03c3efc4cd549c715a493", "95cbde9476e8907d7aade45cb4b873f88b595a68799fa152e6f8f7647aac7957"},
+        {"77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", "0900000000000000000000000000000000000000000000000000000000000000", "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a"},
+        {"5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb", "0900000000000000000000000000000000000000000000000000000000000000", "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f"},
+        {"77076d0a7318a57d3c16c17251b26645df4c2f87ebc0992ab177fba51db92c2a", "de9edb7d7b7dc1b4d35b61c2ece435373f8343c85b78674dadfc7e146f882b4f", "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742"},
+        {"5dab087e624a8a4b79e17f8b83800ee66f3bb1292618b6fd1c2f8b27ff88e0eb", "8520f0098930a754748b7ddcb43ef75a0dbf3a0d26381af4eba4a98eaa9b4e6a", "4a5d9d5ba4ce2de1728e3bf480350f25e07e21c947d19e3376f09b3c1e161742"},
+    };
+    uint8_t scalar[32];
+    uint8_t point[32];
+    uint8_t expected[32];
+    uint8_t out[32];
+    for (size_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+        _hex(vectors[i][0], scalar);
+        _hex(vectors[i][1], point);
+        _hex(vectors[i][2], expected);
+        CHECK_EQ_INT(x25519_opt(out, scalar, point), 0);
+        CHECK(memcmp(out, expected, 32) == 0);
+    }
+
+    // RFC 7748 section 5.2, after 1 and 1000 iterations
+    uint8_t k[32] = {9};
+    uint8_t u[32] = {9};
+    for (int i = 1; i <= 1000; i++) {
+        x25519_opt(out, k, u);
+        memcpy(u, k, 32);
+        memcpy(k, out, 32);
+        if (i == 1) {
+            _hex("422c8e7a6227d7bca1350b3e2bb7279f7897b87bb6854b783c60e80311ae3079", expected);
+            CHECK(memcmp(k, expected, 32) == 0);
+        }
+    }
+    _hex("684cf59ba83309552800ef566f2f4d3c1c3887c49360e3875f2eb94d99532c51", expected);
+    CHECK(memcmp(k, expected, 32) == 0);
+
+    // A point of low order gives all zeros
+    memset(point, 0, sizeof(point));
+    CHECK_EQ_INT(x25519_opt(out, scalar, point), -1);
+}
+
+static void test_x25519_against_reference(void) {
+    uint8_t scalar[32];
+    uint8_t point[32];
+    uint8_t refOut[32];
+    uint8_t naclOut[32];
+    uint8_t optOut[32];
+    uint32_t mismatches = 0;
+    srand(2);
+    for (int n = 0; n < 300; n++) {
+        for (int i = 0; i < 32; i++) {
+            scalar[i] = rand();
+            point[i] = rand();
+        }
+        // Including the values just below the field prime
+        if (n % 7 == 0) memset(&point[1], 0xff, 31);
+        // The reference and NaCl don't ignore the top bit
+        point[31] &= 0x7f;
+        x25519(refOut, scalar, point, 1);
+        crypto_scalarmult(naclOut, scalar, point);
+        x25519_opt(optOut, scalar, point);
+        if (memcmp(refOut, optOut, 32) != 0) mismatches++;
+        if (memcmp(naclOut, optOut, 32) != 0) mismatches++;
+    }
+    CHECK_EQ_INT(mismatches, 0);
+}
+
+static void benchmark_aead_blake2s(void) {
+    // A keepalive, a small and a full size transport packet
+    const size_t sizes[] = {0, 64, 1420};
+    static uint8_t in[1420];
+    static uint8_t out[1420 + 16];
+    uint8_t key[32] = {1};
+    uint8_t hash[32];
+    const int n = 2000;
+    memset(in, 0x5a, sizeof(in));
+
+    printf("MB/s optimized / reference:\n");
+    for (size_t si = 0; si < sizeof(sizes) / sizeof(sizes[0]); si++) {
+        size_t len = sizes[si];
+        // Per call overhead counts too, so the tag is included in the length
+        double mb = (double)n * (len + 16) / 1e6;
+
+        double t0 = _now();
+        for (int i = 0; i < n; i++) chacha20poly1305_opt_encrypt(out, in, len, NULL, 0, i, key);
+        double t1 = _now();
+        for (int i = 0; i < n; i++) chacha20poly1305_encrypt(out, in, len, NULL, 0, i, key);
+        printf("chacha20poly1305 encrypt %zu bytes: %.1f / %.1f\n", len, mb / (t1 - t0), mb / (_now() - t1));
+
+        chacha20poly1305_opt_encrypt(out, in, len, NULL, 0, 0, key);
+        t0 = _now();
+        for (int i = 0; i < n; i++) sink = chacha20poly1305_opt_decrypt(in, out, len + 16, NULL, 0, 0, key);
+        t1 = _now();
+        for (int i = 0; i < n; i++) sink = chacha20poly1305_decrypt(in, out, len + 16, NULL, 0, 0, key);
+        printf("chacha20poly1305 decrypt %zu bytes: %.1f / %.1f\n", len, mb / (t1 - t0), mb / (_now() - t1));
+
+        mb = (double)n * (len + 32) / 1e6;
+        t0 = _now();
+        for (int i = 0; i < n; i++) blake2s_opt(hash, 32, key, 32, in, len);
+        t1 = _now();
+        for (int i = 0; i < n; i++) blake2s(hash, 32, key, 32, in, len);
+        printf("blake2s keyed %zu bytes: %.1f / %.1f\n", len, mb / (t1 - t0), mb / (_now() - t1));
+        sink = hash[0];
+    }
+}
+
+static void benchmark_x25519(void) {
+    // A handshake takes four scalar multiplications on each side
+    uint8_t scalar[32];
+    uint8_t point[32];
+    uint8_t out[32];
+    const int n = 100;
+    for (int i = 0; i < 32; i++) {
+        scalar[i] = i * 7;
+        point[i] = i * 13;
+    }
+    point[31] &= 0x7f;
+
+    double t0 = _now();
+    for (int i = 0; i < n; i++) x25519_opt(out, scalar, point);
+    double t1 = _now();
+    for (int i = 0; i < n; i++) x25519(out, scalar, point, 1);
+    double t2 = _now();
+    for (int i = 0; i < n; i++) crypto_scalarmult(out, scalar, point);
+    double t3 = _now();
+    sink = out[0];
+    printf("x25519 optimized / reference / NaCl: %.1f / %.1f / %.1f us\n",
+        (t1 - t0) / n * 1e6, (t2 - t1) / n * 1e6, (t3 - t2) / n * 1e6);
+}
+
+int main(void) {
+    test_aead_vector();
+    test_xaead_vector();
+    test_blake2s_vectors();
+    test_against_reference();
+    test_x25519_vectors();
+    test_x25519_against_reference();
+    benchmark_aead_blake2s();
+    benchmark_x25519();
+    return TEST_RESULT();
+}
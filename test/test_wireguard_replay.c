@@ -0,0 +1,161 @@
+#include "test_common.h"
+#include "wireguard.h"
+#include "crypto.h"
+#include <string.h>
+#include <time.h>
+
+/*
+ * WireGuard replay window against a simple model, and in place decryption.
+ * Built once per window size, see CMakeLists.txt.
+ * The receive path is timed with and without a separate buffer, the timing is informational only.
+ */
+
+#define PACKETS 50000
+#define MAX_SEQ 8000000
+
+// Platform functions used by wireguard.c
+uint32_t wireguard_sys_now() { return 0; }
+void wireguard_random_bytes(void *bytes, size_t size) { memset(bytes, 0x55, size); }
+void wireguard_tai64n_now(uint8_t *output) { memset(output, 0, 12); }
+bool wireguard_is_under_load() { return false; }
+
+static uint8_t seen[MAX_SEQ];
+
+static bool _model_check(uint64_t *newest, uint64_t counter) {
+    // Accept every counter that hasn't been seen and is no more than the window behind the newest one
+    if (seen[counter]) return false;
+    if (counter + WIREGUARD_REPLAY_WINDOW_SIZE < *newest) return false;
+    seen[counter] = 1;
+    if (counter > *newest) *newest = counter;
+    return true;
+}
+
+static void test_against_model(void) {
+    static struct wireguard_keypair keypair;
+    memset(&keypair, 0, sizeof(keypair));
+    memset(seen, 0, sizeof(seen));
+    uint64_t newest = 0;
+    uint64_t next = 0;
+    uint32_t mismatches = 0;
+    uint32_t accepted = 0;
+    uint32_t packets = 0;
+    srand(WIREGUARD_REPLAY_WINDOW_SIZE);
+    while (packets < PACKETS && next < MAX_SEQ - 3 * WIREGUARD_REPLAY_WINDOW_SIZE) {
+        uint64_t counter;
+        int choice = rand() % 100;
+        if (choice < 60) {
+            // In order
+            counter = next++;
+        } else if (choice < 85) {
+            // Reordered, around the edge of the window
+            counter = next + rand() % 8;
+            uint64_t behind = rand() % (WIREGUARD_REPLAY_WINDOW_SIZE + 40);
+            counter = (counter > behind) ? counter - behind : 0;
+        } else if (choice < 95) {
+            // Duplicate of a recent one
+            counter = (next > 0) ? next - 1 - rand() % (next < 4 ? next : 4) : 0;
+        } else if (choice < 99) {
+            // Skipping ahead
+            next += rand() % (2 * WIREGUARD_REPLAY_WINDOW_SIZE);
+            counter = next++;
+        } else {
+            // Way ahead, the whole window moves on
+            next += WIREGUARD_REPLAY_WINDOW_SIZE * 2 + rand() % 1000;
+            counter = next++;
+        }
+        bool expected = _model_check(&newest, counter);
+        bool result = wireguard_check_replay(&keypair, counter);
+        if (result != expected) mismatches++;
+        if (result) accepted++;
+        packets++;
+    }
+    printf("window %d: %u of %u packets accepted\n", WIREGUARD_REPLAY_WINDOW_SIZE, accepted, packets);
+    CHECK_EQ_INT(packets, PACKETS);
+    CHECK_EQ_INT(mismatches, 0);
+}
+
+static void test_window_edges(void) {
+    static struct wireguard_keypair keypair;
+    memset(&keypair, 0, sizeof(keypair));
+    CHECK(wireguard_check_replay(&keypair, 0));
+    CHECK(!wireguard_check_replay(&keypair, 0));
+    CHECK(wireguard_check_replay(&keypair, 10000));
+    // Exactly the window size behind is still accepted, one more isn't
+    CHECK(wireguard_check_replay(&keypair, 10000 - WIREGUARD_REPLAY_WINDOW_SIZE));
+    CHECK(!wireguard_check_replay(&keypair, 10000 - WIREGUARD_REPLAY_WINDOW_SIZE - 1));
+    CHECK(!wireguard_check_replay(&keypair, 10000 - WIREGUARD_REPLAY_WINDOW_SIZE));
+    CHECK(wireguard_check_replay(&keypair, 9999));
+    CHECK(!wireguard_check_replay(&keypair, 10000));
+    // The counter that wraps to 0 is rejected
+    CHECK(!wireguard_check_replay(&keypair, UINT64_MAX));
+}
+
+static void test_decrypt_in_place(void) {
+    static struct wireguard_keypair keypair;
+    uint8_t plaintext[300];
+    uint8_t buf[300 + WIREGUARD_AUTHTAG_LEN];
+    memset(&keypair, 0, sizeof(keypair));
+    for (int i = 0; i < WIREGUARD_SESSION_KEY_LEN; i++) keypair.sending_key[i] = keypair.receiving_key[i] = i * 7;
+    for (int i = 0; i < (int)sizeof(plaintext); i++) plaintext[i] = i;
+    keypair.sending_counter = 42;
+
+    // Decrypting into the buffer holding the ciphertext
+    wireguard_encrypt_packet(buf, plaintext, sizeof(plaintext), &keypair);
+    CHECK_EQ_INT(keypair.sending_counter, 43);
+    CHECK(wireguard_decrypt_packet(buf, buf, sizeof(buf), 42, &keypair));
+    CHECK(memcmp(buf, plaintext, sizeof(plaintext)) == 0);
+
+    // A forged packet leaves the buffer untouched
+    uint8_t forged[sizeof(buf)];
+    wireguard_encrypt_packet(buf, plaintext, sizeof(plaintext), &keypair);
+    buf[5] ^= 1;
+    memcpy(forged, buf, sizeof(buf));
+    CHECK(!wireguard_decrypt_packet(buf, buf, sizeof(buf), 43, &keypair));
+    CHECK(memcmp(buf, forged, sizeof(buf)) == 0);
+}
+
+static double _now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void benchmark_receive(void) {
+    // Each packet is copied into the receive buffer first, like lwIP does
+    // Then decrypted into a newly allocated buffer, like before, or in place
+    static struct wireguard_keypair keypair;
+    static uint8_t plaintext[1420];
+    static uint8_t packet[sizeof(plaintext) + WIREGUARD_AUTHTAG_LEN];
+    static uint8_t rx[sizeof(packet)];
+    const int n = 5000;
+    uint32_t failed = 0;
+    memset(&keypair, 0, sizeof(keypair));
+    for (int i = 0; i < WIREGUARD_SESSION_KEY_LEN; i++) keypair.sending_key[i] = keypair.receiving_key[i] = i * 3;
+    memset(plaintext, 0xa5, sizeof(plaintext));
+    wireguard_encrypt_packet(packet, plaintext, sizeof(plaintext), &keypair);
+
+    double t0 = _now();
+    for (int i = 0; i < n; i++) {
+        memcpy(rx, packet, sizeof(packet));
+        uint8_t *dst = malloc(sizeof(plaintext));
+        if (!dst || !wireguard_decrypt_packet(dst, rx, sizeof(rx), 0, &keypair)) failed++;
+        free(dst);
+    }
+    double t1 = _now();
+    for (int i = 0; i < n; i++) {
+        memcpy(rx, packet, sizeof(packet));
+        if (!wireguard_decrypt_packet(rx, rx, sizeof(rx), 0, &keypair)) failed++;
+    }
+    double t2 = _now();
+    printf("receive %zu bytes, separate buffer / in place: %.2f / %.2f us\n", sizeof(plaintext), (t1 - t0) / n * 1e6, (t2 - t1) / n * 1e6);
+    CHECK_EQ_INT(failed, 0);
+    CHECK(memcmp(rx, plaintext, sizeof(plaintext)) == 0);
+}
+
+int main(void) {
+    test_against_model();
+    test_window_edges();
+    test_decrypt_in_place();
+    benchmark_receive();
+    return TEST_RESULT();
+}